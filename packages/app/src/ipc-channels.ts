@@ -147,6 +147,12 @@ export type RendererChannels = {
   /** Executes an edit command on the browser window. */
   'execute-edit-command': IpcRendererMessage<EditCommand, void>;
 
+  /**
+   * Sorts strings the way the server's `unicode` collation does, in a single
+   * native call. The reply contains the strings in sorted order.
+   */
+  'sort-strings': IpcRendererMessage<readonly string[], string[]>;
+
   /**
    * Gets the initial application state, which includes its configuration and
    * other details necessary to perform the first render.
@@ -34,6 +34,9 @@ const DefaultConfig: AppConfig = {
     kind: 'local',
     database: {
       file: path.join(UserDataPath, 'dictionary.sqlite'),
+      // There is only one user, who rarely runs more than one expensive query
+      // at a time.
+      readWorkers: 2,
     },
   },
   login: {
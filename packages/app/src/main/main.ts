@@ -1,6 +1,7 @@
 import {BrowserWindow, app, dialog, nativeTheme} from 'electron';
 
 import {isMacOS} from '@condict/platform';
+import {sortStrings} from '@condict/server';
 
 import initConfig from './config';
 import initServer from './server';
@@ -86,6 +87,8 @@ const main = (): void => {
     e.sender[cmd]();
   });
 
+  ipc.handle('sort-strings', (_e, strings) => sortStrings(strings));
+
   ipc.handle('get-initial-state', async () => {
     const cfg = config.current;
 
@@ -1,8 +1,8 @@
-import {useMemo} from 'react';
+import {useEffect, useMemo, useState} from 'react';
 
 import {Form, useFormValue} from '../../form';
 
-import NeutralCollator from './neutral-collator';
+import {orderByName, sortStrings} from './collation';
 import {DefinitionTableFormData} from './types';
 
 const useActiveStemNames = (form: Form<any>): string[] => {
@@ -11,23 +11,40 @@ const useActiveStemNames = (form: Form<any>): string[] => {
     'inflectionTables'
   );
 
-  return useMemo(() => {
-    const active: string[] = [];
+  const active = useMemo(() => {
+    const names: string[] = [];
 
     const seen = new Set<string>();
     for (const table of inflectionTables) {
       for (const name of table.stems) {
         if (!seen.has(name)) {
-          active.push(name);
+          names.push(name);
           seen.add(name);
         }
       }
     }
-
-    // eslint-disable-next-line @typescript-eslint/unbound-method
-    active.sort(NeutralCollator.compare);
-    return active;
+    return names;
   }, [inflectionTables]);
+
+  // Until the sorted names arrive, we keep the previous order, and any new
+  // stems go last.
+  const [sortedNames, setSortedNames] = useState<readonly string[]>([]);
+  useEffect(() => {
+    let current = true;
+    void sortStrings(active).then(sorted => {
+      if (current) {
+        setSortedNames(sorted);
+      }
+    });
+    return () => {
+      current = false;
+    };
+  }, [active]);
+
+  return useMemo(
+    () => orderByName(active, sortedNames, name => name),
+    [active, sortedNames]
+  );
 };
 
 export default useActiveStemNames;
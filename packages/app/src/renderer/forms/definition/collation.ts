@@ -0,0 +1,33 @@
+import ipc from '../../ipc';
+
+/**
+ * Sorts strings the way the `unicode` collation used by @condict/server does,
+ * so that lists built here end up in the same order as lists from the server.
+ * The strings are sorted by the main process.
+ * @param strings The strings to sort.
+ * @return A promise that resolves to the strings in sorted order.
+ */
+export const sortStrings = (strings: readonly string[]): Promise<string[]> =>
+  ipc.invoke('sort-strings', strings);
+
+/**
+ * Orders items by name, in the order that the names have in `sortedNames`,
+ * which comes from `sortStrings`. Since sorting is asynchronous, the items may
+ * have changed since; names that aren't in `sortedNames` go last.
+ * @param items The items to order.
+ * @param sortedNames The names of the items in sorted order.
+ * @param getName Gets the name of an item.
+ * @return A new array with the items in order.
+ */
+export const orderByName = <T>(
+  items: readonly T[],
+  sortedNames: readonly string[],
+  getName: (item: T) => string
+): T[] => {
+  const ranks = new Map<string, number>(
+    sortedNames.map<[string, number]>((name, index) => [name, index])
+  );
+  const rankOf = (item: T) => ranks.get(getName(item)) ?? sortedNames.length;
+  // Array.prototype.sort is stable, so unknown names keep their order.
+  return items.slice().sort((a, b) => rankOf(a) - rankOf(b));
+};
@@ -8,7 +8,7 @@ import type {NewPartOfSpeech} from '../../panels';
 
 import {PartOfSpeechData, useCurrentPartsOfSpeech} from '../utils';
 
-import NeutralCollator from './neutral-collator';
+import {orderByName, sortStrings} from './collation';
 import {DefinitionFormState} from './types';
 
 export type Options = {
@@ -62,16 +62,22 @@ const usePartOfSpeechOptions = ({
               id: newPos.id,
               name: newPos.name,
             });
-            // Sort the list so the options end up in the order they'll probably
-            // be in once we reload.
-            draft.sort((a, b) => NeutralCollator.compare(a.name, b.name));
           });
         });
         // Always select the new part of speech.
         form.set('partOfSpeech', newPos.id);
+
+        // Sort the list so the options end up in the order they'll probably
+        // be in once we reload.
+        const names = partsOfSpeech.map(pos => pos.name).concat(newPos.name);
+        void sortStrings(names).then(sortedNames => {
+          setPartsOfSpeech(prevPartsOfSpeech =>
+            orderByName(prevPartsOfSpeech, sortedNames, pos => pos.name)
+          );
+        });
       }
     });
-  }, [openPanel, onCreatePartOfSpeech]);
+  }, [openPanel, onCreatePartOfSpeech, partsOfSpeech]);
 
   return {
     partsOfSpeech,
@@ -1,6 +1,12 @@
 {
   'variables': {
-    'group%': ''
+    'group%': '',
+    # Set to 1 to build the extension with timing and USDT probes in the
+    # collation code. See src-cpp/uca/profile.h.
+    'uca_profile%': 0,
+    # Set to 1 to build collation_fuzz for libFuzzer, which requires clang.
+    # See src-cpp/fuzz.cpp.
+    'libfuzzer%': 0,
   },
   'conditions': [
     ["group == 'test'", {
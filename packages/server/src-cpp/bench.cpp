@@ -0,0 +1,52 @@
+// Collation benchmarks. Results are printed as tab-separated lines of suite,
+// metric, value and unit. Run from the package directory.
+//
+// Usage: collation_bench [suite...]
+//
+// Runs the named suites, or all of them if none are given.
+
+#include <cstdio>
+#include <cstring>
+
+#include "bench/corpora.h"
+#include "bench/levels.h"
+#include "bench/sort.h"
+#include "bench/stages.h"
+#include "bench/tables.h"
+
+struct Suite {
+  const char* name;
+  void (*run)();
+};
+
+const Suite SUITES[] = {
+  { "tables", condict_bench::bench_tables },
+  { "levels", condict_bench::bench_levels },
+  { "stages", condict_bench::bench_stages },
+  { "corpora", condict_bench::bench_corpora },
+  { "sort", condict_bench::bench_sort },
+};
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    bool found = false;
+    for (const Suite &suite : SUITES) {
+      found = found || strcmp(argv[i], suite.name) == 0;
+    }
+    if (!found) {
+      fprintf(stderr, "Unknown suite: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  for (const Suite &suite : SUITES) {
+    bool selected = argc == 1;
+    for (int i = 1; i < argc; i++) {
+      selected = selected || strcmp(argv[i], suite.name) == 0;
+    }
+    if (selected) {
+      suite.run();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "common.h"
+
+#include <cstdio>
+#include <random>
+
+namespace condict_bench {
+  void report(
+    const char* suite,
+    const char* metric,
+    double value,
+    const char* unit
+  ) {
+    printf("%s\t%s\t%.3f\t%s\n", suite, metric, value, unit);
+  }
+
+  uint64_t count_code_points(const std::string &text) {
+    uint64_t count = 0;
+    for (char c : text) {
+      // Count lead bytes only.
+      count += (c & 0xC0) != 0x80;
+    }
+    return count;
+  }
+
+  void append_utf8(std::string &str, uint32_t cp) {
+    if (cp < 0x80) {
+      str.push_back((char) cp);
+    } else if (cp < 0x800) {
+      str.push_back((char) (0xC0 | (cp >> 6)));
+      str.push_back((char) (0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      str.push_back((char) (0xE0 | (cp >> 12)));
+      str.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+      str.push_back((char) (0x80 | (cp & 0x3F)));
+    } else {
+      str.push_back((char) (0xF0 | (cp >> 18)));
+      str.push_back((char) (0x80 | ((cp >> 12) & 0x3F)));
+      str.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+      str.push_back((char) (0x80 | (cp & 0x3F)));
+    }
+  }
+
+  std::vector<std::string> generate_words(
+    const std::vector<uint32_t> &alphabet,
+    uint32_t count,
+    uint32_t seed
+  ) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> words;
+    words.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      std::string word;
+      uint32_t len = 2 + rng() % 9;
+      for (uint32_t j = 0; j < len; j++) {
+        append_utf8(word, alphabet[rng() % alphabet.size()]);
+      }
+      words.push_back(std::move(word));
+    }
+    return words;
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace condict_bench {
+  // Prints a result as a tab-separated line: suite, metric, value, unit. The
+  // output is meant to be diffed and processed by scripts.
+  void report(
+    const char* suite,
+    const char* metric,
+    double value,
+    const char* unit
+  );
+
+  // Runs `run` `warmup` times without timing it, then `repetitions` times,
+  // and returns the duration of the fastest run in nanoseconds.
+  template<typename F>
+  double time_best(uint32_t warmup, uint32_t repetitions, F run) {
+    using std::chrono::steady_clock;
+
+    for (uint32_t i = 0; i < warmup; i++) {
+      run();
+    }
+    double best = 0;
+    for (uint32_t rep = 0; rep < repetitions; rep++) {
+      auto start = steady_clock::now();
+      run();
+      auto end = steady_clock::now();
+      double ns = (double) std::chrono::duration_cast<
+        std::chrono::nanoseconds
+      >(end - start).count();
+      if (rep == 0 || ns < best) {
+        best = ns;
+      }
+    }
+    return best;
+  }
+
+  // Counts the code points in a string of valid UTF-8.
+  uint64_t count_code_points(const std::string &text);
+
+  // Appends the UTF-8 encoding of a code point to a string.
+  void append_utf8(std::string &str, uint32_t cp);
+
+  // Generates `count` random words, each made of 2 to 10 code points from
+  // `alphabet`. The result is the same every time for the same arguments.
+  std::vector<std::string> generate_words(
+    const std::vector<uint32_t> &alphabet,
+    uint32_t count,
+    uint32_t seed
+  );
+}
@@ -0,0 +1,367 @@
+#include "corpora.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "perf_counters.h"
+#include "stages.h"
+#include "../uca/uca.h"
+#include "../uca/utf8.h"
+
+namespace condict_bench {
+  constexpr const char* SUITE = "corpora";
+  constexpr uint32_t WORD_COUNT = 10000;
+  constexpr uint32_t WARMUP = 2;
+  constexpr uint32_t REPETITIONS = 10;
+
+  using condict_uca::Encoding;
+
+  using Alphabet = std::vector<uint32_t>;
+  using Words = std::vector<std::string>;
+
+  // Adds the code points from `from` to `to`, inclusive, `weight` times each,
+  // skipping `step - 1` code points between each one.
+  void add(
+    Alphabet &alphabet,
+    uint32_t from,
+    uint32_t to,
+    uint32_t weight = 1,
+    uint32_t step = 1
+  ) {
+    for (uint32_t cp = from; cp <= to; cp += step) {
+      for (uint32_t i = 0; i < weight; i++) {
+        alphabet.push_back(cp);
+      }
+    }
+  }
+
+  // Lemma lists are mostly lower case, with the odd capitalized word and
+  // compound.
+  Words make_lemmas(
+    const Alphabet &lower,
+    const Alphabet &upper,
+    uint32_t seed
+  ) {
+    Words words = generate_words(lower, WORD_COUNT, seed);
+    std::mt19937 rng(seed);
+    for (std::string &word : words) {
+      uint32_t kind = rng() % 20;
+      if (kind == 0) {
+        std::string capitalized;
+        append_utf8(capitalized, upper[rng() % upper.size()]);
+        word = capitalized + word;
+      } else if (kind == 1) {
+        word += rng() % 2 == 0 ? " " : "-";
+        word += generate_words(lower, 1, rng())[0];
+      }
+    }
+    return words;
+  }
+
+  Words latin_lemmas() {
+    Alphabet lower;
+    add(lower, 'a', 'z', 8);
+    add(lower, 0x00E0, 0x00FF); // Latin-1 letters
+    add(lower, 0x0101, 0x017F, 1, 2); // Latin Extended-A, small letters
+    Alphabet upper;
+    add(upper, 'A', 'Z');
+    return make_lemmas(lower, upper, 11);
+  }
+
+  Words cyrillic_lemmas() {
+    Alphabet lower;
+    add(lower, 0x0430, 0x044F, 4);
+    add(lower, 0x0451, 0x045F); // ё and friends
+    Alphabet upper;
+    add(upper, 0x0410, 0x042F);
+    return make_lemmas(lower, upper, 12);
+  }
+
+  Words greek_lemmas() {
+    Alphabet lower;
+    add(lower, 0x03B1, 0x03C9, 4);
+    add(lower, 0x03AC, 0x03AF); // With tonos, which decompose
+    add(lower, 0x03CA, 0x03CE);
+    Alphabet upper;
+    add(upper, 0x0391, 0x03A1);
+    add(upper, 0x03A3, 0x03A9);
+    return make_lemmas(lower, upper, 13);
+  }
+
+  Words korean_lemmas() {
+    Alphabet syllables;
+    add(syllables, 0xAC00, 0xD7A3, 1, 7);
+    return generate_words(syllables, WORD_COUNT, 14);
+  }
+
+  Words cjk_lemmas() {
+    Alphabet ideographs;
+    add(ideographs, 0x4E00, 0x9FFF, 1, 13); // CJK Unified Ideographs
+    add(ideographs, 0x3400, 0x4DBF, 1, 29); // Extension A
+    return generate_words(ideographs, WORD_COUNT, 15);
+  }
+
+  // Constructed scripts are often encoded in the Private Use Area, and mixed
+  // with combining marks and punctuation from elsewhere.
+  Words pua_lemmas() {
+    Alphabet letters;
+    add(letters, 0xE000, 0xE07F, 2);
+    add(letters, 0x0300, 0x0304);
+    letters.push_back('\'');
+    letters.push_back('-');
+    return generate_words(letters, WORD_COUNT, 16);
+  }
+
+  // Combining marks with different combining classes, which NFD must reorder.
+  const uint32_t MARKS[] = {
+    0x0300, 0x0301, 0x0308, // 230, above
+    0x0316, 0x0323, // 220, below
+    0x0327, 0x0328, // 202, attached below
+    0x031B, // 216, attached above right
+    0x0345, // 240, iota subscript
+    0x0338, // 1, overlay
+  };
+  constexpr uint32_t MARK_COUNT = sizeof(MARKS) / sizeof(MARKS[0]);
+
+  void append_marks(std::string &word, std::mt19937 &rng, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      append_utf8(word, MARKS[rng() % MARK_COUNT]);
+    }
+  }
+
+  Words combining_words() {
+    std::mt19937 rng(17);
+    Words words;
+    words.reserve(WORD_COUNT);
+    for (uint32_t i = 0; i < WORD_COUNT; i++) {
+      std::string word;
+      uint32_t len = 2 + rng() % 7;
+      for (uint32_t j = 0; j < len; j++) {
+        word.push_back((char) ('a' + rng() % 26));
+        append_marks(word, rng, rng() % 5);
+      }
+      words.push_back(std::move(word));
+    }
+    return words;
+  }
+
+  // Pairs of strings that make comparisons do as much work as possible. The
+  // strings of a pair are next to each other.
+  Words pathological_words() {
+    std::mt19937 rng(18);
+    Words words;
+    words.reserve(WORD_COUNT);
+    std::string prefix(200, 'a');
+    while (words.size() + 2 <= WORD_COUNT) {
+      std::string a;
+      std::string b;
+      switch (words.size() / 2 % 5) {
+        case 0:
+          // A long shared prefix.
+          a = prefix + (char) ('a' + rng() % 26);
+          b = prefix + (char) ('a' + rng() % 26);
+          break;
+        case 1:
+          // Long runs of non-starters.
+          a = "o";
+          append_marks(a, rng, 32);
+          b = "o";
+          append_marks(b, rng, 32);
+          break;
+        case 2:
+          // Invalid UTF-8.
+          a = "ab\xC3\x28" "cd\xE2\x82" "ef\xF0\x9F\x98";
+          b = "ab\xC3\x28" "cd\xFF" "ef";
+          break;
+        case 3:
+          // Differences in variable elements only, which are only seen at
+          // the quaternary level.
+          a = "co-op re-enter" + std::string(8, '-');
+          b = "co op re enter" + std::string(8, ' ');
+          break;
+        case 4:
+          // Canonically equivalent strings, which compare equal, and only
+          // the tie breaker tells apart.
+          for (uint32_t i = 0; i < 20; i++) {
+            a += "\xC3\xA9"; // U+00E9
+            b += "e\xCC\x81"; // U+0065 U+0301
+          }
+          break;
+      }
+      words.push_back(std::move(a));
+      words.push_back(std::move(b));
+    }
+    return words;
+  }
+
+  std::string join(const Words &words) {
+    std::string text;
+    for (const std::string &word : words) {
+      text += word;
+      text.push_back(' ');
+    }
+    return text;
+  }
+
+  using CompareFn = int (*)(int, const char*, int, const char*, Encoding);
+
+  // Converts a word to UTF-16LE.
+  std::string to_utf16le(const std::string &word) {
+    std::string result;
+    auto push_unit = [&](uint32_t unit) {
+      result.push_back((char) (unit & 0xFF));
+      result.push_back((char) (unit >> 8));
+    };
+    condict_uca::utf8::CodePointIter iter((int) word.size(), word.data());
+    uint32_t cp;
+    while (iter.next(cp)) {
+      if (cp >= 0x10000) {
+        push_unit(0xD800 | ((cp - 0x10000) >> 10));
+        push_unit(0xDC00 | (cp & 0x3FF));
+      } else {
+        push_unit(cp);
+      }
+    }
+    return result;
+  }
+
+  // Compares every word to the next, and reports the time per code point of
+  // input and per comparison. If `encoding` is not UTF-8, the words are
+  // converted to it first.
+  void bench_compare(
+    const char* corpus,
+    const char* name,
+    const Words &words,
+    CompareFn compare,
+    bool report_counters,
+    Encoding encoding = Encoding::UTF8
+  ) {
+    uint64_t code_points = 0;
+    for (size_t i = 1; i < words.size(); i++) {
+      code_points +=
+        count_code_points(words[i - 1]) + count_code_points(words[i]);
+    }
+    double compares = (double) (words.size() - 1);
+
+    Words converted;
+    if (encoding == Encoding::UTF16LE) {
+      converted.reserve(words.size());
+      for (const std::string &word : words) {
+        converted.push_back(to_utf16le(word));
+      }
+    }
+    const Words &input = encoding == Encoding::UTF8 ? words : converted;
+
+    int sink = 0;
+    auto run = [&]() {
+      for (size_t i = 1; i < input.size(); i++) {
+        sink += compare(
+          (int) input[i - 1].size(), input[i - 1].data(),
+          (int) input[i].size(), input[i].data(),
+          encoding
+        );
+      }
+    };
+    double ns = time_best(WARMUP, REPETITIONS, run);
+
+    std::string metric = std::string(corpus) + "_" + name;
+    report(SUITE, metric.c_str(), ns / code_points, "ns/cp");
+    report(
+      SUITE,
+      (metric + "_per_compare").c_str(),
+      ns / compares,
+      "ns/compare"
+    );
+
+    if (report_counters) {
+      PerfCounters counters;
+      if (counters.any_available()) {
+        counters.start();
+        run();
+        counters.stop();
+        report_perf_counters(
+          SUITE,
+          metric.c_str(),
+          counters,
+          (double) code_points,
+          "cp"
+        );
+      }
+    }
+    // Keep the comparisons from being optimized away.
+    report(SUITE, (metric + "_checksum").c_str(), sink, "");
+  }
+
+  void bench_text(
+    const char* corpus,
+    const char* name,
+    const std::string &text,
+    uint64_t (*run)(const std::string &)
+  ) {
+    uint64_t sink = 0;
+    double ns = time_best(WARMUP, REPETITIONS, [&]() {
+      sink += run(text);
+    });
+
+    std::string metric = std::string(corpus) + "_" + name;
+    report(SUITE, metric.c_str(), ns / count_code_points(text), "ns/cp");
+    report(SUITE, (metric + "_checksum").c_str(), (double) (sink & 0xFFFF), "");
+  }
+
+  // If `sort` is true, also compares the words in sorted order.
+  void bench_corpus(const char* corpus, Words words, bool sort) {
+    // In random order, most comparisons are decided by the first letter.
+    bench_compare(corpus, "compare", words, condict_uca::compare, true);
+    bench_compare(corpus, "compare_tb", words, condict_uca::compare_tb, false);
+    bench_compare(
+      corpus,
+      "compare_utf16le",
+      words,
+      condict_uca::compare,
+      false,
+      Encoding::UTF16LE
+    );
+
+    if (sort) {
+      // Neighbours in sorted order share prefixes, as keys that are close
+      // together in an index do.
+      std::sort(
+        words.begin(),
+        words.end(),
+        [](const std::string &a, const std::string &b) {
+          return condict_uca::compare(
+            (int) a.size(), a.data(),
+            (int) b.size(), b.data()
+          ) < 0;
+        }
+      );
+      bench_compare(
+        corpus,
+        "compare_sorted",
+        words,
+        condict_uca::compare,
+        false
+      );
+    }
+
+    std::string text = join(words);
+    bench_text(corpus, "utf8", text, run_utf8);
+    bench_text(corpus, "nfd", text, run_nfd);
+  }
+
+  void bench_corpora() {
+    bench_corpus("latin", latin_lemmas(), true);
+    bench_corpus("cyrillic", cyrillic_lemmas(), true);
+    bench_corpus("greek", greek_lemmas(), true);
+    bench_corpus("korean", korean_lemmas(), true);
+    bench_corpus("cjk", cjk_lemmas(), true);
+    bench_corpus("pua", pua_lemmas(), true);
+    bench_corpus("combining", combining_words(), true);
+    // Already in pairs; sorting would undo that.
+    bench_corpus("pathological", pathological_words(), false);
+  }
+}
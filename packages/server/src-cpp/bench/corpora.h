@@ -0,0 +1,8 @@
+#pragma once
+
+namespace condict_bench {
+  // Reports the throughput of comparisons (with and without tie breaking),
+  // NFD and UTF-8 decoding on synthetic lemma lists in several scripts, as
+  // well as on text that is built to be hard on the collation code.
+  void bench_corpora();
+}
@@ -0,0 +1,116 @@
+#include "levels.h"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/uca.h"
+#include "../uca/weights.h"
+
+namespace condict_bench {
+  namespace weights = condict_uca::weights;
+
+  using std::chrono::steady_clock;
+
+  constexpr const char* SUITE = "levels";
+  constexpr uint32_t WORD_COUNT = 20000;
+  constexpr uint32_t REPETITIONS = 10;
+
+  const char* const KERNEL_NAMES[] = { "scalar", "sse4.1", "avx2" };
+
+  std::vector<uint32_t> latin_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 'a'; c <= 'z'; c++) {
+      alphabet.push_back(c);
+    }
+    return alphabet;
+  }
+
+  // Words that share a 40-letter prefix, so that every comparison has to go
+  // through several chunks of elements.
+  std::vector<std::string> shared_prefix_words() {
+    std::vector<std::string> prefix =
+      generate_words(latin_alphabet(), 8, 2);
+    std::string common;
+    for (auto &w : prefix) {
+      common += w;
+    }
+    common = common.substr(0, 40);
+
+    std::vector<std::string> words =
+      generate_words(latin_alphabet(), WORD_COUNT, 3);
+    for (auto &w : words) {
+      w = common + w;
+    }
+    return words;
+  }
+
+  // Pairs of words that only differ in the case of some letters, so that the
+  // tertiary level decides.
+  std::vector<std::string> case_pair_words() {
+    std::vector<std::string> words =
+      generate_words(latin_alphabet(), WORD_COUNT, 4);
+    std::mt19937 rng(5);
+    for (size_t i = 1; i < words.size(); i += 2) {
+      std::string w = words[i - 1] + words[i - 1];
+      for (char &c : w) {
+        if (rng() % 8 == 0) {
+          c = (char) (c - 'a' + 'A');
+        }
+      }
+      words[i - 1] += words[i - 1];
+      words[i] = w;
+    }
+    return words;
+  }
+
+  void bench_words(
+    const char* kernels_name,
+    const char* workload,
+    const std::vector<std::string> &words
+  ) {
+    int sink = 0;
+    auto start = steady_clock::now();
+    for (uint32_t rep = 0; rep < REPETITIONS; rep++) {
+      for (size_t i = 1; i < words.size(); i++) {
+        sink += condict_uca::compare(
+          (int) words[i - 1].size(), words[i - 1].data(),
+          (int) words[i].size(), words[i].data()
+        );
+      }
+    }
+    auto end = steady_clock::now();
+
+    double ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start
+    ).count();
+    double compares = (double) (words.size() - 1) * REPETITIONS;
+    std::string metric = std::string(workload) + "_" + kernels_name;
+    report(SUITE, metric.c_str(), ns / compares, "ns/compare");
+    // Keep the comparisons from being optimized away.
+    report(SUITE, (metric + "_checksum").c_str(), sink, "");
+  }
+
+  void bench_levels() {
+    std::vector<std::string> early =
+      generate_words(latin_alphabet(), WORD_COUNT, 1);
+    std::vector<std::string> shared = shared_prefix_words();
+    std::vector<std::string> cases = case_pair_words();
+
+    const weights::Kernels saved = weights::active;
+    for (const char* name : KERNEL_NAMES) {
+      const weights::Kernels* kernels = weights::find_kernels(name);
+      if (!kernels) {
+        continue;
+      }
+      weights::use_kernels(*kernels);
+      bench_words(name, "early_difference", early);
+      bench_words(name, "shared_prefix", shared);
+      bench_words(name, "case_only", cases);
+    }
+    weights::use_kernels(saved);
+  }
+}
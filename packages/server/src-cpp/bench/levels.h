@@ -0,0 +1,8 @@
+#pragma once
+
+namespace condict_bench {
+  // Reports the time per comparison with each implementation of the weight
+  // kernels that the CPU supports, for strings that differ early, strings
+  // with a long common prefix, and strings that only differ in case.
+  void bench_levels();
+}
@@ -0,0 +1,145 @@
+#include "perf_counters.h"
+
+#include <string>
+
+#include "common.h"
+
+#ifdef __linux__
+# include <cstring>
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+namespace condict_bench {
+  const char* const EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "ll_misses",
+  };
+
+  const char* const EVENT_UNITS[PERF_EVENT_COUNT] = {
+    "cycles",
+    "instructions",
+    "misses",
+    "misses",
+  };
+
+#ifdef __linux__
+  int open_counter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  int open_cache_counter(uint64_t cache) {
+    return open_counter(
+      PERF_TYPE_HW_CACHE,
+      cache |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    );
+  }
+
+  PerfCounters::PerfCounters() {
+    this->fds[(uint32_t) PerfEvent::CYCLES] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    this->fds[(uint32_t) PerfEvent::INSTRUCTIONS] =
+      open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    this->fds[(uint32_t) PerfEvent::L1D_MISSES] =
+      open_cache_counter(PERF_COUNT_HW_CACHE_L1D);
+    this->fds[(uint32_t) PerfEvent::LL_MISSES] =
+      open_cache_counter(PERF_COUNT_HW_CACHE_LL);
+  }
+
+  PerfCounters::~PerfCounters() {
+    for (int fd : this->fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  void PerfCounters::start() {
+    for (int fd : this->fds) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+  }
+
+  void PerfCounters::stop() {
+    for (int fd : this->fds) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+  }
+
+  uint64_t PerfCounters::read(PerfEvent event) const {
+    int fd = this->fds[(uint32_t) event];
+    uint64_t value = 0;
+    if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value)) {
+      return 0;
+    }
+    return value;
+  }
+#else
+  PerfCounters::PerfCounters() {
+    for (int &fd : this->fds) {
+      fd = -1;
+    }
+  }
+
+  PerfCounters::~PerfCounters() { }
+
+  void PerfCounters::start() { }
+
+  void PerfCounters::stop() { }
+
+  uint64_t PerfCounters::read(PerfEvent event) const {
+    return 0;
+  }
+#endif
+
+  bool PerfCounters::any_available() const {
+    for (int fd : this->fds) {
+      if (fd >= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void report_perf_counters(
+    const char* suite,
+    const char* prefix,
+    const PerfCounters &counters,
+    double divisor,
+    const char* divisor_unit
+  ) {
+    for (uint32_t i = 0; i < PERF_EVENT_COUNT; i++) {
+      PerfEvent event = (PerfEvent) i;
+      if (!counters.available(event)) {
+        continue;
+      }
+      std::string metric = std::string(prefix) + "_" + EVENT_NAMES[i];
+      std::string unit = std::string(EVENT_UNITS[i]) + "/" + divisor_unit;
+      report(
+        suite,
+        metric.c_str(),
+        (double) counters.read(event) / divisor,
+        unit.c_str()
+      );
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+namespace condict_bench {
+  enum class PerfEvent : uint32_t {
+    CYCLES,
+    INSTRUCTIONS,
+    // L1 data cache read misses.
+    L1D_MISSES,
+    // Last-level cache read misses. The kernel has no generic event for L2
+    // misses; on most machines, the last level is L3.
+    LL_MISSES,
+
+    COUNT,
+  };
+
+  constexpr uint32_t PERF_EVENT_COUNT = (uint32_t) PerfEvent::COUNT;
+
+  // Hardware counters for the calling thread, read through perf_event_open
+  // on Linux. On other systems, or when the kernel doesn't allow access to
+  // the counters (see /proc/sys/kernel/perf_event_paranoid), the counters are
+  // unavailable and read as zero. Some machines, virtual ones in particular,
+  // only have some of them.
+  class PerfCounters {
+  public:
+    PerfCounters();
+
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    inline bool available(PerfEvent event) const {
+      return this->fds[(uint32_t) event] >= 0;
+    }
+
+    // Determines whether any of the counters are available.
+    bool any_available() const;
+
+    // Resets and starts the counters.
+    void start();
+
+    // Stops the counters.
+    void stop();
+
+    // Gets the value of a counter since the last start().
+    uint64_t read(PerfEvent event) const;
+
+  private:
+    int fds[PERF_EVENT_COUNT];
+  };
+
+  // Reports the counters that are available, divided by `divisor`, as
+  // `<prefix>_cycles` and so on. The unit is "<event>/<divisor_unit>".
+  void report_perf_counters(
+    const char* suite,
+    const char* prefix,
+    const PerfCounters &counters,
+    double divisor,
+    const char* divisor_unit
+  );
+}
@@ -0,0 +1,97 @@
+#include "sort.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "../uca/sort.h"
+#include "../uca/uca.h"
+
+namespace condict_bench {
+  constexpr const char* SUITE = "sort";
+  constexpr uint32_t LEMMA_COUNT = 1000000;
+  constexpr uint32_t REPETITIONS = 3;
+
+  // Mostly lower case Latin, with accented and upper case letters and the odd
+  // space or hyphen, as in a lemma list.
+  std::vector<uint32_t> lemma_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 'a'; c <= 'z'; c++) {
+      for (uint32_t i = 0; i < 8; i++) {
+        alphabet.push_back(c);
+      }
+    }
+    for (uint32_t c = 'A'; c <= 'Z'; c++) {
+      alphabet.push_back(c);
+    }
+    for (uint32_t c = 0x00E0; c <= 0x00FF; c++) {
+      if (c != 0x00F7) {
+        alphabet.push_back(c);
+      }
+    }
+    alphabet.push_back(' ');
+    alphabet.push_back('-');
+    return alphabet;
+  }
+
+  void bench_sort() {
+    std::vector<std::string> lemmas =
+      generate_words(lemma_alphabet(), LEMMA_COUNT, 31);
+    std::vector<std::string_view> views(lemmas.begin(), lemmas.end());
+    std::vector<uint32_t> order(views.size());
+    double count = (double) views.size();
+
+    // Takes long enough on its own that one run is plenty.
+    std::vector<std::string_view> sorted;
+    double ns = time_best(0, 1, [&]() {
+      sorted = views;
+      std::sort(
+        sorted.begin(),
+        sorted.end(),
+        [](std::string_view a, std::string_view b) {
+          return condict_uca::compare(
+            (int) a.size(), a.data(),
+            (int) b.size(), b.data()
+          ) < 0;
+        }
+      );
+    });
+    report(SUITE, "std_sort_compare", ns / count, "ns/string");
+
+    ns = time_best(0, REPETITIONS, [&]() {
+      condict_uca::sort(views.data(), (uint32_t) views.size(), order.data());
+    });
+    report(SUITE, "radix_1_thread", ns / count, "ns/string");
+
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    ns = time_best(0, REPETITIONS, [&]() {
+      condict_uca::sort(
+        views.data(),
+        (uint32_t) views.size(),
+        order.data(),
+        condict_uca::sort_key::MAX_STRENGTH,
+        threads
+      );
+    });
+    report(SUITE, "radix_all_threads", ns / count, "ns/string");
+    report(SUITE, "threads", threads, "");
+
+    // std::sort is not stable, so only strings that compare equal may be in
+    // a different order.
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < sorted.size(); i++) {
+      std::string_view a = sorted[i];
+      std::string_view b = views[order[i]];
+      mismatches += condict_uca::compare(
+        (int) a.size(), a.data(),
+        (int) b.size(), b.data()
+      ) != 0;
+    }
+    report(SUITE, "mismatches", mismatches, "");
+  }
+}
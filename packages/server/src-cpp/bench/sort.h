@@ -0,0 +1,7 @@
+#pragma once
+
+namespace condict_bench {
+  // Reports the time per string to sort a million lemmas with std::sort and
+  // compare, and with condict_uca::sort on one and on all hardware threads.
+  void bench_sort();
+}
@@ -0,0 +1,210 @@
+#include "stages.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/cea.h"
+#include "../uca/nfc.h"
+#include "../uca/nfd.h"
+#include "../uca/utf8.h"
+
+namespace condict_bench {
+  using std::chrono::steady_clock;
+
+  constexpr const char* SUITE = "stages";
+  constexpr uint32_t WORD_COUNT = 20000;
+  constexpr uint32_t REPETITIONS = 20;
+  constexpr uint32_t BATCH_SIZE = 64;
+
+  // Plain ASCII letters.
+  std::vector<uint32_t> ascii_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 'a'; c <= 'z'; c++) {
+      alphabet.push_back(c);
+    }
+    for (uint32_t c = 'A'; c <= 'Z'; c++) {
+      alphabet.push_back(c);
+    }
+    return alphabet;
+  }
+
+  // Precomposed letters that decompose in NFD, and Greek and Cyrillic.
+  std::vector<uint32_t> accented_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 'a'; c <= 'z'; c++) {
+      alphabet.push_back(c);
+    }
+    for (uint32_t c = 0x00E0; c <= 0x00FF; c++) {
+      alphabet.push_back(c);
+    }
+    for (uint32_t c = 0x03B1; c <= 0x03C9; c++) {
+      alphabet.push_back(c);
+    }
+    for (uint32_t c = 0x0430; c <= 0x044F; c++) {
+      alphabet.push_back(c);
+    }
+    return alphabet;
+  }
+
+  // Precomposed Hangul syllables, with and without a trailing consonant.
+  std::vector<uint32_t> hangul_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 0xAC00; c <= 0xD7A3; c += 37) {
+      alphabet.push_back(c);
+    }
+    return alphabet;
+  }
+
+  // Han ideographs, which have implicit weights.
+  std::vector<uint32_t> han_alphabet() {
+    std::vector<uint32_t> alphabet;
+    for (uint32_t c = 0x4E00; c <= 0x9FFF; c += 101) {
+      alphabet.push_back(c);
+    }
+    return alphabet;
+  }
+
+  std::string make_text(const std::vector<uint32_t> &alphabet, uint32_t seed) {
+    std::string text;
+    for (auto &word : generate_words(alphabet, WORD_COUNT, seed)) {
+      text += word;
+      text.push_back(' ');
+    }
+    return text;
+  }
+
+  template<typename F>
+  void bench_stage(
+    const char* corpus,
+    const char* stage,
+    const std::string &text,
+    F run
+  ) {
+    uint64_t sink = run(text);
+    double best = 0;
+    for (uint32_t rep = 0; rep < REPETITIONS; rep++) {
+      auto start = steady_clock::now();
+      sink += run(text);
+      auto end = steady_clock::now();
+      double ns = (double) std::chrono::duration_cast<
+        std::chrono::nanoseconds
+      >(end - start).count();
+      if (rep == 0 || ns < best) {
+        best = ns;
+      }
+    }
+
+    std::string metric = std::string(corpus) + "_" + stage;
+    report(
+      SUITE,
+      metric.c_str(),
+      best / count_code_points(text),
+      "ns/cp"
+    );
+    // Keep the work from being optimized away.
+    report(SUITE, (metric + "_checksum").c_str(), (double) (sink & 0xFFFF), "");
+  }
+
+  uint64_t run_utf8(const std::string &text) {
+    condict_uca::utf8::CodePointIter iter((int) text.size(), text.data());
+    uint32_t batch[BATCH_SIZE];
+    uint64_t sum = 0;
+    uint32_t count;
+    while ((count = iter.next_batch(batch, BATCH_SIZE)) > 0) {
+      for (uint32_t i = 0; i < count; i++) {
+        sum += batch[i];
+      }
+    }
+    return sum;
+  }
+
+  uint64_t run_nfd(const std::string &text) {
+    condict_uca::nfd::NfdIter iter((int) text.size(), text.data());
+    uint32_t batch[BATCH_SIZE];
+    uint64_t sum = 0;
+    uint32_t count;
+    while ((count = iter.next_batch(batch, BATCH_SIZE)) > 0) {
+      for (uint32_t i = 0; i < count; i++) {
+        sum += batch[i];
+      }
+    }
+    return sum;
+  }
+
+  uint64_t run_trusted_nfd(const std::string &text) {
+    condict_uca::nfd::NfdIter iter(
+      (int) text.size(),
+      text.data(),
+      nullptr,
+      true
+    );
+    uint32_t batch[BATCH_SIZE];
+    uint64_t sum = 0;
+    uint32_t count;
+    while ((count = iter.next_batch(batch, BATCH_SIZE)) > 0) {
+      for (uint32_t i = 0; i < count; i++) {
+        sum += batch[i];
+      }
+    }
+    return sum;
+  }
+
+  template<bool TrustedNfd>
+  uint64_t run_elements(const std::string &text) {
+    condict_uca::cea::ElementIter iter(
+      (int) text.size(),
+      text.data(),
+      nullptr,
+      nullptr,
+      TrustedNfd
+    );
+    condict_uca::cea::Element batch[BATCH_SIZE];
+    uint64_t sum = 0;
+    uint32_t count;
+    while ((count = iter.next_batch(batch, BATCH_SIZE)) > 0) {
+      for (uint32_t i = 0; i < count; i++) {
+        sum += batch[i].level_1;
+      }
+    }
+    return sum;
+  }
+
+  uint64_t run_nfc(const std::string &text) {
+    // Not reused, so that the cost of allocating is included, as it would be
+    // for a single call.
+    condict_uca::nfc::Normalizer normalizer;
+    return normalizer.to_nfc((int) text.size(), text.data());
+  }
+
+  void bench_corpus(const char* corpus, const std::string &text) {
+    bench_stage(corpus, "utf8", text, run_utf8);
+    bench_stage(corpus, "nfd", text, run_nfd);
+    bench_stage(corpus, "elements", text, run_elements<false>);
+    bench_stage(corpus, "nfc", text, run_nfc);
+
+    // The same text in NFD, as it would be stored for the trusted NFD
+    // collation, read with and without normalizing it again.
+    condict_uca::nfc::Normalizer normalizer;
+    uint32_t len = normalizer.to_nfd((int) text.size(), text.data());
+    std::string nfd_text(normalizer.data(), len);
+    bench_stage(corpus, "nfd_input_nfd", nfd_text, run_nfd);
+    bench_stage(corpus, "nfd_input_trusted_nfd", nfd_text, run_trusted_nfd);
+    bench_stage(corpus, "nfd_input_elements", nfd_text, run_elements<false>);
+    bench_stage(
+      corpus,
+      "nfd_input_trusted_elements",
+      nfd_text,
+      run_elements<true>
+    );
+  }
+
+  void bench_stages() {
+    bench_corpus("ascii", make_text(ascii_alphabet(), 6));
+    bench_corpus("accented", make_text(accented_alphabet(), 7));
+    bench_corpus("hangul", make_text(hangul_alphabet(), 8));
+    bench_corpus("han", make_text(han_alphabet(), 9));
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace condict_bench {
+  // Reports the throughput of each stage of the collation pipeline on its
+  // own: UTF-8 decoding, normalization to NFD and collation elements. Each
+  // stage includes the ones before it. Also compares reading text that is
+  // already in NFD with and without trusting it to be (see nfd::NfdIter).
+  void bench_stages();
+
+  // Runs a stage over a whole text, and returns a checksum of the result.
+  // Used by the other suites too.
+  uint64_t run_utf8(const std::string &text);
+  uint64_t run_nfd(const std::string &text);
+}
@@ -0,0 +1,138 @@
+#include "tables.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "perf_counters.h"
+#include "../uca/cea.h"
+#include "../uca/data.h"
+#include "../uca/nfd.h"
+#include "../uca/uca.h"
+
+namespace condict_bench {
+  namespace data = condict_uca::data;
+
+  using std::chrono::steady_clock;
+
+  constexpr const char* SUITE = "tables";
+  constexpr uint32_t WORD_COUNT = 20000;
+  constexpr uint32_t REPETITIONS = 10;
+
+  void add_range(std::vector<uint32_t> &alphabet, uint32_t from, uint32_t to) {
+    for (uint32_t cp = from; cp <= to; cp++) {
+      alphabet.push_back(cp);
+    }
+  }
+
+  // Latin, Cyrillic and Greek letters with some punctuation, digits and
+  // a sprinkling of Han ideographs and Hangul syllables, which are outside
+  // the hot block.
+  std::vector<uint32_t> mixed_alphabet() {
+    std::vector<uint32_t> alphabet;
+    add_range(alphabet, 'a', 'z');
+    add_range(alphabet, 'A', 'Z');
+    add_range(alphabet, '0', '9');
+    add_range(alphabet, 0x00E0, 0x00FF); // Latin-1 letters
+    add_range(alphabet, 0x0100, 0x017F); // Latin Extended-A
+    add_range(alphabet, 0x0391, 0x03A9); // Greek capitals
+    add_range(alphabet, 0x03B1, 0x03C9); // Greek small letters
+    add_range(alphabet, 0x0410, 0x044F); // Cyrillic
+    add_range(alphabet, 0x2013, 0x2014); // En and em dash
+    add_range(alphabet, 0x2018, 0x201D); // Quotation marks
+    add_range(alphabet, 0x4E00, 0x4E1F); // Han
+    add_range(alphabet, 0xAC00, 0xAC1F); // Hangul
+    alphabet.push_back(' ');
+    alphabet.push_back('-');
+    alphabet.push_back('\'');
+    return alphabet;
+  }
+
+  void report_sizes() {
+    const data::CollationTables &c = data::collation;
+    uint32_t collation_stored =
+      c.cea_data_len * sizeof(uint16_t) +
+      c.cea_indices_len * sizeof(uint32_t) +
+      c.stage1_len * sizeof(uint16_t) +
+      c.stage2_len * sizeof(uint16_t);
+    report(SUITE, "collation_stored", collation_stored, "bytes");
+    report(SUITE, "collation_built", condict_uca::cea::table_size(), "bytes");
+
+    const data::NormalizationTables &n = data::normalization;
+    uint32_t normalization_stored =
+      n.comp_data_len * sizeof(condict_uca::nfd::CompData) +
+      n.stage1_len * sizeof(uint16_t) +
+      n.stage2_len * sizeof(uint16_t) +
+      n.stage3_len * sizeof(uint16_t);
+    report(SUITE, "normalization_stored", normalization_stored, "bytes");
+    report(
+      SUITE,
+      "normalization_built",
+      condict_uca::nfd::table_size(),
+      "bytes"
+    );
+  }
+
+  void bench_tables() {
+    report_sizes();
+
+    std::vector<std::string> words =
+      generate_words(mixed_alphabet(), WORD_COUNT, 1);
+
+    // Every word except the first and last is compared twice.
+    uint64_t code_points = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+      uint64_t word_cps = 0;
+      for (char c : words[i]) {
+        // Count lead bytes only.
+        word_cps += (c & 0xC0) != 0x80;
+      }
+      bool is_end = i == 0 || i == words.size() - 1;
+      code_points += is_end ? word_cps : 2 * word_cps;
+    }
+    code_points *= REPETITIONS;
+
+    // Warm up, which also builds the tables.
+    int sink = 0;
+    for (size_t i = 1; i < words.size(); i++) {
+      sink += condict_uca::compare(
+        (int) words[i - 1].size(), words[i - 1].data(),
+        (int) words[i].size(), words[i].data()
+      );
+    }
+
+    PerfCounters counters;
+    counters.start();
+    auto start = steady_clock::now();
+    for (uint32_t rep = 0; rep < REPETITIONS; rep++) {
+      for (size_t i = 1; i < words.size(); i++) {
+        sink += condict_uca::compare(
+          (int) words[i - 1].size(), words[i - 1].data(),
+          (int) words[i].size(), words[i].data()
+        );
+      }
+    }
+    auto end = steady_clock::now();
+    counters.stop();
+
+    double ns = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start
+    ).count();
+    report(SUITE, "compare_mixed", ns / code_points, "ns/cp");
+    if (counters.any_available()) {
+      report_perf_counters(
+        SUITE,
+        "compare_mixed",
+        counters,
+        (double) code_points,
+        "cp"
+      );
+    } else {
+      report(SUITE, "perf_counters_unavailable", 1, "flag");
+    }
+    // Keep the comparisons from being optimized away.
+    report(SUITE, "checksum", sink, "");
+  }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace condict_bench {
+  // Reports the size of the collation lookup tables, and the time and cache
+  // misses per code point of comparing mixed-script text.
+  void bench_tables();
+}
@@ -0,0 +1,406 @@
+// Differential fuzzer for the collation code. Each input is split into two
+// strings, which are compared by every optimised entry point and by the slow
+// reference implementation in fuzz/reference.h. The fuzzer aborts if:
+//
+// * compare, compare_tb or compare_reverse disagrees with the reference;
+// * a comparison is not antisymmetric, or a string does not equal itself;
+// * compare_nfd on the strings in NFD disagrees with compare;
+// * compare or compare_tb on the strings in UTF-16, in either byte order,
+//   disagrees with the same function on UTF-8;
+// * sort keys order differently than compare, or two strings that compare
+//   equal have different keys, which would break keys used as hash keys;
+// * the optimised code takes much longer than a linear-time implementation
+//   should, on inputs of that length. See TimeBudget.
+//
+// Input format: the first two bytes are the length of the first string, as a
+// little-endian integer modulo the length of the rest. The rest of the input
+// is the two strings, back to back, in any encoding, valid or not.
+//
+// With libFuzzer (build with --libfuzzer=1 and clang), the fuzzer provides
+// the main function. Otherwise, this file has a main function that runs each
+// file named on the command line, or stdin if there are none, which works
+// with AFL and for replaying crashes:
+//
+//     afl-fuzz -i seeds -o findings -- ./collation_fuzz @@
+//     ./collation_fuzz crash-1234abcd
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fuzz/reference.h"
+#include "uca/nfc.h"
+#include "uca/sort_key.h"
+#include "uca/uca.h"
+#include "uca/utf8.h"
+
+namespace condict_fuzz {
+  using condict_uca::Encoding;
+  using condict_uca::sort_key::KeyBuilder;
+  using std::chrono::steady_clock;
+
+  using CompareFn = int (*)(int, const char*, int, const char*);
+
+  inline int sign(int value) {
+    return value < 0 ? -1 : value > 0 ? 1 : 0;
+  }
+
+  void print_hex(const char* label, const std::string &str) {
+    fprintf(stderr, "%s (%zu bytes):", label, str.size());
+    for (unsigned char c : str) {
+      fprintf(stderr, " %02X", c);
+    }
+    fprintf(stderr, "\n");
+  }
+
+  [[noreturn]] void fail(
+    const char* check,
+    const std::string &a,
+    const std::string &b,
+    int expected,
+    int actual
+  ) {
+    fprintf(
+      stderr,
+      "Check failed: %s: expected %d, got %d\n",
+      check,
+      expected,
+      actual
+    );
+    print_hex("a", a);
+    print_hex("b", b);
+    abort();
+  }
+
+  // Flags inputs that take super-linear time. The optimised code is
+  // calibrated on a long, ordinary input the first time it runs, and any
+  // input that takes more than SLACK times as long per byte, plus a fixed
+  // allowance for page faults and the like, is taken to be a performance
+  // bug. The calibration makes the budget follow the build: sanitizers slow
+  // everything down about equally.
+  class TimeBudget {
+  public:
+    static constexpr double SLACK = 100.0;
+    static constexpr double ALLOWANCE_NS = 2e6;
+
+    TimeBudget() : sink(0) {
+      std::string a(4096, 'a');
+      std::string b = a;
+      a.back() = 'b';
+      b.back() = 'c';
+      double best = 0;
+      for (uint32_t i = 0; i < 5; i++) {
+        auto start = steady_clock::now();
+        this->sink += condict_uca::compare_tb(
+          (int) a.size(), a.data(),
+          (int) b.size(), b.data()
+        );
+        double ns = elapsed_ns(start);
+        if (i == 0 || ns < best) {
+          best = ns;
+        }
+      }
+      this->ns_per_byte = best / (a.size() + b.size());
+    }
+
+    // Runs `fn` on `a` and `b`, and if it takes longer than their budget,
+    // runs it twice more to rule out noise before failing.
+    template<typename F>
+    void check(
+      const char* what,
+      const std::string &a,
+      const std::string &b,
+      F fn
+    ) {
+      double budget =
+        ALLOWANCE_NS + SLACK * this->ns_per_byte * (a.size() + b.size());
+      double best = 0;
+      for (uint32_t i = 0; i < 3; i++) {
+        auto start = steady_clock::now();
+        fn();
+        best = i == 0 ? elapsed_ns(start) : std::min(best, elapsed_ns(start));
+        if (best <= budget) {
+          return;
+        }
+      }
+      fprintf(
+        stderr,
+        "Time budget exceeded: %s took %.0f ns, budget %.0f ns\n",
+        what,
+        best,
+        budget
+      );
+      print_hex("a", a);
+      print_hex("b", b);
+      abort();
+    }
+
+  private:
+    double ns_per_byte;
+    int sink;
+
+    static double elapsed_ns(steady_clock::time_point start) {
+      std::chrono::duration<double, std::nano> ns = steady_clock::now() - start;
+      return ns.count();
+    }
+  };
+
+  std::string to_nfd(
+    condict_uca::nfc::Normalizer &normalizer,
+    const std::string &str
+  ) {
+    uint32_t len = normalizer.to_nfd((int) str.size(), str.data());
+    return std::string(normalizer.data(), len);
+  }
+
+  // Converts a string to UTF-16 in the given byte order. Invalid UTF-8 turns
+  // into U+FFFD, just as it does when the collation decodes it.
+  std::string to_utf16(const std::string &str, bool big_endian) {
+    std::string result;
+    auto push_unit = [&](uint32_t unit) {
+      char hi = (char) (unit >> 8);
+      char lo = (char) (unit & 0xFF);
+      result.push_back(big_endian ? hi : lo);
+      result.push_back(big_endian ? lo : hi);
+    };
+    condict_uca::utf8::CodePointIter iter((int) str.size(), str.data());
+    uint32_t cp;
+    while (iter.next(cp)) {
+      if (cp >= 0x10000) {
+        push_unit(0xD800 | ((cp - 0x10000) >> 10));
+        push_unit(0xDC00 | (cp & 0x3FF));
+      } else {
+        push_unit(cp);
+      }
+    }
+    return result;
+  }
+
+  std::string build_key(
+    KeyBuilder &builder,
+    const std::string &str,
+    bool reverse
+  ) {
+    uint32_t len = reverse
+      ? builder.build_reverse((int) str.size(), str.data())
+      : builder.build((int) str.size(), str.data());
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  int compare_keys(const std::string &a, const std::string &b) {
+    size_t len = std::min(a.size(), b.size());
+    int result = memcmp(a.data(), b.data(), len);
+    if (result == 0) {
+      result = a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+    return sign(result);
+  }
+
+  // Checks that `fn` agrees with `reference`, is antisymmetric, and finds
+  // each string equal to itself. Returns the result of fn(a, b).
+  int check_compare(
+    const char* name,
+    CompareFn fn,
+    CompareFn reference,
+    const std::string &a,
+    const std::string &b
+  ) {
+    int a_len = (int) a.size();
+    int b_len = (int) b.size();
+
+    int ab = sign(fn(a_len, a.data(), b_len, b.data()));
+    int ba = sign(fn(b_len, b.data(), a_len, a.data()));
+    int expected = sign(reference(a_len, a.data(), b_len, b.data()));
+
+    std::string check = name;
+    if (ab != expected) {
+      fail((check + " vs reference").c_str(), a, b, expected, ab);
+    }
+    if (ba != -ab) {
+      fail((check + " antisymmetry").c_str(), a, b, -ab, ba);
+    }
+    int aa = fn(a_len, a.data(), a_len, a.data());
+    if (aa != 0) {
+      fail((check + " reflexivity").c_str(), a, a, 0, aa);
+    }
+    return ab;
+  }
+
+  // Checks that `a` and `b` compare as `expected` after conversion to UTF-16,
+  // in both byte orders, with both compare and compare_tb.
+  void check_utf16(
+    const std::string &a,
+    const std::string &b,
+    int expected,
+    int expected_tb
+  ) {
+    for (bool big_endian : {false, true}) {
+      std::string a16 = to_utf16(a, big_endian);
+      std::string b16 = to_utf16(b, big_endian);
+      Encoding encoding = big_endian ? Encoding::UTF16BE : Encoding::UTF16LE;
+      int actual = sign(condict_uca::compare(
+        (int) a16.size(), a16.data(),
+        (int) b16.size(), b16.data(),
+        encoding
+      ));
+      if (actual != expected) {
+        fail("compare in UTF-16", a, b, expected, actual);
+      }
+      int actual_tb = sign(condict_uca::compare_tb(
+        (int) a16.size(), a16.data(),
+        (int) b16.size(), b16.data(),
+        encoding
+      ));
+      if (actual_tb != expected_tb) {
+        fail("compare_tb in UTF-16", a, b, expected_tb, actual_tb);
+      }
+    }
+  }
+
+  // Checks that sort keys order `a` and `b` as `expected`, and are equal
+  // exactly when the strings compare equal.
+  void check_keys(
+    const char* name,
+    KeyBuilder &builder,
+    const std::string &a,
+    const std::string &b,
+    bool reverse,
+    int expected
+  ) {
+    std::string key_a = build_key(builder, a, reverse);
+    std::string key_b = build_key(builder, b, reverse);
+
+    std::string check = name;
+    int actual = compare_keys(key_a, key_b);
+    if (actual != expected) {
+      fail((check + " order").c_str(), a, b, expected, actual);
+    }
+    if ((key_a == key_b) != (expected == 0)) {
+      fail((check + " equality").c_str(), a, b, expected == 0, key_a == key_b);
+    }
+  }
+
+  void run(const uint8_t* data, size_t size) {
+    static TimeBudget budget;
+    static KeyBuilder builder;
+    static condict_uca::nfc::Normalizer normalizer;
+
+    if (size < 2) {
+      return;
+    }
+    size_t rest = size - 2;
+    size_t a_len = ((size_t) data[0] | (size_t) data[1] << 8) % (rest + 1);
+    const char* chars = reinterpret_cast<const char*>(data + 2);
+    std::string a(chars, a_len);
+    std::string b(chars + a_len, rest - a_len);
+
+    int result = check_compare(
+      "compare",
+      [](int a_len, const char* a, int b_len, const char* b) {
+        return condict_uca::compare(a_len, a, b_len, b);
+      },
+      reference::compare,
+      a,
+      b
+    );
+    int tb_result = check_compare(
+      "compare_tb",
+      [](int a_len, const char* a, int b_len, const char* b) {
+        return condict_uca::compare_tb(a_len, a, b_len, b);
+      },
+      reference::compare_tb,
+      a,
+      b
+    );
+    if (result != 0 && tb_result != result) {
+      fail("compare_tb agrees with compare", a, b, result, tb_result);
+    }
+    int reverse_result = check_compare(
+      "compare_reverse",
+      condict_uca::compare_reverse,
+      reference::compare_reverse,
+      a,
+      b
+    );
+
+    std::string a_nfd = to_nfd(normalizer, a);
+    std::string b_nfd = to_nfd(normalizer, b);
+    int nfd_result = sign(condict_uca::compare_nfd(
+      (int) a_nfd.size(), a_nfd.data(),
+      (int) b_nfd.size(), b_nfd.data()
+    ));
+    if (nfd_result != result) {
+      fail("compare_nfd", a, b, result, nfd_result);
+    }
+
+    check_utf16(a, b, result, tb_result);
+
+    check_keys("sort key", builder, a, b, false, result);
+    check_keys("reverse sort key", builder, a, b, true, reverse_result);
+
+    budget.check("compare", a, b, [&]() {
+      condict_uca::compare((int) a.size(), a.data(), (int) b.size(), b.data());
+    });
+    budget.check("compare_tb", a, b, [&]() {
+      condict_uca::compare_tb(
+        (int) a.size(), a.data(),
+        (int) b.size(), b.data()
+      );
+    });
+    budget.check("compare_reverse", a, b, [&]() {
+      condict_uca::compare_reverse(
+        (int) a.size(), a.data(),
+        (int) b.size(), b.data()
+      );
+    });
+    budget.check("sort key", a, b, [&]() {
+      builder.build((int) a.size(), a.data());
+      builder.build((int) b.size(), b.data());
+    });
+  }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  condict_fuzz::run(data, size);
+  return 0;
+}
+
+#ifndef CONDICT_LIBFUZZER
+bool read_file(FILE* file, std::vector<uint8_t> &data) {
+  uint8_t buf[4096];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+    data.insert(data.end(), buf, buf + len);
+  }
+  return !ferror(file);
+}
+
+int main(int argc, char** argv) {
+  std::vector<uint8_t> data;
+  if (argc == 1) {
+    if (!read_file(stdin, data)) {
+      fprintf(stderr, "Could not read stdin\n");
+      return 1;
+    }
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 0;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    FILE* file = fopen(argv[i], "rb");
+    data.clear();
+    if (!file || !read_file(file, data)) {
+      fprintf(stderr, "Could not read %s\n", argv[i]);
+      return 1;
+    }
+    fclose(file);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+  }
+  return 0;
+}
+#endif
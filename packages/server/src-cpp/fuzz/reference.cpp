@@ -0,0 +1,359 @@
+#include "reference.h"
+
+#include <algorithm>
+
+#include "../uca/cea.h"
+#include "../uca/data.h"
+#include "../uca/hash_table.h"
+#include "../uca/nfd.h"
+#include "../uca/utf8.h"
+
+namespace condict_fuzz {
+  namespace reference {
+    namespace cea = condict_uca::cea;
+    namespace data = condict_uca::data;
+    namespace hangul = condict_uca::nfd::hangul;
+
+    using Bucket = condict_uca::HashTableBucket<uint32_t>;
+
+    template<typename T>
+    int compare_sequences(const std::vector<T> &a, const std::vector<T> &b) {
+      size_t len = std::min(a.size(), b.size());
+      for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+          return a[i] < b[i] ? -1 : 1;
+        }
+      }
+      return a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+
+    // Looks up a code point in the normalization tables as they are stored.
+    condict_uca::nfd::CompData get_comp_data(uint32_t cp) {
+      const data::NormalizationTables &t = data::get().normalization;
+      if (cp > t.last_assigned) {
+        return { 0, 0, 0 };
+      }
+      uint32_t index3 = cp >> t.stage3_shift;
+      uint32_t index2 =
+        t.stage3[index3] | ((cp >> t.stage2_shift) & t.stage2_mask);
+      uint32_t index1 =
+        t.stage2[index2] | ((cp >> t.stage1_shift) & t.stage1_mask);
+      uint32_t index0 = t.stage1[index1] | (cp & t.comp_mask);
+      return t.comp_data[index0];
+    }
+
+    // Looks up a code point in the collation tables as they are stored. The
+    // result is a cea::Index, or 0 if the code point has implicit weights.
+    uint32_t get_mapping(uint32_t cp) {
+      const data::CollationTables &t = data::get().collation;
+      if (cp > t.last_assigned) {
+        return 0;
+      }
+      uint32_t index2 = cp >> t.stage2_shift;
+      uint32_t index1 =
+        t.stage2[index2] | ((cp >> t.stage1_shift) & t.stage1_mask);
+      uint32_t index0 = t.stage1[index1] | (cp & t.cea_mask);
+      return t.cea_indices[index0];
+    }
+
+    // Finds a code point among `count` contraction buckets by looking at
+    // every one of them.
+    const Bucket* find_bucket(
+      uint32_t cp,
+      uint32_t count,
+      const Bucket* buckets
+    ) {
+      for (uint32_t i = 0; i < count; i++) {
+        if (buckets[i].key == cp) {
+          return &buckets[i];
+        }
+      }
+      return nullptr;
+    }
+
+    const Bucket* find_continuation(uint32_t cp, const Bucket* bucket) {
+      const data::CollationTables &t = data::get().collation;
+      return find_bucket(
+        cp,
+        bucket->cont_count,
+        &t.contractions[bucket->cont_idx]
+      );
+    }
+
+    // Appends the elements of a cea::Index to `out`, as raw triples.
+    void push_mapping(uint32_t raw, std::vector<cea::RawElement> &out) {
+      const data::CollationTables &t = data::get().collation;
+      cea::Index index(raw);
+      const uint16_t* data = t.cea_data + index.idx();
+      for (uint32_t i = 0; i < index.len(); i++) {
+        if (index.is_simple_l1()) {
+          out.push_back({ data[i], 0x0020, 0x0002 });
+        } else {
+          out.push_back({ data[3 * i], data[3 * i + 1], data[3 * i + 2] });
+        }
+      }
+    }
+
+    bool is_unified_ideograph(uint32_t cp) {
+      // From PropList.txt, Unicode version 15.0.0.
+      static const uint32_t ranges[][2] = {
+        { 0x3400, 0x4DBF },
+        { 0x4E00, 0x9FFF },
+        { 0xFA0E, 0xFA0F },
+        { 0xFA11, 0xFA11 },
+        { 0xFA13, 0xFA14 },
+        { 0xFA1F, 0xFA1F },
+        { 0xFA21, 0xFA21 },
+        { 0xFA23, 0xFA24 },
+        { 0xFA27, 0xFA29 },
+        { 0x20000, 0x2A6DF },
+        { 0x2A700, 0x2B739 },
+        { 0x2B740, 0x2B81D },
+        { 0x2B820, 0x2CEA1 },
+        { 0x2CEB0, 0x2EBE0 },
+        { 0x30000, 0x3134A },
+        { 0x31350, 0x323AF },
+      };
+      for (const auto &range : ranges) {
+        if (range[0] <= cp && cp <= range[1]) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Appends the implicit weights of a code point to `out`, as described in
+    // UTS #10, section 10.1.
+    void push_implicit(uint32_t cp, std::vector<cea::RawElement> &out) {
+      uint16_t a;
+      uint32_t b;
+      if (0x17000 <= cp && cp <= 0x18AFF || 0x18D00 <= cp && cp <= 0x18D8F) {
+        // Tangut
+        a = 0xFB00;
+        b = cp - 0x17000;
+      } else if (0x1B170 <= cp && cp <= 0x1B2FF) {
+        // Nushu
+        a = 0xFB01;
+        b = cp - 0x1B170;
+      } else if (0x18B00 <= cp && cp <= 0x18CFF) {
+        // Khitan Small Script
+        a = 0xFB02;
+        b = cp - 0x18B00;
+      } else {
+        bool core_block =
+          0x4E00 <= cp && cp <= 0x9FFF || // CJK Unified Ideographs
+          0xF900 <= cp && cp <= 0xFAFF; // CJK Compatibility Ideographs
+        uint16_t base =
+          !is_unified_ideograph(cp) ? 0xFBC0 :
+          core_block ? 0xFB40 :
+          0xFB80;
+        a = (uint16_t) (base + (cp >> 15));
+        b = cp;
+      }
+      out.push_back({ a, 0x0020, 0x0002 });
+      out.push_back({ (uint16_t) ((b & 0x7FFF) | 0x8000), 0x0000, 0x0000 });
+    }
+
+    // Gets the raw collation elements of a string in NFD, following step S2
+    // of UTS #10 to the letter.
+    std::vector<cea::RawElement> get_raw_elements(std::vector<uint32_t> cps) {
+      const data::CollationTables &t = data::get().collation;
+      std::vector<cea::RawElement> result;
+
+      size_t i = 0;
+      while (i < cps.size()) {
+        uint32_t cp = cps[i];
+        // S2.1: Find the longest initial substring S that has a match.
+        const Bucket* match = find_bucket(
+          cp,
+          t.contractions_root_size,
+          t.contractions
+        );
+        uint32_t value = match && match->value ? match->value : 0;
+        size_t end = i + 1;
+        if (match) {
+          const Bucket* bucket = match;
+          for (size_t k = i + 1; k < cps.size(); k++) {
+            bucket = find_continuation(cps[k], bucket);
+            if (!bucket) {
+              break;
+            }
+            if (bucket->value) {
+              match = bucket;
+              value = bucket->value;
+              end = k + 1;
+            }
+          }
+
+          // S2.1.1-3: Append each unblocked non-starter C that follows S to
+          // S, if S + C has a match, and remove C from the string. C is
+          // blocked if a character between S and C has a CCC of 0 or at least
+          // that of C.
+          bool any_between = false;
+          uint8_t max_between = 0;
+          size_t k = end;
+          while (k < cps.size()) {
+            uint8_t ccc = get_comp_data(cps[k]).ccc;
+            if (ccc == 0) {
+              break;
+            }
+            bool blocked = any_between && max_between >= ccc;
+            const Bucket* next =
+              blocked ? nullptr : find_continuation(cps[k], match);
+            if (next && next->value) {
+              match = next;
+              value = next->value;
+              cps.erase(cps.begin() + k);
+            } else {
+              any_between = true;
+              max_between = std::max(max_between, ccc);
+              k++;
+            }
+          }
+        }
+
+        // S2.2: Fetch the elements of S, or if S is a single code point
+        // without a mapping, derive them.
+        if (!value) {
+          value = get_mapping(cp);
+        }
+        if (value) {
+          push_mapping(value, result);
+        } else {
+          push_implicit(cp, result);
+        }
+        i = end;
+      }
+      return result;
+    }
+
+    Weights get_weights(int str_len, const char* str, bool reverse) {
+      const data::CollationTables &t = data::get().collation;
+      std::vector<cea::RawElement> raw =
+        get_raw_elements(get_nfd(str_len, str));
+
+      // Shifted variable weighting, as in UTS #10, section 4. As in the real
+      // code, FFFE's primary weight of 1 is not variable.
+      std::vector<cea::Element> elems;
+      bool last_variable = false;
+      for (const cea::RawElement &r : raw) {
+        if (2 <= r.level_1 && r.level_1 <= t.highest_var) {
+          elems.push_back({0, 0, 0, r.level_1});
+          last_variable = true;
+        } else {
+          if (last_variable && r.level_1 == 0 && r.level_3 != 0) {
+            elems.push_back({0, 0, 0, 0});
+          } else {
+            elems.push_back({
+              r.level_1,
+              r.level_2,
+              r.level_3,
+              (uint16_t) (r.level_3 == 0 ? 0x0000 : 0xFFFF),
+            });
+          }
+          last_variable = false;
+        }
+      }
+      if (reverse) {
+        std::reverse(elems.begin(), elems.end());
+      }
+
+      Weights weights;
+      for (const cea::Element &e : elems) {
+        const uint16_t levels[4] = {
+          e.level_1,
+          e.level_2,
+          e.level_3,
+          e.level_4,
+        };
+        for (uint32_t level = 0; level < 4; level++) {
+          if (levels[level] != 0) {
+            weights.levels[level].push_back(levels[level]);
+          }
+        }
+      }
+      return weights;
+    }
+
+    int compare_weights(const Weights &a, const Weights &b) {
+      for (uint32_t level = 0; level < 4; level++) {
+        int result = compare_sequences(a.levels[level], b.levels[level]);
+        if (result != 0) {
+          return result;
+        }
+      }
+      return 0;
+    }
+
+    std::vector<uint32_t> get_nfd(int str_len, const char* str) {
+      const data::NormalizationTables &t = data::get().normalization;
+
+      // Decompose every code point on its own. The stored decompositions are
+      // already fully expanded.
+      condict_uca::utf8::CodePointIter iter(str_len, str);
+      std::vector<uint32_t> result;
+      uint32_t cp;
+      while (iter.next(cp)) {
+        if (cp - hangul::S_BASE < hangul::S_COUNT) {
+          uint32_t s = cp - hangul::S_BASE;
+          result.push_back(hangul::L_BASE + s / hangul::N_COUNT);
+          result.push_back(
+            hangul::V_BASE + (s % hangul::N_COUNT) / hangul::T_COUNT
+          );
+          if (s % hangul::T_COUNT != 0) {
+            result.push_back(hangul::T_BASE + s % hangul::T_COUNT);
+          }
+          continue;
+        }
+        condict_uca::nfd::CompData comp_data = get_comp_data(cp);
+        if (comp_data.decomp_len == 0) {
+          result.push_back(cp);
+        } else {
+          const uint32_t* decomp = &t.decomp_data[comp_data.decomp_idx];
+          result.insert(result.end(), decomp, decomp + comp_data.decomp_len);
+        }
+      }
+
+      // Then put every run of non-starters in canonical order.
+      size_t start = 0;
+      while (start < result.size()) {
+        if (get_comp_data(result[start]).ccc == 0) {
+          start++;
+          continue;
+        }
+        size_t end = start;
+        while (end < result.size() && get_comp_data(result[end]).ccc != 0) {
+          end++;
+        }
+        std::stable_sort(
+          result.begin() + start,
+          result.begin() + end,
+          [](uint32_t a, uint32_t b) {
+            return get_comp_data(a).ccc < get_comp_data(b).ccc;
+          }
+        );
+        start = end;
+      }
+      return result;
+    }
+
+    int compare(int a_len, const char* a, int b_len, const char* b) {
+      return compare_weights(get_weights(a_len, a), get_weights(b_len, b));
+    }
+
+    int compare_tb(int a_len, const char* a, int b_len, const char* b) {
+      int result = compare(a_len, a, b_len, b);
+      if (result == 0) {
+        result = compare_sequences(get_nfd(a_len, a), get_nfd(b_len, b));
+      }
+      return result;
+    }
+
+    int compare_reverse(int a_len, const char* a, int b_len, const char* b) {
+      return compare_weights(
+        get_weights(a_len, a, true),
+        get_weights(b_len, b, true)
+      );
+    }
+  }
+}
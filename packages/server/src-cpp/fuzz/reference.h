@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A slow, straightforward implementation of the root collation, which the
+// fuzzer compares the real one against. It reads the normalization and
+// collation tables as they are stored, and shares nothing else with the real
+// code but the UTF-8 decoder: strings are normalized one code point at a time
+// and then reordered, contractions are matched by scanning the buckets, as in
+// step S2 of UTS #10, implicit weights are computed from the ranges in the
+// specification, variable weighting is applied after the fact, and every level
+// is compared in full.
+
+namespace condict_fuzz {
+  namespace reference {
+    // The non-zero weights of a string, one array per level.
+    struct Weights {
+      std::vector<uint16_t> levels[4];
+    };
+
+    // Gets the weights of a string's collation elements, in order or, if
+    // `reverse` is true, last element first.
+    Weights get_weights(int str_len, const char* str, bool reverse = false);
+
+    // Compares two strings' weights level by level. A string whose weights
+    // at some level are a prefix of the other's sorts first.
+    int compare_weights(const Weights &a, const Weights &b);
+
+    // Gets the code points of a string in NFD.
+    std::vector<uint32_t> get_nfd(int str_len, const char* str);
+
+    // Compares two strings as condict_uca::compare.
+    int compare(int a_len, const char* a, int b_len, const char* b);
+
+    // Compares two strings as condict_uca::compare_tb.
+    int compare_tb(int a_len, const char* a, int b_len, const char* b);
+
+    // Compares two strings as condict_uca::compare_reverse.
+    int compare_reverse(int a_len, const char* a, int b_len, const char* b);
+  }
+}
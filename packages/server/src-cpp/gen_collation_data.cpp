@@ -0,0 +1,32 @@
+// Writes the collation and normalization tables that are compiled into the
+// program to a binary data file, which can then be loaded at runtime through
+// the CONDICT_UCA_DATA environment variable. Usage:
+//
+//   gen_collation_data <output-file>
+//
+// See uca/data.h for details about the file format.
+
+#include <cstdio>
+
+#include "uca/data.h"
+
+namespace data = condict_uca::data;
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <output-file>\n", argv[0]);
+    return 1;
+  }
+
+  // Always write the embedded tables, even if CONDICT_UCA_DATA is set.
+  data::Tables tables = {};
+  snprintf(tables.version, data::VERSION_SIZE, "%s", data::embedded_version);
+  tables.collation = data::embedded_collation;
+  tables.normalization = data::embedded_normalization;
+
+  if (!data::write_file(argv[1], tables)) {
+    fprintf(stderr, "Could not write %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
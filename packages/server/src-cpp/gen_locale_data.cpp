@@ -0,0 +1,129 @@
+// Generates uca/locale_data.inc from uca/locale_rules.inc, by running each set
+// of rules through the tailoring compiler and writing out the result. Usage:
+//
+//   gen_locale_data > src-cpp/uca/locale_data.inc
+//
+// Rerun this whenever locale_rules.inc, the tailoring compiler or the root
+// collation data changes. The collation tests check that the output is up to
+// date.
+
+#include <cstdio>
+#include <cstring>
+
+#include "uca/tailoring.h"
+
+namespace tailoring = condict_uca::tailoring;
+
+struct LocaleRules {
+  const char* name;
+  const char* rules;
+};
+
+const LocaleRules locales[] = {
+#include "uca/locale_rules.inc"
+};
+
+constexpr int VALUES_PER_LINE = 18;
+constexpr int BUCKETS_PER_LINE = 5;
+
+void print_tables(const char* name, const tailoring::Tailoring* t) {
+  printf("const HashTableBucket<uint32_t> %s_contractions[] = {\n", name);
+  const condict_uca::HashTableBucket<uint32_t>* buckets = t->contractions();
+  for (uint32_t i = 0; i < t->contraction_count(); i++) {
+    const auto &b = buckets[i];
+    printf(
+      "%s{ 0x%04X, %d, %u, %u, 0x%08X },%s",
+      i % BUCKETS_PER_LINE == 0 ? "  " : " ",
+      b.key,
+      b.next_offset,
+      b.cont_count,
+      b.cont_idx,
+      b.value,
+      i % BUCKETS_PER_LINE == BUCKETS_PER_LINE - 1 ? "\n" : ""
+    );
+  }
+  if (t->contraction_count() % BUCKETS_PER_LINE != 0) {
+    printf("\n");
+  }
+  printf("};\n\n");
+
+  printf("const uint16_t %s_cea_data[] = {\n", name);
+  const uint16_t* data = t->cea_data();
+  for (uint32_t i = 0; i < t->cea_data_size(); i++) {
+    printf(
+      "%s0x%04X,%s",
+      i % VALUES_PER_LINE == 0 ? "  " : " ",
+      data[i],
+      i % VALUES_PER_LINE == VALUES_PER_LINE - 1 ? "\n" : ""
+    );
+  }
+  if (t->cea_data_size() % VALUES_PER_LINE != 0) {
+    printf("\n");
+  }
+  printf("};\n\n");
+}
+
+int main() {
+  const size_t count = sizeof(locales) / sizeof(locales[0]);
+  const tailoring::Tailoring* compiled[count];
+
+  for (size_t i = 0; i < count; i++) {
+    const LocaleRules &locale = locales[i];
+    tailoring::CompileError error{0, nullptr};
+    compiled[i] = tailoring::acquire(
+      (int) strlen(locale.rules),
+      locale.rules,
+      error
+    );
+    if (!compiled[i] && error.message) {
+      fprintf(
+        stderr,
+        "%s: %s at offset %u\n",
+        locale.name,
+        error.message,
+        error.offset
+      );
+      return 1;
+    }
+  }
+
+  printf("/** THIS FILE IS GENERATED - DO NOT EDIT **/\n\n");
+
+  for (size_t i = 0; i < count; i++) {
+    if (compiled[i]) {
+      print_tables(locales[i].name, compiled[i]);
+    }
+  }
+
+  printf("const LocaleData locale_data[] = {\n");
+  for (size_t i = 0; i < count; i++) {
+    const char* name = locales[i].name;
+    const tailoring::Tailoring* t = compiled[i];
+    if (t) {
+      printf(
+        "  { \"%s\", %s_contractions, %u, %u, %s_cea_data, %u },\n",
+        name,
+        name,
+        t->contraction_count(),
+        t->root_contraction_count(),
+        name,
+        t->cea_data_size()
+      );
+    } else {
+      printf("  { \"%s\", nullptr, 0, 0, nullptr, 0 },\n", name);
+    }
+  }
+  printf("};\n\n");
+
+  printf("const char* const locale_names[] = {\n");
+  for (size_t i = 0; i < count; i++) {
+    printf("  \"%s\",\n", locales[i].name);
+  }
+  printf("  nullptr,\n");
+  printf("};\n");
+
+  for (size_t i = 0; i < count; i++) {
+    tailoring::release(compiled[i]);
+  }
+  return 0;
+}
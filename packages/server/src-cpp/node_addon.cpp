@@ -0,0 +1,201 @@
+// A Node addon that exposes the collation to JavaScript, so that strings can
+// be sorted in memory the same way the database sorts them. See
+// src/collation.ts for the JavaScript side.
+//
+// The addon uses the C API of Node-API directly, which is stable across Node
+// and Electron versions, and does not depend on any npm packages.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <node_api.h>
+
+#include "uca/sort.h"
+#include "uca/sort_key.h"
+
+using condict_uca::sort_key::MAX_STRENGTH;
+
+// Checks the status of a Node-API call. If the call failed and did not throw,
+// throws an error with the call's error message. Returns true on success.
+bool check(napi_env env, napi_status status) {
+  if (status == napi_ok) {
+    return true;
+  }
+  bool pending = false;
+  napi_is_exception_pending(env, &pending);
+  if (!pending) {
+    const napi_extended_error_info* info = nullptr;
+    napi_get_last_error_info(env, &info);
+    napi_throw_error(
+      env,
+      nullptr,
+      info && info->error_message ? info->error_message : "Unknown error"
+    );
+  }
+  return false;
+}
+
+// Reads a string argument as UTF-8 into `out`. If `value` is not a string,
+// throws a TypeError and returns false.
+bool get_string(
+  napi_env env,
+  napi_value value,
+  const char* error,
+  std::string &out
+) {
+  size_t len;
+  if (napi_get_value_string_utf8(env, value, nullptr, 0, &len) != napi_ok) {
+    napi_throw_type_error(env, nullptr, error);
+    return false;
+  }
+  out.resize(len + 1);
+  napi_status status =
+    napi_get_value_string_utf8(env, value, &out[0], len + 1, &len);
+  if (!check(env, status)) {
+    return false;
+  }
+  out.resize(len);
+  return true;
+}
+
+// Reads an optional strength argument, which defaults to MAX_STRENGTH. If
+// `value` is not undefined or an integer from 1 to MAX_STRENGTH, throws and
+// returns false.
+bool get_strength(
+  napi_env env,
+  napi_value value,
+  const char* error,
+  uint32_t &out
+) {
+  napi_valuetype type;
+  if (!check(env, napi_typeof(env, value, &type))) {
+    return false;
+  }
+  if (type == napi_undefined) {
+    out = MAX_STRENGTH;
+    return true;
+  }
+  int32_t strength;
+  if (
+    type != napi_number ||
+    napi_get_value_int32(env, value, &strength) != napi_ok ||
+    strength < 1 ||
+    strength > (int32_t) MAX_STRENGTH
+  ) {
+    napi_throw_range_error(env, nullptr, error);
+    return false;
+  }
+  out = (uint32_t) strength;
+  return true;
+}
+
+// Gets the arguments of a call. Missing arguments are undefined.
+template<size_t N>
+bool get_args(napi_env env, napi_callback_info info, napi_value (&args)[N]) {
+  size_t argc = N;
+  return check(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+}
+
+// sortStrings(strings: string[], strength?: number): string[]
+napi_value condict_sort_strings(napi_env env, napi_callback_info info) {
+  napi_value args[2];
+  uint32_t strength;
+  bool is_array = false;
+  if (!get_args(env, info, args)) {
+    return nullptr;
+  }
+  if (!check(env, napi_is_array(env, args[0], &is_array))) {
+    return nullptr;
+  }
+  if (!is_array) {
+    napi_throw_type_error(
+      env,
+      nullptr,
+      "sortStrings(): strings must be an array"
+    );
+    return nullptr;
+  }
+  if (!get_strength(
+    env,
+    args[1],
+    "sortStrings(): strength must be an integer from 1 to 4",
+    strength
+  )) {
+    return nullptr;
+  }
+
+  uint32_t count;
+  if (!check(env, napi_get_array_length(env, args[0], &count))) {
+    return nullptr;
+  }
+
+  // All the strings, back to back, as UTF-8.
+  std::string text;
+  std::vector<size_t> ends;
+  ends.reserve(count);
+  std::string str;
+  for (uint32_t i = 0; i < count; i++) {
+    napi_value element;
+    if (
+      !check(env, napi_get_element(env, args[0], i, &element)) ||
+      !get_string(
+        env,
+        element,
+        "sortStrings(): strings must only contain strings",
+        str
+      )
+    ) {
+      return nullptr;
+    }
+    text += str;
+    ends.push_back(text.size());
+  }
+  std::vector<std::string_view> views;
+  views.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    size_t start = i > 0 ? ends[i - 1] : 0;
+    views.emplace_back(text.data() + start, ends[i] - start);
+  }
+
+  std::vector<uint32_t> order(count);
+  condict_uca::sort(views.data(), count, order.data(), strength);
+
+  // Put the original string values in the result, rather than converting the
+  // strings back from UTF-8.
+  napi_value result;
+  if (!check(env, napi_create_array_with_length(env, count, &result))) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    napi_value element;
+    if (
+      !check(env, napi_get_element(env, args[0], order[i], &element)) ||
+      !check(env, napi_set_element(env, result, i, element))
+    ) {
+      return nullptr;
+    }
+  }
+  return result;
+}
+
+napi_value condict_init(napi_env env, napi_value exports) {
+  const napi_property_descriptor properties[] = {
+    {
+      "sortStrings", nullptr, condict_sort_strings,
+      nullptr, nullptr, nullptr, napi_enumerable, nullptr,
+    },
+  };
+  if (!check(env, napi_define_properties(
+    env,
+    exports,
+    sizeof(properties) / sizeof(properties[0]),
+    properties
+  ))) {
+    return nullptr;
+  }
+  return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, condict_init)
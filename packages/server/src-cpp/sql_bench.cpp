@@ -0,0 +1,584 @@
+// End-to-end collation benchmarks. Runs the queries the server runs against
+// tables built like the real schema, with the `unicode` collation from the
+// extension and, side by side, with BINARY and NOCASE. Results are printed
+// in the same format as collation_bench. Run from the package directory,
+// after building the extension.
+//
+// Usage: collation_sql_bench [-e extension] [lemma_count...]
+//
+// The extension defaults to bin/condict.sqlite3-ext. The lemma counts default
+// to 10000 and 100000.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "sqlite3.h"
+
+#include "bench/common.h"
+
+using condict_bench::report;
+using std::chrono::steady_clock;
+
+constexpr const char* SUITE = "sql";
+constexpr const char* DEFAULT_EXTENSION = "bin/condict.sqlite3-ext";
+constexpr uint32_t DEFAULT_LEMMA_COUNTS[] = { 10000, 100000 };
+
+constexpr uint32_t WARMUP = 1;
+constexpr uint32_t REPETITIONS = 5;
+
+constexpr uint32_t LANGUAGE_COUNT = 4;
+constexpr uint32_t FIELD_COUNT = 16;
+constexpr uint32_t PAGE_SIZE = 50;
+constexpr uint32_t PAGES = 100;
+constexpr uint32_t SORTED_PAGES = 5;
+constexpr uint32_t LOOKUPS = 2000;
+
+const char* const COLLATIONS[] = { "unicode", "binary", "nocase" };
+constexpr uint32_t COLLATION_COUNT = sizeof(COLLATIONS) / sizeof(COLLATIONS[0]);
+
+void fail(sqlite3* db, const char* what) {
+  fprintf(stderr, "%s: %s\n", what, sqlite3_errmsg(db));
+  exit(1);
+}
+
+void exec(sqlite3* db, const std::string &sql) {
+  char* error = nullptr;
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+    fprintf(stderr, "%s\n%s\n", sql.c_str(), error);
+    exit(1);
+  }
+}
+
+class Statement {
+public:
+  Statement(sqlite3* db, const std::string &sql) : db(db), stmt(nullptr) {
+    int result = sqlite3_prepare_v2(db, sql.c_str(), -1, &this->stmt, nullptr);
+    if (result != SQLITE_OK) {
+      fail(db, sql.c_str());
+    }
+  }
+
+  ~Statement() {
+    sqlite3_finalize(this->stmt);
+  }
+
+  Statement(const Statement &) = delete;
+  Statement &operator=(const Statement &) = delete;
+
+  void bind(int index, int64_t value) {
+    sqlite3_bind_int64(this->stmt, index, value);
+  }
+
+  void bind(int index, const std::string &value) {
+    sqlite3_bind_text(
+      this->stmt,
+      index,
+      value.data(),
+      (int) value.size(),
+      SQLITE_STATIC
+    );
+  }
+
+  // Steps through all result rows, and returns the number of rows.
+  uint32_t run() {
+    uint32_t rows = 0;
+    int result;
+    while ((result = sqlite3_step(this->stmt)) == SQLITE_ROW) {
+      rows++;
+    }
+    if (result != SQLITE_DONE) {
+      fail(this->db, sqlite3_sql(this->stmt));
+    }
+    sqlite3_reset(this->stmt);
+    return rows;
+  }
+
+  // Returns the first column of the first row as an integer.
+  int64_t run_int() {
+    if (sqlite3_step(this->stmt) != SQLITE_ROW) {
+      fail(this->db, sqlite3_sql(this->stmt));
+    }
+    int64_t value = sqlite3_column_int64(this->stmt, 0);
+    sqlite3_reset(this->stmt);
+    return value;
+  }
+
+private:
+  sqlite3* db;
+  sqlite3_stmt* stmt;
+};
+
+// A subset of src/database/schema: the tables that the benchmarked queries
+// touch, with `collate unicode` replaced by `collation`. Keep in sync.
+std::vector<std::string> schema(const std::string &collation) {
+  return {
+    "create table languages ("
+    "  id integer not null primary key,"
+    "  lemma_count integer not null default 0,"
+    "  description_id integer not null,"
+    "  time_created integer not null,"
+    "  time_updated integer not null,"
+    "  name text not null collate " + collation +
+    ")",
+    "create unique index `languages(name)` on languages(name)",
+
+    "create table fields ("
+    "  id integer not null primary key,"
+    "  language_id integer not null,"
+    "  value_type integer not null,"
+    "  has_pos_filter integer not null default 0,"
+    "  name text not null collate " + collation + ","
+    "  name_abbr text not null collate " + collation + ","
+    "  foreign key (language_id) references languages on delete cascade"
+    ")",
+    "create unique index `fields(language_id,name)`"
+    "  on fields(language_id, name)",
+
+    "create table field_values ("
+    "  id integer not null primary key,"
+    "  field_id integer not null,"
+    "  value text not null collate " + collation + ","
+    "  value_abbr text not null collate " + collation + ","
+    "  foreign key (field_id) references fields on delete cascade"
+    ")",
+    "create unique index `field_values(field_id,value)`"
+    "  on field_values(field_id, value)",
+
+    // The lemma index is created by the create_index workload.
+    "create table lemmas ("
+    "  id integer not null primary key,"
+    "  language_id integer not null,"
+    "  term text not null collate " + collation + ","
+    "  foreign key (language_id) references languages on delete cascade"
+    ")",
+  };
+}
+
+const char* const CREATE_LEMMA_INDEX =
+  "create unique index `lemmas(language_id,term)`"
+  "  on lemmas(language_id, term)";
+const char* const DROP_LEMMA_INDEX =
+  "drop index `lemmas(language_id,term)`";
+
+using Alphabet = std::vector<uint32_t>;
+using Words = std::vector<std::string>;
+
+void add(Alphabet &alphabet, uint32_t from, uint32_t to, uint32_t weight = 1) {
+  for (uint32_t cp = from; cp <= to; cp++) {
+    for (uint32_t i = 0; i < weight; i++) {
+      alphabet.push_back(cp);
+    }
+  }
+}
+
+// Lower case letters only, so that distinct words are distinct under every
+// collation, and the unique indexes can be built with NOCASE too.
+Alphabet language_alphabet(uint32_t language) {
+  Alphabet alphabet;
+  switch (language % 4) {
+    case 0:
+      add(alphabet, 'a', 'z', 8);
+      add(alphabet, 0x00E0, 0x00F6); // Latin-1 letters
+      add(alphabet, 0x00F8, 0x00FF);
+      break;
+    case 1:
+      add(alphabet, 0x0430, 0x044F, 2); // Cyrillic
+      break;
+    case 2:
+      add(alphabet, 0x03B1, 0x03C9, 2); // Greek
+      add(alphabet, 0x03AC, 0x03AF); // With tonos, which decompose
+      break;
+    case 3:
+      add(alphabet, 0xE000, 0xE07F); // Private Use Area
+      break;
+  }
+  return alphabet;
+}
+
+// Generates `count` distinct words from `alphabet`.
+Words distinct_words(const Alphabet &alphabet, uint32_t count, uint32_t seed) {
+  std::unordered_set<std::string> seen;
+  Words words;
+  words.reserve(count);
+  while (words.size() < count) {
+    Words batch = condict_bench::generate_words(alphabet, count, seed++);
+    for (std::string &word : batch) {
+      if (words.size() < count && seen.insert(word).second) {
+        words.push_back(std::move(word));
+      }
+    }
+  }
+  return words;
+}
+
+struct Lemma {
+  uint32_t language_id;
+  std::string term;
+};
+
+struct FieldValue {
+  uint32_t field_id;
+  std::string value;
+};
+
+struct Dataset {
+  std::vector<Lemma> lemmas;
+  std::vector<FieldValue> field_values;
+  // The number of lemmas in each language.
+  uint32_t per_language;
+};
+
+Dataset generate(uint32_t lemma_count) {
+  Dataset data;
+  data.per_language = lemma_count / LANGUAGE_COUNT;
+  for (uint32_t lang = 0; lang < LANGUAGE_COUNT; lang++) {
+    Words terms = distinct_words(
+      language_alphabet(lang),
+      data.per_language,
+      100 * lang
+    );
+    for (std::string &term : terms) {
+      data.lemmas.push_back(Lemma{lang + 1, std::move(term)});
+    }
+  }
+  // Insert in random order, as a dictionary is built.
+  std::mt19937 rng(1);
+  std::shuffle(data.lemmas.begin(), data.lemmas.end(), rng);
+
+  // List values repeat across fields, as "noun", "verb" and so on do, which
+  // gives the group by something to group.
+  Words values = distinct_words(language_alphabet(0), lemma_count / 32, 7);
+  for (uint32_t field = 0; field < FIELD_COUNT; field++) {
+    std::unordered_set<uint32_t> used;
+    for (uint32_t i = 0; i < lemma_count / FIELD_COUNT / 4; i++) {
+      uint32_t index = rng() % values.size();
+      if (used.insert(index).second) {
+        data.field_values.push_back(FieldValue{field + 1, values[index]});
+      }
+    }
+  }
+  return data;
+}
+
+sqlite3* open_database(
+  const char* extension,
+  const std::string &collation,
+  const Dataset &data
+) {
+  sqlite3* db;
+  // In memory, so that I/O doesn't drown out the collation.
+  if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+    fail(db, "sqlite3_open");
+  }
+  sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, nullptr);
+  char* error = nullptr;
+  if (sqlite3_load_extension(db, extension, nullptr, &error) != SQLITE_OK) {
+    fprintf(stderr, "Could not load %s: %s\n", extension, error);
+    exit(1);
+  }
+
+  for (const std::string &sql : schema(collation)) {
+    exec(db, sql);
+  }
+
+  exec(db, "begin");
+  for (uint32_t lang = 1; lang <= LANGUAGE_COUNT; lang++) {
+    exec(db,
+      "insert into languages (id, lemma_count, description_id, time_created,"
+      "  time_updated, name)"
+      "values (" + std::to_string(lang) + ", " +
+      std::to_string(data.per_language) + ", " + std::to_string(lang) +
+      ", 0, 0, 'language " + std::to_string(lang) + "')"
+    );
+  }
+  for (uint32_t field = 1; field <= FIELD_COUNT; field++) {
+    exec(db,
+      "insert into fields (id, language_id, value_type, name, name_abbr)"
+      "values (" + std::to_string(field) + ", 1, 1, 'field " +
+      std::to_string(field) + "', '')"
+    );
+  }
+  {
+    Statement insert(db,
+      "insert into field_values (field_id, value, value_abbr)"
+      "values (?, ?, '')"
+    );
+    for (const FieldValue &value : data.field_values) {
+      insert.bind(1, value.field_id);
+      insert.bind(2, value.value);
+      insert.run();
+    }
+  }
+  {
+    Statement insert(db, "insert into lemmas (language_id, term) values (?, ?)");
+    for (const Lemma &lemma : data.lemmas) {
+      insert.bind(1, lemma.language_id);
+      insert.bind(2, lemma.term);
+      insert.run();
+    }
+  }
+  exec(db, "commit");
+  return db;
+}
+
+// Runs `prepare` untimed, then `run` timed, WARMUP + REPETITIONS times, and
+// returns the fastest run in nanoseconds.
+template<typename Prepare, typename Run>
+double measure(Prepare prepare, Run run) {
+  double best = 0;
+  for (uint32_t rep = 0; rep < WARMUP + REPETITIONS; rep++) {
+    prepare();
+    auto start = steady_clock::now();
+    run();
+    std::chrono::duration<double, std::nano> ns = steady_clock::now() - start;
+    if (rep >= WARMUP && (best == 0 || ns.count() < best)) {
+      best = ns.count();
+    }
+  }
+  return best;
+}
+
+// Returns the number of times the extension's collations were called by one
+// run of `run`.
+template<typename Prepare, typename Run>
+int64_t count_comparisons(sqlite3* db, Prepare prepare, Run run) {
+  Statement reset(db, "select unicode_collation_stats_reset()");
+  Statement read(db,
+    "select value from unicode_collation_stats where name = 'comparisons'"
+  );
+  prepare();
+  reset.run();
+  run();
+  return read.run_int();
+}
+
+struct Workload {
+  const char* name;
+  // The number of operations in one run, e.g. rows indexed or queries run.
+  uint32_t ops;
+  const char* unit;
+  // Untimed setup before each run.
+  void (*prepare)(sqlite3* db);
+  void (*run)(sqlite3* db, const char* collation, const Dataset &data);
+};
+
+void prepare_nothing(sqlite3*) { }
+
+void drop_lemma_index(sqlite3* db) {
+  exec(db, DROP_LEMMA_INDEX);
+}
+
+void create_lemma_index(sqlite3* db, const char*, const Dataset&) {
+  exec(db, CREATE_LEMMA_INDEX);
+}
+
+// Pagination as in Lemma.allByLanguageUnfiltered, which walks the index.
+void run_pages(sqlite3* db, const char*, const Dataset &data) {
+  Statement page(db,
+    "select l.* from lemmas l"
+    "  where l.language_id = ?"
+    "  order by l.term"
+    "  limit ? offset ?"
+  );
+  std::mt19937 rng(2);
+  for (uint32_t i = 0; i < PAGES; i++) {
+    page.bind(1, 1 + i % LANGUAGE_COUNT);
+    page.bind(2, PAGE_SIZE);
+    page.bind(3, rng() % data.per_language);
+    page.run();
+  }
+}
+
+// The same, when the index can't be used for the order, as with a tailored
+// language collation. The unary + keeps the column's collation.
+void run_sorted_pages(sqlite3* db, const char*, const Dataset &data) {
+  Statement page(db,
+    "select l.* from lemmas l"
+    "  where l.language_id = ?"
+    "  order by +l.term"
+    "  limit ? offset ?"
+  );
+  std::mt19937 rng(3);
+  for (uint32_t i = 0; i < SORTED_PAGES; i++) {
+    page.bind(1, 1 + i % LANGUAGE_COUNT);
+    page.bind(2, PAGE_SIZE);
+    page.bind(3, rng() % data.per_language);
+    page.run();
+  }
+}
+
+void run_lookups(sqlite3* db, const char*, const Dataset &data) {
+  Statement lookup(db,
+    "select l.id from lemmas l where l.language_id = ? and l.term = ?"
+  );
+  std::mt19937 rng(4);
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    const Lemma &lemma = data.lemmas[rng() % data.lemmas.size()];
+    lookup.bind(1, lemma.language_id);
+    lookup.bind(2, lemma.term);
+    if (lookup.run() != 1) {
+      fprintf(stderr, "Lemma not found: %s\n", lemma.term.c_str());
+      exit(1);
+    }
+  }
+}
+
+// Duplicate detection as in validateFieldValues, where the collation is
+// given in the query.
+void run_group_by(sqlite3* db, const char* collation, const Dataset&) {
+  Statement group(db,
+    std::string("select value, count(*) from field_values") +
+    "  group by value collate " + collation +
+    "  having count(*) > 1"
+  );
+  group.run();
+}
+
+// Filling a sort key column, one row at a time with unicode_sort_key() and
+// in batches with unicode_rebuild_sort_keys().
+void bench_rebuild_keys(
+  sqlite3* db,
+  uint32_t lemma_count,
+  const Dataset &data
+) {
+  exec(db, "alter table lemmas add column term_key blob");
+  double rows = (double) data.lemmas.size();
+  std::string prefix = "rebuild_keys_" + std::to_string(lemma_count) + "_";
+
+  double update_ns = measure(
+    []() { },
+    [&]() { exec(db, "update lemmas set term_key = unicode_sort_key(term)"); }
+  );
+  double rebuild_ns = measure(
+    []() { },
+    [&]() {
+      Statement(db,
+        "select unicode_rebuild_sort_keys('lemmas', 'term', 'term_key')"
+      ).run();
+    }
+  );
+  report(SUITE, (prefix + "update").c_str(), update_ns / rows, "ns/row");
+  report(SUITE, (prefix + "rebuild").c_str(), rebuild_ns / rows, "ns/row");
+  report(
+    SUITE,
+    (prefix + "update_vs_rebuild").c_str(),
+    update_ns / rebuild_ns,
+    "x"
+  );
+}
+
+void bench_lemma_count(const char* extension, uint32_t lemma_count) {
+  Dataset data = generate(lemma_count);
+
+  sqlite3* dbs[COLLATION_COUNT];
+  for (uint32_t i = 0; i < COLLATION_COUNT; i++) {
+    dbs[i] = open_database(extension, COLLATIONS[i], data);
+    exec(dbs[i], CREATE_LEMMA_INDEX);
+  }
+
+  const Workload workloads[] = {
+    {
+      "create_index",
+      (uint32_t) data.lemmas.size(),
+      "ns/row",
+      drop_lemma_index,
+      create_lemma_index,
+    },
+    { "page", PAGES, "ns/query", prepare_nothing, run_pages },
+    {
+      "sorted_page",
+      SORTED_PAGES,
+      "ns/query",
+      prepare_nothing,
+      run_sorted_pages,
+    },
+    { "lookup", LOOKUPS, "ns/query", prepare_nothing, run_lookups },
+    {
+      "group_by",
+      (uint32_t) data.field_values.size(),
+      "ns/row",
+      prepare_nothing,
+      run_group_by,
+    },
+  };
+
+  for (const Workload &workload : workloads) {
+    std::string prefix =
+      std::string(workload.name) + "_" + std::to_string(lemma_count) + "_";
+
+    double per_op[COLLATION_COUNT];
+    for (uint32_t i = 0; i < COLLATION_COUNT; i++) {
+      sqlite3* db = dbs[i];
+      double ns = measure(
+        [&]() { workload.prepare(db); },
+        [&]() { workload.run(db, COLLATIONS[i], data); }
+      );
+      per_op[i] = ns / workload.ops;
+      report(SUITE, (prefix + COLLATIONS[i]).c_str(), per_op[i], workload.unit);
+    }
+    // COLLATIONS[1] is binary.
+    report(
+      SUITE,
+      (prefix + "unicode_vs_binary").c_str(),
+      per_op[0] / per_op[1],
+      "x"
+    );
+
+    // How often SQLite calls the collation, which the query plan decides.
+    int64_t comparisons = count_comparisons(
+      dbs[0],
+      [&]() { workload.prepare(dbs[0]); },
+      [&]() { workload.run(dbs[0], COLLATIONS[0], data); }
+    );
+    report(
+      SUITE,
+      (prefix + "unicode_comparisons").c_str(),
+      (double) comparisons / workload.ops,
+      "calls/op"
+    );
+  }
+
+  // COLLATIONS[0] is unicode.
+  bench_rebuild_keys(dbs[0], lemma_count, data);
+
+  for (sqlite3* db : dbs) {
+    sqlite3_close(db);
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* extension = DEFAULT_EXTENSION;
+  std::vector<uint32_t> lemma_counts;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      extension = argv[++i];
+    } else {
+      long count = strtol(argv[i], nullptr, 10);
+      if (count < (long) LANGUAGE_COUNT) {
+        fprintf(stderr, "Invalid lemma count: %s\n", argv[i]);
+        return 1;
+      }
+      lemma_counts.push_back((uint32_t) count);
+    }
+  }
+  if (lemma_counts.empty()) {
+    lemma_counts.assign(
+      std::begin(DEFAULT_LEMMA_COUNTS),
+      std::end(DEFAULT_LEMMA_COUNTS)
+    );
+  }
+
+  for (uint32_t lemma_count : lemma_counts) {
+    bench_lemma_count(extension, lemma_count);
+  }
+  return 0;
+}
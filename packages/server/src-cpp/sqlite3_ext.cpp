@@ -4,11 +4,91 @@
 # define CONDICT_EXPORT __attribute__((visibility("default")))
 #endif
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "../deps/sqlite3ext.h"
 SQLITE_EXTENSION_INIT1
 
+#include "sqlite3_rank.h"
 #include "uca/uca.h"
+#include "uca/data.h"
+#include "uca/distance.h"
+#include "uca/key_pool.h"
+#include "uca/nfc.h"
+#include "uca/sort_key.h"
+#include "uca/stats.h"
+#include "uca/tailoring.h"
+
+using Encoding = condict_uca::Encoding;
+using EditDistance = condict_uca::distance::EditDistance;
+using KeyBatch = condict_uca::sort_key::KeyBatch;
+using KeyBuilder = condict_uca::sort_key::KeyBuilder;
+using KeyPool = condict_uca::sort_key::KeyPool;
+using Measurement = condict_uca::stats::Measurement;
+using Normalizer = condict_uca::nfc::Normalizer;
+using StatsCounter = condict_uca::stats::Counter;
+using StatsTotals = condict_uca::stats::Totals;
+using Tailoring = condict_uca::tailoring::Tailoring;
+using TailoringError = condict_uca::tailoring::CompileError;
+
+using CollateFn = int (*)(void*, int, const void*, int, const void*);
+
+// Registers a collation in each of SQLite's text encodings, with a callback
+// for each, so that SQLite never has to convert the text of a UTF-16 database
+// to UTF-8 (and back) to compare it. Only the UTF-8 registration owns the
+// context, which is freed by `destroy`. The UTF-16 registrations are purely
+// an optimisation: if one of them fails, SQLite falls back to the UTF-8 one,
+// so its error is ignored.
+int condict_create_collation(
+  sqlite3* db,
+  const char* name,
+  void* context,
+  CollateFn utf8,
+  CollateFn utf16le,
+  CollateFn utf16be,
+  void (*destroy)(void*)
+) {
+  int result = sqlite3_create_collation_v2(
+    db,
+    name,
+    SQLITE_UTF8,
+    context,
+    utf8,
+    destroy
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  sqlite3_create_collation_v2(
+    db,
+    name,
+    SQLITE_UTF16LE,
+    context,
+    utf16le,
+    nullptr
+  );
+  sqlite3_create_collation_v2(
+    db,
+    name,
+    SQLITE_UTF16BE,
+    context,
+    utf16be,
+    nullptr
+  );
+  return SQLITE_OK;
+}
 
+template<Encoding E>
 int condict_collate_unicode(
   void* _context,
   int a_len,
@@ -17,6 +97,85 @@ int condict_collate_unicode(
   const void* b
 ) {
   return condict_uca::compare(
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+// Like `unicode`, but strings that are equal by collation elements are
+// ordered by their code points in NFD, so only canonically equivalent strings
+// compare equal. Useful for indexes that need a total order.
+template<Encoding E>
+int condict_collate_unicode_tb(
+  void* _context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  return condict_uca::compare_tb(
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+// Like `unicode`, but both strings must already be in NFD, for example from
+// unicode_nfd(). Skips normalization, which makes comparisons cheaper. Strings
+// that are not in NFD compare in an undefined (but memory-safe) order.
+template<Encoding E>
+int condict_collate_unicode_trusted_nfd(
+  void* _context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  return condict_uca::compare_nfd(
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+// Like `unicode`, but runs of decimal digits are ordered by their numeric
+// value, so "10" sorts after "2". Useful for numbered senses, tags and the
+// like.
+template<Encoding E>
+int condict_collate_unicode_numeric(
+  void* _context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  return condict_uca::compare_numeric(
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+// The reverse collation is registered for UTF-8 only. It decodes strings from
+// the end, which the UTF-16 iterator does not support; SQLite converts UTF-16
+// text for it instead.
+int condict_collate_unicode_reverse(
+  void* _context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  return condict_uca::compare_reverse(
     a_len,
     reinterpret_cast<const char*>(a),
     b_len,
@@ -24,6 +183,1318 @@ int condict_collate_unicode(
   );
 }
 
+// The collation of a CLDR locale with a precompiled tailoring, such as
+// `unicode_sv`. The context is the tailoring, which is null if the locale uses
+// the root collation.
+template<Encoding E>
+int condict_collate_locale(
+  void* context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  return condict_uca::compare_tailored(
+    reinterpret_cast<const Tailoring*>(context),
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+int condict_register_locales(sqlite3* db) {
+  using condict_uca::tailoring::locale_names;
+  using condict_uca::tailoring::get_locale;
+
+  for (const char* const* name = locale_names; *name; name++) {
+    std::string collation_name = std::string("unicode_") + *name;
+    // Precompiled tailorings are never freed, so there's no destructor.
+    int result = condict_create_collation(
+      db,
+      collation_name.c_str(),
+      const_cast<Tailoring*>(get_locale(*name)),
+      condict_collate_locale<Encoding::UTF8>,
+      condict_collate_locale<Encoding::UTF16LE>,
+      condict_collate_locale<Encoding::UTF16BE>,
+      nullptr
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+  return SQLITE_OK;
+}
+
+// unicode_data_source()
+//
+// Returns the path of the collation data file in use, or null if the tables
+// that are compiled into the extension are used. See uca/data.h.
+void condict_unicode_data_source(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  const char* source = condict_uca::data::get().source;
+  if (source) {
+    sqlite3_result_text(context, source, -1, SQLITE_STATIC);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+// unicode_data_error()
+//
+// If a collation data file was given but could not be loaded, returns a message
+// that describes the problem. Otherwise, returns null.
+void condict_unicode_data_error(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  const char* error = condict_uca::data::get().load_error;
+  if (error) {
+    sqlite3_result_text(context, error, -1, SQLITE_STATIC);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+// Finds the tailoring used by one of the collations that this extension
+// registers, which is null for collations that use the root collation.
+// Returns false if the collation is unknown. Tailorings created by
+// unicode_tailor() are not included, as their rules are not known here.
+bool condict_find_collation(const char* name, const Tailoring* &result) {
+  static const char* const root_collations[] = {
+    "unicode",
+    "unicode_tb",
+    "unicode_trusted_nfd",
+    "unicode_numeric",
+    "unicode_reverse",
+  };
+
+  // Like SQLite, we ignore the case of ASCII letters in collation names.
+  for (const char* root : root_collations) {
+    if (sqlite3_stricmp(name, root) == 0) {
+      result = nullptr;
+      return true;
+    }
+  }
+
+  if (sqlite3_strnicmp(name, "unicode_", 8) != 0) {
+    return false;
+  }
+  using condict_uca::tailoring::locale_names;
+  for (const char* const* locale = locale_names; *locale; locale++) {
+    if (sqlite3_stricmp(name + 8, *locale) == 0) {
+      result = condict_uca::tailoring::get_locale(*locale);
+      return true;
+    }
+  }
+  return false;
+}
+
+// unicode_collation_version([collation])
+//
+// Returns a string that identifies the order of the specified collation, or
+// of the root collation if the argument is omitted. The version changes when
+// the order might have changed, such as after upgrading to a new version of
+// Unicode or loading a different data file, and indexes that use the collation
+// need to be rebuilt. Returns null if the collation is not registered by this
+// extension.
+void condict_unicode_collation_version(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (argc > 1) {
+    sqlite3_result_error(
+      context,
+      "unicode_collation_version() takes 0 or 1 arguments",
+      -1
+    );
+    return;
+  }
+
+  const Tailoring* tailoring = nullptr;
+  if (argc == 1) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+      sqlite3_result_null(context);
+      return;
+    }
+    const char* name =
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    if (!condict_find_collation(name, tailoring)) {
+      sqlite3_result_null(context);
+      return;
+    }
+  }
+
+  std::string version = condict_uca::collation_version(tailoring);
+  sqlite3_result_text64(
+    context,
+    version.data(),
+    version.size(),
+    SQLITE_TRANSIENT,
+    SQLITE_UTF8
+  );
+}
+
+// The kinds of sort keys, by the collation they match.
+enum class SortKeyKind {
+  UNICODE,
+  NUMERIC,
+  REVERSE,
+};
+
+// unicode_sort_key(str), unicode_numeric_sort_key(str),
+// unicode_reverse_sort_key(str)
+//
+// Returns a blob that sorts (as a blob) in the same order as `str` does under
+// the `unicode`, `unicode_numeric` or `unicode_reverse` collation. If `str` is
+// null, the result is null.
+template<SortKeyKind Kind>
+void condict_unicode_sort_key(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  const char* str = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  int str_len = sqlite3_value_bytes(argv[0]);
+
+  // As with the edit distance, each connection has its own KeyBuilder.
+  KeyBuilder* builder =
+    reinterpret_cast<KeyBuilder*>(sqlite3_user_data(context));
+  uint32_t key_len = Kind == SortKeyKind::REVERSE
+    ? builder->build_reverse(str_len, str)
+    : builder->build(
+        str_len,
+        str,
+        condict_uca::sort_key::MAX_STRENGTH,
+        Kind == SortKeyKind::NUMERIC
+      );
+  sqlite3_result_blob64(
+    context,
+    builder->data(),
+    key_len,
+    SQLITE_TRANSIENT
+  );
+}
+
+void condict_destroy_key_builder(void* builder) {
+  delete reinterpret_cast<KeyBuilder*>(builder);
+}
+
+int condict_register_sort_key(
+  sqlite3* db,
+  const char* name,
+  SortKeyKind kind
+) {
+  KeyBuilder* builder = new (std::nothrow) KeyBuilder();
+  if (!builder) {
+    return SQLITE_NOMEM;
+  }
+  void (*func)(sqlite3_context*, int, sqlite3_value**) = nullptr;
+  switch (kind) {
+    case SortKeyKind::UNICODE:
+      func = condict_unicode_sort_key<SortKeyKind::UNICODE>;
+      break;
+    case SortKeyKind::NUMERIC:
+      func = condict_unicode_sort_key<SortKeyKind::NUMERIC>;
+      break;
+    case SortKeyKind::REVERSE:
+      func = condict_unicode_sort_key<SortKeyKind::REVERSE>;
+      break;
+  }
+  // The function has no side effects, so it's safe to use in the triggers
+  // that maintain rank tables, even when the schema isn't trusted.
+  // If registration fails, SQLite calls the destructor for us.
+  return sqlite3_create_function_v2(
+    db,
+    name,
+    1,
+    SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS,
+    builder,
+    func,
+    nullptr,
+    nullptr,
+    condict_destroy_key_builder
+  );
+}
+
+// The number of rows that unicode_rebuild_sort_keys() reads at a time. There
+// are two batches in memory at once: one whose keys are being built, and one
+// that is being read or written.
+constexpr int REBUILD_BATCH_SIZE = 8192;
+
+// The pointer type of batches bound to unicode_rebuild_sort_keys_batch(). See
+// sqlite3_bind_pointer(): SQL code cannot make pointers of this type.
+const char* const REBUILD_BATCH_POINTER = "condict_rebuild_batch";
+
+// A batch of rows read by unicode_rebuild_sort_keys().
+struct RebuildBatch {
+  std::vector<sqlite3_int64> rowids;
+  // Whether the text of each row is null.
+  std::vector<bool> nulls;
+  // The text of all the rows, back to back, and the end of each row's text.
+  std::string text;
+  std::vector<size_t> ends;
+  // Views into `text`, filled in after the whole batch has been read.
+  std::vector<std::string_view> strings;
+  KeyBatch keys;
+  // The index of the row that is likely to be written next.
+  uint32_t cursor;
+
+  inline RebuildBatch() : cursor(0) { }
+
+  inline uint32_t size() const {
+    return (uint32_t) this->rowids.size();
+  }
+
+  inline void clear() {
+    this->rowids.clear();
+    this->nulls.clear();
+    this->text.clear();
+    this->ends.clear();
+    this->strings.clear();
+    this->cursor = 0;
+  }
+};
+
+// Reads the next batch of rows into `batch`, starting from the row after
+// `after`, or from the first row if `first` is true.
+int condict_read_rebuild_batch(
+  sqlite3_stmt* select,
+  bool first,
+  sqlite3_int64 after,
+  RebuildBatch &batch
+) {
+  batch.clear();
+
+  // Rowids can be any 64-bit integer, so we select `rowid >= ?` rather than
+  // `rowid > ?`, which could not include the smallest one.
+  sqlite3_int64 start;
+  if (first) {
+    start = INT64_MIN;
+  } else if (after == INT64_MAX) {
+    return SQLITE_OK;
+  } else {
+    start = after + 1;
+  }
+
+  int result = sqlite3_bind_int64(select, 1, start);
+  while (result == SQLITE_OK && (result = sqlite3_step(select)) == SQLITE_ROW) {
+    batch.rowids.push_back(sqlite3_column_int64(select, 0));
+    bool is_null = sqlite3_column_type(select, 1) == SQLITE_NULL;
+    batch.nulls.push_back(is_null);
+    if (!is_null) {
+      // The text must be fetched before its length: see the SQLite docs.
+      const char* str =
+        reinterpret_cast<const char*>(sqlite3_column_text(select, 1));
+      int str_len = sqlite3_column_bytes(select, 1);
+      if (!str && str_len > 0) {
+        result = SQLITE_NOMEM;
+        break;
+      }
+      batch.text.append(str, str_len);
+    }
+    batch.ends.push_back(batch.text.size());
+    result = SQLITE_OK;
+  }
+  int reset_result = sqlite3_reset(select);
+  if (result == SQLITE_DONE) {
+    result = reset_result;
+  }
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  batch.strings.reserve(batch.size());
+  for (uint32_t i = 0; i < batch.size(); i++) {
+    size_t start = i > 0 ? batch.ends[i - 1] : 0;
+    batch.strings.emplace_back(
+      batch.text.data() + start,
+      batch.ends[i] - start
+    );
+  }
+  return SQLITE_OK;
+}
+
+// unicode_rebuild_sort_keys_batch(batch, rowid)
+//
+// Returns the key of the row with the given rowid from a batch whose keys have
+// been built. Only for use by unicode_rebuild_sort_keys(), which writes a whole
+// batch with one UPDATE statement: that is much faster than one UPDATE per row.
+void condict_unicode_rebuild_sort_keys_batch(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  RebuildBatch* batch = reinterpret_cast<RebuildBatch*>(
+    sqlite3_value_pointer(argv[0], REBUILD_BATCH_POINTER)
+  );
+  if (!batch) {
+    sqlite3_result_error(
+      context,
+      "unicode_rebuild_sort_keys_batch() is internal to "
+      "unicode_rebuild_sort_keys()",
+      -1
+    );
+    return;
+  }
+
+  // SQLite updates the rows in rowid order, the order they were read in, so
+  // we only search for the row if it is not the one after the last one.
+  sqlite3_int64 rowid = sqlite3_value_int64(argv[1]);
+  uint32_t i = batch->cursor;
+  if (i >= batch->size() || batch->rowids[i] != rowid) {
+    auto row = std::lower_bound(
+      batch->rowids.begin(),
+      batch->rowids.end(),
+      rowid
+    );
+    if (row == batch->rowids.end() || *row != rowid) {
+      sqlite3_result_error(
+        context,
+        "unicode_rebuild_sort_keys(): row changed during rebuild",
+        -1
+      );
+      return;
+    }
+    i = (uint32_t) (row - batch->rowids.begin());
+  }
+  batch->cursor = i + 1;
+
+  if (batch->nulls[i]) {
+    sqlite3_result_null(context);
+  } else {
+    // The keys outlive the UPDATE statement.
+    sqlite3_result_blob64(
+      context,
+      batch->keys.key(i),
+      batch->keys.key_len(i),
+      SQLITE_STATIC
+    );
+  }
+}
+
+// Writes the keys of a batch whose keys have been built.
+int condict_write_rebuild_batch(sqlite3_stmt* update, RebuildBatch &batch) {
+  batch.cursor = 0;
+  int result = sqlite3_bind_int64(update, 1, batch.rowids.front());
+  if (result == SQLITE_OK) {
+    result = sqlite3_bind_int64(update, 2, batch.rowids.back());
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_bind_pointer(
+      update,
+      3,
+      &batch,
+      REBUILD_BATCH_POINTER,
+      nullptr
+    );
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_step(update);
+  }
+  int reset_result = sqlite3_reset(update);
+  if (result == SQLITE_DONE) {
+    result = reset_result;
+  }
+  // Don't leave a dangling pointer in the statement.
+  sqlite3_clear_bindings(update);
+  return result;
+}
+
+// Does the work of unicode_rebuild_sort_keys(), except for the savepoint.
+// Counts the rows that were updated in `row_count`.
+int condict_rebuild_sort_keys(
+  sqlite3* db,
+  const char* table,
+  const char* text_column,
+  const char* key_column,
+  bool reverse,
+  sqlite3_int64 &row_count
+) {
+  char* select_sql = sqlite3_mprintf(
+    "select rowid, \"%w\" from \"%w\" where rowid >= ? order by rowid limit %d",
+    text_column,
+    table,
+    REBUILD_BATCH_SIZE
+  );
+  char* update_sql = sqlite3_mprintf(
+    "update \"%w\" set \"%w\" = unicode_rebuild_sort_keys_batch(?3, rowid)"
+    "  where rowid between ?1 and ?2",
+    table,
+    key_column
+  );
+  sqlite3_stmt* select = nullptr;
+  sqlite3_stmt* update = nullptr;
+  int result = select_sql && update_sql ? SQLITE_OK : SQLITE_NOMEM;
+  if (result == SQLITE_OK) {
+    result = sqlite3_prepare_v2(db, select_sql, -1, &select, nullptr);
+  }
+  if (result == SQLITE_OK) {
+    result = sqlite3_prepare_v2(db, update_sql, -1, &update, nullptr);
+  }
+  sqlite3_free(select_sql);
+  sqlite3_free(update_sql);
+
+  if (result == SQLITE_OK) {
+    // The batches must outlive the pool, which may still be using one of
+    // them if we stop early.
+    RebuildBatch batches[2];
+    KeyPool pool(std::thread::hardware_concurrency());
+    if (pool.thread_count() == 0) {
+      result = SQLITE_NOMEM;
+    }
+
+    // The pool builds the keys of one batch while this thread writes the
+    // batch before it and reads the batch after it, so that the workers are
+    // never idle for long.
+    RebuildBatch* current = &batches[0];
+    RebuildBatch* next = &batches[1];
+    if (result == SQLITE_OK) {
+      result = condict_read_rebuild_batch(select, true, 0, *current);
+    }
+    if (result == SQLITE_OK && current->size() > 0) {
+      pool.start(
+        current->strings.data(),
+        current->size(),
+        current->keys,
+        reverse
+      );
+      if (current->size() == REBUILD_BATCH_SIZE) {
+        result = condict_read_rebuild_batch(
+          select,
+          false,
+          current->rowids.back(),
+          *next
+        );
+      }
+    }
+    while (result == SQLITE_OK && current->size() > 0) {
+      pool.wait();
+      if (next->size() > 0) {
+        pool.start(next->strings.data(), next->size(), next->keys, reverse);
+      }
+
+      result = condict_write_rebuild_batch(update, *current);
+      if (result != SQLITE_OK) {
+        break;
+      }
+      row_count += current->size();
+
+      if (next->size() == REBUILD_BATCH_SIZE) {
+        result = condict_read_rebuild_batch(
+          select,
+          false,
+          next->rowids.back(),
+          *current
+        );
+      } else {
+        current->clear();
+      }
+      std::swap(current, next);
+    }
+  }
+
+  sqlite3_finalize(select);
+  sqlite3_finalize(update);
+  return result;
+}
+
+// unicode_rebuild_sort_keys(table, text_column, key_column [, reverse])
+//
+// Sets `key_column` of every row in `table` to the sort key of `text_column`,
+// as unicode_sort_key() would, or unicode_reverse_sort_key() if `reverse` is
+// true. Returns the number of rows that were updated. This is much faster than
+// an equivalent UPDATE statement on large tables: the keys are built by one
+// worker thread per core, while the calling thread reads and writes rows. All
+// rows are updated in a single savepoint, so if anything fails, no keys are
+// changed. The table must have a rowid, and the text and key columns must be
+// different columns.
+void condict_unicode_rebuild_sort_keys(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (argc < 3 || argc > 4) {
+    sqlite3_result_error(
+      context,
+      "unicode_rebuild_sort_keys() takes 3 or 4 arguments",
+      -1
+    );
+    return;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (sqlite3_value_type(argv[i]) != SQLITE_TEXT) {
+      sqlite3_result_error(
+        context,
+        "unicode_rebuild_sort_keys(): table and column names must be strings",
+        -1
+      );
+      return;
+    }
+  }
+  const char* table =
+    reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  const char* text_column =
+    reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+  const char* key_column =
+    reinterpret_cast<const char*>(sqlite3_value_text(argv[2]));
+  bool reverse = argc == 4 && sqlite3_value_int(argv[3]) != 0;
+  if (!table || !text_column || !key_column) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+
+  sqlite3* db = sqlite3_context_db_handle(context);
+
+  // The names are quoted with double quotes in the queries, where SQLite takes
+  // a name that is not a column for a string literal, so we must check them.
+  int result = sqlite3_table_column_metadata(
+    db,
+    nullptr,
+    table,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    char* message = sqlite3_mprintf(
+      "unicode_rebuild_sort_keys(): no such table: %s",
+      table
+    );
+    sqlite3_result_error(context, message, -1);
+    sqlite3_free(message);
+    return;
+  }
+  for (const char* column : {text_column, key_column}) {
+    result = sqlite3_table_column_metadata(
+      db,
+      nullptr,
+      table,
+      column,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr
+    );
+    if (result != SQLITE_OK) {
+      char* message = sqlite3_mprintf(
+        "unicode_rebuild_sort_keys(): no such column: %s.%s",
+        table,
+        column
+      );
+      sqlite3_result_error(context, message, -1);
+      sqlite3_free(message);
+      return;
+    }
+  }
+
+  // Column names are case-insensitive. Writing keys over the text would
+  // leave nothing to build them from.
+  if (sqlite3_stricmp(text_column, key_column) == 0) {
+    sqlite3_result_error(
+      context,
+      "unicode_rebuild_sort_keys(): text and key columns must differ",
+      -1
+    );
+    return;
+  }
+
+  sqlite3_int64 row_count = 0;
+  result = sqlite3_exec(
+    db,
+    "savepoint unicode_rebuild_sort_keys",
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    sqlite3_result_error_code(context, result);
+    return;
+  }
+
+  result = condict_rebuild_sort_keys(
+    db,
+    table,
+    text_column,
+    key_column,
+    reverse,
+    row_count
+  );
+  if (result != SQLITE_OK) {
+    // The message must be copied before the rollback replaces it.
+    std::string message = sqlite3_errmsg(db);
+    sqlite3_exec(
+      db,
+      "rollback to unicode_rebuild_sort_keys;"
+      "release unicode_rebuild_sort_keys",
+      nullptr,
+      nullptr,
+      nullptr
+    );
+    if (result == SQLITE_NOMEM) {
+      // Also the result if the worker threads could not be started.
+      sqlite3_result_error_nomem(context);
+    } else {
+      sqlite3_result_error(context, message.c_str(), -1);
+      sqlite3_result_error_code(context, result);
+    }
+    return;
+  }
+
+  result = sqlite3_exec(
+    db,
+    "release unicode_rebuild_sort_keys",
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    sqlite3_result_error_code(context, result);
+    return;
+  }
+  sqlite3_result_int64(context, row_count);
+}
+
+// A collation that was registered by unicode_tailor(). The tailoring is null
+// if the rules don't tailor anything.
+struct TailoredCollation {
+  const Tailoring* tailoring;
+};
+
+// The tailored collations that have been registered on a connection, by name.
+// The collations themselves are owned by SQLite.
+using TailoredCollations = std::unordered_map<std::string, TailoredCollation*>;
+
+template<Encoding E>
+int condict_collate_tailored(
+  void* context,
+  int a_len,
+  const void* a,
+  int b_len,
+  const void* b
+) {
+  const TailoredCollation* collation =
+    reinterpret_cast<const TailoredCollation*>(context);
+  return condict_uca::compare_tailored(
+    collation->tailoring,
+    a_len,
+    reinterpret_cast<const char*>(a),
+    b_len,
+    reinterpret_cast<const char*>(b),
+    E
+  );
+}
+
+void condict_destroy_tailored_collation(void* context) {
+  TailoredCollation* collation = reinterpret_cast<TailoredCollation*>(context);
+  condict_uca::tailoring::release(collation->tailoring);
+  delete collation;
+}
+
+void condict_destroy_tailored_collations(void* collations) {
+  delete reinterpret_cast<TailoredCollations*>(collations);
+}
+
+// Compiles tailoring rules, or reports an error through `context` if the rules
+// are invalid. Returns true on success.
+bool condict_acquire_tailoring(
+  sqlite3_context* context,
+  sqlite3_value* rules_value,
+  const Tailoring* &result
+) {
+  result = nullptr;
+  if (sqlite3_value_type(rules_value) == SQLITE_NULL) {
+    return true;
+  }
+
+  const char* rules =
+    reinterpret_cast<const char*>(sqlite3_value_text(rules_value));
+  int rules_len = sqlite3_value_bytes(rules_value);
+
+  TailoringError error = { 0, nullptr };
+  result = condict_uca::tailoring::acquire(rules_len, rules, error);
+  if (error.message) {
+    char* message = sqlite3_mprintf(
+      "invalid tailoring rules: %s at offset %u",
+      error.message,
+      error.offset
+    );
+    if (message) {
+      sqlite3_result_error(context, message, -1);
+      sqlite3_free(message);
+    } else {
+      sqlite3_result_error_nomem(context);
+    }
+    return false;
+  }
+  return true;
+}
+
+// unicode_tailor(name, rules)
+//
+// Registers a collation with the given name on the current connection, which
+// orders strings according to `rules` on top of the root collation. If there
+// already is a tailored collation by that name, its rules are replaced. Null or
+// empty rules give the root collation. Compiled rules are shared between all
+// connections that use the same rules.
+void condict_unicode_tailor(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_error(context, "unicode_tailor(): name cannot be null", -1);
+    return;
+  }
+  const char* name =
+    reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+
+  const Tailoring* tailoring;
+  if (!condict_acquire_tailoring(context, argv[1], tailoring)) {
+    return;
+  }
+
+  TailoredCollations* collations =
+    reinterpret_cast<TailoredCollations*>(sqlite3_user_data(context));
+  auto existing = collations->find(name);
+  if (existing != collations->end()) {
+    // SQLite won't let us replace a collation while there are statements
+    // running, which there always are while this function is being called.
+    // Instead, we swap out the tailoring.
+    TailoredCollation* collation = existing->second;
+    condict_uca::tailoring::release(collation->tailoring);
+    collation->tailoring = tailoring;
+    sqlite3_result_null(context);
+    return;
+  }
+
+  TailoredCollation* collation = new (std::nothrow) TailoredCollation();
+  if (!collation) {
+    condict_uca::tailoring::release(tailoring);
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  collation->tailoring = tailoring;
+
+  // A tailored collation is never registered again once it exists, so the
+  // UTF-16 registrations can't outlive the UTF-8 one that owns `collation`.
+  int result = condict_create_collation(
+    sqlite3_context_db_handle(context),
+    name,
+    collation,
+    condict_collate_tailored<Encoding::UTF8>,
+    condict_collate_tailored<Encoding::UTF16LE>,
+    condict_collate_tailored<Encoding::UTF16BE>,
+    condict_destroy_tailored_collation
+  );
+  if (result != SQLITE_OK) {
+    // Unlike functions, SQLite does *not* call the destructor of a collation
+    // that failed to register.
+    condict_destroy_tailored_collation(collation);
+    sqlite3_result_error_code(context, result);
+    return;
+  }
+  (*collations)[name] = collation;
+  sqlite3_result_null(context);
+}
+
+// unicode_tailoring_error(rules)
+//
+// Returns a description of what is wrong with the given tailoring rules, or
+// null if they are valid.
+void condict_unicode_tailoring_error(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  const char* rules = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  int rules_len = sqlite3_value_bytes(argv[0]);
+
+  TailoringError error = { 0, nullptr };
+  const Tailoring* tailoring =
+    condict_uca::tailoring::acquire(rules_len, rules, error);
+  condict_uca::tailoring::release(tailoring);
+
+  if (error.message) {
+    char* message = sqlite3_mprintf(
+      "%s at offset %u",
+      error.message,
+      error.offset
+    );
+    if (!message) {
+      sqlite3_result_error_nomem(context);
+      return;
+    }
+    sqlite3_result_text(context, message, -1, sqlite3_free);
+  } else {
+    sqlite3_result_null(context);
+  }
+}
+
+// unicode_nfd(str), unicode_nfc(str)
+//
+// Returns `str` in Normalization Form D or C. Invalid UTF-8 sequences are
+// replaced with U+FFFD. If `str` is null, the result is null.
+template<bool Compose>
+void condict_unicode_normalize(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  const char* str = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  int str_len = sqlite3_value_bytes(argv[0]);
+
+  // As with sort keys, each connection has its own Normalizer.
+  Normalizer* normalizer =
+    reinterpret_cast<Normalizer*>(sqlite3_user_data(context));
+  uint32_t len = Compose
+    ? normalizer->to_nfc(str_len, str)
+    : normalizer->to_nfd(str_len, str);
+  sqlite3_result_text64(
+    context,
+    normalizer->data(),
+    len,
+    SQLITE_TRANSIENT,
+    SQLITE_UTF8
+  );
+}
+
+void condict_destroy_normalizer(void* normalizer) {
+  delete reinterpret_cast<Normalizer*>(normalizer);
+}
+
+int condict_register_normalizer(sqlite3* db, const char* name, bool compose) {
+  Normalizer* normalizer = new (std::nothrow) Normalizer();
+  if (!normalizer) {
+    return SQLITE_NOMEM;
+  }
+  // If registration fails, SQLite calls the destructor for us.
+  return sqlite3_create_function_v2(
+    db,
+    name,
+    1,
+    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+    normalizer,
+    compose
+      ? condict_unicode_normalize<true>
+      : condict_unicode_normalize<false>,
+    nullptr,
+    nullptr,
+    condict_destroy_normalizer
+  );
+}
+
+// unicode_edit_distance(a, b [, strength] [, max])
+//
+// Returns the edit distance between `a` and `b` over their collation elements.
+// `strength` defaults to 1 (primary weights only). If `max` is given, returns
+// max + 1 as soon as the distance is known to exceed it. If either string is
+// null, the result is null.
+void condict_unicode_edit_distance(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (argc < 2 || argc > 4) {
+    sqlite3_result_error(
+      context,
+      "unicode_edit_distance() takes 2 to 4 arguments",
+      -1
+    );
+    return;
+  }
+  if (
+    sqlite3_value_type(argv[0]) == SQLITE_NULL ||
+    sqlite3_value_type(argv[1]) == SQLITE_NULL
+  ) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  sqlite3_int64 strength = 1;
+  if (argc >= 3 && sqlite3_value_type(argv[2]) != SQLITE_NULL) {
+    strength = sqlite3_value_int64(argv[2]);
+    if (strength < 1 || strength > 4) {
+      sqlite3_result_error(
+        context,
+        "unicode_edit_distance(): strength must be between 1 and 4",
+        -1
+      );
+      return;
+    }
+  }
+
+  // Nothing we can compute is anywhere near this large.
+  sqlite3_int64 max = 0x7FFFFFFF;
+  if (argc >= 4 && sqlite3_value_type(argv[3]) != SQLITE_NULL) {
+    max = sqlite3_value_int64(argv[3]);
+    if (max < 0) {
+      sqlite3_result_error(
+        context,
+        "unicode_edit_distance(): max must not be negative",
+        -1
+      );
+      return;
+    }
+    if (max > 0x7FFFFFFF) {
+      max = 0x7FFFFFFF;
+    }
+  }
+
+  // The text must be fetched before its length: see the SQLite docs.
+  const char* a = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  int a_len = sqlite3_value_bytes(argv[0]);
+  const char* b = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+  int b_len = sqlite3_value_bytes(argv[1]);
+
+  // SQLite never calls functions concurrently on a single connection, so the
+  // connection's EditDistance can be reused without further synchronization.
+  EditDistance* dist =
+    reinterpret_cast<EditDistance*>(sqlite3_user_data(context));
+  uint32_t result = dist->compute(
+    a_len,
+    a,
+    b_len,
+    b,
+    (uint32_t) strength,
+    (uint32_t) max
+  );
+  sqlite3_result_int64(context, result);
+}
+
+void condict_destroy_edit_distance(void* dist) {
+  delete reinterpret_cast<EditDistance*>(dist);
+}
+
+// select name, value from unicode_collation_stats
+//
+// A read-only, eponymous virtual table with the collation statistics of the
+// whole process, summed over all threads and connections (see uca/stats.h).
+// There is one row per counter, followed by `fast_path`, which is the number
+// of code points that did not take the slow path, and a histogram of the
+// number of code points read per comparison. The histogram rows are named
+// after the range they count, e.g. `code_points_per_comparison_4-7`.
+//
+// The statistics are read once, when the query starts.
+
+// The rows that come after the counters.
+constexpr uint32_t STATS_FAST_PATH_ROW = condict_uca::stats::COUNTER_COUNT;
+constexpr uint32_t STATS_HISTOGRAM_ROW = STATS_FAST_PATH_ROW + 1;
+constexpr uint32_t STATS_ROW_COUNT =
+  STATS_HISTOGRAM_ROW + condict_uca::stats::HISTOGRAM_SIZE;
+
+struct StatsCursor {
+  // Must be first: SQLite only knows about this part.
+  sqlite3_vtab_cursor base;
+  StatsTotals totals;
+  uint32_t row;
+};
+
+int condict_stats_connect(
+  sqlite3* db,
+  void* _aux,
+  int _argc,
+  const char* const* _argv,
+  sqlite3_vtab** vtab,
+  char** _err
+) {
+  int result = sqlite3_declare_vtab(
+    db,
+    "create table x(name text, value integer)"
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  *vtab = reinterpret_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+  if (!*vtab) {
+    return SQLITE_NOMEM;
+  }
+  memset(*vtab, 0, sizeof(sqlite3_vtab));
+  sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+  return SQLITE_OK;
+}
+
+int condict_stats_disconnect(sqlite3_vtab* vtab) {
+  sqlite3_free(vtab);
+  return SQLITE_OK;
+}
+
+int condict_stats_best_index(sqlite3_vtab* _vtab, sqlite3_index_info* info) {
+  // There are no constraints we can use: the table is tiny.
+  info->estimatedCost = STATS_ROW_COUNT;
+  info->estimatedRows = STATS_ROW_COUNT;
+  return SQLITE_OK;
+}
+
+int condict_stats_open(sqlite3_vtab* _vtab, sqlite3_vtab_cursor** cursor) {
+  StatsCursor* c =
+    reinterpret_cast<StatsCursor*>(sqlite3_malloc(sizeof(StatsCursor)));
+  if (!c) {
+    return SQLITE_NOMEM;
+  }
+  memset(c, 0, sizeof(StatsCursor));
+  *cursor = &c->base;
+  return SQLITE_OK;
+}
+
+int condict_stats_close(sqlite3_vtab_cursor* cursor) {
+  sqlite3_free(cursor);
+  return SQLITE_OK;
+}
+
+int condict_stats_filter(
+  sqlite3_vtab_cursor* cursor,
+  int _idx_num,
+  const char* _idx_str,
+  int _argc,
+  sqlite3_value** _argv
+) {
+  StatsCursor* c = reinterpret_cast<StatsCursor*>(cursor);
+  c->totals = condict_uca::stats::read();
+  c->row = 0;
+  return SQLITE_OK;
+}
+
+int condict_stats_next(sqlite3_vtab_cursor* cursor) {
+  reinterpret_cast<StatsCursor*>(cursor)->row++;
+  return SQLITE_OK;
+}
+
+int condict_stats_eof(sqlite3_vtab_cursor* cursor) {
+  return reinterpret_cast<StatsCursor*>(cursor)->row >= STATS_ROW_COUNT;
+}
+
+// Writes the name of a stats row to `buf`, and returns it.
+const char* condict_stats_row_name(uint32_t row, char* buf, size_t size) {
+  if (row < STATS_FAST_PATH_ROW) {
+    return condict_uca::stats::counter_name((StatsCounter) row);
+  }
+  if (row == STATS_FAST_PATH_ROW) {
+    return "fast_path";
+  }
+
+  uint32_t bucket = row - STATS_HISTOGRAM_ROW;
+  unsigned long long start =
+    condict_uca::stats::histogram_bucket_start(bucket);
+  if (bucket + 1 == condict_uca::stats::HISTOGRAM_SIZE) {
+    snprintf(buf, size, "code_points_per_comparison_%llu+", start);
+  } else {
+    unsigned long long end =
+      condict_uca::stats::histogram_bucket_start(bucket + 1) - 1;
+    if (start == end) {
+      snprintf(buf, size, "code_points_per_comparison_%llu", start);
+    } else {
+      snprintf(
+        buf,
+        size,
+        "code_points_per_comparison_%llu-%llu",
+        start,
+        end
+      );
+    }
+  }
+  return buf;
+}
+
+uint64_t condict_stats_row_value(const StatsTotals &totals, uint32_t row) {
+  if (row < STATS_FAST_PATH_ROW) {
+    return totals.values[row];
+  }
+  if (row == STATS_FAST_PATH_ROW) {
+    return
+      totals.get(StatsCounter::CODE_POINTS) -
+      totals.get(StatsCounter::SLOW_PATH);
+  }
+  return totals.histogram[row - STATS_HISTOGRAM_ROW];
+}
+
+int condict_stats_column(
+  sqlite3_vtab_cursor* cursor,
+  sqlite3_context* context,
+  int column
+) {
+  const StatsCursor* c = reinterpret_cast<const StatsCursor*>(cursor);
+  if (column == 0) {
+    char name[80];
+    sqlite3_result_text(
+      context,
+      condict_stats_row_name(c->row, name, sizeof(name)),
+      -1,
+      SQLITE_TRANSIENT
+    );
+    return SQLITE_OK;
+  }
+
+  uint64_t value = condict_stats_row_value(c->totals, c->row);
+  sqlite3_result_int64(context, (sqlite3_int64) value);
+  return SQLITE_OK;
+}
+
+int condict_stats_rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+  *rowid = reinterpret_cast<StatsCursor*>(cursor)->row;
+  return SQLITE_OK;
+}
+
+sqlite3_module condict_stats_module = {
+  0, // iVersion
+  nullptr, // xCreate: eponymous only
+  condict_stats_connect,
+  condict_stats_best_index,
+  condict_stats_disconnect,
+  nullptr, // xDestroy
+  condict_stats_open,
+  condict_stats_close,
+  condict_stats_filter,
+  condict_stats_next,
+  condict_stats_eof,
+  condict_stats_column,
+  condict_stats_rowid,
+  nullptr, // xUpdate
+  nullptr, // xBegin
+  nullptr, // xSync
+  nullptr, // xCommit
+  nullptr, // xRollback
+  nullptr, // xFindFunction
+  nullptr, // xRename
+  nullptr, // xSavepoint
+  nullptr, // xRelease
+  nullptr, // xRollbackTo
+  nullptr, // xShadowName
+};
+
+// unicode_collation_stats_reset()
+//
+// Resets the collation statistics to zero. Since the statistics are shared
+// by the whole process, this affects every connection.
+//
+// Returns a JSON object with the non-zero statistics from before the reset,
+// named as in unicode_collation_stats:
+//
+//     {"comparisons":2,"bytes":10,"code_points":10,"fast_path":10,...}
+//
+// The values are read and reset in one step, so unlike reading the table and
+// then resetting, nothing that is counted in between goes missing.
+void condict_unicode_collation_stats_reset(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  StatsTotals totals = condict_uca::stats::take();
+
+  sqlite3_str* json = sqlite3_str_new(sqlite3_context_db_handle(context));
+  sqlite3_str_appendchar(json, 1, '{');
+  bool first = true;
+  for (uint32_t row = 0; row < STATS_ROW_COUNT; row++) {
+    uint64_t value = condict_stats_row_value(totals, row);
+    if (value == 0) {
+      continue;
+    }
+    char name[80];
+    sqlite3_str_appendf(
+      json,
+      "%s\"%s\":%llu",
+      first ? "" : ",",
+      condict_stats_row_name(row, name, sizeof(name)),
+      (unsigned long long) value
+    );
+    first = false;
+  }
+  sqlite3_str_appendchar(json, 1, '}');
+
+  int len = sqlite3_str_length(json);
+  char* result = sqlite3_str_finish(json);
+  if (!result) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  sqlite3_result_text(context, result, len, sqlite3_free);
+}
+
+// unicode_collation_measure_start()
+// unicode_collation_measure_stop()
+//
+// Measures the collation cost of the statements that run in between, for
+// example to find out which queries would benefit from a sort key column.
+// Each connection has its own measurement, which is restarted by every call
+// to unicode_collation_measure_start().
+//
+// unicode_collation_measure_stop() returns a JSON object with the number of
+// comparisons, the number of code points they read and the time they took:
+//
+//     {"comparisons":2,"code_points":12,"nanoseconds":840}
+//
+// If the measurement is not running, the result is null. The measurement runs
+// on the thread that started it, and must be stopped on the same thread. It
+// includes all comparisons on that thread, including those of other
+// connections, but a thread normally runs one statement at a time. Only
+// comparisons are counted, not sort keys.
+void condict_unicode_collation_measure_start(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  Measurement* measurement =
+    reinterpret_cast<Measurement*>(sqlite3_user_data(context));
+  measurement->start();
+  sqlite3_result_null(context);
+}
+
+void condict_unicode_collation_measure_stop(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  Measurement* measurement =
+    reinterpret_cast<Measurement*>(sqlite3_user_data(context));
+  if (!measurement->stop()) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  char json[128];
+  int len = snprintf(
+    json,
+    sizeof(json),
+    "{\"comparisons\":%llu,\"code_points\":%llu,\"nanoseconds\":%llu}",
+    (unsigned long long) measurement->comparison_count(),
+    (unsigned long long) measurement->code_point_count(),
+    (unsigned long long) measurement->elapsed_nanoseconds()
+  );
+  sqlite3_result_text(context, json, len, SQLITE_TRANSIENT);
+}
+
+void condict_destroy_measurement(void* measurement) {
+  delete reinterpret_cast<Measurement*>(measurement);
+}
+
 extern "C" CONDICT_EXPORT int sqlite3_extension_init(
   sqlite3* db,
   char** pzErrMsg,
@@ -31,14 +1502,304 @@ extern "C" CONDICT_EXPORT int sqlite3_extension_init(
 ) {
   SQLITE_EXTENSION_INIT2(pApi);
 
-  int result = sqlite3_create_collation_v2(
+  int result = condict_create_collation(
     db,
     "unicode",
+    nullptr,
+    condict_collate_unicode<Encoding::UTF8>,
+    condict_collate_unicode<Encoding::UTF16LE>,
+    condict_collate_unicode<Encoding::UTF16BE>,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_create_collation(
+    db,
+    "unicode_tb",
+    nullptr,
+    condict_collate_unicode_tb<Encoding::UTF8>,
+    condict_collate_unicode_tb<Encoding::UTF16LE>,
+    condict_collate_unicode_tb<Encoding::UTF16BE>,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_create_collation(
+    db,
+    "unicode_trusted_nfd",
+    nullptr,
+    condict_collate_unicode_trusted_nfd<Encoding::UTF8>,
+    condict_collate_unicode_trusted_nfd<Encoding::UTF16LE>,
+    condict_collate_unicode_trusted_nfd<Encoding::UTF16BE>,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_create_collation(
+    db,
+    "unicode_numeric",
+    nullptr,
+    condict_collate_unicode_numeric<Encoding::UTF8>,
+    condict_collate_unicode_numeric<Encoding::UTF16LE>,
+    condict_collate_unicode_numeric<Encoding::UTF16BE>,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_collation_v2(
+    db,
+    "unicode_reverse",
     SQLITE_UTF8,
     nullptr,
-    condict_collate_unicode,
+    condict_collate_unicode_reverse,
     nullptr
   );
+  if (result != SQLITE_OK) {
+    return result;
+  }
 
-  return result;
+  result = condict_register_locales(db);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_data_source",
+    0,
+    SQLITE_UTF8,
+    nullptr,
+    condict_unicode_data_source,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_data_error",
+    0,
+    SQLITE_UTF8,
+    nullptr,
+    condict_unicode_data_error,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_collation_version",
+    -1,
+    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+    nullptr,
+    condict_unicode_collation_version,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_register_sort_key(
+    db,
+    "unicode_sort_key",
+    SortKeyKind::UNICODE
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_register_sort_key(
+    db,
+    "unicode_numeric_sort_key",
+    SortKeyKind::NUMERIC
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_register_sort_key(
+    db,
+    "unicode_reverse_sort_key",
+    SortKeyKind::REVERSE
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_rebuild_sort_keys",
+    -1,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    nullptr,
+    condict_unicode_rebuild_sort_keys,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_rebuild_sort_keys_batch",
+    2,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    nullptr,
+    condict_unicode_rebuild_sort_keys_batch,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_register_normalizer(db, "unicode_nfd", false);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = condict_register_normalizer(db, "unicode_nfc", true);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  TailoredCollations* collations = new (std::nothrow) TailoredCollations();
+  if (!collations) {
+    return SQLITE_NOMEM;
+  }
+  // If registration fails, SQLite calls the destructor for us.
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_tailor",
+    2,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    collations,
+    condict_unicode_tailor,
+    nullptr,
+    nullptr,
+    condict_destroy_tailored_collations
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_tailoring_error",
+    1,
+    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+    nullptr,
+    condict_unicode_tailoring_error,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_module_v2(
+    db,
+    "unicode_collation_stats",
+    &condict_stats_module,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_collation_stats_reset",
+    0,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    nullptr,
+    condict_unicode_collation_stats_reset,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  Measurement* measurement = new (std::nothrow) Measurement();
+  if (!measurement) {
+    return SQLITE_NOMEM;
+  }
+  // The stop function owns the measurement. It's registered first, so that if
+  // registration fails (and SQLite calls the destructor for us), the start
+  // function is never registered with a dangling pointer.
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_collation_measure_stop",
+    0,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    measurement,
+    condict_unicode_collation_measure_stop,
+    nullptr,
+    nullptr,
+    condict_destroy_measurement
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_collation_measure_start",
+    0,
+    SQLITE_UTF8 | SQLITE_DIRECTONLY,
+    measurement,
+    condict_unicode_collation_measure_start,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  EditDistance* dist = new (std::nothrow) EditDistance();
+  if (!dist) {
+    return SQLITE_NOMEM;
+  }
+  // If registration fails, SQLite calls the destructor for us.
+  result = sqlite3_create_function_v2(
+    db,
+    "unicode_edit_distance",
+    -1,
+    SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+    dist,
+    condict_unicode_edit_distance,
+    nullptr,
+    nullptr,
+    condict_destroy_edit_distance
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  return condict_register_rank(db);
 }
@@ -0,0 +1,1826 @@
+#include "sqlite3_rank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+SQLITE_EXTENSION_INIT3
+
+// Rank tables
+//
+//     create virtual table lemma_ranks using unicode_rank;
+//
+// A rank table is an order-statistic index. It keeps rows sorted by
+// (group_id, key), where `group_id` is an integer and `key` a blob, and finds
+// the position of a row within its group (its rank), or the row at a given
+// rank, in O(log n) time. Keys are compared byte by byte, so they are normally
+// sort keys from unicode_sort_key(): a rank table over
+//
+//     (language_id, unicode_sort_key(term))
+//
+// answers "which lemmas are on page 1000?" without stepping over the 50,000
+// lemmas before them, as `limit 50 offset 50000` does.
+//
+// The rowid of a row is the ID of the row it indexes, and must be given when
+// inserting. The table must be updated along with the indexed table, which is
+// easiest to do with triggers:
+//
+//     create trigger lemma_ranks_insert after insert on lemmas
+//     begin
+//       insert into lemma_ranks (rowid, group_id, key)
+//       values (new.id, new.language_id, unicode_sort_key(new.term));
+//     end;
+//
+// along with matching triggers for updates and deletes.
+//
+// Columns:
+//
+// * group_id: The group of the row. Ranks are counted within a group.
+// * key: The key of the row.
+// * rank: Read-only. The 0-based position of the row within its group. Rows
+//   with the same key are ordered by rowid. Ignored when writing.
+//
+// The table can answer these queries in O(log n + number of rows):
+//
+//     -- The rows at ranks 100 to 149, in order.
+//     select rowid from t where group_id = ? and rank >= 100
+//     order by rank limit 50;
+//     -- The rank of a row.
+//     select rank from t where rowid = ?;
+//     -- The first row at or after a key.
+//     select rowid, rank from t where group_id = ? and key >= ?
+//     order by key limit 1;
+//
+// Rows with non-blob keys cannot be found by key, only by rank or rowid.
+//
+// unicode_rank_count(table, group_id[, lower[, upper]])
+//
+// Counts the rows of a rank table in the main schema, within a group, whose
+// key is at least `lower` and less than `upper`, in O(log n) time. Null bounds
+// (or omitted ones) are unbounded, so with two arguments the function counts
+// the whole group. The rank of a key that is not in the table is the count of
+// keys before it: unicode_rank_count(table, group_id, null, key).
+//
+// Storage
+//
+// The rows are kept in a B+tree whose nodes are stored as blobs in the shadow
+// table `%_node`, with the root always at ID 1. Each entry of an internal node
+// holds the number of rows under its child, so the position of a row is the
+// sum of the counts to the left of the path that leads to it. Rows are also
+// listed by rowid in `%_rowid`, so that they can be found for deletion.
+//
+// Each internal entry also holds a separator, which is at most the lowest row
+// under its child, and greater than every row under the child before it. The
+// first entry's separator is ignored: rows lower than every separator go into
+// the first child. Nodes are split when they grow past RANK_NODE_SIZE bytes,
+// and merged into a neighbour when they shrink below a quarter of that.
+
+// The ID of the root node. When the root splits, its entries move into two new
+// nodes, so that the root keeps its ID.
+constexpr sqlite3_int64 RANK_ROOT = 1;
+
+// Nodes are split once they grow past this many bytes. With the default page
+// size of 4096 bytes, a node fits in a single page.
+constexpr size_t RANK_NODE_SIZE = 3800;
+
+// A node is merged into a neighbour once it shrinks below this size, if the
+// two fit in a single node.
+constexpr size_t RANK_MIN_NODE_SIZE = RANK_NODE_SIZE / 4;
+
+// A node starts with a byte of flags and a 32-bit entry count. Each entry has
+// a 64-bit group, a 64-bit rowid, a 32-bit key length and the key. Entries of
+// internal nodes also have a 64-bit child ID and a 64-bit row count. All
+// integers are little-endian.
+constexpr uint8_t RANK_LEAF = 1;
+constexpr size_t RANK_HEADER_SIZE = 5;
+constexpr size_t RANK_ENTRY_SIZE = 20;
+constexpr size_t RANK_CHILD_SIZE = 16;
+
+// The columns of the table, as numbered by SQLite.
+constexpr int RANK_COLUMN_ROWID = -1;
+constexpr int RANK_COLUMN_GROUP = 0;
+constexpr int RANK_COLUMN_KEY = 1;
+constexpr int RANK_COLUMN_RANK = 2;
+
+// Query plans, passed from xBestIndex to xFilter as the index number. The
+// arguments follow the order of the flags, for the flags that are set.
+enum RankPlan : int {
+  RANK_PLAN_ROWID = 0x001,
+  RANK_PLAN_GROUP = 0x002,
+  RANK_PLAN_RANK_EQ = 0x004,
+  RANK_PLAN_RANK_LOWER = 0x008,
+  RANK_PLAN_RANK_UPPER = 0x010,
+  RANK_PLAN_KEY_EQ = 0x020,
+  RANK_PLAN_KEY_LOWER = 0x040,
+  RANK_PLAN_KEY_UPPER = 0x080,
+  // The lower or upper bound excludes its value (> and < rather than >= and
+  // <=).
+  RANK_PLAN_RANK_LOWER_STRICT = 0x100,
+  RANK_PLAN_RANK_UPPER_STRICT = 0x200,
+  RANK_PLAN_KEY_LOWER_STRICT = 0x400,
+  RANK_PLAN_KEY_UPPER_STRICT = 0x800,
+};
+
+struct RankEntry {
+  sqlite3_int64 group;
+  sqlite3_int64 rowid;
+  std::string key;
+  // Internal nodes only: the child node, and the number of rows under it.
+  sqlite3_int64 child;
+  sqlite3_int64 count;
+
+  inline RankEntry() : group(0), rowid(0), key(), child(0), count(0) { }
+};
+
+inline int condict_rank_compare_keys(
+  const uint8_t* a,
+  size_t a_len,
+  const uint8_t* b,
+  size_t b_len
+) {
+  size_t len = std::min(a_len, b_len);
+  int result = len > 0 ? memcmp(a, b, len) : 0;
+  if (result != 0) {
+    return result;
+  }
+  return a_len < b_len ? -1 : a_len > b_len ? 1 : 0;
+}
+
+inline const uint8_t* condict_rank_key_data(const std::string &key) {
+  return reinterpret_cast<const uint8_t*>(key.data());
+}
+
+// True if `a` comes before `b`.
+bool condict_rank_less(const RankEntry &a, const RankEntry &b) {
+  if (a.group != b.group) {
+    return a.group < b.group;
+  }
+  int keys = condict_rank_compare_keys(
+    condict_rank_key_data(a.key),
+    a.key.size(),
+    condict_rank_key_data(b.key),
+    b.key.size()
+  );
+  if (keys != 0) {
+    return keys < 0;
+  }
+  return a.rowid < b.rowid;
+}
+
+// A point in the order of a rank table, which splits the rows into those that
+// come before it and those that don't.
+struct RankBound {
+  sqlite3_int64 group;
+  const uint8_t* key;
+  size_t key_len;
+  // If true, the bound comes after every key in the group.
+  bool key_max;
+  // If true, the bound comes after the rows whose key is equal to `key`, or
+  // just after the row `rowid`; if false, before them.
+  bool after;
+  bool has_rowid;
+  sqlite3_int64 rowid;
+
+  // The bound before the first row of a group.
+  static inline RankBound group_start(sqlite3_int64 group) {
+    return RankBound(group, nullptr, 0, false, false);
+  }
+
+  // The bound after the last row of a group.
+  static inline RankBound group_end(sqlite3_int64 group) {
+    return RankBound(group, nullptr, 0, true, false);
+  }
+
+  // The bound before or after the rows with a key.
+  static inline RankBound key_bound(
+    sqlite3_int64 group,
+    const uint8_t* key,
+    size_t key_len,
+    bool after
+  ) {
+    return RankBound(group, key, key_len, false, after);
+  }
+
+  // The bound just before a row.
+  static inline RankBound row(const RankEntry &entry) {
+    RankBound bound(
+      entry.group,
+      condict_rank_key_data(entry.key),
+      entry.key.size(),
+      false,
+      false
+    );
+    bound.has_rowid = true;
+    bound.rowid = entry.rowid;
+    return bound;
+  }
+
+private:
+  inline RankBound(
+    sqlite3_int64 group,
+    const uint8_t* key,
+    size_t key_len,
+    bool key_max,
+    bool after
+  ) :
+    group(group),
+    key(key),
+    key_len(key_len),
+    key_max(key_max),
+    after(after),
+    has_rowid(false),
+    rowid(0)
+  { }
+};
+
+// True if `entry` comes before `bound`.
+bool condict_rank_before(const RankEntry &entry, const RankBound &bound) {
+  if (entry.group != bound.group) {
+    return entry.group < bound.group;
+  }
+  if (bound.key_max) {
+    return true;
+  }
+  int keys = condict_rank_compare_keys(
+    condict_rank_key_data(entry.key),
+    entry.key.size(),
+    bound.key,
+    bound.key_len
+  );
+  if (keys != 0) {
+    return keys < 0;
+  }
+  if (bound.has_rowid && entry.rowid != bound.rowid) {
+    return entry.rowid < bound.rowid;
+  }
+  return bound.after;
+}
+
+void condict_rank_put(std::string &out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.push_back((char) (uint8_t) (value >> (8 * i)));
+  }
+}
+
+uint64_t condict_rank_get(const uint8_t* data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= (uint64_t) data[i] << (8 * i);
+  }
+  return value;
+}
+
+struct RankNode {
+  sqlite3_int64 id;
+  bool leaf;
+  std::vector<RankEntry> entries;
+
+  inline RankNode() : id(0), leaf(true), entries() { }
+
+  // The size of the node when encoded.
+  size_t byte_size() const {
+    size_t size = RANK_HEADER_SIZE;
+    for (const RankEntry &entry : this->entries) {
+      size += RANK_ENTRY_SIZE + entry.key.size();
+      if (!this->leaf) {
+        size += RANK_CHILD_SIZE;
+      }
+    }
+    return size;
+  }
+
+  // The number of rows in the node's subtree.
+  sqlite3_int64 row_count() const {
+    if (this->leaf) {
+      return (sqlite3_int64) this->entries.size();
+    }
+    sqlite3_int64 count = 0;
+    for (const RankEntry &entry : this->entries) {
+      count += entry.count;
+    }
+    return count;
+  }
+
+  // Finds the child that `entry` belongs under. Internal nodes only.
+  size_t child_index(const RankEntry &entry) const {
+    auto child = std::partition_point(
+      this->entries.begin() + 1,
+      this->entries.end(),
+      [&](const RankEntry &sep) { return !condict_rank_less(entry, sep); }
+    );
+    return (size_t) (child - this->entries.begin()) - 1;
+  }
+
+  // Finds the child that contains the last row before `bound`, if there is
+  // one. Every row under the children to its left comes before the bound, and
+  // none of the rows to its right do. Internal nodes only.
+  size_t child_index(const RankBound &bound) const {
+    auto child = std::partition_point(
+      this->entries.begin() + 1,
+      this->entries.end(),
+      [&](const RankEntry &sep) { return condict_rank_before(sep, bound); }
+    );
+    return (size_t) (child - this->entries.begin()) - 1;
+  }
+
+  void encode(std::string &out) const {
+    out.clear();
+    out.reserve(this->byte_size());
+    out.push_back((char) (this->leaf ? RANK_LEAF : 0));
+    condict_rank_put(out, this->entries.size(), 4);
+    for (const RankEntry &entry : this->entries) {
+      condict_rank_put(out, (uint64_t) entry.group, 8);
+      condict_rank_put(out, (uint64_t) entry.rowid, 8);
+      condict_rank_put(out, entry.key.size(), 4);
+      out.append(entry.key);
+      if (!this->leaf) {
+        condict_rank_put(out, (uint64_t) entry.child, 8);
+        condict_rank_put(out, (uint64_t) entry.count, 8);
+      }
+    }
+  }
+
+  // Decodes a node. Returns false if the data is malformed.
+  bool decode(const uint8_t* data, size_t len) {
+    if (len < RANK_HEADER_SIZE) {
+      return false;
+    }
+    this->leaf = (data[0] & RANK_LEAF) != 0;
+    uint32_t count = (uint32_t) condict_rank_get(data + 1, 4);
+    const uint8_t* p = data + RANK_HEADER_SIZE;
+    const uint8_t* end = data + len;
+
+    size_t fixed_size = RANK_ENTRY_SIZE + (this->leaf ? 0 : RANK_CHILD_SIZE);
+    if (count > (size_t) (end - p) / fixed_size) {
+      return false;
+    }
+    this->entries.clear();
+    this->entries.resize(count);
+    for (RankEntry &entry : this->entries) {
+      if ((size_t) (end - p) < RANK_ENTRY_SIZE) {
+        return false;
+      }
+      entry.group = (sqlite3_int64) condict_rank_get(p, 8);
+      entry.rowid = (sqlite3_int64) condict_rank_get(p + 8, 8);
+      size_t key_len = (size_t) condict_rank_get(p + 16, 4);
+      p += RANK_ENTRY_SIZE;
+      if ((size_t) (end - p) < key_len) {
+        return false;
+      }
+      entry.key.assign(reinterpret_cast<const char*>(p), key_len);
+      p += key_len;
+      if (!this->leaf) {
+        if ((size_t) (end - p) < RANK_CHILD_SIZE) {
+          return false;
+        }
+        entry.child = (sqlite3_int64) condict_rank_get(p, 8);
+        entry.count = (sqlite3_int64) condict_rank_get(p + 8, 8);
+        p += RANK_CHILD_SIZE;
+      }
+    }
+    return p == end && (this->leaf || count > 0);
+  }
+
+  // Makes the entry that points to this node from its parent.
+  RankEntry parent_entry() const {
+    RankEntry entry = this->entries[0];
+    entry.child = this->id;
+    entry.count = this->row_count();
+    return entry;
+  }
+};
+
+// The B+tree of a rank table, which is read and written through the table's
+// shadow tables. Statements are prepared the first time they are needed, and
+// kept until the tree is destroyed.
+class RankTree {
+public:
+  RankTree(sqlite3* db, const char* schema, const char* name) :
+    db(db),
+    schema(schema),
+    name(name),
+    read_node(nullptr),
+    write_node(nullptr),
+    delete_node(nullptr),
+    max_node_id(nullptr),
+    read_rowid(nullptr),
+    write_rowid(nullptr),
+    delete_rowid(nullptr)
+  { }
+
+  ~RankTree() {
+    this->finalize();
+  }
+
+  RankTree(const RankTree&) = delete;
+  RankTree &operator=(const RankTree&) = delete;
+
+  // Creates the shadow tables of a new table.
+  int create() {
+    char* sql = sqlite3_mprintf(
+      "create table \"%w\".\"%w_node\"(id integer primary key, data blob);"
+      "create table \"%w\".\"%w_rowid\"("
+        "rowid integer primary key, group_id integer, key blob"
+      ");"
+      "insert into \"%w\".\"%w_node\"(id, data) "
+        "values (%lld, x'%02x00000000');",
+      this->schema.c_str(), this->name.c_str(),
+      this->schema.c_str(), this->name.c_str(),
+      this->schema.c_str(), this->name.c_str(),
+      RANK_ROOT,
+      RANK_LEAF
+    );
+    return this->exec(sql);
+  }
+
+  // Drops the shadow tables.
+  int drop() {
+    this->finalize();
+    char* sql = sqlite3_mprintf(
+      "drop table \"%w\".\"%w_node\";"
+      "drop table \"%w\".\"%w_rowid\";",
+      this->schema.c_str(), this->name.c_str(),
+      this->schema.c_str(), this->name.c_str()
+    );
+    return this->exec(sql);
+  }
+
+  // Renames the shadow tables to match a new table name.
+  int rename(const char* new_name) {
+    this->finalize();
+    char* sql = sqlite3_mprintf(
+      "alter table \"%w\".\"%w_node\" rename to \"%w_node\";"
+      "alter table \"%w\".\"%w_rowid\" rename to \"%w_rowid\";",
+      this->schema.c_str(), this->name.c_str(), new_name,
+      this->schema.c_str(), this->name.c_str(), new_name
+    );
+    int result = this->exec(sql);
+    if (result == SQLITE_OK) {
+      this->name = new_name;
+    }
+    return result;
+  }
+
+  int load(sqlite3_int64 id, RankNode &node) {
+    int result = this->prepare(
+      this->read_node,
+      "select data from \"%w\".\"%w_node\" where id = ?"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    sqlite3_stmt* stmt = this->read_node;
+    sqlite3_bind_int64(stmt, 1, id);
+    result = sqlite3_step(stmt);
+    if (result == SQLITE_ROW) {
+      const uint8_t* data =
+        reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, 0));
+      size_t len = (size_t) sqlite3_column_bytes(stmt, 0);
+      node.id = id;
+      result = node.decode(data, len) ? SQLITE_OK : SQLITE_CORRUPT_VTAB;
+    } else if (result == SQLITE_DONE) {
+      // A node that is referenced by its parent must exist.
+      result = SQLITE_CORRUPT_VTAB;
+    }
+    sqlite3_reset(stmt);
+    return result;
+  }
+
+  // Counts the rows that come before a bound.
+  int count_before(const RankBound &bound, sqlite3_int64 &count) {
+    RankNode node;
+    int result = this->load(RANK_ROOT, node);
+    count = 0;
+    while (result == SQLITE_OK && !node.leaf) {
+      size_t index = node.child_index(bound);
+      for (size_t i = 0; i < index; i++) {
+        count += node.entries[i].count;
+      }
+      result = this->load(node.entries[index].child, node);
+    }
+    if (result == SQLITE_OK) {
+      auto end = std::partition_point(
+        node.entries.begin(),
+        node.entries.end(),
+        [&](const RankEntry &entry) {
+          return condict_rank_before(entry, bound);
+        }
+      );
+      count += (sqlite3_int64) (end - node.entries.begin());
+    }
+    return result;
+  }
+
+  // Counts all the rows.
+  int count_all(sqlite3_int64 &count) {
+    RankNode root;
+    int result = this->load(RANK_ROOT, root);
+    count = result == SQLITE_OK ? root.row_count() : 0;
+    return result;
+  }
+
+  // Finds the group and key of a row, by its rowid.
+  int find(sqlite3_int64 rowid, RankEntry &entry, bool &found) {
+    int result = this->prepare(
+      this->read_rowid,
+      "select group_id, key from \"%w\".\"%w_rowid\" where rowid = ?"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    sqlite3_stmt* stmt = this->read_rowid;
+    sqlite3_bind_int64(stmt, 1, rowid);
+    result = sqlite3_step(stmt);
+    found = result == SQLITE_ROW;
+    if (found) {
+      entry.group = sqlite3_column_int64(stmt, 0);
+      entry.rowid = rowid;
+      const char* key =
+        reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 1));
+      entry.key.assign(key ? key : "", sqlite3_column_bytes(stmt, 1));
+      result = SQLITE_OK;
+    } else if (result == SQLITE_DONE) {
+      result = SQLITE_OK;
+    }
+    sqlite3_reset(stmt);
+    return result;
+  }
+
+  // Adds a row. Fails with SQLITE_CONSTRAINT if the rowid is taken.
+  int insert(const RankEntry &entry) {
+    int result = this->prepare(
+      this->write_rowid,
+      "insert into \"%w\".\"%w_rowid\"(rowid, group_id, key) values (?, ?, ?)"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    sqlite3_stmt* stmt = this->write_rowid;
+    sqlite3_bind_int64(stmt, 1, entry.rowid);
+    sqlite3_bind_int64(stmt, 2, entry.group);
+    sqlite3_bind_blob64(
+      stmt,
+      3,
+      entry.key.data(),
+      entry.key.size(),
+      SQLITE_STATIC
+    );
+    result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (result != SQLITE_DONE) {
+      return result;
+    }
+
+    RankNode root;
+    result = this->load(RANK_ROOT, root);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    bool split = false;
+    RankEntry right;
+    return this->insert_into(root, entry, split, right);
+  }
+
+  // Removes a row by its rowid, if it exists.
+  int remove(sqlite3_int64 rowid) {
+    RankEntry entry;
+    bool found = false;
+    int result = this->find(rowid, entry, found);
+    if (result != SQLITE_OK || !found) {
+      return result;
+    }
+
+    result = this->prepare(
+      this->delete_rowid,
+      "delete from \"%w\".\"%w_rowid\" where rowid = ?"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    sqlite3_bind_int64(this->delete_rowid, 1, rowid);
+    result = sqlite3_step(this->delete_rowid);
+    sqlite3_reset(this->delete_rowid);
+    if (result != SQLITE_DONE) {
+      return result;
+    }
+
+    RankNode root;
+    result = this->load(RANK_ROOT, root);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    bool removed = false;
+    result = this->remove_from(root, entry, removed);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    if (!removed) {
+      // The row is listed by rowid, but not in the tree.
+      return SQLITE_CORRUPT_VTAB;
+    }
+
+    // If the root is left with a single child, the child takes its place.
+    while (!root.leaf && root.entries.size() == 1) {
+      RankNode child;
+      result = this->load(root.entries[0].child, child);
+      if (result == SQLITE_OK) {
+        result = this->drop_node(child.id);
+      }
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      root.leaf = child.leaf;
+      root.entries = std::move(child.entries);
+      result = this->save(root);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+    }
+    return SQLITE_OK;
+  }
+
+private:
+  sqlite3* db;
+  std::string schema;
+  std::string name;
+  sqlite3_stmt* read_node;
+  sqlite3_stmt* write_node;
+  sqlite3_stmt* delete_node;
+  sqlite3_stmt* max_node_id;
+  sqlite3_stmt* read_rowid;
+  sqlite3_stmt* write_rowid;
+  sqlite3_stmt* delete_rowid;
+  // The encoded node that is being saved.
+  std::string buffer;
+
+  // Prepares a statement, unless it has been prepared already. The format
+  // receives the schema and table name, in that order.
+  int prepare(sqlite3_stmt* &stmt, const char* format) {
+    if (stmt) {
+      return SQLITE_OK;
+    }
+    char* sql = sqlite3_mprintf(
+      format,
+      this->schema.c_str(),
+      this->name.c_str()
+    );
+    if (!sql) {
+      return SQLITE_NOMEM;
+    }
+    int result = sqlite3_prepare_v2(this->db, sql, -1, &stmt, nullptr);
+    sqlite3_free(sql);
+    return result;
+  }
+
+  // Runs and frees SQL from sqlite3_mprintf().
+  int exec(char* sql) {
+    if (!sql) {
+      return SQLITE_NOMEM;
+    }
+    int result = sqlite3_exec(this->db, sql, nullptr, nullptr, nullptr);
+    sqlite3_free(sql);
+    return result;
+  }
+
+  void finalize() {
+    sqlite3_stmt** statements[] = {
+      &this->read_node,
+      &this->write_node,
+      &this->delete_node,
+      &this->max_node_id,
+      &this->read_rowid,
+      &this->write_rowid,
+      &this->delete_rowid,
+    };
+    for (sqlite3_stmt** stmt : statements) {
+      sqlite3_finalize(*stmt);
+      *stmt = nullptr;
+    }
+  }
+
+  int save(const RankNode &node) {
+    int result = this->prepare(
+      this->write_node,
+      "insert or replace into \"%w\".\"%w_node\"(id, data) values (?, ?)"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    node.encode(this->buffer);
+    sqlite3_stmt* stmt = this->write_node;
+    sqlite3_bind_int64(stmt, 1, node.id);
+    sqlite3_bind_blob64(
+      stmt,
+      2,
+      this->buffer.data(),
+      this->buffer.size(),
+      SQLITE_STATIC
+    );
+    result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return result == SQLITE_DONE ? SQLITE_OK : result;
+  }
+
+  // Gives a new node an ID, and saves it.
+  int add(RankNode &node) {
+    int result = this->prepare(
+      this->max_node_id,
+      "select max(id) from \"%w\".\"%w_node\""
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    result = sqlite3_step(this->max_node_id);
+    if (result == SQLITE_ROW) {
+      node.id = sqlite3_column_int64(this->max_node_id, 0) + 1;
+      result = SQLITE_OK;
+    }
+    sqlite3_reset(this->max_node_id);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    return this->save(node);
+  }
+
+  int drop_node(sqlite3_int64 id) {
+    int result = this->prepare(
+      this->delete_node,
+      "delete from \"%w\".\"%w_node\" where id = ?"
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    sqlite3_bind_int64(this->delete_node, 1, id);
+    result = sqlite3_step(this->delete_node);
+    sqlite3_reset(this->delete_node);
+    return result == SQLITE_DONE ? SQLITE_OK : result;
+  }
+
+  // Inserts an entry into the subtree of `node`, and saves the node. If the
+  // node had to be split, `split` is set and `right` receives the parent
+  // entry of the new right half.
+  int insert_into(
+    RankNode &node,
+    const RankEntry &entry,
+    bool &split,
+    RankEntry &right
+  ) {
+    if (node.leaf) {
+      auto pos = std::upper_bound(
+        node.entries.begin(),
+        node.entries.end(),
+        entry,
+        condict_rank_less
+      );
+      RankEntry &inserted = *node.entries.insert(pos, entry);
+      inserted.child = 0;
+      inserted.count = 0;
+    } else {
+      size_t index = node.child_index(entry);
+      RankNode child;
+      int result = this->load(node.entries[index].child, child);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      bool child_split = false;
+      RankEntry child_right;
+      result = this->insert_into(child, entry, child_split, child_right);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      node.entries[index].count++;
+      if (child_split) {
+        node.entries[index].count -= child_right.count;
+        node.entries.insert(
+          node.entries.begin() + index + 1,
+          std::move(child_right)
+        );
+      }
+    }
+
+    split = false;
+    size_t size = node.byte_size();
+    if (size <= RANK_NODE_SIZE || node.entries.size() < 2) {
+      return this->save(node);
+    }
+
+    // Split the node in half by size, leaving at least one entry on each
+    // side.
+    size_t half = (size - RANK_HEADER_SIZE) / 2;
+    size_t left_size = 0;
+    size_t mid = 0;
+    while (mid < node.entries.size() - 1 && left_size < half) {
+      left_size += RANK_ENTRY_SIZE + node.entries[mid].key.size();
+      if (!node.leaf) {
+        left_size += RANK_CHILD_SIZE;
+      }
+      mid++;
+    }
+    mid = std::max(mid, (size_t) 1);
+
+    RankNode right_node;
+    right_node.leaf = node.leaf;
+    right_node.entries.assign(
+      std::make_move_iterator(node.entries.begin() + mid),
+      std::make_move_iterator(node.entries.end())
+    );
+    node.entries.erase(node.entries.begin() + mid, node.entries.end());
+
+    int result;
+    if (node.id == RANK_ROOT) {
+      // The root keeps its ID: both halves move into new nodes.
+      RankNode left_node;
+      left_node.leaf = node.leaf;
+      left_node.entries = std::move(node.entries);
+      result = this->add(left_node);
+      if (result == SQLITE_OK) {
+        result = this->add(right_node);
+      }
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      node.leaf = false;
+      node.entries.clear();
+      node.entries.push_back(left_node.parent_entry());
+      node.entries.push_back(right_node.parent_entry());
+      return this->save(node);
+    }
+
+    result = this->add(right_node);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    split = true;
+    right = right_node.parent_entry();
+    return this->save(node);
+  }
+
+  // Removes an entry from the subtree of `node`, and saves the node. Sets
+  // `removed` if the entry was found.
+  int remove_from(RankNode &node, const RankEntry &entry, bool &removed) {
+    if (node.leaf) {
+      auto pos = std::lower_bound(
+        node.entries.begin(),
+        node.entries.end(),
+        entry,
+        condict_rank_less
+      );
+      removed =
+        pos != node.entries.end() && !condict_rank_less(entry, *pos);
+      if (!removed) {
+        return SQLITE_OK;
+      }
+      node.entries.erase(pos);
+      return this->save(node);
+    }
+
+    size_t index = node.child_index(entry);
+    RankNode child;
+    int result = this->load(node.entries[index].child, child);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    result = this->remove_from(child, entry, removed);
+    if (result != SQLITE_OK || !removed) {
+      return result;
+    }
+
+    node.entries[index].count--;
+    if (child.entries.empty()) {
+      result = this->drop_node(child.id);
+      node.entries.erase(node.entries.begin() + index);
+    } else if (
+      child.byte_size() < RANK_MIN_NODE_SIZE &&
+      node.entries.size() > 1
+    ) {
+      result = this->merge(node, index, child);
+    }
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    return this->save(node);
+  }
+
+  // Merges a small child with its left neighbour, or if it has none, with
+  // its right neighbour, if they fit in a single node.
+  int merge(RankNode &node, size_t index, RankNode &child) {
+    size_t left_index = index > 0 ? index - 1 : index;
+    size_t right_index = left_index + 1;
+
+    RankNode sibling;
+    int result = this->load(
+      node.entries[index > 0 ? left_index : right_index].child,
+      sibling
+    );
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    RankNode &left = index > 0 ? sibling : child;
+    RankNode &right = index > 0 ? child : sibling;
+    size_t size = left.byte_size() + right.byte_size() - RANK_HEADER_SIZE;
+    if (size > RANK_NODE_SIZE) {
+      return SQLITE_OK;
+    }
+
+    if (!right.leaf) {
+      // The separator of the right node's first entry was ignored; the one
+      // from its parent entry is valid.
+      const RankEntry &sep = node.entries[right_index];
+      right.entries[0].group = sep.group;
+      right.entries[0].rowid = sep.rowid;
+      right.entries[0].key = sep.key;
+    }
+    left.entries.insert(
+      left.entries.end(),
+      std::make_move_iterator(right.entries.begin()),
+      std::make_move_iterator(right.entries.end())
+    );
+    node.entries[left_index].count += node.entries[right_index].count;
+    node.entries.erase(node.entries.begin() + right_index);
+
+    result = this->drop_node(right.id);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    return this->save(left);
+  }
+};
+
+struct RankTable : sqlite3_vtab {
+  RankTree tree;
+
+  RankTable(sqlite3* db, const char* schema, const char* name) :
+    sqlite3_vtab(),
+    tree(db, schema, name)
+  { }
+
+  void set_error(const char* message) {
+    sqlite3_free(this->zErrMsg);
+    this->zErrMsg = sqlite3_mprintf("%s", message);
+  }
+};
+
+struct RankCursor : sqlite3_vtab_cursor {
+  // The nodes from the root to the leaf of the current row, and the index of
+  // the entry in each that leads to the row.
+  std::vector<RankNode> path;
+  std::vector<size_t> indexes;
+  // The position of the current row in the whole table, and the position at
+  // which to stop.
+  sqlite3_int64 position;
+  sqlite3_int64 end;
+  // The group of the last row whose rank was read, and the position of the
+  // first row in that group.
+  bool has_group;
+  sqlite3_int64 group;
+  sqlite3_int64 group_start;
+
+  RankCursor() :
+    sqlite3_vtab_cursor(),
+    path(),
+    indexes(),
+    position(0),
+    end(0),
+    has_group(false),
+    group(0),
+    group_start(0)
+  { }
+
+  inline RankTree &tree() {
+    return static_cast<RankTable*>(this->pVtab)->tree;
+  }
+
+  inline const RankEntry &row() const {
+    return this->path.back().entries[this->indexes.back()];
+  }
+
+  // Moves to the row at the specified position, which must exist.
+  int seek(sqlite3_int64 position) {
+    this->path.clear();
+    this->indexes.clear();
+    this->position = position;
+
+    RankNode node;
+    int result = this->tree().load(RANK_ROOT, node);
+    while (result == SQLITE_OK && !node.leaf) {
+      size_t index = 0;
+      while (
+        index < node.entries.size() - 1 &&
+        position >= node.entries[index].count
+      ) {
+        position -= node.entries[index].count;
+        index++;
+      }
+      sqlite3_int64 child = node.entries[index].child;
+      this->path.push_back(std::move(node));
+      this->indexes.push_back(index);
+      result = this->tree().load(child, node);
+    }
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    if (position >= (sqlite3_int64) node.entries.size()) {
+      return SQLITE_CORRUPT_VTAB;
+    }
+    this->path.push_back(std::move(node));
+    this->indexes.push_back((size_t) position);
+    return SQLITE_OK;
+  }
+
+  // Moves to the next row.
+  int next() {
+    this->position++;
+    if (this->position >= this->end) {
+      return SQLITE_OK;
+    }
+
+    // Climb until there is an entry to the right, then descend along the
+    // leftmost entries.
+    while (!this->path.empty()) {
+      size_t &index = this->indexes.back();
+      index++;
+      if (index < this->path.back().entries.size()) {
+        break;
+      }
+      this->path.pop_back();
+      this->indexes.pop_back();
+    }
+    if (this->path.empty()) {
+      return SQLITE_CORRUPT_VTAB;
+    }
+    while (!this->path.back().leaf) {
+      const RankNode &parent = this->path.back();
+      RankNode node;
+      int result = this->tree().load(
+        parent.entries[this->indexes.back()].child,
+        node
+      );
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      this->path.push_back(std::move(node));
+      this->indexes.push_back(0);
+    }
+    return SQLITE_OK;
+  }
+
+  // Gets the rank of the current row within its group.
+  int rank(sqlite3_int64 &rank) {
+    const RankEntry &row = this->row();
+    if (!this->has_group || this->group != row.group) {
+      int result = this->tree().count_before(
+        RankBound::group_start(row.group),
+        this->group_start
+      );
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      this->has_group = true;
+      this->group = row.group;
+    }
+    rank = this->position - this->group_start;
+    return SQLITE_OK;
+  }
+};
+
+// Gets an integer from a value, converting it as SQLite would for an integer
+// column. Returns false if the value is not an integer.
+bool condict_rank_integer(sqlite3_value* value, sqlite3_int64 &result) {
+  if (sqlite3_value_numeric_type(value) != SQLITE_INTEGER) {
+    return false;
+  }
+  result = sqlite3_value_int64(value);
+  return true;
+}
+
+// Gets a rank bound from a value, as the first rank that is included (if
+// `upper` is false) or excluded (if `upper` is true) by the constraint.
+// Returns false if the value is not a number.
+bool condict_rank_bound(
+  sqlite3_value* value,
+  bool upper,
+  bool strict,
+  sqlite3_int64 &result
+) {
+  switch (sqlite3_value_numeric_type(value)) {
+    case SQLITE_INTEGER:
+      result = sqlite3_value_int64(value);
+      // rank > n and rank <= n both start or stop at n + 1.
+      if (upper != strict && result < INT64_MAX) {
+        result++;
+      }
+      return true;
+    case SQLITE_FLOAT: {
+      double d = sqlite3_value_double(value);
+      d = upper != strict ? std::floor(d) + 1 : std::ceil(d);
+      // No table has this many rows; clamp to keep the conversion defined.
+      d = std::max(-1.0, std::min(d, 4e18));
+      result = (sqlite3_int64) d;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+int condict_rank_init(
+  sqlite3* db,
+  int argc,
+  const char* const* argv,
+  sqlite3_vtab** vtab,
+  char** err,
+  bool create
+) {
+  if (argc > 3) {
+    *err = sqlite3_mprintf("unicode_rank takes no arguments");
+    return SQLITE_ERROR;
+  }
+
+  int result = sqlite3_declare_vtab(
+    db,
+    "create table x(group_id integer, key blob, rank integer)"
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  RankTable* table = new (std::nothrow) RankTable(db, argv[1], argv[2]);
+  if (!table) {
+    return SQLITE_NOMEM;
+  }
+  if (create) {
+    result = table->tree.create();
+    if (result != SQLITE_OK) {
+      *err = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+      delete table;
+      return result;
+    }
+  }
+  // The table only writes to its own shadow tables, so it is safe to use in
+  // triggers and views.
+  sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+  *vtab = table;
+  return SQLITE_OK;
+}
+
+int condict_rank_create(
+  sqlite3* db,
+  void* _aux,
+  int argc,
+  const char* const* argv,
+  sqlite3_vtab** vtab,
+  char** err
+) {
+  return condict_rank_init(db, argc, argv, vtab, err, true);
+}
+
+int condict_rank_connect(
+  sqlite3* db,
+  void* _aux,
+  int argc,
+  const char* const* argv,
+  sqlite3_vtab** vtab,
+  char** err
+) {
+  return condict_rank_init(db, argc, argv, vtab, err, false);
+}
+
+int condict_rank_disconnect(sqlite3_vtab* vtab) {
+  delete static_cast<RankTable*>(vtab);
+  return SQLITE_OK;
+}
+
+int condict_rank_destroy(sqlite3_vtab* vtab) {
+  RankTable* table = static_cast<RankTable*>(vtab);
+  int result = table->tree.drop();
+  if (result == SQLITE_OK) {
+    delete table;
+  }
+  return result;
+}
+
+int condict_rank_best_index(sqlite3_vtab* _vtab, sqlite3_index_info* info) {
+  // The constraint used for each part of the plan, or -1.
+  int rowid = -1;
+  int group = -1;
+  int rank_eq = -1;
+  int rank_lower = -1;
+  int rank_upper = -1;
+  int key_eq = -1;
+  int key_lower = -1;
+  int key_upper = -1;
+  int plan = 0;
+
+  for (int i = 0; i < info->nConstraint; i++) {
+    const auto &c = info->aConstraint[i];
+    if (!c.usable) {
+      continue;
+    }
+    switch (c.iColumn) {
+      case RANK_COLUMN_ROWID:
+        if (c.op == SQLITE_INDEX_CONSTRAINT_EQ && rowid < 0) {
+          rowid = i;
+        }
+        break;
+      case RANK_COLUMN_GROUP:
+        if (c.op == SQLITE_INDEX_CONSTRAINT_EQ && group < 0) {
+          group = i;
+        }
+        break;
+      case RANK_COLUMN_RANK:
+      case RANK_COLUMN_KEY: {
+        bool is_rank = c.iColumn == RANK_COLUMN_RANK;
+        int &eq = is_rank ? rank_eq : key_eq;
+        int &lower = is_rank ? rank_lower : key_lower;
+        int &upper = is_rank ? rank_upper : key_upper;
+        int lower_strict = is_rank
+          ? RANK_PLAN_RANK_LOWER_STRICT
+          : RANK_PLAN_KEY_LOWER_STRICT;
+        int upper_strict = is_rank
+          ? RANK_PLAN_RANK_UPPER_STRICT
+          : RANK_PLAN_KEY_UPPER_STRICT;
+        switch (c.op) {
+          case SQLITE_INDEX_CONSTRAINT_EQ:
+            if (eq < 0) {
+              eq = i;
+            }
+            break;
+          case SQLITE_INDEX_CONSTRAINT_GT:
+          case SQLITE_INDEX_CONSTRAINT_GE:
+            if (lower < 0) {
+              lower = i;
+              if (c.op == SQLITE_INDEX_CONSTRAINT_GT) {
+                plan |= lower_strict;
+              }
+            }
+            break;
+          case SQLITE_INDEX_CONSTRAINT_LT:
+          case SQLITE_INDEX_CONSTRAINT_LE:
+            if (upper < 0) {
+              upper = i;
+              if (c.op == SQLITE_INDEX_CONSTRAINT_LT) {
+                plan |= upper_strict;
+              }
+            }
+            break;
+        }
+        break;
+      }
+    }
+  }
+
+  // The constraints are only used to narrow down the rows, and SQLite checks
+  // them again: values of the wrong type have to be compared as SQLite would.
+  int arg = 0;
+  auto use = [&](int constraint, int flag) {
+    if (constraint >= 0) {
+      info->aConstraintUsage[constraint].argvIndex = ++arg;
+      plan |= flag;
+    }
+  };
+
+  if (rowid >= 0) {
+    plan = 0;
+    use(rowid, RANK_PLAN_ROWID);
+    info->idxNum = plan;
+    info->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+    info->estimatedCost = 10;
+    info->estimatedRows = 1;
+    info->orderByConsumed = 1;
+    return SQLITE_OK;
+  }
+
+  if (group < 0) {
+    info->idxNum = 0;
+    info->estimatedCost = 1e6;
+    info->estimatedRows = 1000000;
+  } else {
+    use(group, RANK_PLAN_GROUP);
+    use(rank_eq, RANK_PLAN_RANK_EQ);
+    use(rank_lower, RANK_PLAN_RANK_LOWER);
+    use(rank_upper, RANK_PLAN_RANK_UPPER);
+    use(key_eq, RANK_PLAN_KEY_EQ);
+    use(key_lower, RANK_PLAN_KEY_LOWER);
+    use(key_upper, RANK_PLAN_KEY_UPPER);
+    if (rank_eq >= 0 || key_eq >= 0) {
+      info->estimatedCost = 20;
+      info->estimatedRows = 1;
+    } else if (
+      rank_lower >= 0 || rank_upper >= 0 ||
+      key_lower >= 0 || key_upper >= 0
+    ) {
+      info->estimatedCost = 100;
+      info->estimatedRows = 100;
+    } else {
+      info->estimatedCost = 1000;
+      info->estimatedRows = 1000;
+    }
+    if (rowid < 0) {
+      // Clear the strict flags of bounds that ended up unused.
+      if (rank_lower < 0) plan &= ~RANK_PLAN_RANK_LOWER_STRICT;
+      if (rank_upper < 0) plan &= ~RANK_PLAN_RANK_UPPER_STRICT;
+      if (key_lower < 0) plan &= ~RANK_PLAN_KEY_LOWER_STRICT;
+      if (key_upper < 0) plan &= ~RANK_PLAN_KEY_UPPER_STRICT;
+    }
+    info->idxNum = plan;
+  }
+
+  // Rows come out in the order of (group_id, key, rowid), which is also the
+  // order of rank within a group.
+  bool ordered = info->nOrderBy > 0;
+  for (int i = 0; i < info->nOrderBy && ordered; i++) {
+    const auto &term = info->aOrderBy[i];
+    if (term.desc) {
+      ordered = false;
+    } else if (term.iColumn == RANK_COLUMN_GROUP) {
+      ordered = group >= 0 || i == 0;
+    } else if (
+      term.iColumn == RANK_COLUMN_KEY ||
+      term.iColumn == RANK_COLUMN_RANK
+    ) {
+      ordered = group >= 0 || i > 0;
+    } else {
+      ordered = false;
+    }
+  }
+  info->orderByConsumed = ordered;
+  return SQLITE_OK;
+}
+
+int condict_rank_open(sqlite3_vtab* _vtab, sqlite3_vtab_cursor** cursor) {
+  RankCursor* c = new (std::nothrow) RankCursor();
+  if (!c) {
+    return SQLITE_NOMEM;
+  }
+  *cursor = c;
+  return SQLITE_OK;
+}
+
+int condict_rank_close(sqlite3_vtab_cursor* cursor) {
+  delete static_cast<RankCursor*>(cursor);
+  return SQLITE_OK;
+}
+
+// Narrows [lower, upper) down to the rows within a group that match the
+// rank and key constraints of a plan.
+int condict_rank_narrow(
+  RankTree &tree,
+  int plan,
+  sqlite3_int64 group,
+  sqlite3_value** args,
+  sqlite3_int64 group_start,
+  sqlite3_int64 &lower,
+  sqlite3_int64 &upper
+) {
+  // The group argument comes first.
+  int arg = 1;
+  int result = SQLITE_OK;
+
+  auto rank_bound = [&](sqlite3_value* value, bool is_upper, bool strict) {
+    sqlite3_int64 rank;
+    if (!condict_rank_bound(value, is_upper, strict, rank)) {
+      return;
+    }
+    rank = std::max(rank, (sqlite3_int64) 0);
+    if (rank > upper - group_start) {
+      rank = upper - group_start;
+    }
+    if (is_upper) {
+      upper = std::min(upper, group_start + rank);
+    } else {
+      lower = std::max(lower, group_start + rank);
+    }
+  };
+
+  auto key_bound = [&](sqlite3_value* value, bool is_upper, bool after) {
+    // Blobs sort after every other type, and keys are always blobs.
+    if (result != SQLITE_OK || sqlite3_value_type(value) != SQLITE_BLOB) {
+      return;
+    }
+    sqlite3_int64 position;
+    result = tree.count_before(
+      RankBound::key_bound(
+        group,
+        reinterpret_cast<const uint8_t*>(sqlite3_value_blob(value)),
+        (size_t) sqlite3_value_bytes(value),
+        after
+      ),
+      position
+    );
+    if (is_upper) {
+      upper = std::min(upper, position);
+    } else {
+      lower = std::max(lower, position);
+    }
+  };
+
+  if (plan & RANK_PLAN_RANK_EQ) {
+    sqlite3_value* value = args[arg++];
+    rank_bound(value, false, false);
+    rank_bound(value, true, false);
+  }
+  if (plan & RANK_PLAN_RANK_LOWER) {
+    rank_bound(args[arg++], false, plan & RANK_PLAN_RANK_LOWER_STRICT);
+  }
+  if (plan & RANK_PLAN_RANK_UPPER) {
+    rank_bound(args[arg++], true, plan & RANK_PLAN_RANK_UPPER_STRICT);
+  }
+  if (plan & RANK_PLAN_KEY_EQ) {
+    sqlite3_value* value = args[arg++];
+    key_bound(value, false, false);
+    key_bound(value, true, true);
+  }
+  if (plan & RANK_PLAN_KEY_LOWER) {
+    key_bound(args[arg++], false, plan & RANK_PLAN_KEY_LOWER_STRICT);
+  }
+  if (plan & RANK_PLAN_KEY_UPPER) {
+    key_bound(args[arg++], true, !(plan & RANK_PLAN_KEY_UPPER_STRICT));
+  }
+  return result;
+}
+
+int condict_rank_filter(
+  sqlite3_vtab_cursor* cursor,
+  int plan,
+  const char* _idx_str,
+  int _argc,
+  sqlite3_value** args
+) {
+  RankCursor* c = static_cast<RankCursor*>(cursor);
+  RankTree &tree = c->tree();
+  c->path.clear();
+  c->indexes.clear();
+  c->has_group = false;
+  c->position = 0;
+  c->end = 0;
+
+  sqlite3_int64 lower = 0;
+  sqlite3_int64 upper = 0;
+  int result = SQLITE_OK;
+  if (plan & RANK_PLAN_ROWID) {
+    sqlite3_int64 rowid;
+    if (!condict_rank_integer(args[0], rowid)) {
+      return SQLITE_OK;
+    }
+    RankEntry entry;
+    bool found = false;
+    result = tree.find(rowid, entry, found);
+    if (result != SQLITE_OK || !found) {
+      return result;
+    }
+    result = tree.count_before(RankBound::row(entry), lower);
+    upper = lower + 1;
+  } else if (plan & RANK_PLAN_GROUP) {
+    sqlite3_int64 group;
+    if (!condict_rank_integer(args[0], group)) {
+      // No row has a group that is not an integer.
+      return SQLITE_OK;
+    }
+    result = tree.count_before(RankBound::group_start(group), lower);
+    if (result == SQLITE_OK) {
+      result = tree.count_before(RankBound::group_end(group), upper);
+    }
+    if (result == SQLITE_OK) {
+      c->has_group = true;
+      c->group = group;
+      c->group_start = lower;
+      result = condict_rank_narrow(
+        tree,
+        plan,
+        group,
+        args,
+        c->group_start,
+        lower,
+        upper
+      );
+    }
+  } else {
+    result = tree.count_all(upper);
+  }
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  c->position = lower;
+  c->end = upper;
+  if (lower < upper) {
+    result = c->seek(lower);
+  }
+  return result;
+}
+
+int condict_rank_next(sqlite3_vtab_cursor* cursor) {
+  return static_cast<RankCursor*>(cursor)->next();
+}
+
+int condict_rank_eof(sqlite3_vtab_cursor* cursor) {
+  const RankCursor* c = static_cast<RankCursor*>(cursor);
+  return c->position >= c->end;
+}
+
+int condict_rank_column(
+  sqlite3_vtab_cursor* cursor,
+  sqlite3_context* context,
+  int column
+) {
+  RankCursor* c = static_cast<RankCursor*>(cursor);
+  const RankEntry &row = c->row();
+  switch (column) {
+    case RANK_COLUMN_GROUP:
+      sqlite3_result_int64(context, row.group);
+      break;
+    case RANK_COLUMN_KEY:
+      sqlite3_result_blob64(
+        context,
+        row.key.data(),
+        row.key.size(),
+        SQLITE_TRANSIENT
+      );
+      break;
+    case RANK_COLUMN_RANK: {
+      sqlite3_int64 rank;
+      int result = c->rank(rank);
+      if (result != SQLITE_OK) {
+        return result;
+      }
+      sqlite3_result_int64(context, rank);
+      break;
+    }
+  }
+  return SQLITE_OK;
+}
+
+int condict_rank_rowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+  *rowid = static_cast<RankCursor*>(cursor)->row().rowid;
+  return SQLITE_OK;
+}
+
+// Reads the row to insert from the arguments of xUpdate. Returns false, with
+// an error message on the table, if a value is invalid.
+bool condict_rank_read_row(
+  RankTable* table,
+  sqlite3_value** argv,
+  RankEntry &entry
+) {
+  if (!condict_rank_integer(argv[1], entry.rowid)) {
+    table->set_error("unicode_rank: the rowid must be an integer");
+    return false;
+  }
+  if (!condict_rank_integer(argv[2], entry.group)) {
+    table->set_error("unicode_rank: group_id must be an integer");
+    return false;
+  }
+  sqlite3_value* key = argv[3];
+  int type = sqlite3_value_type(key);
+  if (type != SQLITE_BLOB && type != SQLITE_TEXT) {
+    table->set_error("unicode_rank: key must be a blob or text");
+    return false;
+  }
+  const char* data = reinterpret_cast<const char*>(sqlite3_value_blob(key));
+  entry.key.assign(data ? data : "", (size_t) sqlite3_value_bytes(key));
+  return true;
+}
+
+int condict_rank_update(
+  sqlite3_vtab* vtab,
+  int argc,
+  sqlite3_value** argv,
+  sqlite3_int64* rowid
+) {
+  RankTable* table = static_cast<RankTable*>(vtab);
+  RankTree &tree = table->tree;
+
+  if (argc == 1) {
+    return tree.remove(sqlite3_value_int64(argv[0]));
+  }
+
+  RankEntry entry;
+  if (!condict_rank_read_row(table, argv, entry)) {
+    return SQLITE_CONSTRAINT;
+  }
+
+  int result = SQLITE_OK;
+  if (sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+    // An update: remove the old row first, unless nothing changes.
+    sqlite3_int64 old_rowid = sqlite3_value_int64(argv[0]);
+    RankEntry old_entry;
+    bool found = false;
+    result = tree.find(old_rowid, old_entry, found);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+    if (
+      found &&
+      old_rowid == entry.rowid &&
+      old_entry.group == entry.group &&
+      old_entry.key == entry.key
+    ) {
+      return SQLITE_OK;
+    }
+    result = tree.remove(old_rowid);
+    if (result != SQLITE_OK) {
+      return result;
+    }
+  }
+
+  RankEntry existing;
+  bool taken = false;
+  result = tree.find(entry.rowid, existing, taken);
+  if (result != SQLITE_OK) {
+    return result;
+  }
+  if (taken) {
+    table->set_error("unicode_rank: the rowid is already in use");
+    return SQLITE_CONSTRAINT;
+  }
+  *rowid = entry.rowid;
+  return tree.insert(entry);
+}
+
+int condict_rank_rename(sqlite3_vtab* vtab, const char* new_name) {
+  return static_cast<RankTable*>(vtab)->tree.rename(new_name);
+}
+
+int condict_rank_shadow_name(const char* name) {
+  return strcmp(name, "node") == 0 || strcmp(name, "rowid") == 0;
+}
+
+sqlite3_module condict_rank_module = {
+  3, // iVersion: for xShadowName
+  condict_rank_create,
+  condict_rank_connect,
+  condict_rank_best_index,
+  condict_rank_disconnect,
+  condict_rank_destroy,
+  condict_rank_open,
+  condict_rank_close,
+  condict_rank_filter,
+  condict_rank_next,
+  condict_rank_eof,
+  condict_rank_column,
+  condict_rank_rowid,
+  condict_rank_update,
+  nullptr, // xBegin
+  nullptr, // xSync
+  nullptr, // xCommit
+  nullptr, // xRollback
+  nullptr, // xFindFunction
+  condict_rank_rename,
+  nullptr, // xSavepoint
+  nullptr, // xRelease
+  nullptr, // xRollbackTo
+  condict_rank_shadow_name,
+};
+
+void condict_destroy_rank_tree(void* tree) {
+  delete reinterpret_cast<RankTree*>(tree);
+}
+
+// Gets the position of a key bound for unicode_rank_count(). Null and omitted
+// bounds are the start or end of the group.
+int condict_rank_count_bound(
+  RankTree &tree,
+  sqlite3_int64 group,
+  sqlite3_value* key,
+  bool is_upper,
+  sqlite3_int64 &position
+) {
+  if (!key || sqlite3_value_type(key) == SQLITE_NULL) {
+    return tree.count_before(
+      is_upper ? RankBound::group_end(group) : RankBound::group_start(group),
+      position
+    );
+  }
+  return tree.count_before(
+    RankBound::key_bound(
+      group,
+      reinterpret_cast<const uint8_t*>(sqlite3_value_blob(key)),
+      (size_t) sqlite3_value_bytes(key),
+      false
+    ),
+    position
+  );
+}
+
+// unicode_rank_count(table, group_id[, lower[, upper]])
+//
+// See the top of the file.
+void condict_unicode_rank_count(
+  sqlite3_context* context,
+  int argc,
+  sqlite3_value** argv
+) {
+  if (argc < 2 || argc > 4) {
+    sqlite3_result_error(
+      context,
+      "unicode_rank_count() takes 2 to 4 arguments",
+      -1
+    );
+    return;
+  }
+  if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    sqlite3_result_error(
+      context,
+      "unicode_rank_count(): table cannot be null",
+      -1
+    );
+    return;
+  }
+  if (sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+  sqlite3_int64 group;
+  if (!condict_rank_integer(argv[1], group)) {
+    sqlite3_result_int64(context, 0);
+    return;
+  }
+
+  // The tree, and its prepared statements, are kept for as long as the table
+  // argument stays the same.
+  RankTree* tree =
+    reinterpret_cast<RankTree*>(sqlite3_get_auxdata(context, 0));
+  bool new_tree = !tree;
+  if (new_tree) {
+    const char* name =
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+    tree = new (std::nothrow) RankTree(
+      sqlite3_context_db_handle(context),
+      "main",
+      name
+    );
+    if (!tree) {
+      sqlite3_result_error_nomem(context);
+      return;
+    }
+  }
+
+  sqlite3_int64 lower = 0;
+  sqlite3_int64 upper = 0;
+  int result = condict_rank_count_bound(
+    *tree,
+    group,
+    argc > 2 ? argv[2] : nullptr,
+    false,
+    lower
+  );
+  if (result == SQLITE_OK) {
+    result = condict_rank_count_bound(
+      *tree,
+      group,
+      argc > 3 ? argv[3] : nullptr,
+      true,
+      upper
+    );
+  }
+
+  if (result == SQLITE_ERROR) {
+    char* message = sqlite3_mprintf(
+      "unicode_rank_count(): no such rank table: %s",
+      sqlite3_value_text(argv[0])
+    );
+    sqlite3_result_error(context, message, -1);
+    sqlite3_free(message);
+  } else if (result != SQLITE_OK) {
+    sqlite3_result_error_code(context, result);
+  } else {
+    sqlite3_result_int64(context, std::max(upper - lower, (sqlite3_int64) 0));
+  }
+
+  if (new_tree) {
+    // SQLite may destroy the tree right away, so this must come last.
+    sqlite3_set_auxdata(context, 0, tree, condict_destroy_rank_tree);
+  }
+}
+
+int condict_register_rank(sqlite3* db) {
+  int result = sqlite3_create_module_v2(
+    db,
+    "unicode_rank",
+    &condict_rank_module,
+    nullptr,
+    nullptr
+  );
+  if (result != SQLITE_OK) {
+    return result;
+  }
+
+  return sqlite3_create_function_v2(
+    db,
+    "unicode_rank_count",
+    -1,
+    SQLITE_UTF8,
+    nullptr,
+    condict_unicode_rank_count,
+    nullptr,
+    nullptr,
+    nullptr
+  );
+}
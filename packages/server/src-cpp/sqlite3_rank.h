@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../deps/sqlite3ext.h"
+
+// Registers the unicode_rank virtual table module and the unicode_rank_count()
+// function on a connection. See sqlite3_rank.cpp.
+int condict_register_rank(sqlite3* db);
@@ -1,9 +1,19 @@
 #include <cstdio>
 
 #include "test/utf8.h"
+#include "test/utf16.h"
 #include "test/nfd.h"
 #include "test/cea.h"
 #include "test/collate.h"
+#include "test/distance.h"
+#include "test/sort_key.h"
+#include "test/tailoring.h"
+#include "test/data.h"
+#include "test/weights.h"
+#include "test/stats.h"
+#include "test/sort.h"
+#include "test/key_pool.h"
+#include "test/numeric.h"
 
 int main() {
   printf("Reading test data...\n");
@@ -25,16 +35,76 @@ int main() {
     return 2;
   }
 
-  if (!condict_test::test_cea_generation(collation_tests)) {
+  if (!condict_test::test_composition(nfd_tests)) {
     printf("Stopping\n");
     return 3;
   }
 
-  if (!condict_test::test_collator(collation_tests)) {
+  if (!condict_test::test_cea_generation(collation_tests)) {
     printf("Stopping\n");
     return 4;
   }
 
+  if (!condict_test::test_collator(collation_tests)) {
+    printf("Stopping\n");
+    return 5;
+  }
+
+  if (!condict_test::test_edit_distance()) {
+    printf("Stopping\n");
+    return 6;
+  }
+
+  if (!condict_test::test_reverse_cea_generation(collation_tests)) {
+    printf("Stopping\n");
+    return 7;
+  }
+
+  if (!condict_test::test_sort_keys(collation_tests)) {
+    printf("Stopping\n");
+    return 8;
+  }
+
+  if (!condict_test::test_tailoring()) {
+    printf("Stopping\n");
+    return 9;
+  }
+
+  if (!condict_test::test_data_file()) {
+    printf("Stopping\n");
+    return 10;
+  }
+
+  if (!condict_test::test_weight_kernels()) {
+    printf("Stopping\n");
+    return 11;
+  }
+
+  if (!condict_test::test_stats()) {
+    printf("Stopping\n");
+    return 12;
+  }
+
+  if (!condict_test::test_batch_sort()) {
+    printf("Stopping\n");
+    return 13;
+  }
+
+  if (!condict_test::test_key_pool()) {
+    printf("Stopping\n");
+    return 14;
+  }
+
+  if (!condict_test::test_utf16_decoder(utf8_valid)) {
+    printf("Stopping\n");
+    return 15;
+  }
+
+  if (!condict_test::test_numeric()) {
+    printf("Stopping\n");
+    return 16;
+  }
+
   printf("All tests succeeded!\n");
   return 0;
 }
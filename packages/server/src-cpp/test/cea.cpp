@@ -1,12 +1,14 @@
 #include "cea.h"
 
 #include <cstdio>
+#include <vector>
 
 #include "common.h"
 #include "../uca/cea.h"
 
 namespace condict_test {
   using CeaIter = condict_uca::cea::ElementIter;
+  using ReverseCeaIter = condict_uca::cea::ReverseElementIter;
 
   bool test_cea(TestRunner &runner, const CollationTest &t) {
     size_t i1 = 0;
@@ -84,6 +86,46 @@ namespace condict_test {
     return true;
   }
 
+  bool same_element(
+    const condict_uca::cea::Element &a,
+    const condict_uca::cea::Element &b
+  ) {
+    return
+      a.level_1 == b.level_1 &&
+      a.level_2 == b.level_2 &&
+      a.level_3 == b.level_3 &&
+      a.level_4 == b.level_4;
+  }
+
+  // Checks that next_batch produces the same elements as next. The batch size
+  // is small and odd so that batches end in the middle of expansions.
+  bool test_cea_batches(TestRunner &runner, const CollationTest &t) {
+    std::vector<condict_uca::cea::Element> expected;
+    CeaIter iter((int) t.source.size(), t.source.c_str());
+    condict_uca::cea::Element e;
+    while (iter.next(e)) {
+      expected.push_back(e);
+    }
+
+    CeaIter batch_iter((int) t.source.size(), t.source.c_str());
+    condict_uca::cea::Element batch[3];
+    size_t i = 0;
+    uint32_t count;
+    while ((count = batch_iter.next_batch(batch, 3)) > 0) {
+      for (uint32_t j = 0; j < count; j++, i++) {
+        if (i == expected.size() || !same_element(batch[j], expected[i])) {
+          printf("next_batch: wrong element at %zu\n", i);
+          return runner.fail();
+        }
+      }
+    }
+    if (i != expected.size()) {
+      printf("next_batch: expected %zu elements, got %zu\n", expected.size(), i);
+      return runner.fail();
+    }
+    return true;
+  }
+
   bool test_cea_generation(const std::vector<CollationTest> &tests) {
     TestRunner runner("CEA generation");
 
@@ -94,6 +136,72 @@ namespace condict_test {
 
       runner.start_test(t.name);
       test_cea(runner, t);
+      test_cea_batches(runner, t);
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+
+  bool test_reverse_cea(TestRunner &runner, const CollationTest &t) {
+    std::vector<condict_uca::cea::Element> expected;
+    CeaIter iter((int) t.source.size(), t.source.c_str());
+    condict_uca::cea::Element e;
+    while (iter.next(e)) {
+      expected.push_back(e);
+    }
+
+    ReverseCeaIter rev_iter((int) t.source.size(), t.source.c_str());
+    size_t i = expected.size();
+    while (rev_iter.next(e)) {
+      if (i == 0) {
+        printf(
+          "expected eof, got [%04X.%04X.%04X.%04X]\n",
+          e.level_1,
+          e.level_2,
+          e.level_3,
+          e.level_4
+        );
+        return runner.fail();
+      }
+      i--;
+      auto &x = expected[i];
+      if (
+        e.level_1 != x.level_1 ||
+        e.level_2 != x.level_2 ||
+        e.level_3 != x.level_3 ||
+        e.level_4 != x.level_4
+      ) {
+        printf(
+          "%zu: expected [%04X.%04X.%04X.%04X], got [%04X.%04X.%04X.%04X]\n",
+          i,
+          x.level_1,
+          x.level_2,
+          x.level_3,
+          x.level_4,
+          e.level_1,
+          e.level_2,
+          e.level_3,
+          e.level_4
+        );
+        return runner.fail();
+      }
+    }
+    if (i != 0) {
+      printf("%zu: expected more elements, got eof\n", i);
+      return runner.fail();
+    }
+    return true;
+  }
+
+  bool test_reverse_cea_generation(const std::vector<CollationTest> &tests) {
+    TestRunner runner("Reverse CEA generation");
+
+    // The reverse iterator must produce exactly the same elements as the
+    // forward iterator, in the opposite order.
+    for (auto &t : tests) {
+      runner.start_test(t.name);
+      test_reverse_cea(runner, t);
       runner.end_test();
     }
 
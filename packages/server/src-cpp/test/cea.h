@@ -4,4 +4,6 @@
 
 namespace condict_test {
   bool test_cea_generation(const std::vector<CollationTest> &tests);
+
+  bool test_reverse_cea_generation(const std::vector<CollationTest> &tests);
 }
@@ -0,0 +1,280 @@
+#include "data.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "common.h"
+#include "../uca/data.h"
+
+namespace condict_test {
+  namespace data = condict_uca::data;
+
+  // Removed when the tests are done.
+  const char* const TEMP_FILE = "test-data/uca-data.tmp";
+
+  data::Tables embedded_tables() {
+    data::Tables tables;
+    memset(&tables, 0, sizeof(tables));
+    strncpy(tables.version, data::embedded_version, data::VERSION_SIZE - 1);
+    tables.collation = data::embedded_collation;
+    tables.normalization = data::embedded_normalization;
+    return tables;
+  }
+
+  template<typename T>
+  bool same_array(
+    const char* name,
+    const T* expected,
+    uint32_t expected_len,
+    const T* actual,
+    uint32_t actual_len
+  ) {
+    if (
+      expected_len != actual_len ||
+      memcmp(expected, actual, expected_len * sizeof(T)) != 0
+    ) {
+      printf("%s: loaded table differs from the embedded one\n", name);
+      return false;
+    }
+    return true;
+  }
+
+  bool same_tables(const data::Tables &expected, const data::Tables &actual) {
+    const data::CollationTables &ec = expected.collation;
+    const data::CollationTables &ac = actual.collation;
+    const data::NormalizationTables &en = expected.normalization;
+    const data::NormalizationTables &an = actual.normalization;
+
+    bool params_ok =
+      strcmp(expected.version, actual.version) == 0 &&
+      ec.highest_var == ac.highest_var &&
+      ec.last_assigned == ac.last_assigned &&
+      ec.contractions_root_size == ac.contractions_root_size &&
+      en.last_assigned == an.last_assigned;
+    if (!params_ok) {
+      printf("Loaded table parameters differ from the embedded ones\n");
+      return false;
+    }
+
+    // Evaluate everything so that all differences are reported.
+    bool ok = true;
+    ok &= same_array(
+      "cea_data",
+      ec.cea_data, ec.cea_data_len,
+      ac.cea_data, ac.cea_data_len
+    );
+    ok &= same_array(
+      "cea_indices",
+      ec.cea_indices, ec.cea_indices_len,
+      ac.cea_indices, ac.cea_indices_len
+    );
+    ok &= same_array(
+      "cea stage1",
+      ec.stage1, ec.stage1_len,
+      ac.stage1, ac.stage1_len
+    );
+    ok &= same_array(
+      "cea stage2",
+      ec.stage2, ec.stage2_len,
+      ac.stage2, ac.stage2_len
+    );
+    ok &= same_array(
+      "contractions",
+      ec.contractions, ec.contractions_len,
+      ac.contractions, ac.contractions_len
+    );
+    ok &= same_array(
+      "decomp_data",
+      en.decomp_data, en.decomp_data_len,
+      an.decomp_data, an.decomp_data_len
+    );
+    ok &= same_array(
+      "comp_data",
+      en.comp_data, en.comp_data_len,
+      an.comp_data, an.comp_data_len
+    );
+    ok &= same_array(
+      "comp stage1",
+      en.stage1, en.stage1_len,
+      an.stage1, an.stage1_len
+    );
+    ok &= same_array(
+      "comp stage2",
+      en.stage2, en.stage2_len,
+      an.stage2, an.stage2_len
+    );
+    ok &= same_array(
+      "comp stage3",
+      en.stage3, en.stage3_len,
+      an.stage3, an.stage3_len
+    );
+    return ok;
+  }
+
+  std::vector<uint8_t> read_file(const char* path) {
+    std::vector<uint8_t> result;
+    FILE* file = fopen(path, "rb");
+    if (file) {
+      uint8_t chunk[4096];
+      size_t count;
+      while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        result.insert(result.end(), chunk, chunk + count);
+      }
+      fclose(file);
+    }
+    return result;
+  }
+
+  bool write_bytes(const char* path, const std::vector<uint8_t> &bytes) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+      return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+  }
+
+  // Checks that the data file at TEMP_FILE is rejected with the specified
+  // error message.
+  void expect_rejected(TestRunner &runner, const char* expected_error) {
+    data::Tables result = embedded_tables();
+    const char* error = nullptr;
+    if (data::load_file(TEMP_FILE, result, error)) {
+      printf("Expected file to be rejected with: %s\n", expected_error);
+      runner.fail();
+    } else if (strcmp(error, expected_error) != 0) {
+      printf("Wrong error message:\n");
+      printf("  expected: %s\n", expected_error);
+      printf("  actual:   %s\n", error);
+      runner.fail();
+    }
+  }
+
+  // Writes a file with valid structure and checksum but invalid contents, and
+  // checks that it's rejected.
+  void test_invalid_tables(
+    TestRunner &runner,
+    const data::Tables &tables,
+    const char* expected_error
+  ) {
+    if (!data::write_file(TEMP_FILE, tables)) {
+      printf("Could not write %s\n", TEMP_FILE);
+      runner.fail();
+      return;
+    }
+    expect_rejected(runner, expected_error);
+  }
+
+  bool test_data_file() {
+    TestRunner runner("Data file");
+
+    const data::Tables embedded = embedded_tables();
+
+    runner.start_test("round trip");
+    if (!data::write_file(TEMP_FILE, embedded)) {
+      printf("Could not write %s\n", TEMP_FILE);
+      runner.fail();
+      runner.end_test();
+      return runner.result();
+    }
+    data::Tables loaded = embedded_tables();
+    const char* error = nullptr;
+    if (!data::load_file(TEMP_FILE, loaded, error)) {
+      printf("Could not load data file: %s\n", error);
+      runner.fail();
+    } else if (!same_tables(embedded, loaded)) {
+      runner.fail();
+    } else if (data::checksum(embedded) != data::checksum(loaded)) {
+      printf("Loaded tables have a different checksum\n");
+      runner.fail();
+    }
+    runner.end_test();
+
+    runner.start_test("checksum changes with contents");
+    {
+      const data::CollationTables &c = embedded.collation;
+      std::vector<uint16_t> cea_data(c.cea_data, c.cea_data + c.cea_data_len);
+      cea_data[0]++;
+      data::Tables tables = embedded;
+      tables.collation.cea_data = cea_data.data();
+      if (data::checksum(tables) == data::checksum(embedded)) {
+        printf("Changed tables have the same checksum\n");
+        runner.fail();
+      }
+    }
+    runner.end_test();
+
+    const std::vector<uint8_t> valid = read_file(TEMP_FILE);
+
+    runner.start_test("corrupted byte");
+    std::vector<uint8_t> corrupted = valid;
+    corrupted[corrupted.size() / 2] ^= 0x40;
+    write_bytes(TEMP_FILE, corrupted);
+    expect_rejected(runner, "checksum mismatch");
+    runner.end_test();
+
+    runner.start_test("truncated file");
+    std::vector<uint8_t> truncated(valid.begin(), valid.end() - 16);
+    write_bytes(TEMP_FILE, truncated);
+    expect_rejected(runner, "file size does not match header");
+    runner.end_test();
+
+    runner.start_test("bad magic");
+    std::vector<uint8_t> bad_magic = valid;
+    bad_magic[0] = 'X';
+    write_bytes(TEMP_FILE, bad_magic);
+    expect_rejected(runner, "not a collation data file");
+    runner.end_test();
+
+    runner.start_test("element index out of bounds");
+    {
+      const data::CollationTables &c = embedded.collation;
+      std::vector<uint32_t> indices(
+        c.cea_indices,
+        c.cea_indices + c.cea_indices_len
+      );
+      // Simple format, 1 element, starting at the very end of the data.
+      indices[0x41] = 0x81000000 | c.cea_data_len;
+      data::Tables tables = embedded;
+      tables.collation.cea_indices = indices.data();
+      test_invalid_tables(
+        runner,
+        tables,
+        "collation element index out of bounds"
+      );
+    }
+    runner.end_test();
+
+    runner.start_test("cyclic contraction chain");
+    {
+      const data::CollationTables &c = embedded.collation;
+      std::vector<condict_uca::HashTableBucket<uint32_t>> buckets(
+        c.contractions,
+        c.contractions + c.contractions_len
+      );
+      buckets[0].next_offset = 1;
+      buckets[1].next_offset = -1;
+      data::Tables tables = embedded;
+      tables.collation.contractions = buckets.data();
+      test_invalid_tables(runner, tables, "contraction chain does not end");
+    }
+    runner.end_test();
+
+    runner.start_test("different table layout");
+    {
+      data::Tables tables = embedded;
+      tables.normalization.stage1_shift++;
+      test_invalid_tables(
+        runner,
+        tables,
+        "normalization table layout does not match"
+      );
+    }
+    runner.end_test();
+
+    remove(TEMP_FILE);
+
+    return runner.result();
+  }
+}
@@ -0,0 +1,175 @@
+#include "distance.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/distance.h"
+
+namespace condict_test {
+  using EditDistance = condict_uca::distance::EditDistance;
+
+  struct DistanceTest {
+    const char* a;
+    const char* b;
+    uint32_t strength;
+    uint32_t max;
+    uint32_t expected;
+  };
+
+  const DistanceTest distance_tests[] = {
+    { "", "", 1, 100, 0 },
+    { "", "abc", 1, 100, 3 },
+    { "abc", "", 1, 100, 3 },
+    { "kitten", "sitting", 1, 100, 3 },
+    { "flaw", "lawn", 1, 100, 2 },
+    // Transpositions count as a single edit...
+    { "ab", "ba", 1, 100, 1 },
+    { "dictoinary", "dictionary", 1, 100, 1 },
+    // ... but a transposed pair cannot be edited again.
+    { "ca", "abc", 1, 100, 3 },
+    // Differences that are ignored at the given strength.
+    { "resume", "r\xC3\xA9sum\xC3\xA9", 1, 100, 0 },
+    { "resume", "r\xC3\xA9sum\xC3\xA9", 2, 100, 2 },
+    { "Resume", "resume", 2, 100, 0 },
+    { "Resume", "resume", 3, 100, 1 },
+    { "ice-cream", "ice cream", 3, 100, 0 },
+    { "ice-cream", "ice cream", 4, 100, 1 },
+    // Canonically equivalent strings are always identical.
+    { "e\xCC\x81", "\xC3\xA9", 4, 100, 0 },
+    // Early cutoff.
+    { "kitten", "sitting", 1, 2, 3 },
+    { "kitten", "sitting", 1, 3, 3 },
+    { "a", "abcdefgh", 1, 3, 4 },
+  };
+
+  // A straightforward, quadratic implementation of the optimal string alignment
+  // distance, which we can check the real thing against. The test strings only
+  // contain lowercase ASCII letters, which have one collation element each,
+  // distinct at the primary level.
+  uint32_t reference_distance(const std::string &a, const std::string &b) {
+    size_t m = a.size();
+    size_t n = b.size();
+    std::vector<std::vector<uint32_t>> d(m + 1, std::vector<uint32_t>(n + 1));
+    for (size_t i = 0; i <= m; i++) {
+      d[i][0] = (uint32_t) i;
+    }
+    for (size_t j = 0; j <= n; j++) {
+      d[0][j] = (uint32_t) j;
+    }
+    for (size_t i = 1; i <= m; i++) {
+      for (size_t j = 1; j <= n; j++) {
+        uint32_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+        d[i][j] = std::min({
+          d[i - 1][j] + 1,
+          d[i][j - 1] + 1,
+          d[i - 1][j - 1] + cost,
+        });
+        if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+          d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+        }
+      }
+    }
+    return d[m][n];
+  }
+
+  std::string random_word(std::mt19937 &rng, size_t len) {
+    // A small alphabet gives us plenty of matches and transpositions.
+    std::string result;
+    for (size_t i = 0; i < len; i++) {
+      result.push_back((char) ('a' + rng() % 6));
+    }
+    return result;
+  }
+
+  bool test_distance(
+    TestRunner &runner,
+    EditDistance &dist,
+    const std::string &a,
+    const std::string &b,
+    uint32_t strength,
+    uint32_t max,
+    uint32_t expected
+  ) {
+    uint32_t actual = dist.compute(
+      (int) a.size(),
+      a.c_str(),
+      (int) b.size(),
+      b.c_str(),
+      strength,
+      max
+    );
+    if (actual != expected) {
+      printf(
+        "'%s' -> '%s' (strength %u, max %u): expected %u, got %u\n",
+        a.c_str(),
+        b.c_str(),
+        strength,
+        max,
+        expected,
+        actual
+      );
+      return runner.fail();
+    }
+    return true;
+  }
+
+  bool test_edit_distance() {
+    TestRunner runner("Edit distance");
+
+    // The same instance is reused throughout, as in real use: buffers that
+    // are left over from earlier (and longer) strings must not matter.
+    EditDistance dist;
+
+    for (auto &t : distance_tests) {
+      runner.start_test(std::string(t.a) + " -> " + t.b);
+      test_distance(runner, dist, t.a, t.b, t.strength, t.max, t.expected);
+      runner.end_test();
+    }
+
+    // Compare against the reference implementation, with lengths on either
+    // side of the 64-element word boundary.
+    std::mt19937 rng(26);
+    for (size_t i = 0; i < 2000; i++) {
+      std::string a = random_word(rng, rng() % 150);
+      std::string b = random_word(rng, rng() % 150);
+      if (i % 2 == 0) {
+        // Make them similar.
+        b = a;
+        for (size_t edits = rng() % 8; edits > 0 && !b.empty(); edits--) {
+          size_t at = rng() % b.size();
+          switch (rng() % 4) {
+            case 0: b.erase(at, 1); break;
+            case 1: b.insert(at, 1, (char) ('a' + rng() % 6)); break;
+            case 2: b[at] = (char) ('a' + rng() % 6); break;
+            case 3:
+              if (at + 1 < b.size()) {
+                std::swap(b[at], b[at + 1]);
+              }
+              break;
+          }
+        }
+      }
+
+      uint32_t expected = reference_distance(a, b);
+      runner.start_test("random: " + a + " -> " + b);
+      test_distance(runner, dist, a, b, 1, 1000, expected);
+      uint32_t max = rng() % 10;
+      test_distance(
+        runner,
+        dist,
+        a,
+        b,
+        1,
+        max,
+        expected > max ? max + 1 : expected
+      );
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+}
@@ -0,0 +1,128 @@
+#include "key_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "../uca/key_pool.h"
+#include "../uca/sort_key.h"
+
+namespace condict_test {
+  using condict_uca::sort_key::KeyBatch;
+  using condict_uca::sort_key::KeyBuilder;
+  using condict_uca::sort_key::KeyPool;
+
+  // Builds the keys of `words` in batches of `batch_size` on `pool`, and
+  // checks each key against KeyBuilder. Alternates between two batches, as
+  // callers that overlap building with other work do.
+  bool check_pool(
+    TestRunner &runner,
+    KeyPool &pool,
+    const std::vector<std::string> &words,
+    uint32_t batch_size,
+    bool reverse
+  ) {
+    std::vector<std::string_view> views(words.begin(), words.end());
+    KeyBatch batches[2];
+    KeyBuilder builder;
+    uint32_t batch_index = 0;
+    for (size_t start = 0; start < views.size(); start += batch_size) {
+      uint32_t count =
+        (uint32_t) std::min<size_t>(batch_size, views.size() - start);
+      KeyBatch &batch = batches[batch_index];
+      batch_index ^= 1;
+      pool.start(views.data() + start, count, batch, reverse);
+      pool.wait();
+
+      if (batch.size() != count) {
+        printf(
+          "key pool: batch has %u keys, expected %u\n",
+          batch.size(),
+          count
+        );
+        return runner.fail();
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        const std::string &word = words[start + i];
+        uint32_t len = reverse
+          ? builder.build_reverse((int) word.size(), word.data())
+          : builder.build((int) word.size(), word.data());
+        std::string expected(
+          reinterpret_cast<const char*>(builder.data()),
+          len
+        );
+        std::string actual(
+          reinterpret_cast<const char*>(batch.key(i)),
+          batch.key_len(i)
+        );
+        if (actual != expected) {
+          printf(
+            "key pool: wrong %skey for word %zu\n",
+            reverse ? "reverse " : "",
+            start + i
+          );
+          return runner.fail();
+        }
+      }
+    }
+    return true;
+  }
+
+  bool test_key_pool() {
+    TestRunner runner("Key pool");
+
+    std::mt19937 rng(45);
+    std::vector<std::string> words;
+    for (uint32_t i = 0; i < 5000; i++) {
+      // Include empty words, and words long enough to make workers' arenas
+      // grow between batches.
+      std::string word;
+      uint32_t len = i % 100 == 0 ? 200 : rng() % 12;
+      for (uint32_t j = 0; j < len; j++) {
+        static const char* const pieces[] = {
+          "a", "B", "e", "\xC3\xA9", "-", " ", "\xE2\x82\xAC",
+        };
+        word += pieces[rng() % 7];
+      }
+      words.push_back(std::move(word));
+    }
+
+    runner.start_test("thread count");
+    for (uint32_t threads : {0u, 1u, 3u}) {
+      KeyPool pool(threads);
+      uint32_t expected = threads > 0 ? threads : 1;
+      if (pool.thread_count() != expected) {
+        printf(
+          "key pool: %u threads started, expected %u\n",
+          pool.thread_count(),
+          expected
+        );
+        runner.fail();
+      }
+    }
+    runner.end_test();
+
+    for (uint32_t threads : {1u, 3u}) {
+      KeyPool pool(threads);
+
+      runner.start_test(std::to_string(threads) + " threads");
+      check_pool(runner, pool, words, 1000, false);
+      runner.end_test();
+
+      runner.start_test(std::to_string(threads) + " threads, reverse");
+      check_pool(runner, pool, words, 1000, true);
+      runner.end_test();
+
+      // Fewer strings than workers, so some workers get nothing to do.
+      runner.start_test(std::to_string(threads) + " threads, tiny batches");
+      check_pool(runner, pool, words, 2, false);
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+}
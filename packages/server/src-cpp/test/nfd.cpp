@@ -7,10 +7,12 @@
 #include <sstream>
 
 #include "common.h"
+#include "../uca/nfc.h"
 #include "../uca/nfd.h"
 
 namespace condict_test {
   using NfdIter = condict_uca::nfd::NfdIter;
+  using Normalizer = condict_uca::nfc::Normalizer;
 
   std::vector<NfdTest> read_nfd_tests(const char* path) {
     std::vector<NfdTest> result;
@@ -89,10 +91,11 @@ namespace condict_test {
     TestRunner &runner,
     const char* label,
     const std::string &source,
-    const std::vector<uint32_t> &expected
+    const std::vector<uint32_t> &expected,
+    bool trusted_nfd = false
   ) {
     size_t i = 0;
-    NfdIter iter((int) source.size(), source.c_str());
+    NfdIter iter((int) source.size(), source.c_str(), nullptr, trusted_nfd);
     while (true) {
       uint32_t actual;
       if (!iter.next(actual)) {
@@ -115,6 +118,28 @@ namespace condict_test {
     return true;
   }
 
+  // Checks that next_batch produces the same code points. The batch size is
+  // small and odd so that batches end in the middle of decompositions.
+  bool test_decomposed_batches(
+    TestRunner &runner,
+    const char* label,
+    const std::string &source,
+    const std::vector<uint32_t> &expected
+  ) {
+    std::vector<uint32_t> actual;
+    NfdIter iter((int) source.size(), source.c_str());
+    uint32_t batch[3];
+    uint32_t count;
+    while ((count = iter.next_batch(batch, 3)) > 0) {
+      actual.insert(actual.end(), batch, batch + count);
+    }
+    if (actual != expected) {
+      printf("%s: next_batch produced different code points\n", label);
+      return runner.fail();
+    }
+    return true;
+  }
+
   bool test_decomposition(const std::vector<NfdTest> &tests) {
     TestRunner runner("Decomposition");
 
@@ -129,6 +154,65 @@ namespace condict_test {
       test_decomposed_forms(runner, "nfd", t.nfd, t.expected);
       test_decomposed_forms(runner, "nfkc", t.nfkc, t.expected_compat);
       test_decomposed_forms(runner, "nfkd", t.nfkd, t.expected_compat);
+      test_decomposed_batches(runner, "src", t.source, t.expected);
+      test_decomposed_batches(runner, "nfkc", t.nfkc, t.expected_compat);
+      // Strings that are already in NFD come out the same when trusted.
+      test_decomposed_forms(runner, "trusted nfd", t.nfd, t.expected, true);
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+
+  bool test_normalized_form(
+    TestRunner &runner,
+    const char* label,
+    const std::string &actual,
+    const std::string &expected
+  ) {
+    if (actual != expected) {
+      printf("%s: expected:", label);
+      for (unsigned char c : expected) {
+        printf(" %02X", c);
+      }
+      printf("\n%s: actual:  ", label);
+      for (unsigned char c : actual) {
+        printf(" %02X", c);
+      }
+      printf("\n");
+      return runner.fail();
+    }
+    return true;
+  }
+
+  std::string to_nfc(Normalizer &normalizer, const std::string &str) {
+    uint32_t len = normalizer.to_nfc((int) str.size(), str.c_str());
+    return std::string(normalizer.data(), len);
+  }
+
+  std::string to_nfd(Normalizer &normalizer, const std::string &str) {
+    uint32_t len = normalizer.to_nfd((int) str.size(), str.c_str());
+    return std::string(normalizer.data(), len);
+  }
+
+  bool test_composition(const std::vector<NfdTest> &tests) {
+    TestRunner runner("Composition");
+
+    // Reused across tests, as in the SQL functions.
+    Normalizer normalizer;
+    for (auto &t : tests) {
+      runner.start_test(t.name);
+      // For every conformant implementation of NFC, the following must hold:
+      //
+      //   t.nfc == NFC(t.source) == NFC(t.nfc) == NFC(t.nfd)
+      //   t.nfkc == NFC(t.nfkc) == NFC(t.nfkd)
+      test_normalized_form(runner, "src", to_nfc(normalizer, t.source), t.nfc);
+      test_normalized_form(runner, "nfc", to_nfc(normalizer, t.nfc), t.nfc);
+      test_normalized_form(runner, "nfd", to_nfc(normalizer, t.nfd), t.nfc);
+      test_normalized_form(runner, "nfkc", to_nfc(normalizer, t.nfkc), t.nfkc);
+      test_normalized_form(runner, "nfkd", to_nfc(normalizer, t.nfkd), t.nfkc);
+      // And back again.
+      test_normalized_form(runner, "nfc -> nfd", to_nfd(normalizer, t.nfc), t.nfd);
       runner.end_test();
     }
 
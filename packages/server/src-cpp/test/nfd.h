@@ -20,4 +20,6 @@ namespace condict_test {
   std::vector<NfdTest> read_nfd_tests(const char* path);
 
   bool test_decomposition(const std::vector<NfdTest> &tests);
+
+  bool test_composition(const std::vector<NfdTest> &tests);
 }
@@ -0,0 +1,236 @@
+#include "numeric.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/numeric.h"
+#include "../uca/sort_key.h"
+#include "../uca/uca.h"
+
+namespace condict_test {
+  using condict_uca::numeric::NOT_A_DIGIT;
+  using condict_uca::sort_key::KeyBuilder;
+  using condict_uca::sort_key::MAX_STRENGTH;
+
+  inline int sign(int value) {
+    return value < 0 ? -1 : value > 0 ? 1 : 0;
+  }
+
+  int compare_numeric(const std::string &a, const std::string &b) {
+    return sign(condict_uca::compare_numeric(
+      (int) a.size(), a.data(),
+      (int) b.size(), b.data()
+    ));
+  }
+
+  std::string numeric_key(KeyBuilder &builder, const std::string &str) {
+    uint32_t len =
+      builder.build((int) str.size(), str.data(), MAX_STRENGTH, true);
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  void test_digit_values(TestRunner &runner) {
+    struct DigitTest {
+      uint32_t cp;
+      uint32_t value;
+    };
+    const DigitTest tests[] = {
+      { '0', 0 },
+      { '9', 9 },
+      { '/', NOT_A_DIGIT },
+      { ':', NOT_A_DIGIT },
+      { 'a', NOT_A_DIGIT },
+      { 0x00B2, NOT_A_DIGIT }, // Superscript two
+      { 0x065F, NOT_A_DIGIT },
+      { 0x0660, 0 }, // Arabic-Indic digit zero
+      { 0x0669, 9 },
+      { 0x066A, NOT_A_DIGIT },
+      { 0x0967, 1 }, // Devanagari digit one
+      { 0x2460, NOT_A_DIGIT }, // Circled digit one
+      { 0xFF15, 5 }, // Fullwidth digit five
+      { 0x11F57, 7 }, // Kawi digit seven
+      { 0x1D7CE, 0 }, // Mathematical bold digit zero
+      { 0x1D7D8, 0 }, // Mathematical double-struck digit zero
+      { 0x1E4F9, 9 }, // Nag Mundari digit nine
+      { 0x1FBF9, 9 }, // Segmented digit nine
+      { 0x1FBFA, NOT_A_DIGIT },
+      { 0x10FFFF, NOT_A_DIGIT },
+    };
+    for (const DigitTest &t : tests) {
+      uint32_t actual = condict_uca::numeric::digit_value(t.cp);
+      if (actual != t.value) {
+        printf(
+          "U+%04X: expected value %u, got %u\n",
+          t.cp,
+          t.value,
+          actual
+        );
+        runner.fail();
+      }
+    }
+  }
+
+  // Checks that each string sorts before the next.
+  void test_order(
+    TestRunner &runner,
+    KeyBuilder &builder,
+    const std::vector<std::string> &strings
+  ) {
+    for (size_t i = 0; i < strings.size(); i++) {
+      for (size_t j = 0; j < strings.size(); j++) {
+        int expected = i < j ? -1 : i > j ? 1 : 0;
+        int actual = compare_numeric(strings[i], strings[j]);
+        std::string key_i = numeric_key(builder, strings[i]);
+        std::string key_j = numeric_key(builder, strings[j]);
+        int key_result = sign(key_i.compare(key_j));
+        if (actual != expected || key_result != expected) {
+          printf(
+            "'%s' vs '%s': expected %d, got %d (sort keys: %d)\n",
+            strings[i].c_str(),
+            strings[j].c_str(),
+            expected,
+            actual,
+            key_result
+          );
+          runner.fail();
+          return;
+        }
+      }
+    }
+  }
+
+  void test_equal(
+    TestRunner &runner,
+    const std::string &a,
+    const std::string &b
+  ) {
+    int actual = compare_numeric(a, b);
+    if (actual != 0) {
+      printf(
+        "'%s' vs '%s': expected 0, got %d\n",
+        a.c_str(),
+        b.c_str(),
+        actual
+      );
+      runner.fail();
+    }
+  }
+
+  bool test_numeric() {
+    TestRunner runner("Numeric");
+    KeyBuilder builder;
+
+    runner.start_test("digit values");
+    test_digit_values(runner);
+    runner.end_test();
+
+    runner.start_test("numbers by value");
+    test_order(runner, builder, {
+      "",
+      "0",
+      "00",
+      "1",
+      "01",
+      "2",
+      "9",
+      "10",
+      "99",
+      "100",
+      "1000",
+      "9999",
+      "10000",
+      "12345",
+      "123456789",
+      "a",
+      "a0",
+      "a1",
+      "a2",
+      "a2b",
+      "a10",
+      "A10",
+      "a10b",
+      "a12",
+      "b",
+    });
+    runner.end_test();
+
+    runner.start_test("several numbers");
+    test_order(runner, builder, {
+      "1.5",
+      "1.10",
+      "2-1",
+      "2-9",
+      "2-10",
+      "10-1",
+      "x2y9",
+      "x2y10",
+      "x10y2",
+    });
+    runner.end_test();
+
+    runner.start_test("leading zeros");
+    test_order(runner, builder, {
+      "a7",
+      "a07",
+      "a007",
+      "a8",
+      "a08",
+    });
+    runner.end_test();
+
+    runner.start_test("other scripts");
+    // Arabic-Indic, fullwidth and mixed digits have the same value.
+    test_equal(runner, "12", "\xD9\xA1\xD9\xA2");
+    test_equal(runner, "12", "\xEF\xBC\x91\xEF\xBC\x92");
+    test_equal(runner, "12", "1\xD9\xA2");
+    test_order(runner, builder, {
+      "\xD9\xA9", // Arabic-Indic 9
+      "\xD9\xA1\xD9\xA0", // Arabic-Indic 10
+      "11",
+    });
+    runner.end_test();
+
+    runner.start_test("long numbers");
+    std::string nines(254, '9');
+    std::string split = nines + "9";
+    test_order(runner, builder, {
+      // Leading zeros don't count towards the limit.
+      std::string(300, '0') + "2",
+      std::string(253, '9'),
+      "1" + std::string(253, '0'),
+      // Split into 254 digits followed by 47 zeros.
+      "1" + std::string(300, '0'),
+      nines,
+      // Split into two numbers after 254 digits.
+      split,
+      split + "a",
+    });
+    runner.end_test();
+
+    runner.start_test("UTF-16");
+    const char a[] = { '2', 0 };
+    const char b[] = { '1', 0, '0', 0 };
+    int actual = sign(condict_uca::compare_numeric(
+      2, a,
+      4, b,
+      condict_uca::Encoding::UTF16LE
+    ));
+    if (actual != -1) {
+      printf("'2' vs '10' in UTF-16: expected -1, got %d\n", actual);
+      runner.fail();
+    }
+    runner.end_test();
+
+    runner.start_test("plain collation unchanged");
+    if (sign(condict_uca::compare(1, "2", 2, "10")) != 1) {
+      printf("'2' vs '10' without numeric mode: expected 1\n");
+      runner.fail();
+    }
+    runner.end_test();
+
+    return runner.result();
+  }
+}
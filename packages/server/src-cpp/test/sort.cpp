@@ -0,0 +1,165 @@
+#include "sort.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.h"
+#include "../uca/sort.h"
+#include "../uca/sort_key.h"
+#include "../uca/uca.h"
+
+namespace condict_test {
+  using condict_uca::sort_key::KeyBuilder;
+
+  // Letters with and without accents, in both cases, and punctuation, so
+  // that words differ at every level.
+  const char* const PIECES[] = {
+    "a", "b", "c", "e", "A", "E",
+    "\xC3\xA9", // é
+    "e\xCC\x81", // e + combining acute, equal to é
+    "\xC3\x89", // É
+    "-", " ", "'",
+  };
+  constexpr uint32_t PIECE_COUNT = sizeof(PIECES) / sizeof(PIECES[0]);
+
+  std::vector<std::string> random_words(
+    uint32_t count,
+    uint32_t seed,
+    const std::string &prefix = ""
+  ) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> words;
+    words.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      std::string word = prefix;
+      uint32_t len = rng() % 6;
+      for (uint32_t j = 0; j < len; j++) {
+        word += PIECES[rng() % PIECE_COUNT];
+      }
+      words.push_back(std::move(word));
+    }
+    return words;
+  }
+
+  std::string key_of(
+    KeyBuilder &builder,
+    const std::string &s,
+    uint32_t strength
+  ) {
+    uint32_t len = builder.build((int) s.size(), s.data(), strength);
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  std::vector<uint32_t> sort_words(
+    const std::vector<std::string> &words,
+    uint32_t strength,
+    uint32_t threads
+  ) {
+    std::vector<std::string_view> views(words.begin(), words.end());
+    std::vector<uint32_t> order(words.size());
+    condict_uca::sort(
+      views.data(),
+      (uint32_t) views.size(),
+      order.data(),
+      strength,
+      threads
+    );
+    return order;
+  }
+
+  // Checks that `order` is a permutation that puts `words` in order, and
+  // keeps equal words in input order.
+  bool check_order(
+    TestRunner &runner,
+    const std::vector<std::string> &words,
+    const std::vector<uint32_t> &order,
+    uint32_t strength
+  ) {
+    std::vector<bool> seen(words.size());
+    for (uint32_t index : order) {
+      if (index >= words.size() || seen[index]) {
+        printf("not a permutation: index %u\n", index);
+        return runner.fail();
+      }
+      seen[index] = true;
+    }
+
+    KeyBuilder builder;
+    for (size_t i = 1; i < order.size(); i++) {
+      const std::string &a = words[order[i - 1]];
+      const std::string &b = words[order[i]];
+      int result = strength == condict_uca::sort_key::MAX_STRENGTH
+        ? condict_uca::compare(
+            (int) a.size(), a.data(),
+            (int) b.size(), b.data()
+          )
+        : key_of(builder, a, strength).compare(key_of(builder, b, strength));
+      if (result > 0 || (result == 0 && order[i - 1] > order[i])) {
+        printf(
+          "out of order at %zu: '%s' (%u), '%s' (%u)\n",
+          i,
+          a.c_str(),
+          order[i - 1],
+          b.c_str(),
+          order[i]
+        );
+        return runner.fail();
+      }
+    }
+    return true;
+  }
+
+  bool test_batch_sort() {
+    TestRunner runner("Batch sort");
+
+    runner.start_test("empty and single");
+    {
+      std::vector<std::string> none;
+      check_order(runner, none, sort_words(none, 4, 1), 4);
+      std::vector<std::string> one{"a"};
+      check_order(runner, one, sort_words(one, 4, 1), 4);
+    }
+    runner.end_test();
+
+    runner.start_test("random words");
+    {
+      // Short words from a small alphabet, so there are many duplicates.
+      auto words = random_words(5000, 1);
+      check_order(runner, words, sort_words(words, 4, 1), 4);
+    }
+    runner.end_test();
+
+    runner.start_test("long shared prefixes");
+    {
+      auto words = random_words(2000, 2, std::string(300, 'x'));
+      check_order(runner, words, sort_words(words, 4, 1), 4);
+    }
+    runner.end_test();
+
+    for (uint32_t strength = 1; strength < 4; strength++) {
+      runner.start_test("strength " + std::to_string(strength));
+      auto words = random_words(5000, 3 + strength);
+      check_order(runner, words, sort_words(words, strength, 1), strength);
+      runner.end_test();
+    }
+
+    runner.start_test("threads");
+    {
+      auto words = random_words(50000, 7);
+      std::vector<uint32_t> single = sort_words(words, 4, 1);
+      std::vector<uint32_t> multi = sort_words(words, 4, 4);
+      check_order(runner, words, multi, 4);
+      if (multi != single) {
+        printf("threaded order differs from single-threaded order\n");
+        runner.fail();
+      }
+    }
+    runner.end_test();
+
+    return runner.result();
+  }
+}
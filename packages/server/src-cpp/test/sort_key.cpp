@@ -0,0 +1,150 @@
+#include "sort_key.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "common.h"
+#include "../uca/sort_key.h"
+#include "../uca/uca.h"
+
+namespace condict_test {
+  using KeyBuilder = condict_uca::sort_key::KeyBuilder;
+
+  inline int sign(int value) {
+    return value < 0 ? -1 : value > 0 ? 1 : 0;
+  }
+
+  std::string build_key(KeyBuilder &builder, const std::string &str) {
+    uint32_t len = builder.build((int) str.size(), str.c_str());
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  std::string build_key(
+    KeyBuilder &builder,
+    const std::string &str,
+    uint32_t strength
+  ) {
+    uint32_t len = builder.build((int) str.size(), str.c_str(), strength);
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  std::string build_reverse_key(KeyBuilder &builder, const std::string &str) {
+    uint32_t len = builder.build_reverse((int) str.size(), str.c_str());
+    return std::string(reinterpret_cast<const char*>(builder.data()), len);
+  }
+
+  int compare_keys(const std::string &a, const std::string &b) {
+    size_t len = a.size() < b.size() ? a.size() : b.size();
+    int result = memcmp(a.data(), b.data(), len);
+    if (result == 0) {
+      result = a.size() < b.size() ? -1 : a.size() > b.size() ? 1 : 0;
+    }
+    return sign(result);
+  }
+
+  bool test_sort_key_pair(
+    TestRunner &runner,
+    KeyBuilder &builder,
+    const CollationTest &a,
+    const CollationTest &b
+  ) {
+    static const char* ordering_symbol[] = { "<", "==", ">" };
+
+    int expected = sign(condict_uca::compare(
+      (int) a.source.size(),
+      a.source.c_str(),
+      (int) b.source.size(),
+      b.source.c_str()
+    ));
+    int actual = compare_keys(
+      build_key(builder, a.source),
+      build_key(builder, b.source)
+    );
+    if (actual != expected) {
+      printf(
+        "sort key: expected '%s' %s '%s', got %s\n",
+        a.name.c_str(),
+        ordering_symbol[expected + 1],
+        b.name.c_str(),
+        ordering_symbol[actual + 1]
+      );
+      return runner.fail();
+    }
+
+    expected = sign(condict_uca::compare_reverse(
+      (int) a.source.size(),
+      a.source.c_str(),
+      (int) b.source.size(),
+      b.source.c_str()
+    ));
+    actual = compare_keys(
+      build_reverse_key(builder, a.source),
+      build_reverse_key(builder, b.source)
+    );
+    if (actual != expected) {
+      printf(
+        "reverse sort key: expected '%s' %s '%s', got %s\n",
+        a.name.c_str(),
+        ordering_symbol[expected + 1],
+        b.name.c_str(),
+        ordering_symbol[actual + 1]
+      );
+      return runner.fail();
+    }
+    return true;
+  }
+
+  // A key of lower strength must be the full key up to the separator before
+  // the first level it leaves out.
+  bool test_sort_key_strength(
+    TestRunner &runner,
+    KeyBuilder &builder,
+    const CollationTest &t
+  ) {
+    std::string full = build_key(builder, t.source);
+    for (uint32_t strength = 1; strength < 4; strength++) {
+      std::string key = build_key(builder, t.source, strength);
+      bool ok =
+        key.size() < full.size() &&
+        full.compare(0, key.size(), key) == 0 &&
+        full[key.size()] == 0 &&
+        full[key.size() + 1] == 0;
+      if (!ok) {
+        printf(
+          "sort key: strength %u key of '%s' is not a prefix of the full key\n",
+          strength,
+          t.name.c_str()
+        );
+        return runner.fail();
+      }
+    }
+    return true;
+  }
+
+  bool test_sort_keys(const std::vector<CollationTest> &tests) {
+    TestRunner runner("Sort keys");
+
+    // Comparing two sort keys must give the same result as comparing the
+    // strings they were built from. Neighbouring test strings are similar
+    // enough to exercise every level.
+    KeyBuilder builder;
+    for (size_t i = 0, len = tests.size(); i < len; i++) {
+      const CollationTest &t = tests[i];
+      runner.start_test(t.name);
+
+      test_sort_key_pair(runner, builder, t, t);
+      test_sort_key_strength(runner, builder, t);
+      if (i > 0) {
+        test_sort_key_pair(runner, builder, t, tests[i - 1]);
+      }
+      if (i < len - 1) {
+        test_sort_key_pair(runner, builder, t, tests[i + 1]);
+      }
+
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+}
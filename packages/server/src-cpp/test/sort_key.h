@@ -0,0 +1,7 @@
+#pragma once
+
+#include "collate.h"
+
+namespace condict_test {
+  bool test_sort_keys(const std::vector<CollationTest> &tests);
+}
@@ -0,0 +1,149 @@
+#include "stats.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "common.h"
+#include "../uca/uca.h"
+#include "../uca/stats.h"
+
+namespace condict_test {
+  namespace stats = condict_uca::stats;
+
+  void compare(const std::string &a, const std::string &b) {
+    condict_uca::compare((int) a.size(), a.c_str(), (int) b.size(), b.c_str());
+  }
+
+  void expect(
+    TestRunner &runner,
+    const stats::Totals &totals,
+    stats::Counter counter,
+    uint64_t expected
+  ) {
+    uint64_t actual = totals.get(counter);
+    if (actual != expected) {
+      printf(
+        "%s: expected %llu, got %llu\n",
+        stats::counter_name(counter),
+        (unsigned long long) expected,
+        (unsigned long long) actual
+      );
+      runner.fail();
+    }
+  }
+
+  bool test_stats() {
+    TestRunner runner("Statistics");
+
+    runner.start_test("single comparison");
+    stats::reset();
+    compare("abc", "abd");
+    {
+      stats::Totals totals = stats::read();
+      expect(runner, totals, stats::Counter::COMPARISONS, 1);
+      expect(runner, totals, stats::Counter::BYTES, 6);
+      expect(runner, totals, stats::Counter::CODE_POINTS, 6);
+      expect(runner, totals, stats::Counter::SLOW_PATH, 0);
+      expect(runner, totals, stats::Counter::CONTRACTION_PROBES, 0);
+      if (totals.histogram[stats::histogram_bucket(6)] != 1) {
+        printf("histogram: expected one comparison of 6 code points\n");
+        runner.fail();
+      }
+    }
+    runner.end_test();
+
+    runner.start_test("contractions");
+    stats::reset();
+    // U+0438 U+0306 (й) is a contraction in the root collation. With U+0316
+    // in between, it becomes a discontiguous match.
+    compare("\xD0\xB8\xCC\x86", "\xD0\xB8\xCC\x96\xCC\x86");
+    {
+      stats::Totals totals = stats::read();
+      expect(runner, totals, stats::Counter::CODE_POINTS, 5);
+      expect(runner, totals, stats::Counter::CONTRACTION_PROBES, 2);
+      expect(runner, totals, stats::Counter::CONTRACTION_MATCHES, 2);
+      expect(runner, totals, stats::Counter::DISCONTIGUOUS_MATCHES, 1);
+      // Both contractions, including the U+0306 they consume.
+      expect(runner, totals, stats::Counter::SLOW_PATH, 4);
+    }
+    runner.end_test();
+
+    runner.start_test("threads");
+    stats::reset();
+    // The thread has exited by the time we read the totals, so its counters
+    // must have been kept.
+    std::thread thread([]() {
+      compare("a", "b");
+      compare("a", "c");
+    });
+    thread.join();
+    compare("a", "d");
+    expect(runner, stats::read(), stats::Counter::COMPARISONS, 3);
+    runner.end_test();
+
+    runner.start_test("measurement");
+    stats::reset();
+    {
+      stats::Measurement measurement;
+      compare("a", "b");
+      measurement.start();
+      // Comparisons on other threads are not measured.
+      std::thread thread([]() {
+        compare("a", "b");
+      });
+      thread.join();
+      compare("abc", "abd");
+      compare("a", "b");
+      if (!measurement.stop()) {
+        printf("measurement: could not stop\n");
+        runner.fail();
+      }
+      if (
+        measurement.comparison_count() != 2 ||
+        measurement.code_point_count() != 8
+      ) {
+        printf(
+          "measurement: expected 2 comparisons and 8 code points, "
+          "got %llu and %llu\n",
+          (unsigned long long) measurement.comparison_count(),
+          (unsigned long long) measurement.code_point_count()
+        );
+        runner.fail();
+      }
+      if (measurement.stop()) {
+        printf("measurement: stopped twice\n");
+        runner.fail();
+      }
+      // Comparisons are only timed while the measurement runs.
+      uint64_t nanoseconds =
+        stats::read().get(stats::Counter::MEASURED_NANOSECONDS);
+      compare("a", "b");
+      expect(
+        runner,
+        stats::read(),
+        stats::Counter::MEASURED_NANOSECONDS,
+        nanoseconds
+      );
+    }
+    runner.end_test();
+
+    runner.start_test("reset");
+    stats::reset();
+    {
+      stats::Totals totals = stats::read();
+      for (uint32_t i = 0; i < stats::COUNTER_COUNT; i++) {
+        expect(runner, totals, (stats::Counter) i, 0);
+      }
+      for (uint32_t i = 0; i < stats::HISTOGRAM_SIZE; i++) {
+        if (totals.histogram[i] != 0) {
+          printf("histogram: expected 0 in bucket %u\n", i);
+          runner.fail();
+        }
+      }
+    }
+    runner.end_test();
+
+    return runner.result();
+  }
+}
@@ -0,0 +1,384 @@
+#include "tailoring.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/cea.h"
+#include "../uca/tailoring.h"
+#include "../uca/uca.h"
+
+namespace condict_test {
+  namespace tailoring = condict_uca::tailoring;
+
+  struct OrderTest {
+    const char* rules;
+    // Strings in ascending order. Each string must sort strictly before the
+    // next one, unless `equal` is set, in which case all strings must be
+    // equal.
+    std::vector<const char*> strings;
+    bool equal;
+  };
+
+  struct ElementTest {
+    const char* rules;
+    const char* str;
+    // The number of collation elements the string should have.
+    uint32_t count;
+  };
+
+  struct ErrorTest {
+    const char* rules;
+    uint32_t offset;
+    const char* message;
+  };
+
+  const OrderTest order_tests[] = {
+    // Primary insertion after a single character.
+    {
+      "&n < ng <<< Ng <<< NG < ny",
+      { "n", "N", "na", "nz", "ng", "Ng", "NG", "nga", "ngz", "ny", "o" },
+      false,
+    },
+    // A tailored single character.
+    {
+      "&t < \xC3\xBE <<< \xC3\x9E", // þ, Þ
+      { "t", "ta", "tz", "\xC3\xBE", "\xC3\x9E", "\xC3\x9E" "a", "u" },
+      false,
+    },
+    // Several strings inserted at the same place keep their order.
+    { "&a < c < b", { "a", "az", "c", "b", "d" }, false },
+    // More than the root collation has room for after "a".
+    {
+      "&a < e < d < c < b <<< B",
+      { "a", "az", "e", "d", "c", "b", "B", "ba", "f" },
+      false,
+    },
+    // Secondary and tertiary relations.
+    // A secondary difference outweighs the tertiary difference of case, but
+    // a tertiary difference does not.
+    { "&e << f", { "e", "E", "f", "F", "g" }, false },
+    { "&e <<< f", { "e", "f", "E", "F", "g" }, false },
+    // A relation that is weaker than the previous one.
+    { "&a < x << y", { "a", "az", "x", "y", "b" }, false },
+    // Canonically equivalent strings are tailored the same way. Other case
+    // forms are not tailored unless listed.
+    { "&z < \xC3\xA4", { "\xC3\x84", "z", "zz", "\xC3\xA4" }, false },
+    { "&z < \xC3\xA4", { "\xC3\xA4", "a\xCC\x88" }, true },
+
+    // Identity.
+    { "&v = w", { "v", "w" }, true },
+    // Quoting, escapes and comments.
+    { "&a < '&' # comment\n", { "a", "az", "&", "b" }, false },
+    { "&\\u0061 < \\x", { "a", "x", "b" }, false },
+    // Untailored contractions in the root collation still work.
+    {
+      "&\xD0\xB5 < \xD1\x94", // е, є
+      { "\xD0\xB5", "\xD1\x94", "\xD0\xB6" }, // е, є, ж
+      false,
+    },
+    // Tailored jamo apply to precomposed Hangul syllables.
+    {
+      "&\xE1\x84\x82 < \xE1\x84\x80", // ᄂ, ᄀ
+      { "\xEB\x82\x98", "\xEA\xB0\x80", "\xEB\x8B\xA4" }, // 나, 가, 다
+      false,
+    },
+    // Tailored ideographs don't get implicit weights.
+    {
+      "&z < \xE4\xB8\x81", // 丁
+      { "z", "\xE4\xB8\x81", "\xE4\xB8\x80" }, // 丁, 一
+      false,
+    },
+  };
+
+  struct LocaleRules {
+    const char* name;
+    const char* rules;
+  };
+
+  const LocaleRules locale_rules[] = {
+#include "../uca/locale_rules.inc"
+  };
+
+  struct LocaleTest {
+    const char* locale;
+    // Strings in strictly ascending order.
+    std::vector<const char*> strings;
+  };
+
+  const LocaleTest locale_tests[] = {
+    { "de", { "a", "\xC3\xA4", "az", "b" } }, // ä
+    { "es", { "n", "nz", "\xC3\xB1", "\xC3\x91", "o" } }, // ñ Ñ
+    {
+      "sv",
+      {
+        "y", "Y", "\xC3\xBC", "\xC3\x9C", "z", "zz", // ü Ü
+        "\xC3\xA5", "\xC3\x85", "\xC3\xA4", "\xC3\x84", // å Å ä Ä
+        "\xC3\xA6", "\xC3\xB6", "\xC3\x96", "\xC3\xB8", // æ ö Ö ø
+      },
+    },
+    {
+      "tr",
+      {
+        "c", "cz", "\xC3\xA7", "\xC3\x87", "d", // ç Ç
+        "h", "hz", "\xC4\xB1", "I", "i", "\xC4\xB0", "j", // ı I i İ
+      },
+    },
+  };
+
+  const ElementTest element_tests[] = {
+    // Primary relations replace the last element.
+    { "&n < ng <<< Ng", "Ng", 1 },
+    { "&t < \xC3\xBE", "\xC3\xBE", 1 }, // þ
+    { "&ch < x", "x", 2 },
+    // Other relations add an element.
+    { "&e << f", "f", 2 },
+    { "&e << f <<< F", "F", 3 },
+    // Without room for a primary weight, a primary relation adds two.
+    { "&a < e < d < c < b", "b", 3 },
+  };
+
+  const ErrorTest error_tests[] = {
+    { "< a", 0, "expected '&' before first relation" },
+    { "&", 1, "expected a string" },
+    { "&a b", 3, "expected '&', '<' or '='" },
+    { "&a < 'b", 5, "unterminated quote" },
+    { "&a < \\", 5, "incomplete escape sequence" },
+    { "&a < \\u00", 5, "invalid escape sequence" },
+    { "&'-' < x", 5, "cannot tailor after a variable character" },
+  };
+
+  inline int sign(int value) {
+    return value < 0 ? -1 : value > 0 ? 1 : 0;
+  }
+
+  bool test_order(TestRunner &runner, const OrderTest &t) {
+    static const char* ordering_symbol[] = { "<", "==", ">" };
+
+    tailoring::CompileError error{0, nullptr};
+    const tailoring::Tailoring* tailoring = tailoring::acquire(
+      (int) strlen(t.rules),
+      t.rules,
+      error
+    );
+    if (!tailoring) {
+      printf(
+        "rules '%s': expected a tailoring, got error: %s\n",
+        t.rules,
+        error.message ? error.message : "(none)"
+      );
+      return runner.fail();
+    }
+
+    bool ok = true;
+    int expected = t.equal ? 0 : -1;
+    for (size_t i = 1; i < t.strings.size(); i++) {
+      const char* a = t.strings[i - 1];
+      const char* b = t.strings[i];
+      int actual = sign(condict_uca::compare_tailored(
+        tailoring,
+        (int) strlen(a),
+        a,
+        (int) strlen(b),
+        b
+      ));
+      if (actual != expected) {
+        printf(
+          "rules '%s': expected '%s' %s '%s', got %s\n",
+          t.rules,
+          a,
+          ordering_symbol[expected + 1],
+          b,
+          ordering_symbol[actual + 1]
+        );
+        ok = runner.fail();
+      }
+    }
+
+    tailoring::release(tailoring);
+    return ok;
+  }
+
+  bool test_elements(TestRunner &runner, const ElementTest &t) {
+    tailoring::CompileError error{0, nullptr};
+    const tailoring::Tailoring* tailoring = tailoring::acquire(
+      (int) strlen(t.rules),
+      t.rules,
+      error
+    );
+    if (!tailoring) {
+      printf(
+        "rules '%s': expected a tailoring, got error: %s\n",
+        t.rules,
+        error.message ? error.message : "(none)"
+      );
+      return runner.fail();
+    }
+
+    condict_uca::cea::ElementIter iter((int) strlen(t.str), t.str, tailoring);
+    condict_uca::cea::Element element;
+    uint32_t count = 0;
+    while (iter.next(element)) {
+      count++;
+    }
+    tailoring::release(tailoring);
+
+    if (count != t.count) {
+      printf(
+        "rules '%s': expected %u elements for '%s', got %u\n",
+        t.rules,
+        t.count,
+        t.str,
+        count
+      );
+      return runner.fail();
+    }
+    return true;
+  }
+
+  bool test_error(TestRunner &runner, const ErrorTest &t) {
+    tailoring::CompileError error{0, nullptr};
+    const tailoring::Tailoring* tailoring = tailoring::acquire(
+      (int) strlen(t.rules),
+      t.rules,
+      error
+    );
+    if (tailoring) {
+      tailoring::release(tailoring);
+      printf("rules '%s': expected an error\n", t.rules);
+      return runner.fail();
+    }
+    if (
+      !error.message ||
+      strcmp(error.message, t.message) != 0 ||
+      error.offset != t.offset
+    ) {
+      printf(
+        "rules '%s': expected '%s' at offset %u, got '%s' at offset %u\n",
+        t.rules,
+        t.message,
+        t.offset,
+        error.message ? error.message : "(none)",
+        error.offset
+      );
+      return runner.fail();
+    }
+    return true;
+  }
+
+  bool test_locale_data(TestRunner &runner, const LocaleRules &locale) {
+    // The precompiled tables must be exactly what the compiler produces from
+    // the rules. If not, locale_data.inc needs to be regenerated.
+    const tailoring::Tailoring* precompiled = tailoring::get_locale(locale.name);
+
+    tailoring::CompileError error{0, nullptr};
+    const tailoring::Tailoring* compiled = tailoring::acquire(
+      (int) strlen(locale.rules),
+      locale.rules,
+      error
+    );
+
+    bool ok = true;
+    if (!compiled || !precompiled) {
+      ok = compiled == precompiled;
+    } else {
+      ok =
+        compiled->contraction_count() == precompiled->contraction_count() &&
+        compiled->root_contraction_count() ==
+          precompiled->root_contraction_count() &&
+        compiled->cea_data_size() == precompiled->cea_data_size() &&
+        memcmp(
+          compiled->contractions(),
+          precompiled->contractions(),
+          compiled->contraction_count() *
+            sizeof(condict_uca::HashTableBucket<uint32_t>)
+        ) == 0 &&
+        memcmp(
+          compiled->cea_data(),
+          precompiled->cea_data(),
+          compiled->cea_data_size() * sizeof(uint16_t)
+        ) == 0;
+    }
+    tailoring::release(compiled);
+
+    if (!ok) {
+      printf(
+        "locale %s: precompiled data does not match the rules\n",
+        locale.name
+      );
+      return runner.fail();
+    }
+    return true;
+  }
+
+  bool test_locale_order(TestRunner &runner, const LocaleTest &t) {
+    const tailoring::Tailoring* tailoring = tailoring::get_locale(t.locale);
+
+    bool ok = true;
+    for (size_t i = 1; i < t.strings.size(); i++) {
+      const char* a = t.strings[i - 1];
+      const char* b = t.strings[i];
+      int actual = sign(condict_uca::compare_tailored(
+        tailoring,
+        (int) strlen(a),
+        a,
+        (int) strlen(b),
+        b
+      ));
+      if (actual != -1) {
+        printf("locale %s: expected '%s' < '%s'\n", t.locale, a, b);
+        ok = runner.fail();
+      }
+    }
+    return ok;
+  }
+
+  bool test_tailoring() {
+    TestRunner runner("Tailoring");
+
+    for (auto &t : order_tests) {
+      runner.start_test(t.rules);
+      test_order(runner, t);
+      runner.end_test();
+    }
+
+    for (auto &t : element_tests) {
+      runner.start_test(std::string("elements: ") + t.rules);
+      test_elements(runner, t);
+      runner.end_test();
+    }
+
+    for (auto &t : error_tests) {
+      runner.start_test(t.rules);
+      test_error(runner, t);
+      runner.end_test();
+    }
+
+    for (auto &locale : locale_rules) {
+      runner.start_test(std::string("locale data: ") + locale.name);
+      test_locale_data(runner, locale);
+      runner.end_test();
+    }
+
+    for (auto &t : locale_tests) {
+      runner.start_test(std::string("locale order: ") + t.locale);
+      test_locale_order(runner, t);
+      runner.end_test();
+    }
+
+    // Rules that don't tailor anything don't need a tailoring.
+
+    runner.start_test("empty rules");
+    tailoring::CompileError error{0, nullptr};
+    const char* empty = "  # nothing here\n";
+    if (tailoring::acquire((int) strlen(empty), empty, error) || error.message) {
+      printf("empty rules: expected no tailoring and no error\n");
+      runner.fail();
+    }
+    runner.end_test();
+
+    return runner.result();
+  }
+}
@@ -0,0 +1,264 @@
+#include "utf16.h"
+
+#include <cstdio>
+#include <string>
+
+#include "common.h"
+#include "../uca/uca.h"
+#include "../uca/utf16.h"
+#include "../uca/utf8.h"
+
+namespace condict_test {
+  using condict_uca::Encoding;
+  using Utf16Iter = condict_uca::utf16::CodePointIter;
+
+  constexpr uint32_t REPLACEMENT_CHAR = 0xFFFD;
+
+  // Appends code units to a string in the given byte order.
+  std::string to_bytes(const std::vector<uint32_t> &units, bool big_endian) {
+    std::string result;
+    for (uint32_t unit : units) {
+      char hi = (char) (unit >> 8);
+      char lo = (char) (unit & 0xFF);
+      result.push_back(big_endian ? hi : lo);
+      result.push_back(big_endian ? lo : hi);
+    }
+    return result;
+  }
+
+  // Converts valid code points to UTF-16 code units.
+  std::vector<uint32_t> to_units(const std::vector<uint32_t> &code_points) {
+    std::vector<uint32_t> result;
+    for (uint32_t cp : code_points) {
+      if (cp >= 0x10000) {
+        result.push_back(0xD800 | ((cp - 0x10000) >> 10));
+        result.push_back(0xDC00 | (cp & 0x3FF));
+      } else {
+        result.push_back(cp);
+      }
+    }
+    return result;
+  }
+
+  // Converts a UTF-8 string to UTF-16. The string must be valid.
+  std::string to_utf16(const std::string &utf8, bool big_endian) {
+    std::vector<uint32_t> code_points;
+    condict_uca::utf8::CodePointIter iter((int) utf8.size(), utf8.data());
+    uint32_t cp;
+    while (iter.next(cp)) {
+      code_points.push_back(cp);
+    }
+    return to_bytes(to_units(code_points), big_endian);
+  }
+
+  bool test_decode_utf16(
+    TestRunner &runner,
+    const std::string &source,
+    bool big_endian,
+    const std::vector<uint32_t> &expected
+  ) {
+    std::vector<uint32_t> actual;
+    Utf16Iter iter((int) source.size(), source.data(), big_endian);
+    while (true) {
+      uint32_t peeked = iter.peek();
+      uint32_t cp;
+      if (!iter.next(cp)) {
+        break;
+      }
+      if (peeked != cp) {
+        printf("peek returned '%04X', next returned '%04X'\n", peeked, cp);
+        return runner.fail();
+      }
+      actual.push_back(cp);
+    }
+    if (actual != expected) {
+      printf("next decoded different code points:");
+      for (uint32_t cp : actual) {
+        printf(" %04X", cp);
+      }
+      printf("\n");
+      return runner.fail();
+    }
+
+    actual.clear();
+    Utf16Iter batch_iter((int) source.size(), source.data(), big_endian);
+    uint32_t batch[3];
+    uint32_t count;
+    while ((count = batch_iter.next_batch(batch, 3)) > 0) {
+      actual.insert(actual.end(), batch, batch + count);
+    }
+    if (actual != expected) {
+      printf("next_batch decoded different code points\n");
+      return runner.fail();
+    }
+    return true;
+  }
+
+  // Decodes the code units in both byte orders, optionally followed by one
+  // stray byte.
+  void test_invalid(
+    TestRunner &runner,
+    const char* name,
+    const std::vector<uint32_t> &units,
+    bool odd_byte,
+    const std::vector<uint32_t> &expected
+  ) {
+    runner.start_test(name);
+    for (bool big_endian : {false, true}) {
+      std::string source = to_bytes(units, big_endian);
+      if (odd_byte) {
+        source.push_back('A');
+      }
+      test_decode_utf16(runner, source, big_endian, expected);
+    }
+    runner.end_test();
+  }
+
+  inline int sign(int value) {
+    return value < 0 ? -1 : value > 0 ? 1 : 0;
+  }
+
+  void test_same_order(
+    TestRunner &runner,
+    const std::string &a,
+    const std::string &b
+  ) {
+    int a_len = (int) a.size();
+    int b_len = (int) b.size();
+    int expected = sign(condict_uca::compare(a_len, a.data(), b_len, b.data()));
+    int expected_tb =
+      sign(condict_uca::compare_tb(a_len, a.data(), b_len, b.data()));
+
+    for (bool big_endian : {false, true}) {
+      Encoding encoding = big_endian ? Encoding::UTF16BE : Encoding::UTF16LE;
+      std::string a16 = to_utf16(a, big_endian);
+      std::string b16 = to_utf16(b, big_endian);
+      int a16_len = (int) a16.size();
+      int b16_len = (int) b16.size();
+
+      int actual = sign(condict_uca::compare(
+        a16_len, a16.data(),
+        b16_len, b16.data(),
+        encoding
+      ));
+      int actual_tb = sign(condict_uca::compare_tb(
+        a16_len, a16.data(),
+        b16_len, b16.data(),
+        encoding
+      ));
+      if (actual != expected || actual_tb != expected_tb) {
+        printf(
+          "'%s' vs '%s' (%s): expected %d/%d, got %d/%d\n",
+          a.c_str(),
+          b.c_str(),
+          big_endian ? "BE" : "LE",
+          expected,
+          expected_tb,
+          actual,
+          actual_tb
+        );
+        runner.fail();
+        return;
+      }
+    }
+  }
+
+  bool test_utf16_decoder(const std::vector<Utf8Test> &valid) {
+    TestRunner runner("UTF-16 decoder");
+
+    runner.start_test("empty");
+    test_decode_utf16(runner, "", false, {});
+    runner.end_test();
+
+    for (auto &t : valid) {
+      runner.start_test(t.name);
+      for (bool big_endian : {false, true}) {
+        std::string source = to_bytes(to_units(t.decoded), big_endian);
+        test_decode_utf16(runner, source, big_endian, t.decoded);
+      }
+      runner.end_test();
+    }
+
+    test_invalid(
+      runner,
+      "surrogate pair",
+      {0x61, 0xD83D, 0xDE00, 0x62},
+      false,
+      {0x61, 0x1F600, 0x62}
+    );
+    test_invalid(
+      runner,
+      "lone high surrogate",
+      {0x61, 0xD800, 0x62},
+      false,
+      {0x61, REPLACEMENT_CHAR, 0x62}
+    );
+    test_invalid(
+      runner,
+      "lone low surrogate",
+      {0x61, 0xDC00, 0x62},
+      false,
+      {0x61, REPLACEMENT_CHAR, 0x62}
+    );
+    test_invalid(
+      runner,
+      "high surrogate at end",
+      {0x61, 0xDBFF},
+      false,
+      {0x61, REPLACEMENT_CHAR}
+    );
+    test_invalid(
+      runner,
+      "reversed pair",
+      {0xDC00, 0xD800},
+      false,
+      {REPLACEMENT_CHAR, REPLACEMENT_CHAR}
+    );
+    test_invalid(
+      runner,
+      "high surrogate before pair",
+      {0xD800, 0xDBFF, 0xDFFF},
+      false,
+      {REPLACEMENT_CHAR, 0x10FFFF}
+    );
+    test_invalid(
+      runner,
+      "odd byte at end",
+      {0x61},
+      true,
+      {0x61, REPLACEMENT_CHAR}
+    );
+    test_invalid(
+      runner,
+      "high surrogate before odd byte",
+      {0xD800},
+      true,
+      {REPLACEMENT_CHAR, REPLACEMENT_CHAR}
+    );
+
+    runner.start_test("same order as UTF-8");
+    const char* strings[] = {
+      "",
+      "a",
+      "A",
+      "ab",
+      "b",
+      "\xC3\xA4",           // ä
+      "a\xCC\x88",          // a + combining diaeresis
+      "\xC3\xA5\xCC\xA3",   // å + combining dot below
+      "\xEA\xB0\x80",       // Hangul syllable GA
+      "\xF0\x9F\x98\x80",   // U+1F600
+      "\xF0\x90\x90\x80",   // U+10400 Deseret capital long I
+      "\xF0\x90\x90\xA8",   // U+10428 Deseret small long I
+      "l\xC2\xB7l",         // l·l
+    };
+    for (const char* a : strings) {
+      for (const char* b : strings) {
+        test_same_order(runner, a, b);
+      }
+    }
+    runner.end_test();
+
+    return runner.result();
+  }
+}
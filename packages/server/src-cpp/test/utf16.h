@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+
+#include "utf8.h"
+
+namespace condict_test {
+  // Tests the UTF-16 decoder on the code points of the valid UTF-8 tests,
+  // converted to UTF-16, and on invalid UTF-16. Also checks that strings
+  // compare the same in UTF-16 as in UTF-8.
+  bool test_utf16_decoder(const std::vector<Utf8Test> &valid);
+}
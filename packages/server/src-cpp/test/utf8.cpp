@@ -83,6 +83,26 @@ namespace condict_test {
     return true;
   }
 
+  // Checks that next_batch decodes the same code points.
+  bool test_decode_batches(
+    TestRunner &runner,
+    const std::string &source,
+    const std::vector<uint32_t> &expected
+  ) {
+    std::vector<uint32_t> actual;
+    CodePointIter iter((int) source.size(), source.c_str());
+    uint32_t batch[3];
+    uint32_t count;
+    while ((count = iter.next_batch(batch, 3)) > 0) {
+      actual.insert(actual.end(), batch, batch + count);
+    }
+    if (actual != expected) {
+      printf("next_batch decoded different code points\n");
+      return runner.fail();
+    }
+    return true;
+  }
+
   bool test_decode_empty(TestRunner &runner) {
     std::string source;
     std::vector<uint32_t> expected;
@@ -102,12 +122,14 @@ namespace condict_test {
     for (auto &t : valid) {
       runner.start_test(t.name);
       test_decode(runner, t.utf8, t.decoded);
+      test_decode_batches(runner, t.utf8, t.decoded);
       runner.end_test();
     }
 
     for (auto &t : invalid) {
       runner.start_test(t.name);
       test_decode(runner, t.utf8, t.decoded);
+      test_decode_batches(runner, t.utf8, t.decoded);
       runner.end_test();
     }
 
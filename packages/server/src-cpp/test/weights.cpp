@@ -0,0 +1,178 @@
+#include "weights.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "../uca/uca.h"
+#include "../uca/weights.h"
+
+namespace condict_test {
+  namespace weights = condict_uca::weights;
+
+  const char* const KERNEL_NAMES[] = { "scalar", "sse4.1", "avx2" };
+
+  // Written past the end of the output, to detect overruns.
+  const uint16_t SENTINEL = 0xBEEF;
+
+  std::vector<uint16_t> random_weights(std::mt19937 &rng, size_t len) {
+    // Plenty of zeros and repeated weights, as in real collation elements.
+    std::vector<uint16_t> result;
+    for (size_t i = 0; i < len; i++) {
+      result.push_back(rng() % 3 == 0 ? 0 : (uint16_t) (0x20 + rng() % 4));
+    }
+    return result;
+  }
+
+  void test_compress(
+    TestRunner &runner,
+    const weights::Kernels &kernels,
+    const std::vector<uint16_t> &src
+  ) {
+    std::vector<uint16_t> expected;
+    for (uint16_t w : src) {
+      if (w != 0) {
+        expected.push_back(w);
+      }
+    }
+
+    uint32_t count = (uint32_t) src.size();
+    std::vector<uint16_t> dest(count + 1, SENTINEL);
+    uint32_t n = kernels.compress(src.data(), count, dest.data());
+    if (n != expected.size()) {
+      printf("compress %u: expected %zu weights, got %u\n",
+        count,
+        expected.size(),
+        n
+      );
+      runner.fail();
+      return;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      if (dest[i] != expected[i]) {
+        printf("compress %u: wrong weight at %u\n", count, i);
+        runner.fail();
+        return;
+      }
+    }
+    if (dest[count] != SENTINEL) {
+      printf("compress %u: wrote past the end of the output\n", count);
+      runner.fail();
+    }
+  }
+
+  void test_mismatch(
+    TestRunner &runner,
+    const weights::Kernels &kernels,
+    const std::vector<uint16_t> &a
+  ) {
+    uint32_t count = (uint32_t) a.size();
+    uint32_t actual = kernels.mismatch(a.data(), a.data(), count);
+    if (actual != count) {
+      printf("mismatch %u: equal arrays, got %u\n", count, actual);
+      runner.fail();
+      return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      std::vector<uint16_t> b = a;
+      // Differ in the high byte only, which must still be found.
+      b[i] ^= 0x0100;
+      actual = kernels.mismatch(a.data(), b.data(), count);
+      if (actual != i) {
+        printf("mismatch %u: expected %u, got %u\n", count, i, actual);
+        runner.fail();
+        return;
+      }
+    }
+  }
+
+  std::string repeat(const char* s, size_t n) {
+    std::string result;
+    for (size_t i = 0; i < n; i++) {
+      result += s;
+    }
+    return result;
+  }
+
+  struct CompareTest {
+    std::string a;
+    std::string b;
+    int expected;
+  };
+
+  // Strings that are equal for well over one chunk, at one or more levels.
+  std::vector<CompareTest> long_compare_tests() {
+    std::string base = repeat("abc", 60);
+    std::string accents = repeat("a\xCC\x81" "bc", 60);
+    return {
+      { base, base, 0 },
+      { base + "a", base + "b", -1 },
+      { base + "b", base, 1 },
+      // Secondary difference after the primaries are exhausted.
+      { accents, base, 1 },
+      { base, accents, -1 },
+      // Tertiary difference near the end.
+      { base + "a", base + "A", -1 },
+      // Primary difference wins over an earlier secondary one.
+      { accents + "a", base + "b", -1 },
+      // A variable element only differs at the quaternary level, where its
+      // weight is lower than that of any regular element.
+      { base + "-" + base, base + base, -1 },
+    };
+  }
+
+  bool test_weight_kernels() {
+    TestRunner runner("Weight kernels");
+
+    const weights::Kernels saved = weights::active;
+    for (const char* name : KERNEL_NAMES) {
+      const weights::Kernels* kernels = weights::find_kernels(name);
+      if (!kernels) {
+        printf("Skipping %s kernels: not supported by this CPU\n", name);
+        continue;
+      }
+
+      // Lengths on either side of every vector width.
+      std::mt19937 rng(32);
+      runner.start_test(std::string(name) + " compress");
+      for (size_t len = 0; len <= 70; len++) {
+        test_compress(runner, *kernels, random_weights(rng, len));
+      }
+      runner.end_test();
+
+      runner.start_test(std::string(name) + " mismatch");
+      for (size_t len = 0; len <= 70; len++) {
+        test_mismatch(runner, *kernels, random_weights(rng, len));
+      }
+      runner.end_test();
+
+      runner.start_test(std::string(name) + " collation");
+      weights::use_kernels(*kernels);
+      for (auto &t : long_compare_tests()) {
+        int actual = condict_uca::compare(
+          (int) t.a.size(),
+          t.a.c_str(),
+          (int) t.b.size(),
+          t.b.c_str()
+        );
+        if (actual != t.expected) {
+          printf(
+            "compare(%zu bytes, %zu bytes): expected %d, got %d\n",
+            t.a.size(),
+            t.b.size(),
+            t.expected,
+            actual
+          );
+          runner.fail();
+        }
+      }
+      weights::use_kernels(saved);
+      runner.end_test();
+    }
+
+    return runner.result();
+  }
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+namespace condict_test {
+  bool test_weight_kernels();
+}
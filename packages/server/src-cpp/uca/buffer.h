@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace condict_uca {
+  // This class implements a contiguous, heap-allocated buffer that is meant to
+  // be reused: it only ever grows, and keeps its storage until it is destroyed.
+  // Objects that own one of these can be kept around between calls in order to
+  // avoid allocating memory every time they're used.
+  //
+  // The buffer does not keep track of how many elements are in use; that is up
+  // to the owner. Existing elements are preserved when the buffer grows.
+  //
+  // Due to the use of realloc and free, the element type *must not* have any
+  // kind of non-trivial constructor or destructor.
+  template<typename T>
+  class Buffer {
+  public:
+    inline Buffer() :
+      buf(nullptr),
+      cap(0)
+    { }
+
+    inline ~Buffer() {
+      free(this->buf);
+    }
+
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+    inline uint32_t capacity() const {
+      return this->cap;
+    }
+
+    // Ensures the buffer has room for at least `count` elements, and returns
+    // a pointer to the first element.
+    inline T* reserve(uint32_t count) {
+      if (count > this->cap) {
+        this->grow(count);
+      }
+      return this->buf;
+    }
+
+    inline T* data() {
+      return this->buf;
+    }
+
+    inline const T* data() const {
+      return this->buf;
+    }
+
+    inline T &operator[](uint32_t i) {
+      return this->buf[i];
+    }
+
+    inline const T &operator[](uint32_t i) const {
+      return this->buf[i];
+    }
+
+  private:
+    T* buf;
+    uint32_t cap;
+
+    void grow(uint32_t min_capacity) {
+      uint32_t new_capacity = this->cap > 0 ? this->cap : 16;
+      while (new_capacity < min_capacity) {
+        new_capacity *= 2;
+      }
+
+      T* new_buf = reinterpret_cast<T*>(
+        realloc(this->buf, new_capacity * sizeof(T))
+      );
+      if (!new_buf) {
+        // What else can we do? If we throw an exception, we *will* cause
+        // problems in non-C++ frames.
+        std::abort();
+      }
+      this->buf = new_buf;
+      this->cap = new_capacity;
+    }
+  };
+}
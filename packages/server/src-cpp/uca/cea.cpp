@@ -1,5 +1,16 @@
 #include "cea.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
 #include "hash_table.h"
+#include "numeric.h"
+#include "profile.h"
+#include "trie.h"
 
 namespace condict_uca {
   namespace cea {
@@ -7,6 +18,13 @@ namespace condict_uca {
 
     constexpr uint32_t IMPLICIT = 0;
 
+    // The collation tables in use, which may come from a data file. The shifts
+    // and masks are the compile-time constants from cea_data.inc; data files
+    // are required to match them.
+    inline const data::CollationTables &tables() {
+      return data::collation;
+    }
+
     inline bool is_variable(uint16_t level_1) {
       // The UCA specification says that all collation elements with primary
       // weights "from 1 to [the maximum variable primary weight]" are variable
@@ -17,7 +35,7 @@ namespace condict_uca {
       // which seems to be the sole exception to this otherwise infallible rule.
       // Since we implement the CLDR tailorings, there's a weird 2 here instead
       // of what would more naturally be 1.
-      return 2 <= level_1 && level_1 <= HIGHEST_VAR;
+      return 2 <= level_1 && level_1 <= tables().highest_var;
     }
 
     inline Element element(
@@ -32,32 +50,618 @@ namespace condict_uca {
 
     const Element IGNORED = { 0, 0, 0, 0 };
 
-    uint32_t lookup_simple_mapping(uint32_t cp) {
-      if (cp > LAST_ASSIGNED) {
+    // Looks up a code point in the tables as they are stored. Only used to
+    // build the root table; see RootTable below.
+    uint32_t lookup_stored_mapping(
+      const data::CollationTables &t,
+      uint32_t cp
+    ) {
+      if (cp > t.last_assigned) {
         return IMPLICIT;
       }
 
       uint16_t index2 = cp >> STAGE2_SHIFT;
-      uint16_t index1 = stage2[index2] | ((cp >> STAGE1_SHIFT) & STAGE1_MASK);
-      uint16_t index0 = stage1[index1] | (cp & CEA_MASK);
-      return cea_indices[index0];
+      uint16_t index1 = t.stage2[index2] | ((cp >> STAGE1_SHIFT) & STAGE1_MASK);
+      uint16_t index0 = t.stage1[index1] | (cp & CEA_MASK);
+      return t.cea_indices[index0];
     }
 
-    uint32_t resolve_contraction(NfdIter &str, uint32_t cp) {
-      using Bucket = const HashTableBucket<uint32_t>;
+    // A value in the root table, which describes the collation elements of
+    // a single code point:
+    //
+    // * Bit 31 is set if the code point starts a contraction.
+    // * If bit 30 is set, the code point has a single collation element, which
+    //   is stored inline: bits 0-15 contain the primary weight, bits 16-24 the
+    //   secondary weight and bits 25-29 the tertiary weight.
+    // * Otherwise, bits 0-15 contain an index into the root table's expansion
+    //   data and bits 16-20 the number of collation elements, which is 0 for
+    //   implicit weights. If bit 21 is set, the data contains only primary
+    //   weights, and every element has a secondary weight of 0x0020 and the
+    //   tertiary weight in bits 22-26. Otherwise, the data contains triples.
+    //
+    // Most code points have a single element, so most lookups never touch the
+    // expansion data. Many expansions only differ from their primary weights
+    // in case, so they only need one weight per element.
+    class RootEntry {
+    public:
+      static constexpr uint32_t STARTS_CONTRACTION = 0x80000000;
+      static constexpr uint32_t SINGLE = 0x40000000;
+      static constexpr uint32_t PRIMARIES_ONLY = 0x00200000;
 
-      // Root buckets are special: they always have a continuation (there are no
-      // contractions that match 1 code point, by definition), thus never have a
-      // value of their own. If we don't find a root bucket, we can bail early.
-      Bucket* b_cur = hash_find(
-        cp,
-        CONTRACTIONS_ROOT_SIZE,
-        contractions
-      );
-      if (!b_cur) {
-        return IMPLICIT;
+      static constexpr uint32_t MAX_LEVEL_2 = 0x1FF;
+      static constexpr uint32_t MAX_LEVEL_3 = 0x1F;
+
+      inline explicit RootEntry(uint32_t raw) : raw(raw) { }
+
+      static inline RootEntry single(
+        uint16_t level_1,
+        uint16_t level_2,
+        uint16_t level_3
+      ) {
+        return RootEntry(
+          SINGLE |
+          level_1 |
+          ((uint32_t) level_2 << 16) |
+          ((uint32_t) level_3 << 25)
+        );
+      }
+
+      static inline RootEntry expansion(
+        uint32_t idx,
+        uint32_t len,
+        bool primaries_only,
+        uint16_t level_3
+      ) {
+        return RootEntry(
+          idx |
+          (len << 16) |
+          (primaries_only ? PRIMARIES_ONLY | ((uint32_t) level_3 << 22) : 0)
+        );
+      }
+
+      inline uint32_t get_raw() const {
+        return this->raw;
+      }
+
+      inline bool starts_contraction() const {
+        return (this->raw & STARTS_CONTRACTION) != 0;
+      }
+
+      inline bool is_single() const {
+        return (this->raw & SINGLE) != 0;
+      }
+
+      inline bool is_implicit() const {
+        return (this->raw & (SINGLE | 0x001F0000)) == 0;
+      }
+
+      inline RawElement element() const {
+        RawElement e = {
+          (uint16_t) (this->raw & 0xFFFF),
+          (uint16_t) ((this->raw >> 16) & MAX_LEVEL_2),
+          (uint16_t) ((this->raw >> 25) & MAX_LEVEL_3),
+        };
+        return e;
+      }
+
+      inline uint32_t idx() const {
+        return this->raw & 0xFFFF;
+      }
+
+      inline uint32_t len() const {
+        return (this->raw >> 16) & 0x1F;
+      }
+
+      inline bool is_primaries_only() const {
+        return (this->raw & PRIMARIES_ONLY) != 0;
+      }
+
+      inline uint16_t level_3() const {
+        return (this->raw >> 22) & MAX_LEVEL_3;
+      }
+
+    private:
+      uint32_t raw;
+    };
+
+    // The collation elements of the next code point(s) in a string.
+    struct Elements {
+      // The number of collation elements, or 0 for implicit weights.
+      uint32_t len;
+      // If null, there is exactly one element, in `single`. If the elements
+      // are primaries only, each element has a secondary weight of 0x0020 and
+      // the tertiary weight `level_3`; otherwise, this points to triples.
+      const uint16_t* data;
+      bool primaries_only;
+      uint16_t level_3;
+      RawElement single;
+    };
+
+    const Elements IMPLICIT_ELEMENTS = { 0, nullptr, false, 0, { 0, 0, 0 } };
+
+    inline Elements from_index(Index index, const uint16_t* data) {
+      Elements e = {
+        index.len(),
+        data + index.idx(),
+        index.is_simple_l1(),
+        0x0002,
+        { 0, 0, 0 },
+      };
+      // A single element is handed out like one from the root table, without
+      // going through the pending elements.
+      if (e.len == 1) {
+        e.single = e.primaries_only
+          ? RawElement{ e.data[0], 0x0020, 0x0002 }
+          : RawElement{ e.data[0], e.data[1], e.data[2] };
+        e.data = nullptr;
+      }
+      return e;
+    }
+
+    // A range of code points whose implicit weights are computed the same way.
+    // The first weight is AAAA = a_base + (cp >> 15), or just a_base if
+    // a_per_block is 0. The second is BBBB = (cp - b_base) & 0x7FFF, which is
+    // always ORed with 0x8000.
+    struct ImplicitRange {
+      uint32_t first;
+      uint32_t last;
+      uint16_t a_base;
+      uint16_t a_per_block;
+      uint32_t b_base;
+    };
+
+    // The ranges with implicit weights of their own, in ascending order. Code
+    // points outside them are given the weights of unassigned code points,
+    // as described by the last entry, which matches everything.
+    //
+    // Taken from Blocks.txt, Unicode version 15.0.0:
+    //   4E00..9FFF; CJK Unified Ideographs
+    //   F900..FAFF; CJK Compatibility Ideographs
+    //
+    // And from PropList.txt, Unicode version 15.0.0:
+    //   3400..4DBF    ; Unified_Ideograph
+    //   4E00..9FFF    ; Unified_Ideograph  --- CJK Unified Ideographs
+    //   FA0E..FA0F    ; Unified_Ideograph  ‾|
+    //   FA11          ; Unified_Ideograph   |
+    //   FA13..FA14    ; Unified_Ideograph   |
+    //   FA1F          ; Unified_Ideograph    > CJK Compatibility Ideographs
+    //   FA21          ; Unified_Ideograph   |
+    //   FA23..FA24    ; Unified_Ideograph   |
+    //   FA27..FA29    ; Unified_Ideograph  _|
+    //   20000..2A6DF  ; Unified_Ideograph
+    //   2A700..2B739  ; Unified_Ideograph
+    //   2B740..2B81D  ; Unified_Ideograph
+    //   2B820..2CEA1  ; Unified_Ideograph
+    //   2CEB0..2EBE0  ; Unified_Ideograph
+    //   30000..3134A  ; Unified_Ideograph
+    //   31350..323AF  ; Unified_Ideograph
+    //
+    // CJK Unified Ideographs and the unified ideographs among the CJK
+    // Compatibility Ideographs use AAAA = FB40; other unified ideographs use
+    // FB80. Tangut, Nushu and Khitan Small Script have fixed AAAA values.
+    constexpr ImplicitRange IMPLICIT_RANGES[] = {
+      { 0x3400, 0x4DBF, 0xFB80, 0xFFFF, 0 },
+      { 0x4E00, 0x9FFF, 0xFB40, 0xFFFF, 0 },
+      { 0xFA0E, 0xFA0F, 0xFB40, 0xFFFF, 0 },
+      { 0xFA11, 0xFA11, 0xFB40, 0xFFFF, 0 },
+      { 0xFA13, 0xFA14, 0xFB40, 0xFFFF, 0 },
+      { 0xFA1F, 0xFA1F, 0xFB40, 0xFFFF, 0 },
+      { 0xFA21, 0xFA21, 0xFB40, 0xFFFF, 0 },
+      { 0xFA23, 0xFA24, 0xFB40, 0xFFFF, 0 },
+      { 0xFA27, 0xFA29, 0xFB40, 0xFFFF, 0 },
+      // Tangut and Tangut Components
+      { 0x17000, 0x18AFF, 0xFB00, 0, 0x17000 },
+      // Khitan Small Script
+      { 0x18B00, 0x18CFF, 0xFB02, 0, 0x18B00 },
+      // Tangut Supplement
+      { 0x18D00, 0x18D8F, 0xFB00, 0, 0x17000 },
+      // Nushu
+      { 0x1B170, 0x1B2FF, 0xFB01, 0, 0x1B170 },
+      { 0x20000, 0x2A6DF, 0xFB80, 0xFFFF, 0 },
+      { 0x2A700, 0x2B739, 0xFB80, 0xFFFF, 0 },
+      { 0x2B740, 0x2B81D, 0xFB80, 0xFFFF, 0 },
+      { 0x2B820, 0x2CEA1, 0xFB80, 0xFFFF, 0 },
+      { 0x2CEB0, 0x2EBE0, 0xFB80, 0xFFFF, 0 },
+      { 0x30000, 0x3134A, 0xFB80, 0xFFFF, 0 },
+      { 0x31350, 0x323AF, 0xFB80, 0xFFFF, 0 },
+      // Unassigned code points
+      { 0, 0xFFFFFFFF, 0xFBC0, 0xFFFF, 0 },
+    };
+
+    constexpr uint32_t IMPLICIT_RANGE_COUNT =
+      sizeof(IMPLICIT_RANGES) / sizeof(IMPLICIT_RANGES[0]);
+    constexpr uint32_t UNASSIGNED_RANGE = IMPLICIT_RANGE_COUNT - 1;
+
+    // The first code point in any of the ranges above, below which everything
+    // is unassigned.
+    constexpr uint32_t FIRST_IMPLICIT_RANGE = 0x3400;
+
+    // To find the range of a code point without searching, the code space is
+    // divided into pages of 4096 code points, and each page stores the index
+    // of the first range that doesn't end before the page.
+    constexpr uint32_t IMPLICIT_PAGE_SHIFT = 12;
+    constexpr uint32_t IMPLICIT_PAGE_COUNT =
+      (IMPLICIT_RANGES[UNASSIGNED_RANGE - 1].last >> IMPLICIT_PAGE_SHIFT) + 1;
+
+    struct ImplicitPages {
+      uint8_t first_range[IMPLICIT_PAGE_COUNT];
+    };
+
+    constexpr ImplicitPages make_implicit_pages() {
+      ImplicitPages pages{};
+      uint32_t range = 0;
+      for (uint32_t page = 0; page < IMPLICIT_PAGE_COUNT; page++) {
+        while (IMPLICIT_RANGES[range].last < page << IMPLICIT_PAGE_SHIFT) {
+          range++;
+        }
+        pages.first_range[page] = (uint8_t) range;
+      }
+      return pages;
+    }
+
+    constexpr ImplicitPages IMPLICIT_PAGES = make_implicit_pages();
+
+    // Finds the index of the implicit weight range that contains `cp`. Most
+    // pages contain at most one range, so the loop rarely runs more than once.
+    inline uint32_t find_implicit_range(uint32_t cp) {
+      uint32_t page = cp >> IMPLICIT_PAGE_SHIFT;
+      uint32_t i = page < IMPLICIT_PAGE_COUNT
+        ? IMPLICIT_PAGES.first_range[page]
+        : UNASSIGNED_RANGE;
+      while (cp > IMPLICIT_RANGES[i].last) {
+        i++;
+      }
+      return cp >= IMPLICIT_RANGES[i].first ? i : UNASSIGNED_RANGE;
+    }
+
+    inline void implicit_weights(
+      uint32_t range_index,
+      uint32_t cp,
+      uint16_t &a,
+      uint16_t &b
+    ) {
+      const ImplicitRange &range = IMPLICIT_RANGES[range_index];
+      a = (uint16_t) (range.a_base + ((cp >> 15) & range.a_per_block));
+      b = (uint16_t) (((cp - range.b_base) & 0x7FFF) | 0x8000);
+    }
+
+    void get_implicit_weights(uint32_t cp, uint16_t &a, uint16_t &b) {
+      implicit_weights(find_implicit_range(cp), cp, a, b);
+    }
+
+    // Layout of the jamo elements in the root table: all Ls, then all Vs,
+    // then all Ts. The first T is unused, as T index 0 means "no T".
+    constexpr uint32_t JAMO_V_START = nfd::hangul::L_COUNT;
+    constexpr uint32_t JAMO_T_START = JAMO_V_START + nfd::hangul::V_COUNT;
+    constexpr uint32_t JAMO_COUNT = JAMO_T_START + nfd::hangul::T_COUNT;
+
+    bool is_contraction_continuation(uint32_t cp);
+
+    // The lookup table for single code points in the root collation, which
+    // is built from the stored tables at startup. See trie.h and RootEntry.
+    class RootTable {
+    public:
+      explicit RootTable(const data::CollationTables &t) :
+        expansion_data(),
+        expansion_len(0),
+        expansion_keys(),
+        trie(
+          trie_last(t),
+          0,
+          [this, &t](uint32_t cp) { return this->encode(t, cp); }
+        ),
+        jamo(),
+        fast_hangul(false),
+        fast_implicit(),
+        number_lead_weight(0),
+        max_number_digits(0),
+        number_group_base(0)
+      {
+        // Only needed while building.
+        this->expansion_keys.clear();
+        this->init_jamo();
+        this->init_implicit();
+        this->init_numeric(t);
       }
 
+      inline RootEntry get(uint32_t cp) const {
+        return RootEntry(this->trie.get(cp));
+      }
+
+      inline Elements elements(RootEntry entry) const {
+        Elements e = IMPLICIT_ELEMENTS;
+        if (entry.is_single()) {
+          e.len = 1;
+          e.single = entry.element();
+        } else if (!entry.is_implicit()) {
+          e.len = entry.len();
+          e.data = this->expansion_data.data() + entry.idx();
+          e.primaries_only = entry.is_primaries_only();
+          e.level_3 = entry.level_3();
+        }
+        return e;
+      }
+
+      inline uint16_t first_primary(RootEntry entry) const {
+        return entry.is_single()
+          ? entry.element().level_1
+          : this->expansion_data[entry.idx()];
+      }
+
+      // Determines whether precomposed Hangul syllables can be given the
+      // elements of their jamo from `jamo_elements()`.
+      inline bool has_fast_hangul() const {
+        return this->fast_hangul;
+      }
+
+      // The elements of the conjoining jamo, in the order described for
+      // JAMO_COUNT.
+      inline const Element* jamo_elements() const {
+        return this->jamo;
+      }
+
+      // Determines whether the implicit weights of the code points in the
+      // specified range can be computed without looking them up.
+      inline bool is_fast_implicit(uint32_t range_index) const {
+        return this->fast_implicit[range_index];
+      }
+
+      // The primary weight of the first element of a number with no
+      // significant digits (that is, zero) in numeric mode. A number with
+      // `n` significant digits has the weight `number_lead() + n`.
+      inline uint16_t number_lead() const {
+        return this->number_lead_weight;
+      }
+
+      // The most significant digits a number can have in numeric mode, or 0
+      // if the tables leave no room for numeric weights.
+      inline uint32_t max_digits() const {
+        return this->max_number_digits;
+      }
+
+      // The weight of a group of digits with the value 0 in numeric mode.
+      inline uint16_t group_base() const {
+        return this->number_group_base;
+      }
+
+      inline uint32_t byte_size() const {
+        return
+          this->trie.byte_size() +
+          this->expansion_len * sizeof(uint16_t);
+      }
+
+    private:
+      Buffer<uint16_t> expansion_data;
+      uint32_t expansion_len;
+      // Maps expansion data to its index, so every sequence is stored once.
+      std::unordered_map<std::string, uint32_t> expansion_keys;
+      CollationTrie trie;
+      Element jamo[JAMO_COUNT];
+      bool fast_hangul;
+      bool fast_implicit[IMPLICIT_RANGE_COUNT];
+      uint16_t number_lead_weight;
+      uint32_t max_number_digits;
+      uint16_t number_group_base;
+
+      // Every jamo must have a single collation element with a non-variable
+      // primary weight, and must not be part of any contraction. Then each
+      // syllable has exactly the elements of its jamo, in order, and nothing
+      // before or after it can change them.
+      void init_jamo() {
+        using namespace nfd::hangul;
+
+        this->fast_hangul = true;
+        for (uint32_t i = 0; i < JAMO_COUNT; i++) {
+          if (i == JAMO_T_START) {
+            // No trailing consonant
+            this->jamo[i] = IGNORED;
+            continue;
+          }
+          uint32_t cp =
+            i < JAMO_V_START ? L_BASE + i :
+            i < JAMO_T_START ? V_BASE + (i - JAMO_V_START) :
+            T_BASE + (i - JAMO_T_START);
+          RootEntry entry = this->get(cp);
+          RawElement e = entry.element();
+          bool usable =
+            entry.is_single() &&
+            !entry.starts_contraction() &&
+            !is_contraction_continuation(cp) &&
+            e.level_1 != 0 &&
+            !is_variable(e.level_1);
+          if (!usable) {
+            this->fast_hangul = false;
+          }
+          this->jamo[i] = element(e.level_1, e.level_2, e.level_3, 0xFFFF);
+        }
+      }
+
+      // A range can skip the lookup if none of its code points have elements
+      // of their own or start a contraction. This is always the case with the
+      // data we ship, but a data file could in principle assign weights to
+      // some of them.
+      void init_implicit() {
+        for (uint32_t i = 0; i < UNASSIGNED_RANGE; i++) {
+          const ImplicitRange &range = IMPLICIT_RANGES[i];
+          bool fast = true;
+          for (uint32_t cp = range.first; cp <= range.last && fast; cp++) {
+            RootEntry entry = this->get(cp);
+            fast = entry.is_implicit() && !entry.starts_contraction();
+          }
+          this->fast_implicit[i] = fast;
+        }
+        // Unassigned code points are scattered all over the code space, and
+        // have to be looked up.
+        this->fast_implicit[UNASSIGNED_RANGE] = false;
+      }
+
+      // Numbers get primary weights that nothing else has. The first element
+      // of a number has a lead weight, which encodes the number of significant
+      // digits, so that longer numbers sort after shorter ones. The lead
+      // weights directly follow the weight of 9, which puts numbers after all
+      // other digits. The remaining elements encode NUMBER_GROUP_DIGITS digits
+      // each. They are only ever compared to the elements of another number
+      // with the same lead, so any weight will do that isn't variable.
+      //
+      // The data we ship has 255 unused weights after 9, which is enough for
+      // MAX_NUMBER_DIGITS. A data file may leave less room, and then numbers
+      // are split into shorter runs. Without any room, numeric mode does
+      // nothing.
+      void init_numeric(const data::CollationTables &t) {
+        RootEntry nine = this->get('9');
+        if (!nine.is_single()) {
+          return;
+        }
+        uint32_t lead = (uint32_t) nine.element().level_1 + 1;
+
+        // Find the next weight in use. Level 2 and 3 weights are included,
+        // which can only make the room smaller.
+        uint32_t next = 0x10000;
+        for (uint32_t i = 0; i < t.cea_data_len; i++) {
+          uint32_t w = t.cea_data[i];
+          if (w >= lead && w < next) {
+            next = w;
+          }
+        }
+        for (const ImplicitRange &range : IMPLICIT_RANGES) {
+          if (range.a_base >= lead && range.a_base < next) {
+            next = range.a_base;
+          }
+        }
+
+        uint32_t group_base = t.highest_var + 1;
+        uint32_t group_count = 1;
+        for (uint32_t i = 0; i < NUMBER_GROUP_DIGITS; i++) {
+          group_count *= 10;
+        }
+        if (
+          next - lead < 2 ||
+          lead <= t.highest_var ||
+          group_base + group_count > 0x10000
+        ) {
+          return;
+        }
+        this->number_lead_weight = (uint16_t) lead;
+        this->max_number_digits = std::min(next - lead - 1, MAX_NUMBER_DIGITS);
+        this->number_group_base = (uint16_t) group_base;
+      }
+
+      // Contractions may start with code points that have implicit weights,
+      // which must still be flagged.
+      static uint32_t trie_last(const data::CollationTables &t) {
+        uint32_t last = t.last_assigned;
+        for (uint32_t i = 0; i < t.contractions_root_size; i++) {
+          uint32_t key = t.contractions[i].key;
+          if (key != 0xFFFFFFFF && key > last) {
+            last = key;
+          }
+        }
+        return last;
+      }
+
+      uint32_t encode(const data::CollationTables &t, uint32_t cp) {
+        uint32_t raw = lookup_stored_mapping(t, cp);
+        RootEntry entry(0);
+        if (raw != IMPLICIT) {
+          entry = this->encode_index(Index(raw), t.cea_data);
+        }
+        uint32_t result = entry.get_raw();
+        if (hash_find(cp, t.contractions_root_size, t.contractions)) {
+          result |= RootEntry::STARTS_CONTRACTION;
+        }
+        return result;
+      }
+
+      RootEntry encode_index(Index index, const uint16_t* cea_data) {
+        const uint16_t* data = cea_data + index.idx();
+        uint32_t len = index.len();
+
+        if (index.is_simple_l1()) {
+          if (len == 1) {
+            return RootEntry::single(data[0], 0x0020, 0x0002);
+          }
+          uint32_t idx = this->add_expansion(data, len);
+          return RootEntry::expansion(idx, len, true, 0x0002);
+        }
+
+        if (
+          len == 1 &&
+          data[1] <= RootEntry::MAX_LEVEL_2 &&
+          data[2] <= RootEntry::MAX_LEVEL_3
+        ) {
+          return RootEntry::single(data[0], data[1], data[2]);
+        }
+
+        uint16_t level_3 = data[2];
+        bool primaries_only = level_3 <= RootEntry::MAX_LEVEL_3;
+        for (uint32_t i = 0; i < len && primaries_only; i++) {
+          primaries_only =
+            data[3 * i + 1] == 0x0020 &&
+            data[3 * i + 2] == level_3;
+        }
+        if (primaries_only) {
+          uint16_t primaries[data::MAX_EXPANSION_LENGTH];
+          for (uint32_t i = 0; i < len; i++) {
+            primaries[i] = data[3 * i];
+          }
+          uint32_t idx = this->add_expansion(primaries, len);
+          return RootEntry::expansion(idx, len, true, level_3);
+        }
+
+        uint32_t idx = this->add_expansion(data, 3 * len);
+        return RootEntry::expansion(idx, len, false, 0);
+      }
+
+      // Adds a sequence of weights to the expansion data, unless it's already
+      // there, and returns its index. The data file loader guarantees that the
+      // index fits in 16 bits.
+      uint32_t add_expansion(const uint16_t* values, uint32_t count) {
+        std::string key(
+          reinterpret_cast<const char*>(values),
+          count * sizeof(uint16_t)
+        );
+        auto existing = this->expansion_keys.find(key);
+        if (existing != this->expansion_keys.end()) {
+          return existing->second;
+        }
+
+        uint32_t idx = this->expansion_len;
+        uint16_t* dest = this->expansion_data.reserve(idx + count);
+        memcpy(dest + idx, values, count * sizeof(uint16_t));
+        this->expansion_len += count;
+        this->expansion_keys.emplace(std::move(key), idx);
+        return idx;
+      }
+    };
+
+    const RootTable &root_table() {
+      static const RootTable table(data::get().collation);
+      return table;
+    }
+
+    uint32_t table_size() {
+      return root_table().byte_size();
+    }
+
+    // Finds the longest contraction that starts with the code point of the
+    // root bucket `root`, which must be a bucket in the root of `table`.
+    //
+    // In the root collation, root buckets always have a continuation (there
+    // are no contractions that match 1 code point, by definition), thus never
+    // have a value of their own. Tailorings can remap single code points, so
+    // their root buckets may have values.
+    uint32_t resolve_contraction(
+      NfdIter &str,
+      const HashTableBucket<uint32_t>* root,
+      const HashTableBucket<uint32_t>* table,
+      stats::IterCounters &counters
+    ) {
+      using Bucket = const HashTableBucket<uint32_t>;
+
+      counters.contraction_probes++;
+
+      Bucket* b_cur = root;
+
       // In the Unicode data, there may be a contraction AB and an ABCD, but no
       // ABC. In our data, there will be an ABC with the value set to IMPLICIT,
       // to indicate that it has no value of its own. Here we record the value
@@ -66,7 +670,7 @@ namespace condict_uca {
       // Note: candidate_len is the length of the match *excluding* the first
       // character, which has already been consumed from str. It's the number
       // of *additional* characters we have to consume once we're done.
-      uint32_t candidate = 0;
+      uint32_t candidate = b_cur->value;
       uint32_t candidate_len = 0;
 
       // Let's start by finding a contiguous match. Just keep matching forward
@@ -77,7 +681,7 @@ namespace condict_uca {
         Bucket* b = hash_find(
           next_cp,
           b_cur->cont_count,
-          &contractions[b_cur->cont_idx]
+          &table[b_cur->cont_idx]
         );
         if (!b) {
           break;
@@ -161,10 +765,11 @@ namespace condict_uca {
             Bucket* b = hash_find(
               next_cp,
               b_cur->cont_count,
-              &contractions[b_cur->cont_idx]
+              &table[b_cur->cont_idx]
             );
             if (b) {
               // We found a discontiguous match!
+              counters.discontiguous_matches++;
               // To make sure this character is *not* matched later, we must
               // shift it back to match_end_idx. This will denormalize the string.
               str.shift_backwards(discontig_idx, match_end_idx);
@@ -188,58 +793,261 @@ namespace condict_uca {
       }
 
       if (candidate != IMPLICIT) {
+        if (candidate_len > 0) {
+          counters.contraction_matches++;
+          counters.code_points += candidate_len;
+        }
         str.skip(candidate_len);
       }
       return candidate;
     }
 
-    Index resolve_cea_index(NfdIter &str, uint32_t cp) {
-      uint32_t result = resolve_contraction(str, cp);
-      if (result == IMPLICIT) {
-        result = lookup_simple_mapping(cp);
+    // The set of code points that can occur anywhere *but* first in
+    // a contraction, sorted in ascending order.
+    class ContinuationSet {
+    public:
+      explicit ContinuationSet(const data::CollationTables &t) :
+        count(0),
+        cps()
+      {
+        this->cps.reserve(t.contractions_len);
+        // The root table comes first. Every other bucket is part of some
+        // continuation table.
+        for (
+          uint32_t i = t.contractions_root_size;
+          i < t.contractions_len;
+          i++
+        ) {
+          if (t.contractions[i].key != 0xFFFFFFFF) {
+            this->cps[this->count] = t.contractions[i].key;
+            this->count++;
+          }
+        }
+        uint32_t* begin = this->cps.data();
+        uint32_t* end = begin + this->count;
+        std::sort(begin, end);
+        this->count = (uint32_t)(std::unique(begin, end) - begin);
       }
-      return Index(result);
+
+      inline bool contains(uint32_t cp) const {
+        const uint32_t* begin = this->cps.data();
+        return std::binary_search(begin, begin + this->count, cp);
+      }
+
+    private:
+      uint32_t count;
+      Buffer<uint32_t> cps;
+    };
+
+    bool is_contraction_continuation(uint32_t cp) {
+      static const ContinuationSet set(tables());
+      return set.contains(cp);
     }
 
-    bool ElementIter::next(Element &result) {
-      if (this->buf.is_empty() && !this->scan_next()) {
-        result = IGNORED;
+    // Determines whether ElementIter can start over at the specified code point
+    // and produce the same collation elements for the rest of the string as it
+    // would have if it had started at the beginning. That is the case when:
+    //
+    // * The code point is a starter that decomposes to a starter, so canonical
+    //   reordering never moves anything across it.
+    // * It can't be part of a contraction that starts earlier. We also exclude
+    //   code points that start contractions, as the first element of such
+    //   a contraction could be anything.
+    // * Its first collation element has a primary weight. The elements of
+    //   ignorables depend on whether they follow a variable element, which we
+    //   wouldn't know.
+    bool is_safe_start(uint32_t cp) {
+      if (nfd::get_ccc(cp) != 0) {
+        return false;
+      }
+      uint32_t first = nfd::get_first_decomposed(cp);
+      if (first != cp && nfd::get_ccc(first) != 0) {
         return false;
       }
 
-      // At this point, we have some elements in the buffer. There is no
-      // code point that maps to zero collation elements.
-      result = this->buf.pop_start();
-      return true;
+      const RootTable &table = root_table();
+      RootEntry entry = table.get(first);
+      if (entry.starts_contraction() || is_contraction_continuation(first)) {
+        return false;
+      }
+
+      if (entry.is_implicit()) {
+        // Implicit weights always have a primary weight.
+        return true;
+      }
+      return table.first_primary(entry) != 0;
     }
 
-    bool ElementIter::scan_next() {
-      uint32_t cp;
-      if (!this->str.next(cp)) {
-        return false;
+    bool starts_contraction(uint32_t cp) {
+      return root_table().get(cp).starts_contraction();
+    }
+
+    bool is_variable_weight(uint16_t level_1) {
+      return is_variable(level_1);
+    }
+
+    // The primary weights that are in use in the root collation. Only used to
+    // build tailorings.
+    class PrimarySet {
+    public:
+      PrimarySet(const data::CollationTables &t, const RootTable &table) :
+        used(0x10000, false)
+      {
+        for (uint32_t i = 0; i < t.cea_indices_len; i++) {
+          this->add(t, t.cea_indices[i]);
+        }
+        for (uint32_t i = 0; i < t.contractions_len; i++) {
+          if (t.contractions[i].key != 0xFFFFFFFF) {
+            this->add(t, t.contractions[i].value);
+          }
+        }
+
+        // The second implicit weight is only ever compared to the second
+        // weight of another implicit, so only the first one counts.
+        for (const ImplicitRange &range : IMPLICIT_RANGES) {
+          uint32_t last = std::min(range.last, (uint32_t) 0x10FFFF);
+          uint32_t last_a = range.a_base + ((last >> 15) & range.a_per_block);
+          for (uint32_t a = range.a_base; a <= last_a && a < 0x10000; a++) {
+            this->used[a] = true;
+          }
+        }
+
+        if (table.max_digits() > 0) {
+          uint32_t lead = table.number_lead();
+          for (uint32_t i = 0; i <= table.max_digits(); i++) {
+            this->used[lead + i] = true;
+          }
+        }
       }
 
-      Index cea_index = resolve_cea_index(this->str, cp);
-      if (cea_index.is_implicit()) {
-        this->push_implicit(cp);
-      } else {
-        const uint16_t* data = &cea_data[cea_index.idx()];
-        uint32_t len = cea_index.len();
-        if (cea_index.is_simple_l1()) {
+      inline uint32_t next(uint16_t level_1) const {
+        uint32_t weight = (uint32_t) level_1 + 1;
+        while (weight < 0x10000 && !this->used[weight]) {
+          weight++;
+        }
+        return weight;
+      }
+
+    private:
+      std::vector<bool> used;
+
+      void add(const data::CollationTables &t, uint32_t raw) {
+        if (raw == IMPLICIT) {
+          return;
+        }
+        Index index(raw);
+        const uint16_t* data = t.cea_data + index.idx();
+        uint32_t stride = index.is_simple_l1() ? 1 : 3;
+        for (uint32_t i = 0; i < index.len(); i++) {
+          this->used[data[stride * i]] = true;
+        }
+      }
+    };
+
+    uint32_t next_primary(uint16_t level_1) {
+      static const PrimarySet set(tables(), root_table());
+      return set.next(level_1);
+    }
+
+    // Finds the collation elements of the next code point(s) in the string.
+    // The elements of contractions are found in the tailoring's or the root
+    // collation's contraction data; those of single code points, in the root
+    // table, unless they are tailored.
+    inline Elements resolve_elements(
+      NfdIter &str,
+      uint32_t cp,
+      const tailoring::Tailoring* tailoring,
+      stats::IterCounters &counters
+    ) {
+      const RootTable &table = root_table();
+
+      // Tailored strings take precedence over everything in the root
+      // collation, including root contractions.
+      if (tailoring) {
+        const HashTableBucket<uint32_t>* root = tailoring->find_start(cp);
+        if (root) {
+          uint32_t result = resolve_contraction(
+            str,
+            root,
+            tailoring->contractions(),
+            counters
+          );
+          if (result != IMPLICIT) {
+            return from_index(Index(result), tailoring->cea_data());
+          }
+          if (!tailoring->starts_root_contraction(root)) {
+            // No need to look for contractions again.
+            return table.elements(table.get(cp));
+          }
+        }
+      }
+
+      RootEntry entry = table.get(cp);
+      if (entry.starts_contraction()) {
+        const data::CollationTables &t = tables();
+        const HashTableBucket<uint32_t>* root = hash_find(
+          cp,
+          t.contractions_root_size,
+          t.contractions
+        );
+        uint32_t result = resolve_contraction(
+          str,
+          root,
+          t.contractions,
+          counters
+        );
+        if (result != IMPLICIT) {
+          return from_index(Index(result), t.cea_data);
+        }
+      }
+      return table.elements(entry);
+    }
+
+    uint32_t get_raw_elements(
+      int str_len,
+      const char* str,
+      Buffer<RawElement> &out,
+      uint32_t out_start
+    ) {
+      NfdIter iter(str_len, str);
+      uint32_t count = out_start;
+      // Only used to build tailorings, which are not counted.
+      stats::IterCounters counters{};
+
+      uint32_t cp;
+      while (iter.next(cp)) {
+        Elements elems = resolve_elements(iter, cp, nullptr, counters);
+        if (elems.len == 0) {
+          uint16_t a;
+          uint16_t b;
+          get_implicit_weights(cp, a, b);
+          RawElement* dest = out.reserve(count + 2) + count;
+          dest[0] = { a, 0x0020, 0x0002 };
+          dest[1] = { b, 0x0000, 0x0000 };
+          count += 2;
+          continue;
+        }
+
+        const uint16_t* data = elems.data;
+        uint32_t len = elems.len;
+        RawElement* dest = out.reserve(count + len) + count;
+        if (!data) {
+          dest[0] = elems.single;
+        } else if (elems.primaries_only) {
           for (uint32_t i = 0; i < len; i++) {
-            this->push_element(data[i], 0x0020, 0x0002);
+            dest[i] = { data[i], 0x0020, elems.level_3 };
           }
         } else {
-          len *= 3;
-          for (uint32_t i = 0; i < len; i += 3) {
-            this->push_element(data[i], data[i + 1], data[i + 2]);
+          for (uint32_t i = 0; i < len; i++) {
+            dest[i] = { data[3 * i], data[3 * i + 1], data[3 * i + 2] };
           }
         }
+        count += len;
       }
-      return true;
+      return count;
     }
 
-    void ElementIter::push_element(
+    inline Element ElementIter::make_element(
       uint16_t level_1,
       uint16_t level_2,
       uint16_t level_3
@@ -264,96 +1072,353 @@ namespace condict_uca {
         }
         this->last_variable = false;
       }
-      this->buf.push_end(elem);
+      return elem;
+    }
+
+    bool ElementIter::next(Element &result) {
+      if (this->next_batch(&result, 1) == 0) {
+        result = IGNORED;
+        return false;
+      }
+      return true;
     }
 
-    void ElementIter::push_implicit(uint32_t cp) {
-      uint16_t a;
-      uint16_t b;
+    uint32_t ElementIter::next_batch(Element* out, uint32_t n) {
+      CONDICT_UCA_PROFILE_STAGE(ELEMENTS);
+      uint32_t count = 0;
+      if (n == 0) {
+        return 0;
+      }
 
-      if (
-        0x17000 <= cp && cp <= 0x18AFF ||
-        0x18D00 <= cp && cp <= 0x18D8F
-      ) {
-        // Tangut, Tangut Components and Tangut Supplement
-        a = 0xFB00;
-        b = cp - 0x17000;
-      } else if (0x1B170 <= cp && cp <= 0x1B2FF) {
-        // Nushu
-        a = 0xFB01;
-        b = cp - 0x1B170;
-      } else if (0x18B00 <= cp && cp <= 0x18CFF) {
-        // Khitan Small Script
-        a = 0xFB02;
-        b = cp - 0x18B00;
-      } else {
-        // Compute the default, unassigned values first and overwrite later
-        // if we find a CJK ideograph. CJK ideographs use the same BBBB value
-        // as unassigned characters.
-        a = 0xFBC0 + (cp >> 15);
-        b = cp & 0x7FFF;
-
-        // Taken from Blocks.txt, Unicode version 15.0.0:
-        //   4E00..9FFF; CJK Unified Ideographs
-        //   F900..FAFF; CJK Compatibility Ideographs
-        //
-        // And from PropList.txt, Unicode version 15.0.0:
-        //   3400..4DBF    ; Unified_Ideograph
-        //   4E00..9FFF    ; Unified_Ideograph  --- CJK Unified Ideographs
-        //   FA0E..FA0F    ; Unified_Ideograph  ‾|
-        //   FA11          ; Unified_Ideograph   |
-        //   FA13..FA14    ; Unified_Ideograph   |
-        //   FA1F          ; Unified_Ideograph    > CJK Compatibility Ideographs
-        //   FA21          ; Unified_Ideograph   |
-        //   FA23..FA24    ; Unified_Ideograph   |
-        //   FA27..FA29    ; Unified_Ideograph  _|
-        //   20000..2A6DF  ; Unified_Ideograph
-        //   2A700..2B739  ; Unified_Ideograph
-        //   2B740..2B81D  ; Unified_Ideograph
-        //   2B820..2CEA1  ; Unified_Ideograph
-        //   2CEB0..2EBE0  ; Unified_Ideograph
-        //   30000..3134A  ; Unified_Ideograph
-        //   31350..323AF  ; Unified_Ideograph
-        //
-        // Lookup table for code points FA0E to FA29. This is within the block
-        // CJK_Compatibility_Ideographs, where only a subset of code points have
-        // Unified_Ideograph=True. The full block spans from F900 to FAFF.
-        static const bool is_cjk_compat_unified_ideograph[] = {
-          true,  true,  false, true,  false, true,  true,  false,
-          false, false, false, false, false, false, false, false,
-          false, true,  false, true,  false, true,  true,  false,
-          false, true,  true,  true,
-        };
+      // Finish whatever didn't fit last time. There can only be one of these.
+      if (this->held_len > 0) {
+        count = std::min(this->held_len, n);
+        for (uint32_t i = 0; i < count; i++) {
+          out[i] = this->held[i];
+        }
+        this->held_len -= count;
+        if (this->held_len > 0) {
+          this->held[0] = this->held[1];
+        }
+      } else if (this->pending_len > 0) {
+        count = this->take_pending(out, 0, n);
+      }
 
-        bool is_unified_cjk_or_compat =
-          0x4E00 <= cp && cp <= 0x9FFF ||
-          0xFA0E <= cp && cp <= 0xFA29 &&
-            is_cjk_compat_unified_ideograph[cp - 0xFA0E];
-        if (is_unified_cjk_or_compat) {
-          a = 0xFB40 + (cp >> 15);
-        } else {
-          bool is_other_unified_ideograph =
-            0x3400 <= cp && cp <= 0x4DBF ||
-            0x20000 <= cp && cp <= 0x2A6DF ||
-            0x2A700 <= cp && cp <= 0x2B739 ||
-            0x2B740 <= cp && cp <= 0x2B81D ||
-            0x2B820 <= cp && cp <= 0x2CEA1 ||
-            0x2CEB0 <= cp && cp <= 0x2EBE0 ||
-            0x30000 <= cp && cp <= 0x3134A ||
-            0x31350 <= cp && cp <= 0x323AF;
-          if (is_other_unified_ideograph) {
-            a = 0xFB80 + (cp >> 15);
+      const RootTable &table = root_table();
+      bool keep_hangul =
+        table.has_fast_hangul() &&
+        !(this->tailoring && this->tailoring->tailors_jamo());
+      bool numeric = this->numeric && table.max_digits() > 0;
+      // Counted locally, as `out` may alias the counters as far as the
+      // compiler knows.
+      uint32_t code_points = 0;
+
+      while (count < n) {
+        uint32_t cp;
+        bool has_next = keep_hangul
+          ? this->str.next_keep_hangul(cp)
+          : this->str.next(cp);
+        if (!has_next) {
+          break;
+        }
+        code_points++;
+
+        // Numbers take precedence over tailorings and contractions.
+        if (numeric) {
+          uint32_t digit = numeric::digit_value(cp);
+          if (digit != numeric::NOT_A_DIGIT) {
+            count = this->put_number(digit, out, count, n);
+            continue;
+          }
+        }
+
+        // Hangul syllables and ideographs are computed rather than looked up,
+        // unless the tailoring has something to say about them.
+        if (cp >= FIRST_IMPLICIT_RANGE) {
+          if (nfd::is_hangul_syllable(cp)) {
+            // Only returned by next_keep_hangul.
+            count = this->put_hangul(cp, out, count, n);
+            continue;
+          }
+          uint32_t range = find_implicit_range(cp);
+          if (
+            table.is_fast_implicit(range) &&
+            !(this->tailoring && this->tailoring->find_start(cp))
+          ) {
+            uint16_t a;
+            uint16_t b;
+            implicit_weights(range, cp, a, b);
+            count = this->put_implicit(a, b, out, count, n);
+            continue;
           }
         }
+
+        // Contractions count the extra code points they consume, which take
+        // the slow path too.
+        uint32_t consumed = this->counters.code_points;
+        uint32_t probes = this->counters.contraction_probes;
+        Elements elems = resolve_elements(
+          this->str,
+          cp,
+          this->tailoring,
+          this->counters
+        );
+        if (
+          elems.len == 0 ||
+          elems.data ||
+          this->counters.contraction_probes != probes
+        ) {
+          this->counters.slow_path +=
+            1 + this->counters.code_points - consumed;
+        }
+        if (elems.len == 0) {
+          uint16_t a;
+          uint16_t b;
+          get_implicit_weights(cp, a, b);
+          count = this->put_implicit(a, b, out, count, n);
+        } else if (!elems.data) {
+          const RawElement &e = elems.single;
+          out[count] = this->make_element(e.level_1, e.level_2, e.level_3);
+          count++;
+        } else {
+          this->pending_data = elems.data;
+          this->pending_len = elems.len;
+          this->pending_primaries_only = elems.primaries_only;
+          this->pending_level_3 = elems.level_3;
+          count = this->take_pending(out, count, n);
+        }
+      }
+      this->counters.code_points += code_points;
+      // There is no code point that maps to zero collation elements, so we
+      // only return less than `n` at the end of the string.
+      return count;
+    }
+
+    uint32_t ElementIter::take_pending(
+      Element* out,
+      uint32_t count,
+      uint32_t n
+    ) {
+      uint32_t take = std::min(this->pending_len, n - count);
+      const uint16_t* data = this->pending_data;
+      Element* dest = out + count;
+      if (this->pending_primaries_only) {
+        uint16_t level_3 = this->pending_level_3;
+        for (uint32_t i = 0; i < take; i++) {
+          dest[i] = this->make_element(data[i], 0x0020, level_3);
+        }
+        data += take;
+      } else {
+        for (uint32_t i = 0; i < take; i++) {
+          dest[i] = this->make_element(data[0], data[1], data[2]);
+          data += 3;
+        }
+      }
+      this->pending_data = data;
+      this->pending_len -= take;
+      return count + take;
+    }
+
+    bool ReverseElementIter::next(Element &result) {
+      if (this->buf.is_empty() && !this->scan_prev()) {
+        result = IGNORED;
+        return false;
+      }
+
+      result = this->buf.pop_end();
+      return true;
+    }
+
+    uint32_t ReverseElementIter::next_batch(Element* out, uint32_t n) {
+      uint32_t count = 0;
+      while (count < n) {
+        if (this->buf.is_empty() && !this->scan_prev()) {
+          break;
+        }
+        out[count] = this->buf.pop_end();
+        count++;
       }
+      return count;
+    }
+
+    void ReverseElementIter::add_stats(const stats::IterCounters &chunk) {
+      this->counters.code_points += chunk.code_points;
+      this->counters.slow_path += chunk.slow_path;
+      this->counters.contraction_probes += chunk.contraction_probes;
+      this->counters.contraction_matches += chunk.contraction_matches;
+      this->counters.discontiguous_matches += chunk.discontiguous_matches;
+    }
 
-      // The BBBB value is always ORed with this constant
-      b |= 0x8000;
+    bool ReverseElementIter::scan_prev() {
+      const char* chunk_end = this->str.position();
+
+      uint32_t cp;
+      if (!this->str.next(cp)) {
+        return false;
+      }
+      // Keep going until we find a safe starting point, or run out of string.
+      while (!is_safe_start(cp) && this->str.next(cp)) {
+        // Keep going
+      }
+      const char* chunk_start = this->str.position();
 
-      this->buf.push_end(element(a, 0x0020, 0x0002, 0xFFFF));
-      // Implicit BBBB has a level 4 weight of 0
-      this->buf.push_end(element(b, 0x0000, 0x0000, 0x0000));
+      ElementIter chunk((int)(chunk_end - chunk_start), chunk_start);
+      Element elems[16];
+      uint32_t count;
+      while ((count = chunk.next_batch(elems, 16)) > 0) {
+        for (uint32_t i = 0; i < count; i++) {
+          this->buf.push_end(elems[i]);
+        }
+      }
+      this->add_stats(chunk.stats());
+      // Every code point produces at least one collation element, so the
+      // buffer is never empty here.
+      return true;
+    }
+
+    uint32_t ElementIter::put_elements(
+      const Element* elems,
+      uint32_t len,
+      Element* out,
+      uint32_t count,
+      uint32_t n
+    ) {
+      uint32_t take = std::min(len, n - count);
+      for (uint32_t i = 0; i < take; i++) {
+        out[count + i] = elems[i];
+      }
+      for (uint32_t i = take; i < len; i++) {
+        this->held[i - take] = elems[i];
+      }
+      this->held_len = len - take;
+      return count + take;
+    }
+
+    uint32_t ElementIter::put_implicit(
+      uint16_t a,
+      uint16_t b,
+      Element* out,
+      uint32_t count,
+      uint32_t n
+    ) {
+      const Element elems[2] = {
+        element(a, 0x0020, 0x0002, 0xFFFF),
+        // Implicit BBBB has a level 4 weight of 0
+        element(b, 0x0000, 0x0000, 0x0000),
+      };
       this->last_variable = false;
+      return this->put_elements(elems, 2, out, count, n);
     }
+
+    uint32_t ElementIter::put_hangul(
+      uint32_t cp,
+      Element* out,
+      uint32_t count,
+      uint32_t n
+    ) {
+      using namespace nfd::hangul;
+
+      const Element* jamo = root_table().jamo_elements();
+      uint32_t s_index = cp - S_BASE;
+      uint32_t t_index = s_index % T_COUNT;
+      const Element elems[3] = {
+        jamo[s_index / N_COUNT],
+        jamo[JAMO_V_START + (s_index % N_COUNT) / T_COUNT],
+        jamo[JAMO_T_START + t_index],
+      };
+      // None of the jamo are variable.
+      this->last_variable = false;
+      return this->put_elements(elems, t_index > 0 ? 3 : 2, out, count, n);
+    }
+
+    uint32_t ElementIter::put_number(
+      uint32_t digit,
+      Element* out,
+      uint32_t count,
+      uint32_t n
+    ) {
+      const RootTable &table = root_table();
+      uint32_t max_digits = table.max_digits();
+      uint16_t group_base = table.group_base();
+
+      // Leading zeros are only counted. The weights of the significant digits
+      // are collected from number[1] onwards; the lead goes in number[0] once
+      // we know how many digits there are.
+      uint32_t zeros = 0;
+      uint32_t digits = 0;
+      uint32_t len = 1;
+      uint32_t group = 0;
+      while (true) {
+        if (digit == 0 && digits == 0) {
+          zeros++;
+        } else {
+          group = group * 10 + digit;
+          digits++;
+          if (digits % NUMBER_GROUP_DIGITS == 0) {
+            this->number[len] = (uint16_t) (group_base + group);
+            len++;
+            group = 0;
+          }
+          if (digits == max_digits) {
+            break;
+          }
+        }
+
+        // Only consume the next code point if it continues the number.
+        uint32_t next = numeric::digit_value(this->str.peek(0));
+        if (next == numeric::NOT_A_DIGIT) {
+          break;
+        }
+        this->str.skip(1);
+        this->counters.code_points++;
+        digit = next;
+      }
+      if (digits % NUMBER_GROUP_DIGITS != 0) {
+        this->number[len] = (uint16_t) (group_base + group);
+        len++;
+      }
+      if (digits == 0) {
+        // The last zero is the number itself.
+        zeros--;
+      }
+      this->number[0] = (uint16_t) (table.number_lead() + digits);
+
+      // A number is never variable, and all its elements share the level 3
+      // weight, which puts "7" before "07" before "007".
+      this->pending_data = this->number;
+      this->pending_len = len;
+      this->pending_primaries_only = true;
+      this->pending_level_3 = (uint16_t) (0x0002 + std::min(zeros, 0xFFFDu));
+      return this->take_pending(out, count, n);
+    }
+  }
+}
+
+namespace condict_uca {
+  namespace data {
+    constexpr CollationTables EMBEDDED_COLLATION = {
+      cea::HIGHEST_VAR,
+      cea::LAST_ASSIGNED,
+      cea::CEA_MASK,
+      cea::STAGE1_SHIFT,
+      cea::STAGE1_MASK,
+      cea::STAGE2_SHIFT,
+      cea::STAGE2_MASK,
+      cea::cea_data,
+      sizeof(cea::cea_data) / sizeof(cea::cea_data[0]),
+      cea::cea_indices,
+      sizeof(cea::cea_indices) / sizeof(cea::cea_indices[0]),
+      cea::stage1,
+      sizeof(cea::stage1) / sizeof(cea::stage1[0]),
+      cea::stage2,
+      sizeof(cea::stage2) / sizeof(cea::stage2[0]),
+      cea::contractions,
+      sizeof(cea::contractions) / sizeof(cea::contractions[0]),
+      cea::CONTRACTIONS_ROOT_SIZE,
+    };
+
+    const CollationTables embedded_collation = EMBEDDED_COLLATION;
+
+    CollationTables collation = EMBEDDED_COLLATION;
   }
 }
@@ -2,8 +2,11 @@
 
 #include <cstdint>
 
+#include "buffer.h"
 #include "tiny_queue.h"
 #include "nfd.h"
+#include "stats.h"
+#include "tailoring.h"
 
 // CEA: Collation Element Array
 //
@@ -48,32 +51,218 @@ namespace condict_uca {
       uint16_t level_4;
     };
 
+    // A collation element as it is stored in the tables, before the variable
+    // weighting has been applied.
+    struct RawElement {
+      uint16_t level_1;
+      uint16_t level_2;
+      uint16_t level_3;
+    };
+
+    // Determines whether any contraction in the root collation starts with
+    // the specified code point.
+    bool starts_contraction(uint32_t cp);
+
+    // Determines whether a primary weight belongs to a variable collation
+    // element (spaces, punctuation and most symbols).
+    bool is_variable_weight(uint16_t level_1);
+
+    // Gets the lowest primary weight above `level_1` that the root collation
+    // gives to anything, including implicit weights and the weights of numbers
+    // in numeric mode, or 0x10000 if there is none. Tailorings can use the
+    // weights in between without changing the order of anything else.
+    uint32_t next_primary(uint16_t level_1);
+
+    // The longest run of digits that is given a single numeric weight in
+    // numeric mode. Longer runs are split. See ElementIter.
+    constexpr uint32_t MAX_NUMBER_DIGITS = 254;
+    // The number of digits in each weight after the first.
+    constexpr uint32_t NUMBER_GROUP_DIGITS = 4;
+    constexpr uint32_t MAX_NUMBER_WEIGHTS =
+      1 + (MAX_NUMBER_DIGITS + NUMBER_GROUP_DIGITS - 1) / NUMBER_GROUP_DIGITS;
+
+    // Gets the size in bytes of the lookup table that is built from the root
+    // collation data at startup.
+    uint32_t table_size();
+
+    // Gets the raw collation elements of a string in the root collation, and
+    // writes them to `out`, starting at `out_start`. Returns the index after
+    // the last element that was written.
+    uint32_t get_raw_elements(
+      int str_len,
+      const char* str,
+      Buffer<RawElement> &out,
+      uint32_t out_start
+    );
+
     class ElementIter {
     public:
-      inline explicit ElementIter(NfdIter &&str) :
+      inline explicit ElementIter(
+        NfdIter &&str,
+        const tailoring::Tailoring* tailoring = nullptr
+      ) :
         str(str),
+        tailoring(tailoring),
         last_variable(false),
-        buf()
+        pending_data(nullptr),
+        pending_len(0),
+        pending_primaries_only(false),
+        pending_level_3(0),
+        held(),
+        held_len(0),
+        numeric(false),
+        counters()
       { }
 
-      inline ElementIter(int str_len, const char* str) :
-        str(str_len, str),
+      // If `log` is not null, the string's code points are appended to it in
+      // NFD. See nfd::CodePointLog. If `trusted_nfd` is true, the string must
+      // already be in NFD, and is not normalized again. See nfd::NfdIter.
+      // `encoding` is the encoding of the string data.
+      //
+      // If `numeric` is true, every run of decimal digits, of any script, gets
+      // elements that order it by numeric value, after every other digit-like
+      // character. Leading zeros only count at level 3, where "7" < "07".
+      inline ElementIter(
+        int str_len,
+        const char* str,
+        const tailoring::Tailoring* tailoring = nullptr,
+        nfd::CodePointLog* log = nullptr,
+        bool trusted_nfd = false,
+        Encoding encoding = Encoding::UTF8,
+        bool numeric = false
+      ) :
+        str(str_len, str, log, trusted_nfd, encoding),
+        tailoring(tailoring),
         last_variable(false),
-        buf()
+        pending_data(nullptr),
+        pending_len(0),
+        pending_primaries_only(false),
+        pending_level_3(0),
+        held(),
+        held_len(0),
+        numeric(numeric),
+        counters()
       { }
 
       bool next(Element &result);
 
+      // Reads up to `n` collation elements into `out`, and returns the number
+      // of elements read. Returns less than `n` only at the end of the string.
+      uint32_t next_batch(Element* out, uint32_t n);
+
+      // Gets the statistics of the elements read so far. See stats.h.
+      inline const stats::IterCounters &stats() const {
+        return this->counters;
+      }
+
     private:
       NfdIter str;
+      const tailoring::Tailoring* tailoring;
       bool last_variable;
-      TinyQueue<Element, 4> buf;
+      // The rest of an expansion that did not fit in the output of the last
+      // call to next_batch. This points into the collation data, so nothing
+      // is copied. See Elements in cea.cpp for the meaning of the fields.
+      const uint16_t* pending_data;
+      uint32_t pending_len;
+      bool pending_primaries_only;
+      uint16_t pending_level_3;
+      // The last elements of an implicit weight or a Hangul syllable, if they
+      // did not fit.
+      Element held[2];
+      uint32_t held_len;
+      bool numeric;
+      // The weights of the last number in numeric mode, which are handed out
+      // as pending elements.
+      uint16_t number[MAX_NUMBER_WEIGHTS];
+      stats::IterCounters counters;
+
+      // Writes pending elements to `out`, starting at `count`, until there are
+      // no more pending elements or `out` contains `n` elements. Returns the
+      // new element count.
+      uint32_t take_pending(Element* out, uint32_t count, uint32_t n);
 
-      bool scan_next();
+      // Applies variable weighting to an element.
+      Element make_element(
+        uint16_t level_1,
+        uint16_t level_2,
+        uint16_t level_3
+      );
+
+      // Writes up to 3 elements to `out`, starting at `count`, and holds on
+      // to those that don't fit. Returns the new element count.
+      uint32_t put_elements(
+        const Element* elems,
+        uint32_t len,
+        Element* out,
+        uint32_t count,
+        uint32_t n
+      );
+
+      // Writes the implicit weights AAAA and BBBB to `out`, as put_elements.
+      uint32_t put_implicit(
+        uint16_t a,
+        uint16_t b,
+        Element* out,
+        uint32_t count,
+        uint32_t n
+      );
+
+      // Writes the elements of a precomposed Hangul syllable to `out`, as
+      // put_elements. Only valid if the jamo have the root weights.
+      uint32_t put_hangul(
+        uint32_t cp,
+        Element* out,
+        uint32_t count,
+        uint32_t n
+      );
+
+      // Reads the rest of a run of digits that starts with `digit`, and
+      // writes the elements of its numeric value to `out`, as take_pending.
+      uint32_t put_number(
+        uint32_t digit,
+        Element* out,
+        uint32_t count,
+        uint32_t n
+      );
+    };
+
+    // An iterator that produces the collation elements of a string in reverse
+    // order. The elements are exactly those ElementIter would produce for the
+    // same string, last element first.
+    //
+    // Normalization and contractions can only be resolved from left to right,
+    // so this iterator walks the string backwards until it finds a code point
+    // at which ElementIter could safely have started over, without the text
+    // before it making a difference. It then runs ElementIter over the chunk
+    // from that code point to the end of the previous chunk, and hands out the
+    // elements of the chunk from the back. In most scripts, almost every base
+    // character is such a safe point, so chunks are tiny.
+    class ReverseElementIter {
+    public:
+      inline ReverseElementIter(int str_len, const char* str) :
+        str(str_len, str),
+        buf(),
+        counters()
+      { }
+
+      bool next(Element &result);
+
+      // Reads up to `n` collation elements into `out`, as ElementIter does.
+      uint32_t next_batch(Element* out, uint32_t n);
+
+      // Gets the statistics of the chunks read so far, as ElementIter does.
+      inline const stats::IterCounters &stats() const {
+        return this->counters;
+      }
+
+    private:
+      utf8::ReverseCodePointIter str;
+      TinyQueue<Element, 8> buf;
+      stats::IterCounters counters;
 
-      void push_element(uint16_t level_1, uint16_t level_2, uint16_t level_3);
+      bool scan_prev();
 
-      void push_implicit(uint32_t cp);
+      void add_stats(const stats::IterCounters &chunk);
     };
   }
 }
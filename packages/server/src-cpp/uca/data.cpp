@@ -0,0 +1,800 @@
+#include "data.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# ifndef WIN32_LEAN_AND_MEAN
+#   define WIN32_LEAN_AND_MEAN
+# endif
+# ifndef NOMINMAX
+#   define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "trie.h"
+
+namespace condict_uca {
+  namespace data {
+    // The versions that the embedded tables were generated from. Keep this in
+    // sync with cea_data.inc and comp_data.inc.
+    const char* const embedded_version = "Unicode 15.0.0; CLDR 42";
+
+    constexpr const char* ENV_VAR = "CONDICT_UCA_DATA";
+
+    constexpr uint32_t SECTION_ALIGN = 16;
+    constexpr uint32_t PARAM_COUNT = 8;
+    constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+    constexpr uint32_t MAX_CODE_POINT = 0x10FFFF;
+    // The tailoring compiler allocates primary weights from 0x0400 upwards,
+    // which must not be variable.
+    constexpr uint32_t MAX_HIGHEST_VAR = 0x03FF;
+    // Contraction tables are nested one level per code point in the longest
+    // contraction. This is far more than any real data needs.
+    constexpr uint32_t MAX_CONTRACTION_DEPTH = 32;
+
+    uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc) {
+      static const struct CrcTable {
+        uint32_t values[256];
+
+        CrcTable() : values() {
+          for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+              c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            this->values[i] = c;
+          }
+        }
+      } table;
+
+      crc ^= 0xFFFFFFFF;
+      for (size_t i = 0; i < len; i++) {
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+      }
+      return crc ^ 0xFFFFFFFF;
+    }
+
+    // Writing
+
+    class FileWriter {
+    public:
+      inline FileWriter() : sections(), payload() { }
+
+      template<typename T>
+      void add(SectionId id, const T* items, uint32_t count) {
+        uint32_t offset = (uint32_t) this->payload.size();
+        offset = (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+        size_t size = (size_t) count * sizeof(T);
+        this->payload.resize(offset + size, 0);
+        memcpy(this->payload.data() + offset, items, size);
+
+        SectionHeader section = { id, offset, count, (uint32_t) sizeof(T) };
+        this->sections.push_back(section);
+      }
+
+      bool write(const char* path, const char* version) {
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+        header.format = FILE_FORMAT;
+        header.byte_order = BYTE_ORDER_MARK;
+        header.section_count = (uint32_t) this->sections.size();
+        strncpy(header.version, version, VERSION_SIZE - 1);
+
+        // Section offsets are relative to the start of the payload so far;
+        // now make them relative to the start of the file.
+        uint32_t payload_start = (uint32_t) (
+          sizeof(FileHeader) + this->sections.size() * sizeof(SectionHeader)
+        );
+        payload_start =
+          (payload_start + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+        for (auto &section : this->sections) {
+          section.offset += payload_start;
+        }
+
+        std::vector<uint8_t> body(payload_start - sizeof(FileHeader), 0);
+        memcpy(
+          body.data(),
+          this->sections.data(),
+          this->sections.size() * sizeof(SectionHeader)
+        );
+        body.insert(body.end(), this->payload.begin(), this->payload.end());
+
+        header.file_size = (uint32_t) (sizeof(FileHeader) + body.size());
+        header.checksum = crc32(body.data(), body.size());
+
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+          return false;
+        }
+        bool ok =
+          fwrite(&header, sizeof(header), 1, file) == 1 &&
+          fwrite(body.data(), 1, body.size(), file) == body.size();
+        return fclose(file) == 0 && ok;
+      }
+
+      // The CRC-32 of the sections that have been added.
+      uint32_t payload_checksum() const {
+        return crc32(this->payload.data(), this->payload.size());
+      }
+
+    private:
+      std::vector<SectionHeader> sections;
+      std::vector<uint8_t> payload;
+    };
+
+    void add_sections(FileWriter &writer, const Tables &tables) {
+      const CollationTables &c = tables.collation;
+      const NormalizationTables &n = tables.normalization;
+
+      const uint32_t collation_params[PARAM_COUNT] = {
+        c.highest_var,
+        c.last_assigned,
+        c.cea_mask,
+        c.stage1_shift,
+        c.stage1_mask,
+        c.stage2_shift,
+        c.stage2_mask,
+        c.contractions_root_size,
+      };
+      writer.add(SectionId::COLLATION_PARAMS, collation_params, PARAM_COUNT);
+      writer.add(SectionId::CEA_DATA, c.cea_data, c.cea_data_len);
+      writer.add(SectionId::CEA_INDICES, c.cea_indices, c.cea_indices_len);
+      writer.add(SectionId::CEA_STAGE1, c.stage1, c.stage1_len);
+      writer.add(SectionId::CEA_STAGE2, c.stage2, c.stage2_len);
+      writer.add(SectionId::CONTRACTIONS, c.contractions, c.contractions_len);
+
+      const uint32_t normalization_params[PARAM_COUNT] = {
+        n.last_assigned,
+        n.comp_mask,
+        n.stage1_shift,
+        n.stage1_mask,
+        n.stage2_shift,
+        n.stage2_mask,
+        n.stage3_shift,
+        n.stage3_mask,
+      };
+      writer.add(
+        SectionId::NORMALIZATION_PARAMS,
+        normalization_params,
+        PARAM_COUNT
+      );
+      writer.add(SectionId::DECOMP_DATA, n.decomp_data, n.decomp_data_len);
+      writer.add(SectionId::COMP_DATA, n.comp_data, n.comp_data_len);
+      writer.add(SectionId::COMP_STAGE1, n.stage1, n.stage1_len);
+      writer.add(SectionId::COMP_STAGE2, n.stage2, n.stage2_len);
+      writer.add(SectionId::COMP_STAGE3, n.stage3, n.stage3_len);
+    }
+
+    bool write_file(const char* path, const Tables &tables) {
+      FileWriter writer;
+      add_sections(writer, tables);
+      return writer.write(path, tables.version);
+    }
+
+    // Loading
+
+    bool map_file(
+      const char* path,
+      const uint8_t* &data,
+      size_t &size,
+      const char* &error
+    ) {
+#ifdef _WIN32
+      HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+      );
+      if (file == INVALID_HANDLE_VALUE) {
+        error = "could not open file";
+        return false;
+      }
+      LARGE_INTEGER file_size;
+      if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        error = "could not determine file size";
+        return false;
+      }
+      HANDLE mapping = CreateFileMappingA(
+        file,
+        nullptr,
+        PAGE_READONLY,
+        0,
+        0,
+        nullptr
+      );
+      CloseHandle(file);
+      if (!mapping) {
+        error = "could not map file";
+        return false;
+      }
+      void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      // The view keeps the mapping alive.
+      CloseHandle(mapping);
+      if (!view) {
+        error = "could not map file";
+        return false;
+      }
+      data = reinterpret_cast<const uint8_t*>(view);
+      size = (size_t) file_size.QuadPart;
+      return true;
+#else
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) {
+        error = "could not open file";
+        return false;
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        error = "could not determine file size";
+        return false;
+      }
+      void* view = mmap(
+        nullptr,
+        (size_t) st.st_size,
+        PROT_READ,
+        MAP_SHARED,
+        fd,
+        0
+      );
+      // The mapping stays valid after the file is closed.
+      close(fd);
+      if (view == MAP_FAILED) {
+        error = "could not map file";
+        return false;
+      }
+      data = reinterpret_cast<const uint8_t*>(view);
+      size = (size_t) st.st_size;
+      return true;
+#endif
+    }
+
+    void unmap_file(const uint8_t* data, size_t size) {
+#ifdef _WIN32
+      (void) size;
+      UnmapViewOfFile(data);
+#else
+      munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+
+    // Reads and validates the contents of a mapped data file.
+    class FileReader {
+    public:
+      inline FileReader(const uint8_t* data, size_t size) :
+        data(data),
+        size(size),
+        sections(nullptr),
+        section_count(0),
+        error(nullptr)
+      { }
+
+      bool read(Tables &result);
+
+      inline const char* get_error() const {
+        return this->error;
+      }
+
+    private:
+      const uint8_t* data;
+      size_t size;
+      const SectionHeader* sections;
+      uint32_t section_count;
+      const char* error;
+
+      inline bool fail(const char* message) {
+        this->error = message;
+        return false;
+      }
+
+      bool read_header(Tables &result);
+
+      template<typename T>
+      bool read_section(SectionId id, const T* &items, uint32_t &count);
+
+      bool read_params(SectionId id, uint32_t (&params)[PARAM_COUNT]);
+
+      bool read_collation(CollationTables &result);
+
+      bool read_normalization(NormalizationTables &result);
+
+      bool check_cea_index(const CollationTables &tables, uint32_t raw);
+
+      bool check_expansion_size(const CollationTables &tables);
+
+      bool check_contraction_table(
+        const CollationTables &tables,
+        uint32_t start,
+        uint32_t count,
+        uint32_t depth
+      );
+    };
+
+    bool FileReader::read(Tables &result) {
+      return
+        this->read_header(result) &&
+        this->read_collation(result.collation) &&
+        this->read_normalization(result.normalization);
+    }
+
+    bool FileReader::read_header(Tables &result) {
+      if (this->size < sizeof(FileHeader)) {
+        return this->fail("file is too small");
+      }
+      const FileHeader* header =
+        reinterpret_cast<const FileHeader*>(this->data);
+      if (memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        return this->fail("not a collation data file");
+      }
+      if (header->byte_order != BYTE_ORDER_MARK) {
+        return this->fail("wrong byte order");
+      }
+      if (header->format != FILE_FORMAT) {
+        return this->fail("unsupported format version");
+      }
+      if (header->file_size != this->size) {
+        return this->fail("file size does not match header");
+      }
+      uint32_t checksum = crc32(
+        this->data + sizeof(FileHeader),
+        this->size - sizeof(FileHeader)
+      );
+      if (checksum != header->checksum) {
+        return this->fail("checksum mismatch");
+      }
+
+      uint64_t sections_end =
+        sizeof(FileHeader) +
+        (uint64_t) header->section_count * sizeof(SectionHeader);
+      if (sections_end > this->size) {
+        return this->fail("section headers out of bounds");
+      }
+      this->sections = reinterpret_cast<const SectionHeader*>(
+        this->data + sizeof(FileHeader)
+      );
+      this->section_count = header->section_count;
+
+      memcpy(result.version, header->version, VERSION_SIZE);
+      result.version[VERSION_SIZE - 1] = '\0';
+      return true;
+    }
+
+    template<typename T>
+    bool FileReader::read_section(
+      SectionId id,
+      const T* &items,
+      uint32_t &count
+    ) {
+      for (uint32_t i = 0; i < this->section_count; i++) {
+        const SectionHeader &section = this->sections[i];
+        if (section.id != id) {
+          continue;
+        }
+        if (section.item_size != sizeof(T)) {
+          return this->fail("section has the wrong item size");
+        }
+        if (section.offset % SECTION_ALIGN != 0) {
+          return this->fail("section is misaligned");
+        }
+        uint64_t end =
+          (uint64_t) section.offset + (uint64_t) section.count * sizeof(T);
+        if (end > this->size) {
+          return this->fail("section out of bounds");
+        }
+        items = reinterpret_cast<const T*>(this->data + section.offset);
+        count = section.count;
+        return true;
+      }
+      return this->fail("missing section");
+    }
+
+    bool FileReader::read_params(
+      SectionId id,
+      uint32_t (&params)[PARAM_COUNT]
+    ) {
+      const uint32_t* items;
+      uint32_t count;
+      if (!this->read_section(id, items, count)) {
+        return false;
+      }
+      if (count != PARAM_COUNT) {
+        return this->fail("wrong number of table parameters");
+      }
+      memcpy(params, items, sizeof(params));
+      return true;
+    }
+
+    bool FileReader::read_collation(CollationTables &result) {
+      uint32_t params[PARAM_COUNT];
+      if (!this->read_params(SectionId::COLLATION_PARAMS, params)) {
+        return false;
+      }
+      result.highest_var = params[0];
+      result.last_assigned = params[1];
+      result.cea_mask = params[2];
+      result.stage1_shift = params[3];
+      result.stage1_mask = params[4];
+      result.stage2_shift = params[5];
+      result.stage2_mask = params[6];
+      result.contractions_root_size = params[7];
+
+      const CollationTables &embedded = embedded_collation;
+      if (
+        result.cea_mask != embedded.cea_mask ||
+        result.stage1_shift != embedded.stage1_shift ||
+        result.stage1_mask != embedded.stage1_mask ||
+        result.stage2_shift != embedded.stage2_shift ||
+        result.stage2_mask != embedded.stage2_mask
+      ) {
+        return this->fail("collation table layout does not match");
+      }
+      if (result.highest_var > MAX_HIGHEST_VAR) {
+        return this->fail("highest variable weight is too high");
+      }
+      if (result.last_assigned > CollationTrie::MAX_CODE_POINT) {
+        return this->fail("last assigned code point is out of range");
+      }
+
+      if (
+        !this->read_section(
+          SectionId::CEA_DATA,
+          result.cea_data,
+          result.cea_data_len
+        ) ||
+        !this->read_section(
+          SectionId::CEA_INDICES,
+          result.cea_indices,
+          result.cea_indices_len
+        ) ||
+        !this->read_section(
+          SectionId::CEA_STAGE1,
+          result.stage1,
+          result.stage1_len
+        ) ||
+        !this->read_section(
+          SectionId::CEA_STAGE2,
+          result.stage2,
+          result.stage2_len
+        ) ||
+        !this->read_section(
+          SectionId::CONTRACTIONS,
+          result.contractions,
+          result.contractions_len
+        )
+      ) {
+        return false;
+      }
+
+      // Every lookup has to stay within the tables, no matter what the input
+      // is. The stages are trimmed and overlap, so the simplest way to be sure
+      // is to do every lookup that cea.cpp can do.
+      for (uint32_t cp = 0; cp <= result.last_assigned; cp++) {
+        uint32_t index2 = cp >> result.stage2_shift;
+        if (index2 >= result.stage2_len) {
+          return this->fail("collation stage 2 table is too short");
+        }
+        uint32_t index1 =
+          result.stage2[index2] |
+          ((cp >> result.stage1_shift) & result.stage1_mask);
+        if (index1 >= result.stage1_len) {
+          return this->fail("collation stage 2 index out of bounds");
+        }
+        uint32_t index0 = result.stage1[index1] | (cp & result.cea_mask);
+        if (index0 >= result.cea_indices_len) {
+          return this->fail("collation stage 1 index out of bounds");
+        }
+      }
+      for (uint32_t i = 0; i < result.cea_indices_len; i++) {
+        if (!this->check_cea_index(result, result.cea_indices[i])) {
+          return false;
+        }
+      }
+      if (!this->check_expansion_size(result)) {
+        return false;
+      }
+
+      uint32_t root_size = result.contractions_root_size;
+      if (root_size == 0 || root_size > 0xFFFF) {
+        return this->fail("invalid contraction table size");
+      }
+      for (uint32_t i = 0; i < root_size && i < result.contractions_len; i++) {
+        uint32_t key = result.contractions[i].key;
+        if (key != EMPTY_KEY && key > CollationTrie::MAX_CODE_POINT) {
+          return this->fail("contraction starts with invalid code point");
+        }
+      }
+      return this->check_contraction_table(result, 0, root_size, 0);
+    }
+
+    bool FileReader::check_expansion_size(const CollationTables &tables) {
+      // This mirrors RootTable::encode_index() in cea.cpp, except that it
+      // ignores the savings from primaries-only expansions, and so gives an
+      // upper bound on the size of the root table's expansion data.
+      std::vector<uint32_t> indices(
+        tables.cea_indices,
+        tables.cea_indices + tables.cea_indices_len
+      );
+      std::sort(indices.begin(), indices.end());
+      auto end = std::unique(indices.begin(), indices.end());
+
+      uint64_t size = 0;
+      for (auto it = indices.begin(); it != end; ++it) {
+        uint32_t raw = *it;
+        if (raw == 0) {
+          continue;
+        }
+        // See cea::Index for the format.
+        uint32_t idx = raw & 0xFFFFFF;
+        uint32_t len = (raw >> 24) & 0x7F;
+        bool simple = (raw >> 31) == 1;
+        if (len > MAX_EXPANSION_LENGTH) {
+          return this->fail("expansion is too long");
+        }
+        if (len == 1) {
+          const uint16_t* data = tables.cea_data + idx;
+          if (simple || (data[1] <= 0x1FF && data[2] <= 0x1F)) {
+            // Stored inline.
+            continue;
+          }
+        }
+        size += simple ? len : 3 * len;
+      }
+      if (size > MAX_EXPANSION_DATA) {
+        return this->fail("too much expansion data");
+      }
+      return true;
+    }
+
+    bool FileReader::check_cea_index(
+      const CollationTables &tables,
+      uint32_t raw
+    ) {
+      if (raw == 0) {
+        // Implicit weights.
+        return true;
+      }
+      // See cea::Index for the format.
+      uint32_t idx = raw & 0xFFFFFF;
+      uint32_t len = (raw >> 24) & 0x7F;
+      uint32_t stride = (raw >> 31) == 1 ? 1 : 3;
+      if (len == 0 || (uint64_t) idx + len * stride > tables.cea_data_len) {
+        return this->fail("collation element index out of bounds");
+      }
+      return true;
+    }
+
+    bool FileReader::check_contraction_table(
+      const CollationTables &tables,
+      uint32_t start,
+      uint32_t count,
+      uint32_t depth
+    ) {
+      if (depth > MAX_CONTRACTION_DEPTH) {
+        return this->fail("contraction tables nested too deeply");
+      }
+      if (count == 0 || (uint64_t) start + count > tables.contractions_len) {
+        return this->fail("contraction table out of bounds");
+      }
+
+      const HashTableBucket<uint32_t>* buckets = tables.contractions + start;
+      for (uint32_t i = 0; i < count; i++) {
+        // Every chain must stay inside the table and end, or hash_find()
+        // would read out of bounds or never return.
+        uint32_t index = i;
+        uint32_t steps = 0;
+        while (buckets[index].next_offset != 0) {
+          int64_t next = (int64_t) index + buckets[index].next_offset;
+          if (next < 0 || next >= count) {
+            return this->fail("contraction chain out of bounds");
+          }
+          index = (uint32_t) next;
+          if (++steps > count) {
+            return this->fail("contraction chain does not end");
+          }
+        }
+
+        const HashTableBucket<uint32_t> &bucket = buckets[i];
+        if (bucket.key == EMPTY_KEY) {
+          continue;
+        }
+        if (!this->check_cea_index(tables, bucket.value)) {
+          return false;
+        }
+        if (
+          bucket.cont_count != 0 &&
+          !this->check_contraction_table(
+            tables,
+            bucket.cont_idx,
+            bucket.cont_count,
+            depth + 1
+          )
+        ) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool FileReader::read_normalization(NormalizationTables &result) {
+      uint32_t params[PARAM_COUNT];
+      if (!this->read_params(SectionId::NORMALIZATION_PARAMS, params)) {
+        return false;
+      }
+      result.last_assigned = params[0];
+      result.comp_mask = params[1];
+      result.stage1_shift = params[2];
+      result.stage1_mask = params[3];
+      result.stage2_shift = params[4];
+      result.stage2_mask = params[5];
+      result.stage3_shift = params[6];
+      result.stage3_mask = params[7];
+
+      const NormalizationTables &embedded = embedded_normalization;
+      if (
+        result.comp_mask != embedded.comp_mask ||
+        result.stage1_shift != embedded.stage1_shift ||
+        result.stage1_mask != embedded.stage1_mask ||
+        result.stage2_shift != embedded.stage2_shift ||
+        result.stage2_mask != embedded.stage2_mask ||
+        result.stage3_shift != embedded.stage3_shift ||
+        result.stage3_mask != embedded.stage3_mask
+      ) {
+        return this->fail("normalization table layout does not match");
+      }
+      if (result.last_assigned > NormalizationTrie::MAX_CODE_POINT) {
+        return this->fail("last assigned code point is out of range");
+      }
+
+      if (
+        !this->read_section(
+          SectionId::DECOMP_DATA,
+          result.decomp_data,
+          result.decomp_data_len
+        ) ||
+        !this->read_section(
+          SectionId::COMP_DATA,
+          result.comp_data,
+          result.comp_data_len
+        ) ||
+        !this->read_section(
+          SectionId::COMP_STAGE1,
+          result.stage1,
+          result.stage1_len
+        ) ||
+        !this->read_section(
+          SectionId::COMP_STAGE2,
+          result.stage2,
+          result.stage2_len
+        ) ||
+        !this->read_section(
+          SectionId::COMP_STAGE3,
+          result.stage3,
+          result.stage3_len
+        )
+      ) {
+        return false;
+      }
+
+      // As above, do every lookup that nfd.cpp can do.
+      for (uint32_t cp = 0; cp <= result.last_assigned; cp++) {
+        uint32_t index3 = cp >> result.stage3_shift;
+        if (index3 >= result.stage3_len) {
+          return this->fail("normalization stage 3 table is too short");
+        }
+        uint32_t index2 =
+          result.stage3[index3] |
+          ((cp >> result.stage2_shift) & result.stage2_mask);
+        if (index2 >= result.stage2_len) {
+          return this->fail("normalization stage 3 index out of bounds");
+        }
+        uint32_t index1 =
+          result.stage2[index2] |
+          ((cp >> result.stage1_shift) & result.stage1_mask);
+        if (index1 >= result.stage1_len) {
+          return this->fail("normalization stage 2 index out of bounds");
+        }
+        uint32_t index0 = result.stage1[index1] | (cp & result.comp_mask);
+        if (index0 >= result.comp_data_len) {
+          return this->fail("normalization stage 1 index out of bounds");
+        }
+      }
+      for (uint32_t i = 0; i < result.comp_data_len; i++) {
+        const nfd::CompData &comp = result.comp_data[i];
+        if (
+          (uint32_t) comp.decomp_idx + comp.decomp_len > result.decomp_data_len
+        ) {
+          return this->fail("decomposition index out of bounds");
+        }
+      }
+      for (uint32_t i = 0; i < result.decomp_data_len; i++) {
+        if (result.decomp_data[i] > MAX_CODE_POINT) {
+          return this->fail("decomposition contains invalid code point");
+        }
+      }
+      return true;
+    }
+
+    bool load_file(const char* path, Tables &result, const char* &error) {
+      const uint8_t* data;
+      size_t size;
+      if (!map_file(path, data, size, error)) {
+        return false;
+      }
+
+      FileReader reader(data, size);
+      if (!reader.read(result)) {
+        unmap_file(data, size);
+        error = reader.get_error();
+        return false;
+      }
+      return true;
+    }
+
+    Tables load_tables() {
+      Tables tables;
+      strncpy(tables.version, embedded_version, VERSION_SIZE - 1);
+      tables.version[VERSION_SIZE - 1] = '\0';
+      tables.source = nullptr;
+      tables.load_error = nullptr;
+      tables.collation = embedded_collation;
+      tables.normalization = embedded_normalization;
+
+      const char* path = getenv(ENV_VAR);
+      if (!path || !*path) {
+        return tables;
+      }
+
+      // The path has to outlive the environment variable.
+      static const std::string source(path);
+
+      Tables loaded = tables;
+      const char* error = nullptr;
+      if (load_file(source.c_str(), loaded, error)) {
+        loaded.source = source.c_str();
+        collation = loaded.collation;
+        normalization = loaded.normalization;
+        return loaded;
+      }
+      tables.load_error = error;
+      return tables;
+    }
+
+    const Tables &get() {
+      static const Tables tables = load_tables();
+      return tables;
+    }
+
+    uint32_t checksum(const Tables &tables) {
+      // The checksum covers the same data as a data file does.
+      FileWriter writer;
+      add_sections(writer, tables);
+      return writer.payload_checksum();
+    }
+
+    uint32_t tables_checksum() {
+      static const uint32_t result = checksum(get());
+      return result;
+    }
+
+    // Make sure the data file is loaded before anything can use the tables
+    // from another thread.
+    const bool tables_loaded = (get(), true);
+  }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hash_table.h"
+#include "nfd.h"
+
+// Collation data
+//
+// The normalization and collation tables are compiled into the program (see
+// comp_data.inc and cea_data.inc), but can also be loaded from a binary data
+// file, which is memory-mapped read-only. Every process that maps the same file
+// shares one copy of it in the page cache, and the data can be updated without
+// rebuilding the program.
+//
+// The tables are chosen once, during static initialization: if the environment
+// variable CONDICT_UCA_DATA contains the path of a valid data file, that file
+// is used. Otherwise, or if the file can't be loaded for any reason, we fall
+// back to the embedded tables. The lookup code reads the tables through the
+// `collation` and `normalization` globals, which are constant-initialized to
+// the embedded tables, so nothing can observe a partially loaded state, and the
+// hot paths don't need to check whether the tables have been loaded.
+//
+// The data file is position-independent: everything in it is addressed by
+// offset from the start of the file. All values are little-endian. It consists
+// of a FileHeader, followed by `section_count` SectionHeaders, followed by the
+// sections themselves, each aligned to 16 bytes. The checksum covers everything
+// after the file header.
+//
+// The lookup code is specialised for the layout of the embedded tables: the
+// shifts and masks of the multi-stage lookup tables are compile-time constants.
+// A data file must have the same table layout to be accepted, but the table
+// contents and sizes may differ.
+//
+// Note that the precompiled locale tailorings (see locales.cpp) are derived from
+// the embedded tables. If a data file contains different weights, they must be
+// regenerated.
+
+namespace condict_uca {
+  namespace data {
+    struct CollationTables {
+      uint32_t highest_var;
+      uint32_t last_assigned;
+      uint32_t cea_mask;
+      uint32_t stage1_shift;
+      uint32_t stage1_mask;
+      uint32_t stage2_shift;
+      uint32_t stage2_mask;
+
+      const uint16_t* cea_data;
+      uint32_t cea_data_len;
+      const uint32_t* cea_indices;
+      uint32_t cea_indices_len;
+      const uint16_t* stage1;
+      uint32_t stage1_len;
+      const uint16_t* stage2;
+      uint32_t stage2_len;
+      const HashTableBucket<uint32_t>* contractions;
+      uint32_t contractions_len;
+      uint32_t contractions_root_size;
+    };
+
+    struct NormalizationTables {
+      uint32_t last_assigned;
+      uint32_t comp_mask;
+      uint32_t stage1_shift;
+      uint32_t stage1_mask;
+      uint32_t stage2_shift;
+      uint32_t stage2_mask;
+      uint32_t stage3_shift;
+      uint32_t stage3_mask;
+
+      const uint32_t* decomp_data;
+      uint32_t decomp_data_len;
+      const nfd::CompData* comp_data;
+      uint32_t comp_data_len;
+      const uint16_t* stage1;
+      uint32_t stage1_len;
+      const uint16_t* stage2;
+      uint32_t stage2_len;
+      const uint16_t* stage3;
+      uint32_t stage3_len;
+    };
+
+    constexpr uint32_t VERSION_SIZE = 32;
+
+    // Limits imposed by the lookup tables that are built from the data at
+    // startup (see trie.h and RootEntry in cea.cpp). Data files that exceed
+    // them are rejected.
+    constexpr uint32_t MAX_EXPANSION_LENGTH = 31;
+    constexpr uint32_t MAX_EXPANSION_DATA = 0x10000;
+
+    struct Tables {
+      // The Unicode and CLDR versions that the data comes from, as a string.
+      char version[VERSION_SIZE];
+      // The path of the data file, or nullptr if the tables are embedded.
+      const char* source;
+      // If a data file was given but could not be loaded, describes why.
+      const char* load_error;
+
+      CollationTables collation;
+      NormalizationTables normalization;
+    };
+
+    // The tables that are compiled into the program, defined in cea.cpp and
+    // nfd.cpp respectively, and the versions they were generated from.
+    extern const CollationTables embedded_collation;
+    extern const NormalizationTables embedded_normalization;
+    extern const char* const embedded_version;
+
+    // The tables in use, for the lookup code. Only modified during static
+    // initialization.
+    extern CollationTables collation;
+    extern NormalizationTables normalization;
+
+    // Gets the tables in use, along with where they came from.
+    const Tables &get();
+
+    // Computes the CRC-32 of `len` bytes. To compute the CRC-32 of several
+    // blocks as if they were one, pass the result for the previous blocks as
+    // `crc`.
+    uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+    // Computes the CRC-32 of the contents of the specified tables. Tables
+    // loaded from a data file have the same checksum as the tables that the
+    // file was written from.
+    uint32_t checksum(const Tables &tables);
+
+    // Gets the checksum of the tables in use. Computed on first use.
+    uint32_t tables_checksum();
+
+    constexpr char FILE_MAGIC[8] = {'C', 'D', 'C', 'T', 'U', 'C', 'A', 0};
+    constexpr uint32_t FILE_FORMAT = 1;
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct FileHeader {
+      char magic[8];
+      uint32_t format;
+      uint32_t byte_order;
+      // The total size of the file in bytes.
+      uint32_t file_size;
+      // CRC-32 of everything after this header.
+      uint32_t checksum;
+      uint32_t section_count;
+      uint32_t reserved;
+      char version[VERSION_SIZE];
+    };
+
+    enum class SectionId : uint32_t {
+      COLLATION_PARAMS = 1,
+      CEA_DATA = 2,
+      CEA_INDICES = 3,
+      CEA_STAGE1 = 4,
+      CEA_STAGE2 = 5,
+      CONTRACTIONS = 6,
+      NORMALIZATION_PARAMS = 7,
+      DECOMP_DATA = 8,
+      COMP_DATA = 9,
+      COMP_STAGE1 = 10,
+      COMP_STAGE2 = 11,
+      COMP_STAGE3 = 12,
+    };
+
+    struct SectionHeader {
+      SectionId id;
+      // The offset of the section from the start of the file.
+      uint32_t offset;
+      // The number of items in the section.
+      uint32_t count;
+      // The size of each item, which must match what we expect.
+      uint32_t item_size;
+    };
+
+    // Writes the specified tables to a data file. Returns false if the file
+    // could not be written.
+    bool write_file(const char* path, const Tables &tables);
+
+    // Memory-maps a data file and validates its contents, and if successful,
+    // points the tables in `result` into the mapped file. On failure, returns
+    // false and sets `error` to a static string that describes the problem.
+    // The file remains mapped until the process exits.
+    bool load_file(const char* path, Tables &result, const char* &error);
+  }
+}
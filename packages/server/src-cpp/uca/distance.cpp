@@ -0,0 +1,229 @@
+#include "distance.h"
+
+#include <cstring>
+
+#include "cea.h"
+
+namespace condict_uca {
+  namespace distance {
+    constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFF;
+
+    // A mask of the weights that take part in the comparison, for each
+    // strength. Symbols are collation elements with their four weights packed
+    // into a single integer, level 1 in the topmost bits.
+    const uint64_t LEVEL_MASKS[] = {
+      0,
+      0xFFFF000000000000,
+      0xFFFFFFFF00000000,
+      0xFFFFFFFFFFFF0000,
+      0xFFFFFFFFFFFFFFFF,
+    };
+
+    inline uint64_t hash_symbol(uint64_t sym) {
+      // Fibonacci hashing; the top bits are the most thoroughly mixed.
+      return (sym * 0x9E3779B97F4A7C15) >> 32;
+    }
+
+    uint32_t EditDistance::read_symbols(
+      int str_len,
+      const char* str,
+      uint64_t level_mask,
+      Buffer<uint64_t> &dest
+    ) {
+      cea::ElementIter iter(str_len, str);
+      uint32_t len = 0;
+      cea::Element elems[32];
+      uint32_t count;
+      while ((count = iter.next_batch(elems, 32)) > 0) {
+        uint64_t* out = dest.reserve(len + count);
+        for (uint32_t i = 0; i < count; i++) {
+          const cea::Element &e = elems[i];
+          uint64_t sym =
+            (uint64_t)e.level_1 << 48 |
+            (uint64_t)e.level_2 << 32 |
+            (uint64_t)e.level_3 << 16 |
+            (uint64_t)e.level_4;
+          sym &= level_mask;
+          // Elements that are ignorable at this strength don't exist as far as
+          // we're concerned.
+          if (sym != 0) {
+            out[len] = sym;
+            len++;
+          }
+        }
+      }
+      return len;
+    }
+
+    uint32_t EditDistance::build_masks(
+      const uint64_t* pattern,
+      uint32_t pattern_len,
+      uint32_t words
+    ) {
+      // Keep the load factor at or below 1/2, so probe sequences stay short.
+      uint32_t slot_count = 16;
+      while (slot_count < pattern_len * 2) {
+        slot_count *= 2;
+      }
+      Slot* slots = this->slots.reserve(slot_count);
+      for (uint32_t i = 0; i < slot_count; i++) {
+        slots[i].index = EMPTY_SLOT;
+      }
+
+      // There can't be more distinct symbols than there are symbols.
+      uint64_t* masks = this->masks.reserve(pattern_len * words);
+      uint32_t distinct = 0;
+      for (uint32_t i = 0; i < pattern_len; i++) {
+        uint64_t sym = pattern[i];
+        uint32_t s = (uint32_t)hash_symbol(sym) & (slot_count - 1);
+        while (slots[s].index != EMPTY_SLOT && slots[s].key != sym) {
+          s = (s + 1) & (slot_count - 1);
+        }
+        if (slots[s].index == EMPTY_SLOT) {
+          slots[s].key = sym;
+          slots[s].index = distinct;
+          memset(&masks[distinct * words], 0, words * sizeof(uint64_t));
+          distinct++;
+        }
+        masks[slots[s].index * words + i / 64] |= (uint64_t)1 << (i % 64);
+      }
+      return slot_count;
+    }
+
+    const uint64_t* EditDistance::find_masks(
+      uint64_t sym,
+      uint32_t slot_count,
+      uint32_t words
+    ) {
+      const Slot* slots = this->slots.data();
+      uint32_t s = (uint32_t)hash_symbol(sym) & (slot_count - 1);
+      while (slots[s].index != EMPTY_SLOT) {
+        if (slots[s].key == sym) {
+          return &this->masks[slots[s].index * words];
+        }
+        s = (s + 1) & (slot_count - 1);
+      }
+      return nullptr;
+    }
+
+    uint32_t EditDistance::compute(
+      int a_len,
+      const char* a,
+      int b_len,
+      const char* b,
+      uint32_t strength,
+      uint32_t max
+    ) {
+      if (strength < 1) {
+        strength = 1;
+      } else if (strength > 4) {
+        strength = 4;
+      }
+      uint64_t level_mask = LEVEL_MASKS[strength];
+
+      uint32_t m = this->read_symbols(a_len, a, level_mask, this->a_syms);
+      uint32_t n = this->read_symbols(b_len, b, level_mask, this->b_syms);
+
+      // The distance is symmetric, so we can choose which string to use as the
+      // pattern. The shorter string means fewer words per row.
+      const uint64_t* pattern = this->a_syms.data();
+      const uint64_t* text = this->b_syms.data();
+      if (m > n) {
+        uint32_t tmp_len = m;
+        m = n;
+        n = tmp_len;
+        const uint64_t* tmp = pattern;
+        pattern = text;
+        text = tmp;
+      }
+
+      // It takes at least n - m insertions to turn the shorter string into the
+      // longer one. We may not need to look any further than that.
+      if (n - m > max) {
+        return max + 1;
+      }
+      if (m == 0) {
+        return n;
+      }
+
+      uint32_t words = (m + 63) / 64;
+      uint32_t slot_count = this->build_masks(pattern, m, words);
+
+      // Each row has an extra entry at the start, which represents the word
+      // before the first. It saves us from special-casing the first word when
+      // looking at the bits carried over from the previous word.
+      Row* old_rows = this->old_rows.reserve(words + 1);
+      Row* new_rows = this->new_rows.reserve(words + 1);
+      for (uint32_t w = 0; w <= words; w++) {
+        old_rows[w] = { ~(uint64_t)0, 0, 0, 0 };
+        new_rows[w] = { ~(uint64_t)0, 0, 0, 0 };
+      }
+
+      // The bit in the last word that corresponds to the last pattern symbol.
+      const uint64_t last_bit = (uint64_t)1 << ((m - 1) % 64);
+
+      // dist is the distance between the full pattern and the first j symbols
+      // of the text, i.e. the bottom cell of the current column.
+      uint32_t dist = m;
+      for (uint32_t j = 0; j < n; j++) {
+        Row* tmp = old_rows;
+        old_rows = new_rows;
+        new_rows = tmp;
+
+        const uint64_t* sym_masks =
+          this->find_masks(text[j], slot_count, words);
+
+        // The top row of the matrix is 0, 1, 2, ..., so the horizontal delta
+        // entering the first word is always +1.
+        uint64_t hp_carry = 1;
+        uint64_t hn_carry = 0;
+        for (uint32_t w = 0; w < words; w++) {
+          const Row &prev = old_rows[w + 1];
+          uint64_t pm = sym_masks ? sym_masks[w] : 0;
+          uint64_t vp = prev.vp;
+          uint64_t vn = prev.vn;
+          uint64_t d0 = prev.d0;
+
+          // Transpositions: a match here that was preceded by a match of the
+          // previous pattern symbol against the previous text symbol. The low
+          // bit comes from the top of the word before this one.
+          uint64_t tr =
+            (((~d0) & pm) << 1 | ((~old_rows[w].d0) & new_rows[w].pm) >> 63) &
+            prev.pm;
+
+          uint64_t x = pm | hn_carry;
+          d0 = (((x & vp) + vp) ^ vp) | x | vn | tr;
+
+          uint64_t hp = vn | ~(d0 | vp);
+          uint64_t hn = d0 & vp;
+          if (w == words - 1) {
+            dist += (hp & last_bit) != 0;
+            dist -= (hn & last_bit) != 0;
+          }
+
+          uint64_t hp_carry_in = hp_carry;
+          uint64_t hn_carry_in = hn_carry;
+          hp_carry = hp >> 63;
+          hn_carry = hn >> 63;
+          hp = (hp << 1) | hp_carry_in;
+          hn = (hn << 1) | hn_carry_in;
+
+          Row &next = new_rows[w + 1];
+          next.vp = hn | ~(d0 | hp);
+          next.vn = hp & d0;
+          next.d0 = d0;
+          next.pm = pm;
+        }
+
+        // The bottom cell can decrease by at most one per remaining column.
+        // If even that can't bring it down to max, we may as well stop.
+        uint64_t remaining = n - j - 1;
+        if (dist > max + remaining) {
+          return max + 1;
+        }
+      }
+
+      return dist > max ? max + 1 : dist;
+    }
+  }
+}
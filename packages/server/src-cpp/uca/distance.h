@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer.h"
+
+// Edit distance
+//
+// This file contains functionality related to measuring how different two
+// strings are, in terms of their collation elements rather than their code
+// points. Since the comparison happens on collation elements, differences that
+// the collation considers irrelevant at the chosen strength are ignored: at
+// primary strength, "resume" and "résumé" are identical.
+//
+// The distance computed is the *optimal string alignment* distance, also known
+// as the restricted Damerau-Levenshtein distance: the number of insertions,
+// deletions, substitutions and transpositions of adjacent collation elements
+// needed to turn one string into the other, where no element is edited more
+// than once.
+
+namespace condict_uca {
+  namespace distance {
+    // Computes edit distances between strings. An instance holds on to the
+    // memory it needs between calls, so it only ever allocates when it sees
+    // longer strings than it has seen before. Reuse instances where possible.
+    //
+    // The implementation is Hyyrö's bit-parallel extension of Myers' algorithm,
+    // which processes up to 64 collation elements of the shorter string in each
+    // machine word. See:
+    //
+    //   Heikki Hyyrö, "A Bit-Vector Algorithm for Computing Levenshtein and
+    //   Damerau Edit Distances", Nordic Journal of Computing 10 (2003).
+    class EditDistance {
+    public:
+      inline EditDistance() { }
+
+      // Computes the edit distance between two strings.
+      //
+      // `strength` is the number of collation levels that take part in the
+      // comparison, from 1 (primary weights only) to 4 (all levels). Two
+      // collation elements are equal if all of their weights up to and
+      // including that level are equal. Elements that are ignorable at the
+      // given strength are skipped entirely.
+      //
+      // `max` is the largest distance the caller is interested in. As soon as
+      // the distance is known to exceed it, the computation stops and returns
+      // `max + 1`. It must be less than UINT32_MAX.
+      uint32_t compute(
+        int a_len,
+        const char* a,
+        int b_len,
+        const char* b,
+        uint32_t strength,
+        uint32_t max
+      );
+
+    private:
+      struct Row {
+        uint64_t vp;
+        uint64_t vn;
+        uint64_t d0;
+        uint64_t pm;
+      };
+
+      struct Slot {
+        // The symbol in this slot, only valid if `index` is not EMPTY_SLOT.
+        uint64_t key;
+        // Index of the symbol's match masks, or EMPTY_SLOT.
+        uint32_t index;
+      };
+
+      // The collation elements of both strings, reduced to one symbol each.
+      Buffer<uint64_t> a_syms;
+      Buffer<uint64_t> b_syms;
+      // An open-addressing hash table from symbol to match masks.
+      Buffer<Slot> slots;
+      // Match masks, `words` entries per distinct symbol in the pattern.
+      Buffer<uint64_t> masks;
+      Buffer<Row> old_rows;
+      Buffer<Row> new_rows;
+
+      uint32_t read_symbols(
+        int str_len,
+        const char* str,
+        uint64_t level_mask,
+        Buffer<uint64_t> &dest
+      );
+
+      // Builds the match masks of the pattern, and returns the size of the
+      // hash table.
+      uint32_t build_masks(
+        const uint64_t* pattern,
+        uint32_t pattern_len,
+        uint32_t words
+      );
+
+      const uint64_t* find_masks(
+        uint64_t sym,
+        uint32_t slot_count,
+        uint32_t words
+      );
+    };
+  }
+}
@@ -0,0 +1,141 @@
+#include "key_pool.h"
+
+#include <cstring>
+#include <exception>
+
+#include "sort_key.h"
+
+namespace condict_uca {
+  namespace sort_key {
+    KeyPool::KeyPool(uint32_t thread_count) :
+      worker_count(0),
+      strings(nullptr),
+      count(0),
+      batch(nullptr),
+      reverse(false),
+      generation(0),
+      remaining(0),
+      stopping(false)
+    {
+      if (thread_count == 0) {
+        thread_count = 1;
+      }
+      // Workers cannot read the worker count before it is final, since they
+      // take the lock first.
+      std::lock_guard<std::mutex> lock(this->mutex);
+      try {
+        this->threads.reserve(thread_count);
+        for (uint32_t i = 0; i < thread_count; i++) {
+          this->threads.emplace_back(&KeyPool::run_worker, this, i);
+        }
+      } catch (const std::exception &) {
+        // std::system_error if there are no more threads, std::bad_alloc if
+        // there is no memory. Neither may escape into SQLite.
+      }
+      this->worker_count = (uint32_t) this->threads.size();
+    }
+
+    KeyPool::~KeyPool() {
+      this->wait();
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+      }
+      this->started.notify_all();
+      for (std::thread &thread : this->threads) {
+        thread.join();
+      }
+    }
+
+    void KeyPool::start(
+      const std::string_view* strings,
+      uint32_t count,
+      KeyBatch &batch,
+      bool reverse
+    ) {
+      uint32_t worker_count = this->worker_count;
+      batch.count = count;
+      batch.keys.reserve(count);
+      batch.lens.reserve(count);
+      if (batch.arenas.size() < worker_count) {
+        batch.arenas = std::vector<Buffer<uint8_t>>(worker_count);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->strings = strings;
+        this->count = count;
+        this->batch = &batch;
+        this->reverse = reverse;
+        this->generation++;
+        this->remaining = worker_count;
+      }
+      this->started.notify_all();
+    }
+
+    void KeyPool::wait() {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->finished.wait(lock, [this]() { return this->remaining == 0; });
+    }
+
+    void KeyPool::run_worker(uint32_t worker) {
+      KeyBuilder builder;
+      uint64_t seen_generation = 0;
+
+      while (true) {
+        uint32_t worker_count;
+        const std::string_view* strings;
+        uint32_t count;
+        KeyBatch* batch;
+        bool reverse;
+        {
+          std::unique_lock<std::mutex> lock(this->mutex);
+          this->started.wait(lock, [&]() {
+            return this->stopping || this->generation != seen_generation;
+          });
+          if (this->stopping) {
+            return;
+          }
+          seen_generation = this->generation;
+          worker_count = this->worker_count;
+          strings = this->strings;
+          count = this->count;
+          batch = this->batch;
+          reverse = this->reverse;
+        }
+
+        // Each worker takes an equal share of the batch.
+        uint32_t begin = (uint32_t) ((uint64_t) count * worker / worker_count);
+        uint32_t end =
+          (uint32_t) ((uint64_t) count * (worker + 1) / worker_count);
+        Buffer<uint8_t> &arena = batch->arenas[worker];
+        uint32_t arena_len = 0;
+        for (uint32_t i = begin; i < end; i++) {
+          const std::string_view &str = strings[i];
+          uint32_t key_len = reverse
+            ? builder.build_reverse((int) str.size(), str.data())
+            : builder.build((int) str.size(), str.data());
+          uint8_t* dest = arena.reserve(arena_len + key_len) + arena_len;
+          memcpy(dest, builder.data(), key_len);
+          batch->lens[i] = key_len;
+          arena_len += key_len;
+        }
+        // The keys are back to back, and the arena no longer moves.
+        const uint8_t* key = arena.data();
+        for (uint32_t i = begin; i < end; i++) {
+          batch->keys[i] = key;
+          key += batch->lens[i];
+        }
+
+        bool last;
+        {
+          std::lock_guard<std::mutex> lock(this->mutex);
+          last = --this->remaining == 0;
+        }
+        if (last) {
+          this->finished.notify_all();
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+
+// Parallel sort keys
+//
+// A KeyPool builds the sort keys of batches of strings on a fixed set of
+// worker threads. Building is asynchronous: the caller starts a batch, is
+// free to do other work (such as reading the next batch from the database or
+// writing out the previous one), and then waits for the batch to finish.
+// Memory use is bounded by the size of the batches, which the caller picks.
+
+namespace condict_uca {
+  namespace sort_key {
+    // The sort keys of a batch of strings. A batch holds on to its memory
+    // between uses, so it only allocates when it sees more or longer strings
+    // than it has seen before.
+    class KeyBatch {
+    public:
+      inline KeyBatch() : count(0) { }
+
+      inline uint32_t size() const {
+        return this->count;
+      }
+
+      inline const uint8_t* key(uint32_t i) const {
+        return this->keys[i];
+      }
+
+      inline uint32_t key_len(uint32_t i) const {
+        return this->lens[i];
+      }
+
+    private:
+      friend class KeyPool;
+
+      uint32_t count;
+      Buffer<const uint8_t*> keys;
+      Buffer<uint32_t> lens;
+      // One arena per worker, so that workers never share a buffer that
+      // grows.
+      std::vector<Buffer<uint8_t>> arenas;
+    };
+
+    class KeyPool {
+    public:
+      // Starts `thread_count` worker threads, at least one. If the system
+      // runs out of threads or memory, the pool makes do with the threads
+      // that did start. If none did, thread_count() is 0 and the pool must
+      // not be used.
+      explicit KeyPool(uint32_t thread_count);
+
+      // Waits for the current batch, if any, and stops the workers.
+      ~KeyPool();
+
+      KeyPool(const KeyPool &) = delete;
+      KeyPool &operator=(const KeyPool &) = delete;
+
+      // Starts building the keys of `count` strings into `batch`. The strings
+      // and the batch must stay alive and unchanged until wait() returns.
+      // Only one batch can be built at a time. If `reverse` is true, builds
+      // reverse sort keys, as KeyBuilder::build_reverse.
+      void start(
+        const std::string_view* strings,
+        uint32_t count,
+        KeyBatch &batch,
+        bool reverse = false
+      );
+
+      // Waits until the keys of the last batch are built.
+      void wait();
+
+      // The number of worker threads that were started.
+      inline uint32_t thread_count() const {
+        return this->worker_count;
+      }
+
+    private:
+      std::mutex mutex;
+      // Signalled when a batch starts, or the pool stops.
+      std::condition_variable started;
+      // Signalled when the last worker finishes a batch.
+      std::condition_variable finished;
+      // Set once the constructor has started the threads.
+      uint32_t worker_count;
+      std::vector<std::thread> threads;
+
+      // The current batch. Protected by the mutex.
+      const std::string_view* strings;
+      uint32_t count;
+      KeyBatch* batch;
+      bool reverse;
+      // Incremented for every batch, so workers can tell a new one from the
+      // one they just did.
+      uint64_t generation;
+      // The number of workers that have not finished the current batch.
+      uint32_t remaining;
+      bool stopping;
+
+      void run_worker(uint32_t worker);
+    };
+  }
+}
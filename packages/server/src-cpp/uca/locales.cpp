@@ -0,0 +1,69 @@
+#include "tailoring.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace condict_uca {
+  namespace tailoring {
+    struct LocaleData {
+      const char* name;
+      // If null, the locale uses the root collation.
+      const HashTableBucket<uint32_t>* contractions;
+      uint32_t contraction_count;
+      uint16_t root_size;
+      const uint16_t* cea_data;
+      uint32_t cea_data_size;
+    };
+
+    #include "locale_data.inc"
+
+    constexpr size_t LOCALE_COUNT = sizeof(locale_data) / sizeof(LocaleData);
+
+    class Locales {
+    public:
+      static const Tailoring* get(size_t index) {
+        // The tailorings are created the first time any locale is used. The
+        // tables are static; only the start index is built at runtime.
+        static Tailoring* const* tailorings = create_all();
+        return tailorings[index];
+      }
+
+    private:
+      static Tailoring* const* create_all() {
+        Tailoring** result = new (std::nothrow) Tailoring*[LOCALE_COUNT];
+        if (!result) {
+          std::abort();
+        }
+
+        for (size_t i = 0; i < LOCALE_COUNT; i++) {
+          const LocaleData &locale = locale_data[i];
+          if (!locale.contractions) {
+            result[i] = nullptr;
+            continue;
+          }
+          result[i] = new (std::nothrow) Tailoring(
+            locale.contractions,
+            locale.contraction_count,
+            locale.root_size,
+            locale.cea_data,
+            locale.cea_data_size
+          );
+          if (!result[i]) {
+            std::abort();
+          }
+        }
+        return result;
+      }
+    };
+
+    const Tailoring* get_locale(const char* name) {
+      for (size_t i = 0; i < LOCALE_COUNT; i++) {
+        if (strcmp(locale_data[i].name, name) == 0) {
+          return Locales::get(i);
+        }
+      }
+      return nullptr;
+    }
+  }
+}
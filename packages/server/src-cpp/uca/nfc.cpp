@@ -0,0 +1,246 @@
+#include "nfc.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "data.h"
+#include "nfd.h"
+#include "utf8.h"
+
+namespace condict_uca {
+  namespace nfc {
+    // Code points whose canonical decompositions are excluded from
+    // composition, from CompositionExclusions.txt: script-specific exclusions
+    // and characters that were added after Unicode 3.0. Singletons and
+    // decompositions that start with a non-starter are also excluded, but
+    // those are detected from the data.
+    struct ExcludedRange {
+      uint32_t first;
+      uint32_t last;
+    };
+
+    const ExcludedRange EXCLUSIONS[] = {
+      { 0x0958, 0x095F },
+      { 0x09DC, 0x09DD },
+      { 0x09DF, 0x09DF },
+      { 0x0A33, 0x0A33 },
+      { 0x0A36, 0x0A36 },
+      { 0x0A59, 0x0A5B },
+      { 0x0A5E, 0x0A5E },
+      { 0x0B5C, 0x0B5D },
+      { 0x0F43, 0x0F43 },
+      { 0x0F4D, 0x0F4D },
+      { 0x0F52, 0x0F52 },
+      { 0x0F57, 0x0F57 },
+      { 0x0F5C, 0x0F5C },
+      { 0x0F69, 0x0F69 },
+      { 0x0F76, 0x0F76 },
+      { 0x0F78, 0x0F78 },
+      { 0x0F93, 0x0F93 },
+      { 0x0F9D, 0x0F9D },
+      { 0x0FA2, 0x0FA2 },
+      { 0x0FA7, 0x0FA7 },
+      { 0x0FAC, 0x0FAC },
+      { 0x0FB9, 0x0FB9 },
+      { 0x2ADC, 0x2ADC },
+      { 0xFB1D, 0xFB1D },
+      { 0xFB1F, 0xFB1F },
+      { 0xFB2A, 0xFB36 },
+      { 0xFB38, 0xFB3C },
+      { 0xFB3E, 0xFB3E },
+      { 0xFB40, 0xFB41 },
+      { 0xFB43, 0xFB44 },
+      { 0xFB46, 0xFB4E },
+      { 0x1D15E, 0x1D164 },
+      { 0x1D1BB, 0x1D1C0 },
+    };
+
+    bool is_excluded(uint32_t cp) {
+      for (const ExcludedRange &range : EXCLUSIONS) {
+        if (cp <= range.last) {
+          return cp >= range.first;
+        }
+      }
+      return false;
+    }
+
+    inline uint64_t pair_key(uint32_t first, uint32_t second) {
+      return (uint64_t) first << 21 | second;
+    }
+
+    // The composition pairs, sorted by key.
+    struct CompositionTable {
+      std::vector<uint64_t> keys;
+      std::vector<uint32_t> composites;
+      // The lowest code point that is the second of a pair. Almost all text
+      // is below it, and can skip the search.
+      uint32_t min_second;
+    };
+
+    CompositionTable build_composition_table() {
+      // A composite may decompose into more than two code points, in which
+      // case it composes from the composite of all but the last code point,
+      // and the last code point. For example, U+01D5 (Ǖ) decomposes to
+      // U+0055 U+0308 U+0304, and composes from U+00DC (Ü) and U+0304. Hence
+      // we need to be able to find composites by their full decompositions.
+      std::map<std::vector<uint32_t>, uint32_t> composites;
+
+      uint32_t last = data::get().normalization.last_assigned;
+      for (uint32_t cp = 0; cp <= last; cp++) {
+        const uint32_t* decomp;
+        uint32_t len = nfd::get_decomposition(cp, decomp);
+        if (
+          len < 2 ||
+          nfd::get_ccc(cp) != 0 ||
+          nfd::get_ccc(decomp[0]) != 0 ||
+          is_excluded(cp)
+        ) {
+          continue;
+        }
+        // A few sequences have more than one composite. Only the first is
+        // canonical, the others are compatibility variants.
+        composites.emplace(std::vector<uint32_t>(decomp, decomp + len), cp);
+      }
+
+      std::vector<std::pair<uint64_t, uint32_t>> pairs;
+      pairs.reserve(composites.size());
+      uint32_t min_second = 0x110000;
+      for (const auto &entry : composites) {
+        const std::vector<uint32_t> &decomp = entry.first;
+        uint32_t first = decomp[0];
+        if (decomp.size() > 2) {
+          auto prefix = composites.find(
+            std::vector<uint32_t>(decomp.begin(), decomp.end() - 1)
+          );
+          if (prefix == composites.end()) {
+            continue;
+          }
+          first = prefix->second;
+        }
+        uint32_t second = decomp.back();
+        pairs.emplace_back(pair_key(first, second), entry.second);
+        min_second = std::min(min_second, second);
+      }
+      std::sort(pairs.begin(), pairs.end());
+
+      CompositionTable table;
+      table.keys.reserve(pairs.size());
+      table.composites.reserve(pairs.size());
+      for (const auto &pair : pairs) {
+        table.keys.push_back(pair.first);
+        table.composites.push_back(pair.second);
+      }
+      table.min_second = min_second;
+      return table;
+    }
+
+    const CompositionTable &composition_table() {
+      static const CompositionTable table = build_composition_table();
+      return table;
+    }
+
+    uint32_t compose_pair(uint32_t first, uint32_t second) {
+      using namespace nfd::hangul;
+
+      // Hangul syllables compose algorithmically, in two steps: L + V = LV,
+      // then LV + T = LVT.
+      if (first - L_BASE < L_COUNT && second - V_BASE < V_COUNT) {
+        uint32_t l_index = first - L_BASE;
+        uint32_t v_index = second - V_BASE;
+        return S_BASE + (l_index * V_COUNT + v_index) * T_COUNT;
+      }
+      if (
+        nfd::is_hangul_syllable(first) &&
+        (first - S_BASE) % T_COUNT == 0 &&
+        second - (T_BASE + 1) < T_COUNT - 1
+      ) {
+        return first + (second - T_BASE);
+      }
+
+      const CompositionTable &table = composition_table();
+      if (second < table.min_second) {
+        return 0;
+      }
+      uint64_t key = pair_key(first, second);
+      auto it = std::lower_bound(table.keys.begin(), table.keys.end(), key);
+      if (it == table.keys.end() || *it != key) {
+        return 0;
+      }
+      return table.composites[it - table.keys.begin()];
+    }
+
+    uint32_t compose(uint32_t* cps, uint32_t len) {
+      if (len == 0) {
+        return 0;
+      }
+
+      // The last starter, which the following code points may combine with.
+      uint32_t starter_pos = 0;
+      // The CCC of the last code point that was kept. A code point can only
+      // combine with the starter if nothing between them has the same or a
+      // higher CCC; starters block everything. If the string starts with a
+      // non-starter, there is no starter to combine with until the next one,
+      // which 256 accomplishes.
+      uint32_t last_ccc = nfd::get_ccc(cps[0]) == 0 ? 0 : 256;
+      uint32_t out = 1;
+      for (uint32_t i = 1; i < len; i++) {
+        uint32_t cp = cps[i];
+        uint32_t ccc = nfd::get_ccc(cp);
+        if (last_ccc < ccc || last_ccc == 0) {
+          uint32_t composite = compose_pair(cps[starter_pos], cp);
+          if (composite != 0) {
+            cps[starter_pos] = composite;
+            continue;
+          }
+        }
+        if (ccc == 0) {
+          starter_pos = out;
+        }
+        last_ccc = ccc;
+        cps[out] = cp;
+        out++;
+      }
+      return out;
+    }
+
+    // The number of code points that are decoded at a time.
+    constexpr uint32_t BATCH_SIZE = 32;
+
+    uint32_t Normalizer::decompose(int str_len, const char* str) {
+      nfd::NfdIter iter(str_len, str);
+      uint32_t count = 0;
+      while (true) {
+        uint32_t* dest = this->code_points.reserve(count + BATCH_SIZE) + count;
+        uint32_t read = iter.next_batch(dest, BATCH_SIZE);
+        count += read;
+        if (read < BATCH_SIZE) {
+          return count;
+        }
+      }
+    }
+
+    uint32_t Normalizer::encode(uint32_t count) {
+      // Each code point takes at most 4 bytes. Reserve at least one byte, so
+      // that data() is not null for empty strings.
+      char* dest = this->text.reserve(4 * count + 1);
+      const uint32_t* cps = this->code_points.data();
+      uint32_t len = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        len += utf8::encode(cps[i], dest + len);
+      }
+      return len;
+    }
+
+    uint32_t Normalizer::to_nfd(int str_len, const char* str) {
+      uint32_t count = this->decompose(str_len, str);
+      return this->encode(count);
+    }
+
+    uint32_t Normalizer::to_nfc(int str_len, const char* str) {
+      uint32_t count = this->decompose(str_len, str);
+      count = compose(this->code_points.data(), count);
+      return this->encode(count);
+    }
+  }
+}
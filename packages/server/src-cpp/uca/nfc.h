@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer.h"
+
+// NFC: Normalization Form C
+//
+// This file contains the canonical composition algorithm, which turns a string
+// in NFD into NFC, as well as helpers for converting whole strings to either
+// normalization form. The collation code itself only ever needs NFD, and
+// reads it straight from an NfdIter (see nfd.h).
+//
+// The composition pairs are derived from the canonical decompositions in the
+// normalization tables, the first time they're needed. See The Unicode
+// Standard, section 3.11, Normalization Forms, for the algorithm.
+
+namespace condict_uca {
+  namespace nfc {
+    // Gets the primary composite of two code points, or 0 if they don't
+    // compose. Includes precomposed Hangul syllables.
+    uint32_t compose_pair(uint32_t first, uint32_t second);
+
+    // Applies the canonical composition algorithm to `len` code points in NFD,
+    // in place, and returns the number of code points in the result.
+    uint32_t compose(uint32_t* cps, uint32_t len);
+
+    // Converts strings to NFD or NFC. An instance holds on to the memory it
+    // needs between calls, like sort_key::KeyBuilder. Invalid UTF-8 sequences
+    // are replaced with U+FFFD.
+    class Normalizer {
+    public:
+      inline Normalizer() { }
+
+      // Converts a string to NFD, and returns the length in bytes of the
+      // result. The result can be read from `data()` until the next call.
+      uint32_t to_nfd(int str_len, const char* str);
+
+      // Converts a string to NFC, and returns the length in bytes of the
+      // result. The result can be read from `data()` until the next call.
+      uint32_t to_nfc(int str_len, const char* str);
+
+      inline const char* data() const {
+        return this->text.data();
+      }
+
+    private:
+      Buffer<uint32_t> code_points;
+      Buffer<char> text;
+
+      // Writes the code points of a string in NFD to `code_points`, and
+      // returns how many there are.
+      uint32_t decompose(int str_len, const char* str);
+
+      // Encodes the first `count` code points in `code_points` as UTF-8 into
+      // `text`, and returns the length in bytes.
+      uint32_t encode(uint32_t count);
+    };
+  }
+}
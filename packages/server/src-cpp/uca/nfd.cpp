@@ -1,39 +1,211 @@
 #include "nfd.h"
 
+#include <cstring>
+
+// node-gyp defines DEBUG in debug builds, but doesn't define NDEBUG in release
+// builds, so assert() would be enabled everywhere.
+#ifdef DEBUG
+# include <cassert>
+# define CHECK_TRUSTED_NFD(cp, next) assert(is_nfd_pair(cp, next))
+#else
+# define CHECK_TRUSTED_NFD(cp, next) ((void) 0)
+#endif
+
+#include "data.h"
+#include "profile.h"
+#include "stats.h"
+#include "trie.h"
+
 namespace condict_uca {
   namespace nfd {
     #include "comp_data.inc"
 
     const CompData DEFAULT_COMP_DATA = { 0, 0, 0 };
 
-    CompData lookup_comp_data(uint32_t cp) {
-      if (cp > LAST_ASSIGNED) {
+    // The normalization tables in use, which may come from a data file. As in
+    // cea.cpp, the shifts and masks are compile-time constants.
+    inline const data::NormalizationTables &tables() {
+      return data::normalization;
+    }
+
+    // Looks up a code point in the tables as they are stored. Only used to
+    // build the trie.
+    CompData lookup_stored_comp_data(
+      const data::NormalizationTables &t,
+      uint32_t cp
+    ) {
+      if (cp > t.last_assigned) {
         return DEFAULT_COMP_DATA;
       }
 
       uint16_t index3 = cp >> STAGE3_SHIFT;
-      uint16_t index2 = stage3[index3] | ((cp >> STAGE2_SHIFT) & STAGE2_MASK);
-      uint16_t index1 = stage2[index2] | ((cp >> STAGE1_SHIFT) & STAGE1_MASK);
-      uint16_t index0 = stage1[index1] | (cp & COMP_MASK);
-      return comp_data[index0];
+      uint16_t index2 = t.stage3[index3] | ((cp >> STAGE2_SHIFT) & STAGE2_MASK);
+      uint16_t index1 = t.stage2[index2] | ((cp >> STAGE1_SHIFT) & STAGE1_MASK);
+      uint16_t index0 = t.stage1[index1] | (cp & COMP_MASK);
+      return t.comp_data[index0];
+    }
+
+    const NormalizationTrie &comp_trie() {
+      static const NormalizationTrie trie(
+        data::get().normalization.last_assigned,
+        DEFAULT_COMP_DATA,
+        [](uint32_t cp) {
+          return lookup_stored_comp_data(data::get().normalization, cp);
+        }
+      );
+      return trie;
+    }
+
+    inline CompData lookup_comp_data(uint32_t cp) {
+      return comp_trie().get(cp);
+    }
+
+    uint32_t table_size() {
+      return comp_trie().byte_size();
     }
 
     uint8_t get_ccc(uint32_t cp) {
       return lookup_comp_data(cp).ccc;
     }
 
-    bool NfdIter::next(uint32_t &result) {
-      if (this->buf.is_empty() && !this->scan_next()) {
+    uint32_t get_first_decomposed(uint32_t cp) {
+      // Precomposed Hangul syllables always start with a leading consonant.
+      // See NfdIter::decompose_hangul for details.
+      if (is_hangul_syllable(cp)) {
+        return hangul::L_BASE + (cp - hangul::S_BASE) / hangul::N_COUNT;
+      }
+
+      CompData comp_data = lookup_comp_data(cp);
+      if (comp_data.decomp_len == 0) {
+        return cp;
+      }
+      return tables().decomp_data[comp_data.decomp_idx];
+    }
+
+    uint32_t get_decomposition(uint32_t cp, const uint32_t* &result) {
+      CompData comp_data = lookup_comp_data(cp);
+      if (comp_data.decomp_len != 0) {
+        result = &tables().decomp_data[comp_data.decomp_idx];
+      }
+      return comp_data.decomp_len;
+    }
+
+#ifdef DEBUG
+    // Determines whether `cp` followed by `next` can occur in a string that
+    // is in NFD: `cp` must not decompose, and if it's a non-starter, `next`
+    // must not need to be moved in front of it.
+    bool is_nfd_pair(uint32_t cp, uint32_t next) {
+      CompData comp_data = lookup_comp_data(cp);
+      if (comp_data.decomp_len != 0 || is_hangul_syllable(cp)) {
+        return false;
+      }
+      uint8_t next_ccc = get_ccc(next);
+      return comp_data.ccc == 0 || next_ccc == 0 || next_ccc >= comp_data.ccc;
+    }
+#endif
+
+    // Determines whether a code point is a starter that doesn't decompose, and
+    // hence is its own NFD form regardless of what follows it.
+    inline bool is_stable_starter(uint32_t cp, CompData comp_data) {
+      return
+        comp_data.ccc == 0 &&
+        comp_data.decomp_len == 0 &&
+        // Hangul syllables are decomposed algorithmically.
+        !is_hangul_syllable(cp);
+    }
+
+    bool NfdIter::next_unbuffered(uint32_t &result, bool keep_hangul) {
+      CONDICT_UCA_PROFILE_STAGE(NFD);
+      uint32_t cp;
+      if (!this->str.next(cp)) {
         result = 0;
         return false;
       }
 
+      if (this->trusted_nfd) {
+        CHECK_TRUSTED_NFD(cp, this->str.peek());
+        if (this->log) {
+          this->log->push(cp);
+        }
+        result = cp;
+        return true;
+      }
+
+      CompData comp_data = lookup_comp_data(cp);
+      if (is_stable_starter(cp, comp_data)) {
+        if (this->log) {
+          this->log->push(cp);
+        }
+        result = cp;
+        return true;
+      }
+      if (keep_hangul && is_hangul_syllable(cp)) {
+        if (this->log) {
+          // Log the jamo as decompose_hangul would produce them.
+          this->decompose_hangul(cp);
+          this->log_buffered(0);
+          this->buf.skip(this->buf.size());
+        }
+        result = cp;
+        return true;
+      }
+
       // At this point, the buffer will contain at least one code point.
+      this->decompose(cp, comp_data);
       result = this->buf.pop_start();
       return true;
     }
 
+    uint32_t NfdIter::next_batch(uint32_t* out, uint32_t n) {
+      CONDICT_UCA_PROFILE_STAGE(NFD);
+      uint32_t count = 0;
+      if (this->trusted_nfd) {
+        while (count < n && !this->buf.is_empty()) {
+          out[count] = this->buf.pop_start();
+          count++;
+        }
+        uint32_t start = count;
+        count += this->str.next_batch(out + count, n - count);
+        for (uint32_t i = start; i < count; i++) {
+          CHECK_TRUSTED_NFD(
+            out[i],
+            i + 1 < count ? out[i + 1] : this->str.peek()
+          );
+          if (this->log) {
+            this->log->push(out[i]);
+          }
+        }
+        return count;
+      }
+
+      const NormalizationTrie &trie = comp_trie();
+      while (count < n) {
+        if (!this->buf.is_empty()) {
+          out[count] = this->buf.pop_start();
+          count++;
+          continue;
+        }
+
+        uint32_t cp;
+        if (!this->str.next(cp)) {
+          break;
+        }
+        CompData comp_data = trie.get(cp);
+        if (is_stable_starter(cp, comp_data)) {
+          if (this->log) {
+            this->log->push(cp);
+          }
+          out[count] = cp;
+          count++;
+        } else {
+          this->decompose(cp, comp_data);
+        }
+      }
+      return count;
+    }
+
     uint32_t NfdIter::peek(uint32_t n) {
+      CONDICT_UCA_PROFILE_STAGE(NFD);
       while (this->buf.size() <= n) {
         if (!this->scan_next()) {
           return 0;
@@ -48,23 +220,39 @@ namespace condict_uca {
         return false;
       }
 
-      // At this point, we have at least one more code point. Let's see if we
-      // can decompose it.
-      bool has_nonstarters = false;
-      CompData comp_data = lookup_comp_data(next_cp);
+      if (this->trusted_nfd) {
+        CHECK_TRUSTED_NFD(next_cp, this->str.peek());
+        this->buf.push_end(next_cp);
+        if (this->log) {
+          this->log->push(next_cp);
+        }
+        return true;
+      }
+
+      this->decompose(next_cp, lookup_comp_data(next_cp));
+      return true;
+    }
+
+    void NfdIter::decompose(uint32_t next_cp, CompData comp_data) {
+      // Everything this function pushes is in NFD order when it returns.
+      uint32_t log_start = this->buf.size();
 
+      bool has_nonstarters = false;
       if (comp_data.decomp_len == 0) {
         if (this->decompose_hangul(next_cp)) {
           // Hangul syllables decompose into starters. We do not need to do any
           // more work, as we can't possibly be inside a non-starter sequence.
-          return true;
+          if (this->log) {
+            this->log_buffered(log_start);
+          }
+          return;
         }
 
         this->push(next_cp, comp_data.ccc, has_nonstarters);
       } else {
         // The decompositions in our data are already fully expanded, i.e. we
         // will not need to decompose them any further.
-        const uint32_t* decomp = &decomp_data[comp_data.decomp_idx];
+        const uint32_t* decomp = &tables().decomp_data[comp_data.decomp_idx];
         for (uint32_t i = 0; i < comp_data.decomp_len; i++) {
           uint32_t cp = decomp[i];
           this->push(cp, get_ccc(cp), has_nonstarters);
@@ -90,7 +278,8 @@ namespace condict_uca {
             }
             this->push_nonstarter(cp, comp_data.ccc);
           } else {
-            const uint32_t* decomp = &decomp_data[comp_data.decomp_idx];
+            const uint32_t* decomp =
+              &tables().decomp_data[comp_data.decomp_idx];
 
             if (get_ccc(decomp[0]) == 0) {
               // Decomposes into something that starts with a starter - we're
@@ -109,26 +298,25 @@ namespace condict_uca {
           this->str.skip();
         }
       }
-      return true;
+
+      if (this->log) {
+        this->log_buffered(log_start);
+      }
+    }
+
+    void NfdIter::log_buffered(uint32_t start) {
+      uint32_t end = this->buf.size();
+      for (uint32_t i = start; i < end; i++) {
+        this->log->push(this->buf[i]);
+      }
     }
 
     bool NfdIter::decompose_hangul(uint32_t cp) {
-      // These constants are taken from The Unicode Standard, section 3.12,
-      // Conjoining Jamo Behavior.
-      //   L = Leading consonant
-      //   V = Vowel
-      //   T = Trailing consonant (may be absent)
-      constexpr uint32_t S_BASE = 0xAC00; // The first Hangul syllable
-      constexpr uint32_t L_BASE = 0x1100; // Code point of the first L
-      constexpr uint32_t V_BASE = 0x1161; // Code point of the first V
-      constexpr uint32_t T_BASE = 0x11A7; // Code point of the first T
-      constexpr uint32_t V_COUNT = 21; // Total number of Vs
-      constexpr uint32_t T_COUNT = 28; // Total number of Ts
-      constexpr uint32_t N_COUNT = V_COUNT * T_COUNT;
-
-      constexpr uint32_t S_LAST = 0xD7AF; // The last Hangul syllable
-
-      if (S_BASE <= cp && cp <= S_LAST) {
+      using namespace hangul;
+
+      // The unassigned code points at the end of the Hangul Syllables block
+      // don't decompose.
+      if (is_hangul_syllable(cp)) {
         uint32_t s_index = cp - S_BASE;
         uint32_t l_index = s_index / N_COUNT;
         uint32_t v_index = (s_index % N_COUNT) / T_COUNT;
@@ -145,6 +333,40 @@ namespace condict_uca {
       return false;
     }
 
+    void CodePointLog::grow() {
+      // Make room by dropping the code points that have been removed, if
+      // that frees up enough of the buffer.
+      uint32_t size = this->len - this->start;
+      if (this->start > 0 && size < this->cap / 2) {
+        memmove(this->buf, this->buf + this->start, size * sizeof(uint32_t));
+        this->start = 0;
+        this->len = size;
+        return;
+      }
+
+      stats::count(stats::Counter::LOG_SPILLS);
+      uint32_t new_cap = 2 * this->cap;
+      uint32_t* new_buf;
+      if (this->buf == this->inline_buf) {
+        new_buf = reinterpret_cast<uint32_t*>(
+          malloc(new_cap * sizeof(uint32_t))
+        );
+        if (new_buf) {
+          memcpy(new_buf, this->inline_buf, this->len * sizeof(uint32_t));
+        }
+      } else {
+        new_buf = reinterpret_cast<uint32_t*>(
+          realloc(this->buf, new_cap * sizeof(uint32_t))
+        );
+      }
+      if (!new_buf) {
+        // As in Buffer, there is nothing better we can do.
+        std::abort();
+      }
+      this->buf = new_buf;
+      this->cap = new_cap;
+    }
+
     void NfdIter::push(uint32_t cp, uint8_t ccc, bool &has_nonstarters) {
       if (ccc == 0) {
         this->buf.push_end(cp);
@@ -178,3 +400,32 @@ namespace condict_uca {
     }
   }
 }
+
+namespace condict_uca {
+  namespace data {
+    constexpr NormalizationTables EMBEDDED_NORMALIZATION = {
+      nfd::LAST_ASSIGNED,
+      nfd::COMP_MASK,
+      nfd::STAGE1_SHIFT,
+      nfd::STAGE1_MASK,
+      nfd::STAGE2_SHIFT,
+      nfd::STAGE2_MASK,
+      nfd::STAGE3_SHIFT,
+      nfd::STAGE3_MASK,
+      nfd::decomp_data,
+      sizeof(nfd::decomp_data) / sizeof(nfd::decomp_data[0]),
+      nfd::comp_data,
+      sizeof(nfd::comp_data) / sizeof(nfd::comp_data[0]),
+      nfd::stage1,
+      sizeof(nfd::stage1) / sizeof(nfd::stage1[0]),
+      nfd::stage2,
+      sizeof(nfd::stage2) / sizeof(nfd::stage2[0]),
+      nfd::stage3,
+      sizeof(nfd::stage3) / sizeof(nfd::stage3[0]),
+    };
+
+    const NormalizationTables embedded_normalization = EMBEDDED_NORMALIZATION;
+
+    NormalizationTables normalization = EMBEDDED_NORMALIZATION;
+  }
+}
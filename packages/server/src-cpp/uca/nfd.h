@@ -1,9 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
 
+#include "text.h"
 #include "tiny_queue.h"
-#include "utf8.h"
 
 // NFD: Normalization Form D
 //
@@ -13,7 +14,7 @@
 
 namespace condict_uca {
   namespace nfd {
-    using CodePointIter = utf8::CodePointIter;
+    using CodePointIter = text::CodePointIter;
 
     struct CompData {
       // The Canonical Composition Class (CCC) of the code point.
@@ -36,9 +37,119 @@ namespace condict_uca {
       uint16_t decomp_idx;
     };
 
+    // Constants for the algorithmic decomposition of precomposed Hangul
+    // syllables, taken from The Unicode Standard, section 3.12, Conjoining Jamo
+    // Behavior. Each syllable decomposes to a leading consonant (L), a vowel
+    // (V) and optionally a trailing consonant (T).
+    namespace hangul {
+      constexpr uint32_t S_BASE = 0xAC00; // The first Hangul syllable
+      constexpr uint32_t L_BASE = 0x1100; // Code point of the first L
+      constexpr uint32_t V_BASE = 0x1161; // Code point of the first V
+      constexpr uint32_t T_BASE = 0x11A7; // Code point of the first T, minus 1
+      constexpr uint32_t L_COUNT = 19; // Total number of Ls
+      constexpr uint32_t V_COUNT = 21; // Total number of Vs
+      constexpr uint32_t T_COUNT = 28; // Total number of Ts, plus 1 for none
+      constexpr uint32_t N_COUNT = V_COUNT * T_COUNT;
+      constexpr uint32_t S_COUNT = L_COUNT * N_COUNT;
+    }
+
+    // Determines whether a code point is an assigned precomposed Hangul
+    // syllable.
+    inline bool is_hangul_syllable(uint32_t cp) {
+      return cp - hangul::S_BASE < hangul::S_COUNT;
+    }
+
     // Gets the Canonical Composition Class (CCC) of the specified code point.
     uint8_t get_ccc(uint32_t cp);
 
+    // Gets the first code point of the canonical decomposition of the specified
+    // code point. If the code point does not decompose, it is returned as-is.
+    uint32_t get_first_decomposed(uint32_t cp);
+
+    // Gets the full canonical decomposition of the specified code point, and
+    // returns its length. If the code point does not decompose, returns 0 and
+    // leaves `result` untouched. Hangul syllables are decomposed
+    // algorithmically, and are not included.
+    uint32_t get_decomposition(uint32_t cp, const uint32_t* &result);
+
+    // Gets the size in bytes of the lookup table that is built from the
+    // normalization data at startup. See trie.h.
+    uint32_t table_size();
+
+    // A queue of code points, to which an NfdIter appends everything it reads,
+    // in NFD order, as soon as the order is known. That is usually before the
+    // code points are returned from the iterator, and always before any are
+    // moved by `shift_backwards`. This lets the collation code compare strings
+    // by code point while it compares their collation elements, rather than
+    // normalizing them a second time.
+    class CodePointLog {
+    public:
+      inline CodePointLog() :
+        active(true),
+        start(0),
+        len(0),
+        cap(INLINE_CAP),
+        buf(inline_buf)
+      { }
+
+      inline ~CodePointLog() {
+        if (this->buf != this->inline_buf) {
+          free(this->buf);
+        }
+      }
+
+      CodePointLog(const CodePointLog &) = delete;
+      CodePointLog &operator=(const CodePointLog &) = delete;
+
+      inline void push(uint32_t cp) {
+        if (this->active) {
+          if (this->len == this->cap) {
+            this->grow();
+          }
+          this->buf[this->len] = cp;
+          this->len++;
+        }
+      }
+
+      // The number of code points in the queue.
+      inline uint32_t size() const {
+        return this->len - this->start;
+      }
+
+      inline const uint32_t* data() const {
+        return this->buf + this->start;
+      }
+
+      // Removes `count` code points from the start of the queue.
+      inline void pop_start(uint32_t count) {
+        this->start += count;
+        if (this->start == this->len) {
+          this->start = 0;
+          this->len = 0;
+        }
+      }
+
+      // Empties the queue and ignores all code points from now on, for when
+      // the caller has seen enough.
+      inline void stop() {
+        this->active = false;
+        this->start = 0;
+        this->len = 0;
+      }
+
+    private:
+      static constexpr uint32_t INLINE_CAP = 128;
+
+      bool active;
+      uint32_t start;
+      uint32_t len;
+      uint32_t cap;
+      uint32_t* buf;
+      uint32_t inline_buf[INLINE_CAP];
+
+      void grow();
+    };
+
     // An iterator that produces code points in Normalization Form D, based on
     // an inner iterator that produces raw code points from a string.
     class NfdIter {
@@ -46,13 +157,31 @@ namespace condict_uca {
       // Creates an NfdIter with the specified inner iterator.
       inline explicit NfdIter(CodePointIter &&str) :
         str(str),
-        buf()
+        buf(),
+        log(nullptr),
+        trusted_nfd(false)
       { }
 
-      // Creates an NfdIter from the specified string data.
-      inline NfdIter(int str_len, const char* str) :
-        str(str_len, str),
-        buf()
+      // Creates an NfdIter from the specified string data. If `log` is not
+      // null, the code points are also appended to it.
+      //
+      // If `trusted_nfd` is true, the caller guarantees that the string is
+      // already in NFD, and code points are returned as they are, without
+      // looking them up in the normalization tables. The result is undefined
+      // if the string is not in NFD. Debug builds check the guarantee.
+      //
+      // `encoding` is the encoding of the string data; see text.h.
+      inline NfdIter(
+        int str_len,
+        const char* str,
+        CodePointLog* log = nullptr,
+        bool trusted_nfd = false,
+        Encoding encoding = Encoding::UTF8
+      ) :
+        str(str_len, str, encoding),
+        buf(),
+        log(log),
+        trusted_nfd(trusted_nfd)
       { }
 
       // Fetches the next code point in the iterator.
@@ -61,7 +190,30 @@ namespace condict_uca {
       //
       //   - true: A code point was read and has been written to `result`.
       //   - false: The end of the string has been reached. `result` contains 0.
-      bool next(uint32_t &result);
+      inline bool next(uint32_t &result) {
+        if (!this->buf.is_empty()) {
+          result = this->buf.pop_start();
+          return true;
+        }
+        return this->next_unbuffered(result, false);
+      }
+
+      // Like `next`, but if nothing is buffered, a precomposed Hangul syllable
+      // is returned as it is instead of being decomposed. Syllables decompose
+      // to starters only, so the caller can treat the syllable as the jamo it
+      // decomposes to without looking at the rest of the string. Code points
+      // that were decomposed by `peek` are still returned as jamo.
+      inline bool next_keep_hangul(uint32_t &result) {
+        if (!this->buf.is_empty()) {
+          result = this->buf.pop_start();
+          return true;
+        }
+        return this->next_unbuffered(result, true);
+      }
+
+      // Reads up to `n` code points into `out`, and returns the number of code
+      // points read. Returns less than `n` only at the end of the string.
+      uint32_t next_batch(uint32_t* out, uint32_t n);
 
       // Peeks ahead by a certain amount.
       //
@@ -86,10 +238,17 @@ namespace condict_uca {
     private:
       CodePointIter str;
       TinyQueue<uint32_t, 8> buf;
+      CodePointLog* log;
+      bool trusted_nfd;
 
       // Fills the internal buffer with the next set of code points.
       bool fill_buffer();
 
+      // Fetches the next code point when the buffer is empty. Most code points
+      // are starters that don't decompose, and are returned without going
+      // through the buffer. If `keep_hangul` is true, so are Hangul syllables.
+      bool next_unbuffered(uint32_t &result, bool keep_hangul);
+
       // Scans ahead until the next deterministic state.
       //
       // "Next" does *not* mean the function will only read a single code point.
@@ -100,6 +259,13 @@ namespace condict_uca {
       // the non-starters comes first.
       bool scan_next();
 
+      // Decomposes `cp`, whose composition data is `comp_data`, into the
+      // buffer, and if necessary scans ahead as described for scan_next.
+      void decompose(uint32_t cp, CompData comp_data);
+
+      // Appends the buffered code points from index `start` to the log.
+      void log_buffered(uint32_t start);
+
       // Attempts to decompose a precomposed Hangul syllable.
       //
       // See The Unicode Standard, 3.12, Combining Jamo Behavior for details.
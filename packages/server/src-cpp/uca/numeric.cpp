@@ -0,0 +1,62 @@
+#include "numeric.h"
+
+#include <algorithm>
+
+namespace condict_uca {
+  namespace numeric {
+    // The digit zero of every script, in ascending order. Unicode encodes the
+    // decimal digits of a script as ten consecutive code points, from zero to
+    // nine, so the value of any digit is its distance from the zero.
+    //
+    // Taken from UnicodeData.txt, Unicode version 15.0.0: every code point of
+    // general category Nd with numeric value 0.
+    constexpr uint32_t ZEROS[] = {
+      0x0030, 0x0660, 0x06F0, 0x07C0, 0x0966, 0x09E6, 0x0A66, 0x0AE6,
+      0x0B66, 0x0BE6, 0x0C66, 0x0CE6, 0x0D66, 0x0DE6, 0x0E50, 0x0ED0,
+      0x0F20, 0x1040, 0x1090, 0x17E0, 0x1810, 0x1946, 0x19D0, 0x1A80,
+      0x1A90, 0x1B50, 0x1BB0, 0x1C40, 0x1C50, 0xA620, 0xA8D0, 0xA900,
+      0xA9D0, 0xA9F0, 0xAA50, 0xABF0, 0xFF10, 0x104A0, 0x10D30, 0x11066,
+      0x110F0, 0x11136, 0x111D0, 0x112F0, 0x11450, 0x114D0, 0x11650,
+      0x116C0, 0x11730, 0x118E0, 0x11950, 0x11C50, 0x11D50, 0x11DA0,
+      0x11F50, 0x16A60, 0x16AC0, 0x16B50, 0x1D7CE, 0x1D7D8, 0x1D7E2,
+      0x1D7EC, 0x1D7F6, 0x1E140, 0x1E2F0, 0x1E4F0, 0x1E950, 0x1FBF0,
+    };
+    constexpr uint32_t ZERO_COUNT = sizeof(ZEROS) / sizeof(ZEROS[0]);
+
+    // Digits are few and far between, so most code points can be ruled out
+    // without searching. The code space up to the last digit is divided into
+    // pages of 256 code points, and each page has a bit that is set if it
+    // contains any digits. No run of digits crosses a page boundary.
+    constexpr uint32_t PAGE_SHIFT = 8;
+    constexpr uint32_t PAGE_COUNT = (ZEROS[ZERO_COUNT - 1] >> PAGE_SHIFT) + 1;
+
+    struct DigitPages {
+      uint64_t bits[(PAGE_COUNT + 63) / 64];
+    };
+
+    constexpr DigitPages make_digit_pages() {
+      DigitPages pages = {};
+      for (uint32_t i = 0; i < ZERO_COUNT; i++) {
+        uint32_t page = ZEROS[i] >> PAGE_SHIFT;
+        pages.bits[page / 64] |= (uint64_t) 1 << (page % 64);
+      }
+      return pages;
+    }
+
+    constexpr DigitPages DIGIT_PAGES = make_digit_pages();
+
+    uint32_t lookup_digit(uint32_t cp) {
+      uint32_t page = cp >> PAGE_SHIFT;
+      if (
+        page >= PAGE_COUNT ||
+        (DIGIT_PAGES.bits[page / 64] >> (page % 64) & 1) == 0
+      ) {
+        return NOT_A_DIGIT;
+      }
+      // The last zero that is not after the code point.
+      const uint32_t* zero = std::upper_bound(ZEROS, ZEROS + ZERO_COUNT, cp);
+      uint32_t value = cp - zero[-1];
+      return value < 10 ? value : NOT_A_DIGIT;
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// Numeric ordering
+//
+// In numeric mode, cea::ElementIter gives every run of decimal digits the
+// collation elements of its numeric value, so that "a2" sorts before "a10".
+// This file contains the digit lookup; the weights are made in cea.cpp.
+
+namespace condict_uca {
+  namespace numeric {
+    // Returned by digit_value for code points that are not decimal digits.
+    constexpr uint32_t NOT_A_DIGIT = 10;
+
+    // The first decimal digit after the ASCII digits.
+    constexpr uint32_t FIRST_NON_ASCII_DIGIT = 0x0660;
+
+    // Looks up a code point in the table of decimal digits.
+    uint32_t lookup_digit(uint32_t cp);
+
+    // Gets the value of a decimal digit of any script, that is, a code point
+    // of general category Nd, or NOT_A_DIGIT if the code point is something
+    // else. Most text is ASCII, which never needs the table.
+    inline uint32_t digit_value(uint32_t cp) {
+      if (cp - '0' < 10) {
+        return cp - '0';
+      }
+      if (cp < FIRST_NON_ASCII_DIGIT) {
+        return NOT_A_DIGIT;
+      }
+      return lookup_digit(cp);
+    }
+  }
+}
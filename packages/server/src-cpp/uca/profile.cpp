@@ -0,0 +1,59 @@
+#include "profile.h"
+
+#ifdef CONDICT_UCA_PROFILE
+
+#include "stats.h"
+
+namespace condict_uca {
+  namespace profile {
+    thread_local ThreadState state = {};
+
+    // Finds the smallest interval between two reads of the clock.
+    uint64_t measure_overhead() {
+      uint64_t min = UINT64_MAX;
+      for (int i = 0; i < 1000; i++) {
+        uint64_t start = now();
+        uint64_t elapsed = now() - start;
+        if (elapsed < min) {
+          min = elapsed;
+        }
+      }
+      return min;
+    }
+
+    void Comparison::start(ThreadState &s) {
+      this->sampled = true;
+      if (s.overhead == 0) {
+        s.overhead = measure_overhead();
+      }
+      s.sampling = true;
+      s.stage = Stage::COMPARE;
+      s.countdown = CONDICT_UCA_PROFILE_INTERVAL - 1;
+      for (uint32_t i = 0; i < STAGE_COUNT; i++) {
+        s.cycles[i] = 0;
+      }
+      s.since = now();
+    }
+
+    void Comparison::finish(ThreadState &s) {
+      switch_stage(s, Stage::COMPARE);
+      s.sampling = false;
+
+      using stats::Counter;
+      stats::ThreadCounters &counters = stats::local();
+      counters.add(Counter::SAMPLED_COMPARISONS, 1);
+      counters.add(Counter::DECODE_CYCLES, s.cycles[(uint32_t) Stage::DECODE]);
+      counters.add(Counter::NFD_CYCLES, s.cycles[(uint32_t) Stage::NFD]);
+      counters.add(
+        Counter::ELEMENTS_CYCLES,
+        s.cycles[(uint32_t) Stage::ELEMENTS]
+      );
+      counters.add(
+        Counter::COMPARE_CYCLES,
+        s.cycles[(uint32_t) Stage::COMPARE]
+      );
+    }
+  }
+}
+
+#endif
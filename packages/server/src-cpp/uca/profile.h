@@ -0,0 +1,199 @@
+#pragma once
+
+// Profiling builds
+//
+// When CONDICT_UCA_PROFILE is defined (`node-gyp rebuild --uca_profile=1`),
+// the collation code measures where comparisons spend their time, and fires
+// USDT probes when comparisons start and end. In all other builds, the macros
+// in this file expand to nothing, and cost nothing.
+//
+// Timing: one comparison in CONDICT_UCA_PROFILE_INTERVAL is sampled. While a
+// comparison is sampled, every change of pipeline stage reads the time stamp
+// counter (or a steady clock on non-x86 CPUs), and the time since the last
+// change is charged to the stage that was running. The stages are:
+//
+// * DECODE: UTF-8 and UTF-16 decoding, in utf8::CodePointIter and
+//   utf16::CodePointIter.
+// * NFD: normalization, in nfd::NfdIter, excluding decoding.
+// * ELEMENTS: collation element lookup, including contractions, in
+//   cea::ElementIter, excluding normalization.
+// * COMPARE: everything else, mostly comparing weights.
+//
+// The totals are added to the thread's statistics (see stats.h) at the end of
+// each sampled comparison, and can be read from the unicode_collation_stats
+// table. Reading the clock has a cost of its own, which is measured and
+// subtracted, but the measurements still disturb the pipeline somewhat, so the
+// numbers are best compared between runs rather than taken at face value.
+//
+// Probes: `condict:compare_entry(a, a_len, b, b_len)` and
+// `condict:compare_return(result)` fire on every comparison, sampled or not.
+// They are only available if <sys/sdt.h> is (e.g. from systemtap-sdt-dev),
+// and are no-ops until a tracer attaches to them:
+//
+//     bpftrace -e 'usdt:./bin/condict.sqlite3-ext:condict:compare_entry
+//       { @len = hist(arg1 + arg3); }'
+
+#ifdef CONDICT_UCA_PROFILE
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define CONDICT_UCA_HAS_RDTSC 1
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+# define CONDICT_UCA_HAS_RDTSC 1
+#else
+# include <chrono>
+#endif
+
+#if defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define CONDICT_UCA_HAS_USDT 1
+# endif
+#endif
+
+#ifndef CONDICT_UCA_PROFILE_INTERVAL
+# define CONDICT_UCA_PROFILE_INTERVAL 64
+#endif
+
+namespace condict_uca {
+  namespace profile {
+    enum class Stage : uint32_t {
+      DECODE,
+      NFD,
+      ELEMENTS,
+      COMPARE,
+
+      COUNT,
+    };
+
+    constexpr uint32_t STAGE_COUNT = (uint32_t) Stage::COUNT;
+
+    // Reads the time stamp counter, or failing that, a steady clock in
+    // nanoseconds.
+    inline uint64_t now() {
+#ifdef CONDICT_UCA_HAS_RDTSC
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+      ).count();
+#endif
+    }
+
+    // The profiling state of a thread. Trivial, so that it can be accessed
+    // without guard checks.
+    struct ThreadState {
+      // True while a sampled comparison is running.
+      bool sampling;
+      Stage stage;
+      // The time of the last stage change.
+      uint64_t since;
+      // The number of comparisons until the next sample.
+      uint32_t countdown;
+      // The time it takes to read the clock, which is subtracted from every
+      // interval. Measured when the thread takes its first sample.
+      uint64_t overhead;
+      uint64_t cycles[STAGE_COUNT];
+    };
+
+    extern thread_local ThreadState state;
+
+    // Charges the time since the last change to the current stage, and makes
+    // `stage` the current stage.
+    inline void switch_stage(ThreadState &s, Stage stage) {
+      uint64_t t = now();
+      uint64_t elapsed = t - s.since;
+      if (elapsed > s.overhead) {
+        s.cycles[(uint32_t) s.stage] += elapsed - s.overhead;
+      }
+      s.since = t;
+      s.stage = stage;
+    }
+
+    // Makes a stage current for the duration of a scope, if the comparison is
+    // being sampled. Scopes can nest.
+    class StageScope {
+    public:
+      inline explicit StageScope(Stage stage) : prev(Stage::COUNT) {
+        ThreadState &s = state;
+        if (s.sampling && s.stage != stage) {
+          this->prev = s.stage;
+          switch_stage(s, stage);
+        }
+      }
+
+      inline ~StageScope() {
+        if (this->prev != Stage::COUNT) {
+          ThreadState &s = state;
+          // The comparison cannot end inside a stage, so we're still sampling.
+          switch_stage(s, this->prev);
+        }
+      }
+
+      StageScope(const StageScope &) = delete;
+      StageScope &operator=(const StageScope &) = delete;
+
+    private:
+      // The stage to return to, or COUNT if nothing changed.
+      Stage prev;
+    };
+
+    // Decides whether to sample a comparison, and fires the entry probe.
+    class Comparison {
+    public:
+      inline Comparison(int a_len, const char* a, int b_len, const char* b) :
+        sampled(false)
+      {
+#ifdef CONDICT_UCA_HAS_USDT
+        STAP_PROBE4(condict, compare_entry, a, a_len, b, b_len);
+#endif
+        ThreadState &s = state;
+        if (s.countdown == 0) {
+          this->start(s);
+        } else {
+          s.countdown--;
+        }
+      }
+
+      // Ends the comparison, and fires the return probe.
+      inline void end(int result) {
+        if (this->sampled) {
+          this->finish(state);
+        }
+#ifdef CONDICT_UCA_HAS_USDT
+        STAP_PROBE1(condict, compare_return, result);
+#endif
+      }
+
+      Comparison(const Comparison &) = delete;
+      Comparison &operator=(const Comparison &) = delete;
+
+    private:
+      bool sampled;
+
+      void start(ThreadState &s);
+
+      void finish(ThreadState &s);
+    };
+  }
+}
+
+# define CONDICT_UCA_PROFILE_STAGE(stage) \
+  ::condict_uca::profile::StageScope _profile_stage( \
+    ::condict_uca::profile::Stage::stage \
+  )
+# define CONDICT_UCA_PROFILE_COMPARE_BEGIN(a_len, a, b_len, b) \
+  ::condict_uca::profile::Comparison _profile_comparison(a_len, a, b_len, b)
+# define CONDICT_UCA_PROFILE_COMPARE_END(result) \
+  _profile_comparison.end(result)
+
+#else // CONDICT_UCA_PROFILE
+
+# define CONDICT_UCA_PROFILE_STAGE(stage) ((void) 0)
+# define CONDICT_UCA_PROFILE_COMPARE_BEGIN(a_len, a, b_len, b) ((void) 0)
+# define CONDICT_UCA_PROFILE_COMPARE_END(result) ((void) 0)
+
+#endif // CONDICT_UCA_PROFILE
@@ -0,0 +1,290 @@
+#include "sort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+
+namespace condict_uca {
+  namespace radix {
+    // Buckets that are smaller than this are sorted by insertion sort.
+    constexpr uint32_t INSERTION_SORT_CUTOFF = 32;
+
+    // Bucket 0 holds keys that end at the current depth, and bucket b + 1
+    // holds keys whose byte at the current depth is b.
+    constexpr uint32_t BUCKET_COUNT = 257;
+
+    // The fewest strings per thread. Below this, starting a thread costs
+    // more than it saves.
+    constexpr uint32_t MIN_STRINGS_PER_THREAD = 4096;
+
+    struct Entry {
+      const uint8_t* key;
+      uint32_t len;
+      // The index of the string in the input.
+      uint32_t index;
+    };
+
+    // A range of entries whose keys are equal up to `depth`, and at least
+    // `depth` bytes long.
+    struct Range {
+      uint32_t begin;
+      uint32_t end;
+      uint32_t depth;
+    };
+
+    inline uint32_t bucket_of(const Entry &e, uint32_t depth) {
+      return depth < e.len ? e.key[depth] + 1 : 0;
+    }
+
+    // Determines whether the key of `a` sorts before the key of `b`. Both
+    // keys must be equal up to `depth`.
+    inline bool key_less(const Entry &a, const Entry &b, uint32_t depth) {
+      uint32_t len = std::min(a.len, b.len) - depth;
+      // Strength 1 keys of empty strings are empty, and may be null.
+      int result = len > 0 ? memcmp(a.key + depth, b.key + depth, len) : 0;
+      return result < 0 || (result == 0 && a.len < b.len);
+    }
+
+    // A stable insertion sort.
+    void insertion_sort(Entry* entries, uint32_t count, uint32_t depth) {
+      for (uint32_t i = 1; i < count; i++) {
+        Entry e = entries[i];
+        uint32_t j = i;
+        while (j > 0 && key_less(e, entries[j - 1], depth)) {
+          entries[j] = entries[j - 1];
+          j--;
+        }
+        entries[j] = e;
+      }
+    }
+
+    // A stack of ranges that remain to be sorted. The sort is iterative, as
+    // keys with long shared prefixes would make a recursive sort recurse
+    // once per shared byte.
+    class RangeStack {
+    public:
+      inline RangeStack() : len(0) { }
+
+      inline bool empty() const {
+        return this->len == 0;
+      }
+
+      inline void push(Range range) {
+        this->ranges.reserve(this->len + 1)[this->len] = range;
+        this->len++;
+      }
+
+      inline Range pop() {
+        this->len--;
+        return this->ranges[this->len];
+      }
+
+    private:
+      Buffer<Range> ranges;
+      uint32_t len;
+    };
+
+    // Sorts the ranges on `stack`, using the same ranges of `scratch` as
+    // temporary storage. If `deferred` is not null, ranges with fewer than
+    // `min_size` entries are moved to it instead of being sorted.
+    void sort_ranges(
+      Entry* entries,
+      Entry* scratch,
+      RangeStack &stack,
+      uint32_t min_size = 0,
+      RangeStack* deferred = nullptr
+    ) {
+      uint32_t counts[BUCKET_COUNT];
+      while (!stack.empty()) {
+        Range range = stack.pop();
+        uint32_t size = range.end - range.begin;
+        if (deferred && size < min_size) {
+          deferred->push(range);
+          continue;
+        }
+        Entry* first = entries + range.begin;
+        if (size < INSERTION_SORT_CUTOFF) {
+          insertion_sort(first, size, range.depth);
+          continue;
+        }
+
+        memset(counts, 0, sizeof(counts));
+        for (uint32_t i = 0; i < size; i++) {
+          counts[bucket_of(first[i], range.depth)]++;
+        }
+
+        uint32_t only_bucket = bucket_of(first[0], range.depth);
+        if (counts[only_bucket] == size) {
+          // Every key has the same byte here, so there is nothing to move.
+          // If every key has ended, they are all equal and already sorted.
+          if (only_bucket != 0) {
+            stack.push({range.begin, range.end, range.depth + 1});
+          }
+          continue;
+        }
+
+        uint32_t offsets[BUCKET_COUNT];
+        uint32_t offset = 0;
+        for (uint32_t b = 0; b < BUCKET_COUNT; b++) {
+          offsets[b] = offset;
+          offset += counts[b];
+        }
+        Entry* temp = scratch + range.begin;
+        for (uint32_t i = 0; i < size; i++) {
+          temp[offsets[bucket_of(first[i], range.depth)]++] = first[i];
+        }
+        memcpy(first, temp, size * sizeof(Entry));
+
+        // Keys that have ended are equal, and stay in input order.
+        uint32_t start = range.begin + counts[0];
+        for (uint32_t b = 1; b < BUCKET_COUNT; b++) {
+          if (counts[b] > 1) {
+            stack.push({start, start + counts[b], range.depth + 1});
+          }
+          start += counts[b];
+        }
+      }
+    }
+
+    // Builds the keys of strings [begin, end) into `arena`, and points the
+    // entries at them.
+    void build_keys(
+      const std::string_view* strings,
+      uint32_t begin,
+      uint32_t end,
+      uint32_t strength,
+      Entry* entries,
+      Buffer<uint8_t> &arena
+    ) {
+      sort_key::KeyBuilder builder;
+      uint32_t arena_len = 0;
+      for (uint32_t i = begin; i < end; i++) {
+        const std::string_view &str = strings[i];
+        uint32_t key_len =
+          builder.build((int) str.size(), str.data(), strength);
+        if (key_len > 0) {
+          uint8_t* dest = arena.reserve(arena_len + key_len) + arena_len;
+          memcpy(dest, builder.data(), key_len);
+        }
+        entries[i] = {nullptr, key_len, i};
+        arena_len += key_len;
+      }
+      // The keys are back to back, and the arena no longer moves.
+      const uint8_t* key = arena.data();
+      for (uint32_t i = begin; i < end; i++) {
+        entries[i].key = key;
+        key += entries[i].len;
+      }
+    }
+  }
+
+  void sort(
+    const std::string_view* strings,
+    uint32_t count,
+    uint32_t* out,
+    uint32_t strength,
+    uint32_t thread_count
+  ) {
+    using radix::Entry;
+    using radix::Range;
+    using radix::RangeStack;
+
+    thread_count = std::max(
+      1u,
+      std::min(thread_count, count / radix::MIN_STRINGS_PER_THREAD)
+    );
+
+    Buffer<Entry> entries;
+    Buffer<Entry> scratch;
+    entries.reserve(count);
+    scratch.reserve(count);
+    // One arena per thread, so that threads never share a buffer that grows.
+    std::vector<Buffer<uint8_t>> arenas(thread_count);
+
+    if (thread_count == 1) {
+      radix::build_keys(
+        strings, 0, count, strength, entries.data(), arenas[0]
+      );
+    } else {
+      std::vector<std::thread> threads;
+      threads.reserve(thread_count - 1);
+      for (uint32_t t = 1; t < thread_count; t++) {
+        threads.emplace_back(
+          radix::build_keys,
+          strings,
+          (uint32_t) ((uint64_t) count * t / thread_count),
+          (uint32_t) ((uint64_t) count * (t + 1) / thread_count),
+          strength,
+          entries.data(),
+          std::ref(arenas[t])
+        );
+      }
+      radix::build_keys(
+        strings,
+        0,
+        (uint32_t) ((uint64_t) count / thread_count),
+        strength,
+        entries.data(),
+        arenas[0]
+      );
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+    }
+
+    RangeStack stack;
+    if (count > 1) {
+      stack.push({0, count, 0});
+    }
+    if (thread_count == 1) {
+      radix::sort_ranges(entries.data(), scratch.data(), stack);
+    } else {
+      // Split the input on this thread until every range is small enough to
+      // give the threads roughly even shares, then let the threads take
+      // ranges until there are none left. Ranges never overlap, so the
+      // threads need no other synchronization.
+      RangeStack deferred;
+      uint32_t min_size = count / (8 * thread_count);
+      radix::sort_ranges(
+        entries.data(),
+        scratch.data(),
+        stack,
+        min_size,
+        &deferred
+      );
+
+      std::vector<Range> work;
+      while (!deferred.empty()) {
+        work.push_back(deferred.pop());
+      }
+      uint32_t work_len = (uint32_t) work.size();
+      std::atomic<uint32_t> next(0);
+      auto run = [&]() {
+        RangeStack local;
+        uint32_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < work_len) {
+          local.push(work[i]);
+          radix::sort_ranges(entries.data(), scratch.data(), local);
+        }
+      };
+      std::vector<std::thread> threads;
+      threads.reserve(thread_count - 1);
+      for (uint32_t t = 1; t < thread_count; t++) {
+        threads.emplace_back(run);
+      }
+      run();
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      out[i] = entries[i].index;
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "sort_key.h"
+
+// Batch sorting
+//
+// Sorting strings with compare() as the comparator runs the whole collation
+// pipeline on both strings for each of the O(n log n) comparisons. sort()
+// instead builds the sort key of each string once, and sorts the keys with a
+// most-significant-digit radix sort: keys are distributed into buckets by one
+// byte at a time, and small buckets are finished with an insertion sort. Key
+// bytes are only ever compared, never decoded, so the collation code runs
+// once per string.
+
+namespace condict_uca {
+  // Sorts `count` strings, and writes the resulting order to `out`, which
+  // must have room for `count` indexes: `out[0]` is the index of the string
+  // that sorts first, and so on. Strings that compare equal at the given
+  // strength keep their relative order.
+  //
+  // If `thread_count` is greater than 1, the keys are built and the buckets
+  // are sorted on up to that many threads, including the calling thread.
+  void sort(
+    const std::string_view* strings,
+    uint32_t count,
+    uint32_t* out,
+    uint32_t strength = sort_key::MAX_STRENGTH,
+    uint32_t thread_count = 1
+  );
+}
@@ -0,0 +1,83 @@
+#include "sort_key.h"
+
+#include "cea.h"
+
+namespace condict_uca {
+  namespace sort_key {
+    constexpr uint16_t LEVEL_SEPARATOR = 0x0000;
+
+    // The number of collation elements that are read at a time.
+    constexpr uint32_t BATCH_SIZE = 32;
+
+    inline uint32_t put_weight(Buffer<uint8_t> &key, uint32_t len, uint16_t w) {
+      uint8_t* dest = key.reserve(len + 2) + len;
+      dest[0] = (uint8_t)(w >> 8);
+      dest[1] = (uint8_t)(w & 0xFF);
+      return len + 2;
+    }
+
+    template<typename Iter>
+    uint32_t KeyBuilder::build_from(Iter &iter, uint32_t strength) {
+      uint32_t len = 0;
+      uint32_t element_count = 0;
+
+      // The primary weights go straight into the key. The other levels have
+      // to wait until we've seen every element.
+      cea::Element elems[BATCH_SIZE];
+      uint32_t count;
+      while ((count = iter.next_batch(elems, BATCH_SIZE)) > 0) {
+        uint16_t* rest = this->lower_levels.reserve(
+          3 * (element_count + count)
+        );
+        rest += 3 * element_count;
+        for (uint32_t i = 0; i < count; i++) {
+          const cea::Element &e = elems[i];
+          if (e.level_1 != 0) {
+            len = put_weight(this->key, len, e.level_1);
+          }
+
+          rest[0] = e.level_2;
+          rest[1] = e.level_3;
+          rest[2] = e.level_4;
+          rest += 3;
+        }
+        element_count += count;
+      }
+
+      const uint16_t* rest = this->lower_levels.data();
+      for (uint32_t level = 0; level + 1 < strength; level++) {
+        len = put_weight(this->key, len, LEVEL_SEPARATOR);
+        for (uint32_t i = 0; i < element_count; i++) {
+          uint16_t w = rest[3 * i + level];
+          if (w != 0) {
+            len = put_weight(this->key, len, w);
+          }
+        }
+      }
+      return len;
+    }
+
+    uint32_t KeyBuilder::build(
+      int str_len,
+      const char* str,
+      uint32_t strength,
+      bool numeric
+    ) {
+      cea::ElementIter iter(
+        str_len,
+        str,
+        nullptr,
+        nullptr,
+        false,
+        Encoding::UTF8,
+        numeric
+      );
+      return this->build_from(iter, strength);
+    }
+
+    uint32_t KeyBuilder::build_reverse(int str_len, const char* str) {
+      cea::ReverseElementIter iter(str_len, str);
+      return this->build_from(iter, MAX_STRENGTH);
+    }
+  }
+}
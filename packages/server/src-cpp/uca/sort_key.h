@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer.h"
+
+// Sort keys
+//
+// A sort key is a byte string computed from a string, such that comparing the
+// sort keys of two strings byte by byte (as memcmp does, and as SQLite does
+// with blobs) gives the same result as comparing the strings themselves. It is
+// more efficient to compute sort keys once and compare them many times than to
+// run the full collation algorithm for every comparison.
+//
+// A sort key contains the non-zero weights of each level, in order, as 16-bit
+// big-endian values. The levels are separated by 0000. Since zero is lower than
+// any weight, a level that is a prefix of another sorts first, in exactly the
+// same way as in compare().
+
+namespace condict_uca {
+  namespace sort_key {
+    // The number of levels in a full sort key.
+    constexpr uint32_t MAX_STRENGTH = 4;
+
+    // Computes sort keys. An instance holds on to the memory it needs between
+    // calls, so it only ever allocates when it sees longer strings than it has
+    // seen before. Reuse instances where possible.
+    class KeyBuilder {
+    public:
+      inline KeyBuilder() { }
+
+      // Computes the sort key of a string, and returns its length in bytes.
+      // The key can be read from `data()` until the next call. If `strength`
+      // is less than MAX_STRENGTH, the key only contains that many levels,
+      // and strings that differ only at later levels get the same key. If
+      // `numeric` is true, the key orders the same way as compare_numeric().
+      uint32_t build(
+        int str_len,
+        const char* str,
+        uint32_t strength = MAX_STRENGTH,
+        bool numeric = false
+      );
+
+      // Computes the reverse sort key of a string, which orders the same way
+      // as compare_reverse(), and returns its length in bytes. The key can be
+      // read from `data()` until the next call.
+      uint32_t build_reverse(int str_len, const char* str);
+
+      inline const uint8_t* data() {
+        return this->key.data();
+      }
+
+    private:
+      Buffer<uint8_t> key;
+      // Level 2, 3 and 4 weights of every element, three per element.
+      Buffer<uint16_t> lower_levels;
+
+      template<typename Iter>
+      uint32_t build_from(Iter &iter, uint32_t strength);
+    };
+  }
+}
@@ -0,0 +1,207 @@
+#include "stats.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace condict_uca {
+  namespace stats {
+    const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+      "comparisons",
+      "bytes",
+      "code_points",
+      "slow_path",
+      "contraction_probes",
+      "contraction_matches",
+      "discontiguous_matches",
+      "queue_spills",
+      "weight_spills",
+      "log_spills",
+      "measured_nanoseconds",
+#ifdef CONDICT_UCA_PROFILE
+      "sampled_comparisons",
+      "decode_cycles",
+      "nfd_cycles",
+      "elements_cycles",
+      "compare_cycles",
+#endif
+    };
+
+    const char* counter_name(Counter counter) {
+      return COUNTER_NAMES[(uint32_t) counter];
+    }
+
+    // Keeps track of the counters of all live threads, as well as the totals
+    // of threads that have exited and the totals at the last reset.
+    class Registry {
+    public:
+      inline Registry() : retired(), baseline() { }
+
+      void add(ThreadCounters* counters) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->threads.insert(counters);
+      }
+
+      void remove(ThreadCounters* counters) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->threads.erase(counters);
+        add_to(this->retired, *counters);
+      }
+
+      Totals read() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->since_baseline(this->sum());
+      }
+
+      void reset() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->baseline = this->sum();
+      }
+
+      Totals take() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        Totals sum = this->sum();
+        Totals totals = this->since_baseline(sum);
+        this->baseline = sum;
+        return totals;
+      }
+
+    private:
+      std::mutex mutex;
+      std::unordered_set<ThreadCounters*> threads;
+      Totals retired;
+      Totals baseline;
+
+      // Must be called with the mutex held.
+      Totals sum() const {
+        Totals totals = this->retired;
+        for (const ThreadCounters* counters : this->threads) {
+          add_to(totals, *counters);
+        }
+        return totals;
+      }
+
+      // Must be called with the mutex held.
+      Totals since_baseline(Totals totals) const {
+        for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+          totals.values[i] -= this->baseline.values[i];
+        }
+        for (uint32_t i = 0; i < HISTOGRAM_SIZE; i++) {
+          totals.histogram[i] -= this->baseline.histogram[i];
+        }
+        return totals;
+      }
+
+      static void add_to(Totals &totals, const ThreadCounters &counters) {
+        for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+          totals.values[i] +=
+            counters.values[i].load(std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < HISTOGRAM_SIZE; i++) {
+          totals.histogram[i] +=
+            counters.histogram[i].load(std::memory_order_relaxed);
+        }
+      }
+    };
+
+    Registry &registry() {
+      // Never destroyed, as threads may still exit (and retire their counters)
+      // while static objects are being destroyed.
+      static Registry* const registry = new Registry();
+      return *registry;
+    }
+
+    ThreadCounters::ThreadCounters() :
+      values(),
+      histogram(),
+      measurements(0)
+    {
+      registry().add(this);
+    }
+
+    ThreadCounters::~ThreadCounters() {
+      registry().remove(this);
+    }
+
+    void ThreadCounters::add_comparison(
+      uint64_t bytes,
+      const IterCounters &left,
+      const IterCounters &right
+    ) {
+      uint64_t code_points = (uint64_t) left.code_points + right.code_points;
+
+      this->add(Counter::COMPARISONS, 1);
+      this->add(Counter::BYTES, bytes);
+      this->add(Counter::CODE_POINTS, code_points);
+      this->add(Counter::SLOW_PATH, left.slow_path + right.slow_path);
+      this->add(
+        Counter::CONTRACTION_PROBES,
+        left.contraction_probes + right.contraction_probes
+      );
+      this->add(
+        Counter::CONTRACTION_MATCHES,
+        left.contraction_matches + right.contraction_matches
+      );
+      this->add(
+        Counter::DISCONTIGUOUS_MATCHES,
+        left.discontiguous_matches + right.discontiguous_matches
+      );
+      increment(this->histogram[histogram_bucket(code_points)], 1);
+    }
+
+    ThreadCounters &local() {
+      thread_local ThreadCounters counters;
+      return counters;
+    }
+
+    Measurement::~Measurement() {
+      // A connection may be closed with a measurement running. If it's closed
+      // on another thread, that thread's counters are not ours to touch, and
+      // the owning thread keeps timing its comparisons.
+      this->stop();
+    }
+
+    void Measurement::start() {
+      this->stop();
+
+      ThreadCounters &counters = local();
+      counters.measurements++;
+      this->counters = &counters;
+      this->thread = std::this_thread::get_id();
+      this->start_comparisons = counters.get(Counter::COMPARISONS);
+      this->start_code_points = counters.get(Counter::CODE_POINTS);
+      this->start_nanoseconds = counters.get(Counter::MEASURED_NANOSECONDS);
+      this->comparisons = 0;
+      this->code_points = 0;
+      this->nanoseconds = 0;
+    }
+
+    bool Measurement::stop() {
+      if (!this->counters || this->thread != std::this_thread::get_id()) {
+        return false;
+      }
+
+      ThreadCounters &counters = *this->counters;
+      counters.measurements--;
+      this->counters = nullptr;
+      this->comparisons =
+        counters.get(Counter::COMPARISONS) - this->start_comparisons;
+      this->code_points =
+        counters.get(Counter::CODE_POINTS) - this->start_code_points;
+      this->nanoseconds =
+        counters.get(Counter::MEASURED_NANOSECONDS) - this->start_nanoseconds;
+      return true;
+    }
+
+    Totals read() {
+      return registry().read();
+    }
+
+    void reset() {
+      registry().reset();
+    }
+
+    Totals take() {
+      return registry().take();
+    }
+  }
+}
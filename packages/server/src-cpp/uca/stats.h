@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Collation statistics
+//
+// Each thread counts what the collation code does in its own set of counters,
+// so that counting is cheap: there is no contention, and the counters are
+// atomic only so that other threads can read them. Iterators collect their
+// counts in plain integers (see IterCounters), which are added to the thread's
+// counters once per comparison.
+//
+// The totals over all threads, including threads that have exited, can be
+// read at any time. Totals are exact once the threads that are counting have
+// finished their current comparison.
+//
+// A Measurement counts the comparisons of a single thread between two points,
+// such as the execution of one statement. While a thread has a measurement
+// running, its comparisons are also timed; reading the clock costs too much to
+// do it all the time.
+
+namespace condict_uca {
+  namespace stats {
+    enum class Counter : uint32_t {
+      // The number of strings compared by the collations.
+      COMPARISONS,
+      // The total length in bytes of the strings that were compared.
+      BYTES,
+      // The number of code points that were read, in NFD. Comparisons stop
+      // as soon as the result is known, so this is usually less than the
+      // number of code points in the strings.
+      CODE_POINTS,
+      // Code points whose collation elements needed more than a single table
+      // lookup or calculation: expansions, contractions (including the code
+      // points they consume) and code points with implicit weights that are
+      // not computed directly. The rest took the fast path.
+      SLOW_PATH,
+      // The number of times a contraction was looked for.
+      CONTRACTION_PROBES,
+      // The number of times a contraction was found.
+      CONTRACTION_MATCHES,
+      // The number of code points that were added to a contraction out of
+      // order, as discontiguous matches.
+      DISCONTIGUOUS_MATCHES,
+      // The number of times a TinyQueue moved to the heap or grew there.
+      QUEUE_SPILLS,
+      // The number of times a comparison's weight queue moved to the heap or
+      // grew there.
+      WEIGHT_SPILLS,
+      // The number of times a code point log (for tie breaking) moved to the
+      // heap or grew there.
+      LOG_SPILLS,
+      // The time in nanoseconds spent in comparisons that were timed, because
+      // a Measurement was running on their thread.
+      MEASURED_NANOSECONDS,
+
+#ifdef CONDICT_UCA_PROFILE
+      // Profiling builds only: the number of comparisons that were timed, and
+      // the time they spent in each stage. See profile.h.
+      SAMPLED_COMPARISONS,
+      DECODE_CYCLES,
+      NFD_CYCLES,
+      ELEMENTS_CYCLES,
+      COMPARE_CYCLES,
+#endif
+
+      COUNT,
+    };
+
+    constexpr uint32_t COUNTER_COUNT = (uint32_t) Counter::COUNT;
+
+    // Gets the name of a counter, like "comparisons".
+    const char* counter_name(Counter counter);
+
+    // The histogram of the number of code points read per comparison has one
+    // bucket for 0, and one for each power of two from 1 to 2^(N-2), with the
+    // last bucket counting everything from 2^(N-2) up.
+    constexpr uint32_t HISTOGRAM_SIZE = 12;
+
+    // Gets the histogram bucket for the specified number of code points.
+    inline uint32_t histogram_bucket(uint64_t code_points) {
+      uint32_t bucket = 0;
+      while (code_points > 0 && bucket < HISTOGRAM_SIZE - 1) {
+        code_points >>= 1;
+        bucket++;
+      }
+      return bucket;
+    }
+
+    // Gets the lowest number of code points counted by a histogram bucket.
+    inline uint64_t histogram_bucket_start(uint32_t bucket) {
+      return bucket == 0 ? 0 : (uint64_t) 1 << (bucket - 1);
+    }
+
+    // Reads a steady clock, in nanoseconds.
+    inline uint64_t now() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+      ).count();
+    }
+
+    // The counts that an element iterator collects while it runs.
+    struct IterCounters {
+      uint32_t code_points;
+      uint32_t slow_path;
+      uint32_t contraction_probes;
+      uint32_t contraction_matches;
+      uint32_t discontiguous_matches;
+    };
+
+    class ThreadCounters {
+    public:
+      ThreadCounters();
+      ~ThreadCounters();
+
+      ThreadCounters(const ThreadCounters &) = delete;
+      ThreadCounters &operator=(const ThreadCounters &) = delete;
+
+      // Adds to a counter. Only the owning thread may call this.
+      inline void add(Counter counter, uint64_t n) {
+        increment(this->values[(uint32_t) counter], n);
+      }
+
+      // Gets the current value of a counter, since the thread started.
+      inline uint64_t get(Counter counter) const {
+        return this->values[(uint32_t) counter].load(std::memory_order_relaxed);
+      }
+
+      // True if comparisons on this thread should be timed, because there is
+      // a Measurement running.
+      inline bool measuring() const {
+        return this->measurements > 0;
+      }
+
+      // Records a comparison of two strings whose total length is `bytes`.
+      // Only the owning thread may call this.
+      void add_comparison(
+        uint64_t bytes,
+        const IterCounters &left,
+        const IterCounters &right
+      );
+
+    private:
+      std::atomic<uint64_t> values[COUNTER_COUNT];
+      std::atomic<uint64_t> histogram[HISTOGRAM_SIZE];
+      // The number of running measurements. Only the owning thread uses it.
+      uint32_t measurements;
+
+      // Since only the owning thread writes to the counters, there is no
+      // need for an atomic read-modify-write.
+      static inline void increment(std::atomic<uint64_t> &value, uint64_t n) {
+        value.store(
+          value.load(std::memory_order_relaxed) + n,
+          std::memory_order_relaxed
+        );
+      }
+
+      friend struct Totals;
+      friend class Registry;
+      friend class Measurement;
+    };
+
+    // Gets the counters of the current thread.
+    ThreadCounters &local();
+
+    // Counts something that happens rarely enough that it's not worth
+    // collecting in IterCounters first.
+    inline void count(Counter counter) {
+      local().add(counter, 1);
+    }
+
+    struct Totals {
+      uint64_t values[COUNTER_COUNT];
+      uint64_t histogram[HISTOGRAM_SIZE];
+
+      inline uint64_t get(Counter counter) const {
+        return this->values[(uint32_t) counter];
+      }
+    };
+
+    // Counts the comparisons made on one thread between start() and stop().
+    // Measurements can overlap, but each one counts every comparison on its
+    // thread, not only its own.
+    class Measurement {
+    public:
+      inline Measurement() :
+        counters(nullptr),
+        start_comparisons(0),
+        start_code_points(0),
+        start_nanoseconds(0),
+        comparisons(0),
+        code_points(0),
+        nanoseconds(0)
+      { }
+
+      ~Measurement();
+
+      Measurement(const Measurement &) = delete;
+      Measurement &operator=(const Measurement &) = delete;
+
+      // True if the measurement has been started and not yet stopped.
+      inline bool running() const {
+        return this->counters != nullptr;
+      }
+
+      // Starts (or restarts) measuring on the current thread, and clears the
+      // results.
+      void start();
+
+      // Stops measuring and stores the results. Returns false, and does
+      // nothing, if the measurement is not running or was started on another
+      // thread.
+      bool stop();
+
+      // The results of the last stopped measurement: the number of
+      // comparisons, the number of code points they read and the time they
+      // took.
+      inline uint64_t comparison_count() const {
+        return this->comparisons;
+      }
+
+      inline uint64_t code_point_count() const {
+        return this->code_points;
+      }
+
+      inline uint64_t elapsed_nanoseconds() const {
+        return this->nanoseconds;
+      }
+
+    private:
+      ThreadCounters* counters;
+      std::thread::id thread;
+      uint64_t start_comparisons;
+      uint64_t start_code_points;
+      uint64_t start_nanoseconds;
+      uint64_t comparisons;
+      uint64_t code_points;
+      uint64_t nanoseconds;
+    };
+
+    // Sums the counters of all threads since the last reset.
+    Totals read();
+
+    // Resets the totals to zero.
+    void reset();
+
+    // Resets the totals to zero and returns what they were. Unlike read()
+    // followed by reset(), no counts are lost in between.
+    Totals take();
+  }
+}
@@ -0,0 +1,767 @@
+#include "tailoring.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cea.h"
+#include "utf8.h"
+
+namespace condict_uca {
+  namespace tailoring {
+    using Bucket = HashTableBucket<uint32_t>;
+    using RawElement = cea::RawElement;
+
+    // The primary weight of the first element of a marker pair.
+    constexpr uint16_t MARKER_WEIGHT = 0xFFFF;
+    // The range of weights that relations are numbered with, in the order they
+    // appear in the rules. They are all above the highest variable primary
+    // weight in the root collation, so that primaries in marker pairs are never
+    // shifted to level 4, and above every secondary and tertiary weight in the
+    // root collation, so they can be used as they are at those levels.
+    constexpr uint32_t FIRST_WEIGHT = 0x0400;
+    constexpr uint32_t LAST_WEIGHT = 0xFFFE;
+    // The longest expansion that fits in a cea::Index.
+    constexpr size_t MAX_ELEMENTS = 0x7F;
+    // Offsets within a hash table are stored as int16_t.
+    constexpr size_t MAX_TABLE_SIZE = 0x7FFF;
+
+    constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+
+    enum Strength : uint8_t {
+      IDENTICAL = 0,
+      PRIMARY = 1,
+      SECONDARY = 2,
+      TERTIARY = 3,
+    };
+
+    struct Relation {
+      Strength strength;
+      uint16_t weight;
+    };
+
+    // A tailored string, as the string it is placed after and the relations
+    // that place it there. The relations are turned into collation elements
+    // once all the rules have been read; see Compiler::build.
+    struct Entry {
+      // The root collation elements of the string that everything is relative
+      // to.
+      std::vector<RawElement> elements;
+      // At most one relation of each strength, strongest first.
+      std::vector<Relation> relations;
+    };
+
+    // The primary weights that the tailoring inserts after a primary weight of
+    // the root collation, identified by the weights of their relations, which
+    // are also their order.
+    using PrimaryInserts = std::map<uint16_t, std::vector<uint16_t>>;
+
+    struct TrieNode {
+      std::map<uint32_t, TrieNode> children;
+      uint32_t value = 0;
+    };
+
+    void append_utf8(std::string &out, uint32_t cp) {
+      if (cp < 0x80) {
+        out.push_back((char) cp);
+      } else if (cp < 0x800) {
+        out.push_back((char) (0xC0 | (cp >> 6)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+      } else if (cp < 0x10000) {
+        out.push_back((char) (0xE0 | (cp >> 12)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+      } else {
+        out.push_back((char) (0xF0 | (cp >> 18)));
+        out.push_back((char) (0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+      }
+    }
+
+    inline bool is_space(uint32_t cp) {
+      return cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r' ||
+        cp == '\f' || cp == '\v';
+    }
+
+    inline bool is_syntax(uint32_t cp) {
+      return cp == '&' || cp == '<' || cp == '=' || cp == '#' ||
+        cp == '\'' || cp == '\\';
+    }
+
+    inline int hex_value(uint32_t cp) {
+      if ('0' <= cp && cp <= '9') {
+        return (int) (cp - '0');
+      }
+      if ('a' <= cp && cp <= 'f') {
+        return (int) (cp - 'a' + 10);
+      }
+      if ('A' <= cp && cp <= 'F') {
+        return (int) (cp - 'A' + 10);
+      }
+      return -1;
+    }
+
+    class Compiler {
+    public:
+      inline Compiler(int rules_len, const char* rules, CompileError &error) :
+        rules_start(rules),
+        rules_end(rules + rules_len),
+        rules(rules_len, rules),
+        error(error),
+        next_weight(FIRST_WEIGHT),
+        entries(),
+        root_elements()
+      { }
+
+      Tailoring* compile();
+
+    private:
+      const char* rules_start;
+      const char* rules_end;
+      utf8::CodePointIter rules;
+      CompileError &error;
+      uint32_t next_weight;
+      std::map<std::vector<uint32_t>, Entry> entries;
+      Buffer<RawElement> root_elements;
+
+      inline bool at_end() const {
+        return this->rules.position() == this->rules_end;
+      }
+
+      bool fail(const char* position, const char* message);
+
+      void skip_space();
+
+      bool read_string(std::string &result);
+
+      bool read_escape(std::string &result);
+
+      bool lookup(const std::string &str, Entry &result);
+
+      bool relate(
+        const char* position,
+        Strength strength,
+        const Entry &prev,
+        Entry &result
+      );
+
+      Tailoring* build();
+
+      PrimaryInserts find_primary_inserts() const;
+
+      void make_elements(
+        const Entry &entry,
+        const PrimaryInserts &inserts,
+        std::vector<RawElement> &result
+      ) const;
+
+      void write_table(
+        const std::map<uint32_t, TrieNode> &nodes,
+        std::vector<Bucket> &out
+      );
+    };
+
+    std::vector<uint32_t> to_nfd(const std::string &str) {
+      std::vector<uint32_t> result;
+      nfd::NfdIter iter((int) str.size(), str.c_str());
+      uint32_t cp;
+      while (iter.next(cp)) {
+        result.push_back(cp);
+      }
+      return result;
+    }
+
+    bool Compiler::fail(const char* position, const char* message) {
+      this->error.offset = (uint32_t) (position - this->rules_start);
+      this->error.message = message;
+      return false;
+    }
+
+    void Compiler::skip_space() {
+      while (true) {
+        uint32_t cp = this->rules.peek();
+        if (this->at_end()) {
+          break;
+        } else if (is_space(cp)) {
+          this->rules.skip();
+        } else if (cp == '#') {
+          // Comment until end of line
+          while (!this->at_end() && cp != '\n') {
+            this->rules.skip();
+            cp = this->rules.peek();
+          }
+        } else {
+          break;
+        }
+      }
+    }
+
+    bool Compiler::read_escape(std::string &result) {
+      const char* position = this->rules.position();
+      // Skip the backslash
+      this->rules.skip();
+
+      uint32_t cp;
+      if (!this->rules.next(cp)) {
+        return this->fail(position, "incomplete escape sequence");
+      }
+
+      int digits = cp == 'u' ? 4 : cp == 'U' ? 8 : 0;
+      if (digits == 0) {
+        // Any other character stands for itself.
+        append_utf8(result, cp);
+        return true;
+      }
+
+      uint32_t value = 0;
+      for (int i = 0; i < digits; i++) {
+        int digit = hex_value(this->rules.peek());
+        if (digit < 0) {
+          return this->fail(position, "invalid escape sequence");
+        }
+        this->rules.skip();
+        value = (value << 4) | (uint32_t) digit;
+      }
+      if (value > 0x10FFFF || (value & 0xFFFFF800) == 0xD800) {
+        return this->fail(position, "invalid code point in escape sequence");
+      }
+      append_utf8(result, value);
+      return true;
+    }
+
+    bool Compiler::read_string(std::string &result) {
+      this->skip_space();
+      const char* position = this->rules.position();
+
+      while (true) {
+        uint32_t cp = this->rules.peek();
+        if (this->at_end() || is_space(cp)) {
+          break;
+        }
+
+        if (cp == '\\') {
+          if (!this->read_escape(result)) {
+            return false;
+          }
+        } else if (cp == '\'') {
+          const char* quote_position = this->rules.position();
+          this->rules.skip();
+          if (this->rules.peek() == '\'') {
+            // '' is an apostrophe
+            this->rules.skip();
+            result.push_back('\'');
+            continue;
+          }
+          while (true) {
+            if (!this->rules.next(cp)) {
+              return this->fail(quote_position, "unterminated quote");
+            }
+            if (cp == '\'') {
+              if (this->rules.peek() != '\'') {
+                break;
+              }
+              // '' inside a quote is an apostrophe
+              this->rules.skip();
+            }
+            append_utf8(result, cp);
+          }
+        } else if (is_syntax(cp)) {
+          break;
+        } else {
+          this->rules.skip();
+          append_utf8(result, cp);
+        }
+      }
+
+      if (result.empty()) {
+        return this->fail(position, "expected a string");
+      }
+      return true;
+    }
+
+    bool Compiler::lookup(const std::string &str, Entry &result) {
+      // If the string has been tailored already, continue after it.
+      auto entry = this->entries.find(to_nfd(str));
+      if (entry != this->entries.end()) {
+        result = entry->second;
+        return true;
+      }
+
+      uint32_t count = cea::get_raw_elements(
+        (int) str.size(),
+        str.c_str(),
+        this->root_elements,
+        0
+      );
+      result.elements.assign(
+        this->root_elements.data(),
+        this->root_elements.data() + count
+      );
+      result.relations.clear();
+      return true;
+    }
+
+    bool Compiler::relate(
+      const char* position,
+      Strength strength,
+      const Entry &prev,
+      Entry &result
+    ) {
+      result = prev;
+      if (strength == IDENTICAL) {
+        return true;
+      }
+
+      // When variable elements are shifted, whatever follows them is either
+      // ignored or treated as a regular element, which would put the string in
+      // the wrong place entirely. Primary relations get rid of the last root
+      // primary, so this only matters before the first.
+      if (
+        result.relations.empty() ||
+        result.relations.front().strength != PRIMARY
+      ) {
+        for (size_t i = result.elements.size(); i > 0; i--) {
+          uint16_t level_1 = result.elements[i - 1].level_1;
+          if (level_1 != 0) {
+            if (cea::is_variable_weight(level_1)) {
+              return this->fail(
+                position,
+                "cannot tailor after a variable character"
+              );
+            }
+            break;
+          }
+        }
+      }
+
+      if (this->next_weight > LAST_WEIGHT) {
+        return this->fail(position, "too many tailored strings");
+      }
+      uint16_t weight = (uint16_t) this->next_weight;
+      this->next_weight++;
+
+      // Anything the previous string was placed after at a lower level has to
+      // go: `&n < ng <<< Ng < ny` puts "ny" after "ng", not "Ng".
+      while (
+        !result.relations.empty() &&
+        result.relations.back().strength > strength
+      ) {
+        result.relations.pop_back();
+      }
+
+      if (
+        !result.relations.empty() &&
+        result.relations.back().strength == strength
+      ) {
+        // The previous string was placed after something at the same level.
+        // We go right after it.
+        result.relations.back().weight = weight;
+      } else {
+        result.relations.push_back({strength, weight});
+      }
+
+      // A primary relation may take two elements; the others, one.
+      if (
+        result.elements.size() + 2 * result.relations.size() > MAX_ELEMENTS
+      ) {
+        return this->fail(
+          position,
+          "tailored string has too many collation elements"
+        );
+      }
+      return true;
+    }
+
+    Tailoring* Compiler::compile() {
+      Entry prev;
+      bool has_reset = false;
+
+      while (true) {
+        this->skip_space();
+        if (this->at_end()) {
+          break;
+        }
+        const char* position = this->rules.position();
+        uint32_t cp = this->rules.peek();
+
+        Strength strength;
+        if (cp == '&') {
+          this->rules.skip();
+          std::string str;
+          if (!this->read_string(str) || !this->lookup(str, prev)) {
+            return nullptr;
+          }
+          has_reset = true;
+          continue;
+        } else if (cp == '<') {
+          uint8_t count = 0;
+          while (!this->at_end() && this->rules.peek() == '<') {
+            this->rules.skip();
+            count++;
+          }
+          if (count > 3) {
+            this->fail(position, "unsupported relation");
+            return nullptr;
+          }
+          strength = (Strength) count;
+        } else if (cp == '=') {
+          this->rules.skip();
+          strength = IDENTICAL;
+        } else {
+          this->fail(position, "expected '&', '<' or '='");
+          return nullptr;
+        }
+
+        if (!has_reset) {
+          this->fail(position, "expected '&' before first relation");
+          return nullptr;
+        }
+
+        std::string str;
+        if (!this->read_string(str)) {
+          return nullptr;
+        }
+        Entry next;
+        if (!this->relate(position, strength, prev, next)) {
+          return nullptr;
+        }
+        // If the string has been tailored before, the last rule wins.
+        this->entries[to_nfd(str)] = next;
+        prev = std::move(next);
+      }
+
+      if (this->entries.size() > MAX_TABLE_SIZE) {
+        this->fail(this->rules.position(), "too many tailored strings");
+        return nullptr;
+      }
+      if (this->entries.empty()) {
+        this->error.offset = 0;
+        this->error.message = nullptr;
+        return nullptr;
+      }
+      return this->build();
+    }
+
+    Tailoring* Compiler::build() {
+      Tailoring* result = new (std::nothrow) Tailoring();
+      if (!result) {
+        std::abort();
+      }
+
+      PrimaryInserts inserts = this->find_primary_inserts();
+
+      TrieNode root;
+      uint32_t data_len = 0;
+      std::vector<RawElement> elements;
+      for (auto &entry : this->entries) {
+        const std::vector<uint32_t> &key = entry.first;
+        this->make_elements(entry.second, inserts, elements);
+
+        uint16_t* data =
+          result->own_data.reserve(data_len + 3 * (uint32_t) elements.size());
+        for (size_t i = 0; i < elements.size(); i++) {
+          data[data_len + 3 * i] = elements[i].level_1;
+          data[data_len + 3 * i + 1] = elements[i].level_2;
+          data[data_len + 3 * i + 2] = elements[i].level_3;
+        }
+
+        TrieNode* node = &root;
+        for (uint32_t cp : key) {
+          node = &node->children[cp];
+        }
+        node->value = data_len | (uint32_t) (elements.size() << 24);
+        data_len += 3 * (uint32_t) elements.size();
+      }
+
+      std::vector<Bucket> buckets;
+      this->write_table(root.children, buckets);
+
+      uint32_t bucket_count = (uint32_t) buckets.size();
+      Bucket* dest = result->own_buckets.reserve(bucket_count);
+      std::copy(buckets.begin(), buckets.end(), dest);
+
+      result->buckets = dest;
+      result->bucket_count = bucket_count;
+      result->root_size = (uint16_t) root.children.size();
+      result->data = result->own_data.data();
+      result->data_size = data_len;
+      result->build_index();
+      return result;
+    }
+
+    // Finds the last element with a primary weight, which a primary relation
+    // replaces with a weight of its own. Implicit weights can't be used, since
+    // the root collation has no room between them; we recognize their second
+    // element by the missing secondary weight.
+    bool find_anchor(const std::vector<RawElement> &elements, size_t &index) {
+      for (size_t i = elements.size(); i > 0; i--) {
+        const RawElement &e = elements[i - 1];
+        if (e.level_1 != 0) {
+          index = i - 1;
+          return e.level_2 != 0;
+        }
+      }
+      return false;
+    }
+
+    PrimaryInserts Compiler::find_primary_inserts() const {
+      PrimaryInserts inserts;
+      for (auto &entry : this->entries) {
+        const Entry &e = entry.second;
+        size_t anchor;
+        if (
+          !e.relations.empty() &&
+          e.relations.front().strength == PRIMARY &&
+          find_anchor(e.elements, anchor)
+        ) {
+          inserts[e.elements[anchor].level_1].push_back(
+            e.relations.front().weight
+          );
+        }
+      }
+
+      // If there are more strings than free weights after a root weight, they
+      // all get marker pairs instead.
+      for (auto it = inserts.begin(); it != inserts.end();) {
+        std::vector<uint16_t> &weights = it->second;
+        std::sort(weights.begin(), weights.end());
+        weights.erase(
+          std::unique(weights.begin(), weights.end()),
+          weights.end()
+        );
+        uint32_t room = cea::next_primary(it->first) - it->first - 1;
+        if (weights.size() > room) {
+          it = inserts.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      return inserts;
+    }
+
+    void Compiler::make_elements(
+      const Entry &entry,
+      const PrimaryInserts &inserts,
+      std::vector<RawElement> &result
+    ) const {
+      result = entry.elements;
+      const std::vector<Relation> &relations = entry.relations;
+      size_t i = 0;
+
+      if (!relations.empty() && relations[0].strength == PRIMARY) {
+        uint16_t weight = relations[0].weight;
+        i = 1;
+
+        size_t anchor;
+        auto insert = find_anchor(result, anchor)
+          ? inserts.find(result[anchor].level_1)
+          : inserts.end();
+        if (insert != inserts.end()) {
+          // The string gets a primary weight of its own, between the anchor
+          // and the next weight in use. Weaker relations can then change the
+          // other weights of the same element, since nothing else has it.
+          const std::vector<uint16_t> &weights = insert->second;
+          uint32_t rank = (uint32_t) (
+            std::lower_bound(weights.begin(), weights.end(), weight) -
+            weights.begin()
+          );
+          RawElement e = result[anchor];
+          e.level_1 = (uint16_t) (insert->first + 1 + rank);
+          for (; i < relations.size(); i++) {
+            if (relations[i].strength == SECONDARY) {
+              e.level_2 = relations[i].weight;
+            } else {
+              e.level_3 = relations[i].weight;
+            }
+          }
+          result.resize(anchor);
+          result.push_back(e);
+          return;
+        }
+
+        RawElement marker = { MARKER_WEIGHT, 0, 0 };
+        RawElement value = { weight, 0, 0 };
+        result.push_back(marker);
+        result.push_back(value);
+      }
+
+      // Secondary and tertiary weights of relations are higher than those of
+      // the root collation, so one element is enough to sort after the string
+      // and everything that follows it at the same level.
+      for (; i < relations.size(); i++) {
+        RawElement e = { 0, 0, 0 };
+        if (relations[i].strength == SECONDARY) {
+          e.level_2 = relations[i].weight;
+        } else {
+          e.level_3 = relations[i].weight;
+        }
+        result.push_back(e);
+      }
+    }
+
+    void Tailoring::build_index() {
+      uint16_t root_size = this->root_size;
+      bool* root_flags = this->root_flags.reserve(root_size);
+      std::fill(
+        this->start_index,
+        this->start_index + START_INDEX_MASK + 1,
+        START_NONE
+      );
+      for (uint16_t i = 0; i < root_size; i++) {
+        uint32_t cp = this->buckets[i].key;
+        if (cp == EMPTY_KEY) {
+          root_flags[i] = false;
+          continue;
+        }
+        root_flags[i] = cea::starts_contraction(cp);
+
+        uint16_t &start = this->start_index[cp & START_INDEX_MASK];
+        start = start == START_NONE ? i : START_SHARED;
+      }
+
+      // Tailored strings are stored in NFD, so Hangul syllables only appear
+      // as jamo, and any table that uses them has a key in this block.
+      this->jamo = false;
+      for (uint32_t i = 0; i < this->bucket_count; i++) {
+        uint32_t cp = this->buckets[i].key;
+        if (cp != EMPTY_KEY && 0x1100 <= cp && cp <= 0x11FF) {
+          this->jamo = true;
+          break;
+        }
+      }
+    }
+
+    void Compiler::write_table(
+      const std::map<uint32_t, TrieNode> &nodes,
+      std::vector<Bucket> &out
+    ) {
+      // The table is laid out just like the generated root table: each key
+      // goes into bucket (key % size) if it can, otherwise into any free bucket
+      // that is then linked from the last bucket of the chain.
+      const Bucket empty = { EMPTY_KEY, 0, 0, 0, 0 };
+      uint32_t start = (uint32_t) out.size();
+      uint32_t size = (uint32_t) nodes.size();
+      out.resize(start + size, empty);
+
+      std::vector<const TrieNode*> slot_nodes(size, nullptr);
+      std::vector<std::pair<uint32_t, const TrieNode*>> leftovers;
+      for (auto &node : nodes) {
+        uint32_t slot = node.first % size;
+        if (slot_nodes[slot]) {
+          leftovers.emplace_back(node.first, &node.second);
+        } else {
+          out[start + slot].key = node.first;
+          out[start + slot].value = node.second.value;
+          slot_nodes[slot] = &node.second;
+        }
+      }
+
+      uint32_t free_slot = 0;
+      for (auto &node : leftovers) {
+        while (slot_nodes[free_slot]) {
+          free_slot++;
+        }
+
+        uint32_t last = node.first % size;
+        while (out[start + last].next_offset != 0) {
+          last = (uint32_t) ((int32_t) last + out[start + last].next_offset);
+        }
+        out[start + last].next_offset =
+          (int16_t) ((int32_t) free_slot - (int32_t) last);
+
+        out[start + free_slot].key = node.first;
+        out[start + free_slot].value = node.second->value;
+        slot_nodes[free_slot] = node.second;
+      }
+
+      // Continuation tables come after this one. Note that `out` may be
+      // reallocated, so we can't hold on to pointers into it.
+      for (uint32_t i = 0; i < size; i++) {
+        const TrieNode* node = slot_nodes[i];
+        if (!node->children.empty()) {
+          uint32_t cont_idx = (uint32_t) out.size();
+          this->write_table(node->children, out);
+          out[start + i].cont_idx = cont_idx;
+          out[start + i].cont_count = (uint16_t) node->children.size();
+        }
+      }
+    }
+
+    // The cache of compiled tailorings, keyed by their rules. A tailoring is
+    // kept for as long as somebody is using it.
+    class Cache {
+    public:
+      static const Tailoring* acquire(
+        int rules_len,
+        const char* rules,
+        CompileError &error
+      ) {
+        std::string key(rules, rules_len);
+
+        std::lock_guard<std::mutex> guard(lock());
+        auto &cached = entries();
+        auto entry = cached.find(key);
+        if (entry != cached.end()) {
+          entry->second->ref_count++;
+          return entry->second;
+        }
+
+        Compiler compiler(rules_len, rules, error);
+        Tailoring* result = compiler.compile();
+        if (result) {
+          result->ref_count = 1;
+          cached.emplace(std::move(key), result);
+        }
+        return result;
+      }
+
+      static void release(const Tailoring* tailoring) {
+        if (!tailoring) {
+          return;
+        }
+
+        std::lock_guard<std::mutex> guard(lock());
+        auto &cached = entries();
+        for (auto entry = cached.begin(); entry != cached.end(); ++entry) {
+          if (entry->second == tailoring) {
+            entry->second->ref_count--;
+            if (entry->second->ref_count == 0) {
+              delete entry->second;
+              cached.erase(entry);
+            }
+            return;
+          }
+        }
+      }
+
+    private:
+      static std::mutex &lock() {
+        static std::mutex instance;
+        return instance;
+      }
+
+      static std::unordered_map<std::string, Tailoring*> &entries() {
+        static std::unordered_map<std::string, Tailoring*> instance;
+        return instance;
+      }
+    };
+
+    const Tailoring* acquire(
+      int rules_len,
+      const char* rules,
+      CompileError &error
+    ) {
+      return Cache::acquire(rules_len, rules, error);
+    }
+
+    void release(const Tailoring* tailoring) {
+      Cache::release(tailoring);
+    }
+  }
+}
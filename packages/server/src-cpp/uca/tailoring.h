@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+
+#include "buffer.h"
+#include "hash_table.h"
+
+// Tailorings
+//
+// A tailoring changes the order of some strings relative to the root collation,
+// such as to put "ng" after "n", or "þ" after "t". Tailorings are described by
+// rule strings in (a subset of) the CLDR syntax, like:
+//
+//   &n < ng <<< Ng <<< NG
+//   &t < þ <<< Þ
+//
+// `&x` resets the insertion point to right after `x`, and each of `<`, `<<`,
+// `<<<` and `=` inserts the following string after the previous one, with
+// a primary, secondary, tertiary or no difference respectively. Characters
+// that are part of the syntax can be quoted with '...' or escaped with `\`.
+// Whitespace is ignored, and `#` starts a comment that runs to the end of the
+// line.
+//
+// Rules are compiled into an overlay on top of the root collation: a table of
+// (possibly single-character) contractions, in the same format as the root
+// contraction table, that map tailored strings to collation elements of their
+// own. Everything else falls through to the root tables.
+//
+// The root collation leaves a few primary weights unused after most of its
+// own. A string that is placed after another with a primary difference gets
+// the collation elements of that string, with the last primary weight replaced
+// by one of the unused weights after it, so it has no more elements than the
+// string itself. Strings placed at the same point get the unused weights in
+// the order they were given. Secondary and tertiary relations after such a
+// string change the other weights of the same element, which nothing else
+// shares.
+//
+// If there is no room after a weight, the strings placed after it get the
+// elements of the previous string followed by a marker pair instead: one
+// element with the primary weight FFFF, which the root collation does not use,
+// and one with a weight that increases for each string. A secondary or
+// tertiary relation after a root string adds one element with a weight above
+// every weight of the root collation at that level.
+
+namespace condict_uca {
+  namespace tailoring {
+    // A compiled tailoring. Instances are immutable and can be shared between
+    // threads.
+    class Tailoring {
+    public:
+      // Finds the bucket for the specified code point in the root of the
+      // contraction table, or returns nullptr if no tailored string starts
+      // with that code point.
+      inline const HashTableBucket<uint32_t>* find_start(uint32_t cp) const {
+        // Most code points can be found without hashing, through the start
+        // index. Only code points that share an index entry have to go through
+        // hash_find().
+        uint16_t i = this->start_index[cp & START_INDEX_MASK];
+        if (i == START_NONE) {
+          return nullptr;
+        }
+        if (i == START_SHARED) {
+          return hash_find(cp, this->root_size, this->buckets);
+        }
+        const HashTableBucket<uint32_t>* bucket = this->buckets + i;
+        return bucket->key == cp ? bucket : nullptr;
+      }
+
+      // Determines whether there are contractions in the root collation that
+      // start with the code point of the specified root bucket. If not, and
+      // the tailoring has no match, we can skip the root contraction table.
+      inline bool starts_root_contraction(
+        const HashTableBucket<uint32_t>* root
+      ) const {
+        return this->root_flags[(uint32_t) (root - this->buckets)];
+      }
+
+      // Determines whether any tailored string contains a conjoining jamo.
+      // If so, precomposed Hangul syllables must be decomposed to jamo and
+      // looked up one by one; otherwise they can use the root weights.
+      inline bool tailors_jamo() const {
+        return this->jamo;
+      }
+
+      inline const HashTableBucket<uint32_t>* contractions() const {
+        return this->buckets;
+      }
+
+      // The total number of buckets in the contraction table, including all
+      // continuation tables.
+      inline uint32_t contraction_count() const {
+        return this->bucket_count;
+      }
+
+      // The number of buckets in the root of the contraction table.
+      inline uint16_t root_contraction_count() const {
+        return this->root_size;
+      }
+
+      // Collation elements as (level 1, level 2, level 3) triples, pointed to
+      // by the values of the contraction table.
+      inline const uint16_t* cea_data() const {
+        return this->data;
+      }
+
+      // The number of values (not triples) in `cea_data()`.
+      inline uint32_t cea_data_size() const {
+        return this->data_size;
+      }
+
+    private:
+      static constexpr uint32_t START_INDEX_MASK = 0xFFF;
+      static constexpr uint16_t START_NONE = 0xFFFF;
+      static constexpr uint16_t START_SHARED = 0xFFFE;
+
+      // Compiled tailorings own their tables, and these point into own_buckets
+      // and own_data. Precompiled tailorings point to static data.
+      const HashTableBucket<uint32_t>* buckets;
+      uint32_t bucket_count;
+      uint16_t root_size;
+      const uint16_t* data;
+      uint32_t data_size;
+      Buffer<HashTableBucket<uint32_t>> own_buckets;
+      Buffer<uint16_t> own_data;
+      // For each root bucket, whether the root collation has contractions that
+      // start with the same code point.
+      Buffer<bool> root_flags;
+      // Maps the low bits of a code point to the index of the root bucket that
+      // holds it, or START_NONE or START_SHARED.
+      uint16_t start_index[START_INDEX_MASK + 1];
+      // Whether any key in the contraction table is a conjoining jamo.
+      bool jamo;
+
+      // The number of users of the tailoring. Protected by the cache's lock.
+      uint32_t ref_count;
+
+      inline Tailoring() :
+        buckets(nullptr),
+        bucket_count(0),
+        root_size(0),
+        data(nullptr),
+        data_size(0),
+        own_buckets(),
+        own_data(),
+        root_flags(),
+        start_index{},
+        jamo(false),
+        ref_count(0)
+      { }
+
+      inline Tailoring(
+        const HashTableBucket<uint32_t>* buckets,
+        uint32_t bucket_count,
+        uint16_t root_size,
+        const uint16_t* data,
+        uint32_t data_size
+      ) :
+        buckets(buckets),
+        bucket_count(bucket_count),
+        root_size(root_size),
+        data(data),
+        data_size(data_size),
+        own_buckets(),
+        own_data(),
+        root_flags(),
+        start_index{},
+        jamo(false),
+        ref_count(0)
+      {
+        this->build_index();
+      }
+
+      // Fills in `root_flags`, `start_index` and `jamo` from the contraction
+      // table.
+      void build_index();
+
+      friend class Compiler;
+      friend class Cache;
+      friend class Locales;
+    };
+
+    struct CompileError {
+      // The byte offset in the rules at which the error was found.
+      uint32_t offset;
+      // A static string that describes the error.
+      const char* message;
+    };
+
+    // Gets a compiled tailoring for the specified rules. Compiled rules are
+    // cached, so calling this function again with the same rules is cheap,
+    // as long as the previous tailoring has not been released. Every
+    // successful call must be paired with a call to `release`.
+    //
+    // If the rules are invalid, returns nullptr and writes the reason to
+    // `error`. If the rules do not tailor anything, also returns nullptr,
+    // with `error.message` set to nullptr, as there's no need for a tailoring.
+    const Tailoring* acquire(
+      int rules_len,
+      const char* rules,
+      CompileError &error
+    );
+
+    // Releases a tailoring that was obtained from `acquire`. It is safe to
+    // pass nullptr to this function.
+    void release(const Tailoring* tailoring);
+
+    // The names of the CLDR locales that have precompiled tailorings, such as
+    // "sv" or "tr", terminated by nullptr.
+    extern const char* const locale_names[];
+
+    // Gets the precompiled tailoring of one of the `locale_names`, or nullptr
+    // if the locale uses the root collation as-is. Precompiled tailorings live
+    // for as long as the program, and must not be passed to `release`.
+    const Tailoring* get_locale(const char* name);
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+
+#include "utf8.h"
+#include "utf16.h"
+
+namespace condict_uca {
+  // The encodings that strings can be collated in. They match the text
+  // encodings of SQLite, which can call a collation with text in any of them.
+  enum class Encoding : uint8_t {
+    UTF8,
+    UTF16LE,
+    UTF16BE,
+  };
+
+  namespace text {
+    // An iterator that produces the code points of a string in any of the
+    // supported encodings. The encoding is fixed for the whole string, so the
+    // branch on it is very predictable, and UTF-8 strings cost little more
+    // than with utf8::CodePointIter.
+    class CodePointIter {
+    public:
+      inline CodePointIter(int str_len, const char* str, Encoding encoding) :
+        encoding(encoding)
+      {
+        if (encoding == Encoding::UTF8) {
+          new (&this->utf8) utf8::CodePointIter(str_len, str);
+        } else {
+          new (&this->utf16) utf16::CodePointIter(
+            str_len,
+            str,
+            encoding == Encoding::UTF16BE
+          );
+        }
+      }
+
+      inline bool next(uint32_t &result) {
+        return this->encoding == Encoding::UTF8
+          ? this->utf8.next(result)
+          : this->utf16.next(result);
+      }
+
+      // Reads up to `n` code points into `out`, and returns the number of code
+      // points read. Returns less than `n` only at the end of the string.
+      inline uint32_t next_batch(uint32_t* out, uint32_t n) {
+        return this->encoding == Encoding::UTF8
+          ? this->utf8.next_batch(out, n)
+          : this->utf16.next_batch(out, n);
+      }
+
+      inline uint32_t peek() {
+        return this->encoding == Encoding::UTF8
+          ? this->utf8.peek()
+          : this->utf16.peek();
+      }
+
+      inline void skip() {
+        uint32_t _cp;
+        this->next(_cp);
+      }
+
+      // Returns a pointer to the current position in the string, that is, the
+      // first byte of the code point that will be returned next.
+      inline const char* position() const {
+        return this->encoding == Encoding::UTF8
+          ? this->utf8.position()
+          : this->utf16.position();
+      }
+
+    private:
+      Encoding encoding;
+      // Both iterators are trivially copyable and destructible, so the union
+      // needs no special care.
+      union {
+        utf8::CodePointIter utf8;
+        utf16::CodePointIter utf16;
+      };
+    };
+  }
+}
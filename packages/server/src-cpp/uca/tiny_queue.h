@@ -3,6 +3,8 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "stats.h"
+
 namespace condict_uca {
   // This class implements a tiny queue as a ring buffer, whose storage lives
   // on the stack by default, but is automatically moved to the heap as items
@@ -58,6 +60,7 @@ namespace condict_uca {
 
     inline void skip(uint32_t count) {
       this->start = (this->start + count) % this->capacity();
+      this->len -= count;
     }
 
     inline void shift_backwards(uint32_t from, uint32_t to) {
@@ -94,6 +97,16 @@ namespace condict_uca {
       }
     }
 
+    T pop_end() {
+      this->len--;
+      uint32_t i = this->start + this->len;
+      if (this->on_heap) {
+        return this->heap.buf[i % this->heap.capacity];
+      } else {
+        return this->stack_buf[i % INIT_CAP];
+      }
+    }
+
     void push_end(T value) {
       if (this->len == this->capacity()) {
         this->grow();
@@ -121,6 +134,8 @@ namespace condict_uca {
     };
 
     void grow() {
+      stats::count(stats::Counter::QUEUE_SPILLS);
+
       uint32_t old_capacity;
       T* old_buf;
       if (this->on_heap) {
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+#include "buffer.h"
+#include "nfd.h"
+
+// Code point tries
+//
+// The tables in comp_data.inc and cea_data.inc (or a data file) are laid out
+// for size on disk, with one separate array per lookup stage and values that
+// often need a second lookup. At startup, we rebuild them into tries that are
+// laid out for lookup speed instead: every value is found in one leaf, the
+// index stages share one allocation of 16-bit block numbers, and identical
+// blocks are stored once.
+//
+// The most frequently used code points, which cover Latin, Greek, Cyrillic,
+// Armenian and common punctuation, are also stored in a dense "hot block" that
+// is indexed directly by code point. Text in those scripts touches one cache
+// line per code point rather than one for each stage.
+
+namespace condict_uca {
+  // The first hot range: U+0000 to U+052F.
+  constexpr uint32_t HOT_LOW_END = 0x0530;
+  // The second hot range: General Punctuation, U+2000 to U+206F.
+  constexpr uint32_t HOT_PUNCT_START = 0x2000;
+  constexpr uint32_t HOT_PUNCT_SIZE = 0x0070;
+  constexpr uint32_t HOT_SIZE = HOT_LOW_END + HOT_PUNCT_SIZE;
+
+  // A two-stage trie that maps code points to values of type T, which must be
+  // trivially copyable. Code points above `last` map to a default value. Each
+  // leaf block contains 2^LeafShift values, and each index block selects
+  // 2^IndexShift leaf blocks.
+  template<typename T, uint32_t LeafShift, uint32_t IndexShift>
+  class Trie {
+  public:
+    static constexpr uint32_t LEAF_SHIFT = LeafShift;
+    static constexpr uint32_t LEAF_SIZE = 1 << LEAF_SHIFT;
+    static constexpr uint32_t LEAF_MASK = LEAF_SIZE - 1;
+    static constexpr uint32_t INDEX_SHIFT = IndexShift;
+    static constexpr uint32_t INDEX_SIZE = 1 << INDEX_SHIFT;
+    static constexpr uint32_t INDEX_MASK = INDEX_SIZE - 1;
+    static constexpr uint32_t TOP_SHIFT = LEAF_SHIFT + INDEX_SHIFT;
+
+    // Leaf blocks are numbered with 16 bits, which limits the number of code
+    // points that can be stored.
+    static constexpr uint32_t MAX_CODE_POINT = (0x10000 << LEAF_SHIFT) - 1;
+
+    // Builds a trie from the function `lookup`, which receives a code point
+    // and must return its value. `last` must be at most MAX_CODE_POINT.
+    template<typename F>
+    Trie(uint32_t last, T default_value, F lookup);
+
+    Trie(const Trie &) = delete;
+    Trie &operator=(const Trie &) = delete;
+
+    inline T get(uint32_t cp) const {
+      if (cp < HOT_LOW_END) {
+        return this->hot[cp];
+      }
+      if (cp - HOT_PUNCT_START < HOT_PUNCT_SIZE) {
+        return this->hot[HOT_LOW_END + cp - HOT_PUNCT_START];
+      }
+      if (cp > this->last) {
+        return this->default_value;
+      }
+
+      const uint16_t* index = this->index.data();
+      uint32_t block =
+        ((uint32_t) index[this->top_start + (cp >> TOP_SHIFT)] << INDEX_SHIFT) |
+        ((cp >> LEAF_SHIFT) & INDEX_MASK);
+      uint32_t leaf =
+        ((uint32_t) index[block] << LEAF_SHIFT) | (cp & LEAF_MASK);
+      return this->leaf[leaf];
+    }
+
+    // The total size of the trie, in bytes.
+    inline uint32_t byte_size() const {
+      return
+        sizeof(this->hot) +
+        this->index_len * sizeof(uint16_t) +
+        this->leaf_len * sizeof(T);
+    }
+
+  private:
+    T hot[HOT_SIZE];
+    uint32_t last;
+    T default_value;
+    // The index blocks, followed by the top stage, which selects an index
+    // block for every 2^TOP_SHIFT code points. The index blocks select a leaf
+    // block.
+    // Both stages store block numbers rather than offsets.
+    Buffer<uint16_t> index;
+    uint32_t index_len;
+    uint32_t top_start;
+    Buffer<T> leaf;
+    uint32_t leaf_len;
+
+    // Appends a block to `buf` unless an identical block has already been
+    // added, and returns its block number.
+    template<typename U>
+    static uint32_t add_block(
+      std::unordered_map<std::string, uint32_t> &blocks,
+      Buffer<U> &buf,
+      uint32_t &len,
+      const U* block,
+      uint32_t block_size
+    );
+  };
+
+  template<typename T, uint32_t LeafShift, uint32_t IndexShift>
+  template<typename F>
+  Trie<T, LeafShift, IndexShift>::Trie(
+    uint32_t last,
+    T default_value,
+    F lookup
+  ) :
+    hot(),
+    last(last),
+    default_value(default_value),
+    index(),
+    index_len(0),
+    top_start(0),
+    leaf(),
+    leaf_len(0)
+  {
+    for (uint32_t cp = 0; cp < HOT_LOW_END; cp++) {
+      this->hot[cp] = cp <= last ? lookup(cp) : default_value;
+    }
+    for (uint32_t i = 0; i < HOT_PUNCT_SIZE; i++) {
+      uint32_t cp = HOT_PUNCT_START + i;
+      this->hot[HOT_LOW_END + i] = cp <= last ? lookup(cp) : default_value;
+    }
+
+    uint32_t top_count = (last >> TOP_SHIFT) + 1;
+    Buffer<uint16_t> top;
+    top.reserve(top_count);
+
+    std::unordered_map<std::string, uint32_t> leaf_blocks;
+    std::unordered_map<std::string, uint32_t> index_blocks;
+    T leaf_block[LEAF_SIZE];
+    uint16_t index_block[INDEX_SIZE];
+    for (uint32_t i = 0; i < top_count; i++) {
+      for (uint32_t j = 0; j < INDEX_SIZE; j++) {
+        uint32_t base = (i << TOP_SHIFT) | (j << LEAF_SHIFT);
+        for (uint32_t k = 0; k < LEAF_SIZE; k++) {
+          uint32_t cp = base | k;
+          leaf_block[k] = cp <= last ? lookup(cp) : default_value;
+        }
+        index_block[j] = (uint16_t) add_block(
+          leaf_blocks,
+          this->leaf,
+          this->leaf_len,
+          leaf_block,
+          LEAF_SIZE
+        );
+      }
+      top[i] = (uint16_t) add_block(
+        index_blocks,
+        this->index,
+        this->index_len,
+        index_block,
+        INDEX_SIZE
+      );
+    }
+
+    // Put the top stage after the index blocks, in the same allocation.
+    this->top_start = this->index_len;
+    uint16_t* dest = this->index.reserve(this->index_len + top_count);
+    memcpy(dest + this->top_start, top.data(), top_count * sizeof(uint16_t));
+    this->index_len += top_count;
+  }
+
+  template<typename T, uint32_t LeafShift, uint32_t IndexShift>
+  template<typename U>
+  uint32_t Trie<T, LeafShift, IndexShift>::add_block(
+    std::unordered_map<std::string, uint32_t> &blocks,
+    Buffer<U> &buf,
+    uint32_t &len,
+    const U* block,
+    uint32_t block_size
+  ) {
+    std::string key(
+      reinterpret_cast<const char*>(block),
+      block_size * sizeof(U)
+    );
+    auto existing = blocks.find(key);
+    if (existing != blocks.end()) {
+      return existing->second;
+    }
+
+    uint32_t number = len / block_size;
+    U* dest = buf.reserve(len + block_size);
+    memcpy(dest + len, block, block_size * sizeof(U));
+    len += block_size;
+    blocks.emplace(std::move(key), number);
+    return number;
+  }
+
+  // The tries for the collation and normalization data. Collation elements
+  // are stored in larger blocks since there are many runs of similar code
+  // points that share a value, such as Han ideographs with implicit weights.
+  using CollationTrie = Trie<uint32_t, 4, 6>;
+  using NormalizationTrie = Trie<nfd::CompData, 3, 5>;
+}
@@ -1,237 +1,457 @@
 #include "uca.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
 
 #include "cea.h"
+#include "data.h"
 #include "nfd.h"
+#include "profile.h"
+#include "stats.h"
+#include "weights.h"
 
 namespace condict_uca {
-  struct WeightPair {
-    uint16_t left;
-    uint16_t right;
+  // The number of elements that are read from each string at a time. Strings
+  // often differ in the first few elements, so we start small and read bigger
+  // chunks as long as the strings are still equal.
+  constexpr uint32_t FIRST_CHUNK_SIZE = 2;
+  constexpr uint32_t MAX_CHUNK_SIZE = 64;
+
+  constexpr uint32_t LEVEL_COUNT = 4;
+
+  // The weights of a chunk of collation elements, with one array per level.
+  struct ElementChunk {
+    uint16_t weights[LEVEL_COUNT][MAX_CHUNK_SIZE];
+    uint32_t len;
   };
 
-  class WeightBuf {
+  // Reads up to `size` elements from the iterator into `chunk`. Returns false
+  // if the iterator ran out of elements.
+  template<typename Iter>
+  inline bool fill_chunk(Iter &iter, ElementChunk &chunk, uint32_t size) {
+    cea::Element elems[MAX_CHUNK_SIZE];
+    uint32_t len = iter.next_batch(elems, size);
+    for (uint32_t i = 0; i < len; i++) {
+      chunk.weights[0][i] = elems[i].level_1;
+      chunk.weights[1][i] = elems[i].level_2;
+      chunk.weights[2][i] = elems[i].level_3;
+      chunk.weights[3][i] = elems[i].level_4;
+    }
+    chunk.len = len;
+    return len == size;
+  }
+
+  // The non-zero weights of one string at one level that have not yet been
+  // compared against the other string.
+  class WeightQueue {
   public:
-    inline WeightBuf() :
-      start(0),
-      left_len(0),
-      right_len(0),
-      result(0),
-      on_heap(false),
-      stack_buf{}
+    inline WeightQueue() :
+      len(0),
+      cap(INLINE_CAP),
+      buf(inline_buf)
     { }
 
-    ~WeightBuf() {
-      if (this->on_heap) {
-        free(this->heap.buf);
+    inline ~WeightQueue() {
+      if (this->buf != this->inline_buf) {
+        free(this->buf);
       }
     }
 
-    inline uint32_t capacity() const {
-      return this->on_heap ? this->heap.capacity : STACK_CAP;
+    WeightQueue(const WeightQueue &) = delete;
+    WeightQueue &operator=(const WeightQueue &) = delete;
+
+    inline uint32_t size() const {
+      return this->len;
     }
 
-    int push(uint16_t left, uint16_t right) {
-      if (this->result == 0) {
-        if (left) {
-          this->push_left(left);
-        }
-        if (right) {
-          this->push_right(right);
-        }
+    inline const uint16_t* data() const {
+      return this->buf;
+    }
 
-        if (this->left_len > 0 && this->right_len > 0) {
-          WeightPair* next = &this->buf()[this->start];
-          // We never push zero-weights, so we don't need to check whether
-          // one of the weights is zero.
-          if (next->left < next->right) {
-            this->result = -1;
-          } else if (next->left > next->right) {
-            this->result = 1;
-          } else {
-            // left == right, still not settled. Move on to the next pair!
-            next->left = 0;
-            next->right = 0;
-            this->start = (this->start + 1) % this->capacity();
-            this->left_len--;
-            this->right_len--;
-          }
+    // Compresses `count` weights onto the end of the queue, skipping zeros.
+    inline void push(const uint16_t* src, uint32_t count) {
+      if (this->len + count > this->cap) {
+        this->grow(this->len + count);
+      }
+      this->len += weights::compress(
+        src,
+        count,
+        this->buf + this->len
+      );
+    }
+
+    // Removes `count` weights from the start of the queue.
+    inline void pop_start(uint32_t count) {
+      this->len -= count;
+      if (this->len > 0) {
+        memmove(this->buf, this->buf + count, this->len * sizeof(uint16_t));
+      }
+    }
+
+  private:
+    // Equal weights are removed as soon as both strings have them, so the
+    // queues are usually short.
+    static const uint32_t INLINE_CAP = 2 * MAX_CHUNK_SIZE;
+
+    uint32_t len;
+    uint32_t cap;
+    uint16_t* buf;
+    uint16_t inline_buf[INLINE_CAP];
+
+    void grow(uint32_t min_capacity) {
+      uint32_t new_capacity = this->cap * 2;
+      while (new_capacity < min_capacity) {
+        new_capacity *= 2;
+      }
+      stats::count(stats::Counter::WEIGHT_SPILLS);
+
+      uint16_t* new_buf;
+      if (this->buf == this->inline_buf) {
+        new_buf = reinterpret_cast<uint16_t*>(
+          malloc(new_capacity * sizeof(uint16_t))
+        );
+        if (new_buf) {
+          memcpy(new_buf, this->inline_buf, this->len * sizeof(uint16_t));
         }
+      } else {
+        new_buf = reinterpret_cast<uint16_t*>(
+          realloc(this->buf, new_capacity * sizeof(uint16_t))
+        );
+      }
+      if (!new_buf) {
+        // What else can we do? If we throw an exception, we *will* cause
+        // problems in non-C++ frames.
+        std::abort();
+      }
+      this->buf = new_buf;
+      this->cap = new_capacity;
+    }
+  };
+
+  // Compares the weights of two strings at one level. The weights are added a
+  // chunk at a time, and compared as soon as both strings have them.
+  class LevelComparer {
+  public:
+    inline LevelComparer() : result(0) { }
+
+    int push(
+      const uint16_t* left_weights,
+      uint32_t left_count,
+      const uint16_t* right_weights,
+      uint32_t right_count
+    ) {
+      this->left.push(left_weights, left_count);
+      this->right.push(right_weights, right_count);
+
+      uint32_t count = std::min(this->left.size(), this->right.size());
+      const uint16_t* l = this->left.data();
+      const uint16_t* r = this->right.data();
+      uint32_t i = weights::mismatch(l, r, count);
+      if (i < count) {
+        this->result = l[i] < r[i] ? -1 : 1;
+      } else {
+        // Still not settled. Drop the weights we've compared, which leaves
+        // at most one non-empty queue.
+        this->left.pop_start(count);
+        this->right.pop_start(count);
       }
       return this->result;
     }
 
-    int final_result() {
+    int final_result() const {
       if (this->result == 0) {
-        // Weights are reset to 0 when pairs are removed, so we can safely
-        // compare whatever is in the next pair. Similarly, pairs that are
-        // equal are also removed from the buffer when added, so we don't
-        // need to look past the very next pair.
-        WeightPair next = this->buf()[this->start];
-        if (next.left < next.right) {
-          this->result = -1;
-        } else if (next.left > next.right) {
-          this->result = 1;
+        // Everything that both strings have has been compared and found to be
+        // equal. If one string has weights left, it sorts after the other.
+        if (this->left.size() > 0) {
+          return 1;
+        }
+        if (this->right.size() > 0) {
+          return -1;
         }
-        // otherwise, fall through for 0
       }
       return this->result;
     }
 
   private:
-    static const uint32_t STACK_CAP = 8;
-
-    uint32_t start;
-    uint32_t left_len;
-    uint32_t right_len;
-    int8_t result;
-    bool on_heap;
-    union {
-      WeightPair stack_buf[STACK_CAP];
-      struct {
-        uint32_t capacity;
-        WeightPair* buf;
-      } heap;
-    };
+    WeightQueue left;
+    WeightQueue right;
+    int result;
+  };
 
-    void push_left(uint16_t value) {
-      this->get_pair(this->left_len)->left = value;
-      this->left_len++;
-    }
+  // Compares two strings by their code points in NFD, which breaks ties
+  // between strings whose collation elements are equal. The code points are
+  // logged by the NfdIters of the element iterators, and compared a chunk at
+  // a time, so that each string is only normalized once.
+  class CodePointComparer {
+  public:
+    nfd::CodePointLog left;
+    nfd::CodePointLog right;
 
-    void push_right(uint16_t value) {
-      this->get_pair(this->right_len)->right = value;
-      this->right_len++;
-    }
+    inline CodePointComparer() : left(), right(), result(0) { }
 
-    WeightPair* get_pair(uint32_t index) {
-      if (index == this->capacity()) {
-        this->grow();
+    // Compares the code points that both strings have logged since the last
+    // call.
+    void update() {
+      if (this->result != 0) {
+        return;
       }
 
-      if (this->on_heap) {
-        return &this->heap.buf[(index + this->start) % this->heap.capacity];
-      } else {
-        return &this->stack_buf[(index + this->start) % STACK_CAP];
+      uint32_t count = std::min(this->left.size(), this->right.size());
+      const uint32_t* l = this->left.data();
+      const uint32_t* r = this->right.data();
+      for (uint32_t i = 0; i < count; i++) {
+        if (l[i] != r[i]) {
+          this->result = l[i] < r[i] ? -1 : 1;
+          // We know the answer, and the logs are no longer needed.
+          this->left.stop();
+          this->right.stop();
+          return;
+        }
       }
+      this->left.pop_start(count);
+      this->right.pop_start(count);
     }
 
-    inline WeightPair* buf() {
-      return this->on_heap ? this->heap.buf : this->stack_buf;
+    // Gets the result once both strings have been read to the end. As with
+    // collation elements, if one string is a prefix of the other, the
+    // shorter string sorts first.
+    int final_result() {
+      this->update();
+      if (this->result == 0) {
+        if (this->left.size() > 0) {
+          return 1;
+        }
+        if (this->right.size() > 0) {
+          return -1;
+        }
+      }
+      return this->result;
     }
 
-    void grow() {
-      uint32_t old_capacity;
-      WeightPair* old_buf;
-      if (this->on_heap) {
-        old_capacity = this->heap.capacity;
-        old_buf = this->heap.buf;
-      } else {
-        old_capacity = STACK_CAP;
-        old_buf = this->stack_buf;
-      }
+  private:
+    int result;
+  };
 
-      uint32_t new_capacity = old_capacity * 2;
-      WeightPair* new_buf = reinterpret_cast<WeightPair*>(calloc(
-        new_capacity,
-        sizeof(WeightPair)
-      ));
-      if (!new_buf) {
-        // What else can we do? If we throw an exception, we *will* cause
-        // problems in non-C++ frames.
-        std::abort();
-      }
+  // Compares the collation elements produced by two iterators. The iterators
+  // must be of a type that has a `next_batch(cea::Element* out, uint32_t n)`
+  // method. If `code_points` is not null, it must be attached to the NFD
+  // iterators of `left` and `right`, and breaks ties.
+  template<typename Iter>
+  int compare_elements(
+    Iter &left,
+    Iter &right,
+    CodePointComparer* code_points = nullptr
+  ) {
+    ElementChunk left_chunk;
+    ElementChunk right_chunk;
 
-      // We only grow when len == capacity, so we know for sure we need
-      // to copy the entire queue.
-      uint32_t start = this->start;
-      uint32_t count = old_capacity - start;
-      memcpy(new_buf, old_buf + start, count * sizeof(WeightPair));
-      memcpy(new_buf + count, old_buf, start * sizeof(WeightPair));
+    bool more_left = fill_chunk(left, left_chunk, 1);
+    bool more_right = fill_chunk(right, right_chunk, 1);
 
-      // Now we've allocated a new buffer, copied the data across, *and*
-      // reoriented the data to start at index 0. If we were already on
-      // the heap, we can now free the previous buffer.
-      if (this->on_heap) {
-        free(old_buf);
+    // Most strings can be told apart by their first primary weight. Check for
+    // that before setting up anything else.
+    if (left_chunk.len > 0 && right_chunk.len > 0) {
+      uint16_t l = left_chunk.weights[0][0];
+      uint16_t r = right_chunk.weights[0][0];
+      if (l != 0 && r != 0 && l != r) {
+        return l < r ? -1 : 1;
       }
-      this->start = 0;
-      this->on_heap = true;
-      this->heap.capacity = new_capacity;
-      this->heap.buf = new_buf;
     }
-  };
 
-  int compare(int a_len, const char* a, int b_len, const char* b) {
-    WeightBuf level_1;
-    WeightBuf level_2;
-    WeightBuf level_3;
-    WeightBuf level_4;
+    LevelComparer levels[LEVEL_COUNT];
 
-    cea::ElementIter left(a_len, a);
-    cea::ElementIter right(b_len, b);
+    // Once a level is settled, the levels after it can no longer affect the
+    // result, so we stop comparing them.
+    uint32_t active_levels = LEVEL_COUNT;
 
-    int r;
+    uint32_t chunk_size = FIRST_CHUNK_SIZE;
     while (true) {
-      cea::Element e_left;
-      cea::Element e_right;
+      for (uint32_t level = 0; level < active_levels; level++) {
+        int r = levels[level].push(
+          left_chunk.weights[level],
+          left_chunk.len,
+          right_chunk.weights[level],
+          right_chunk.len
+        );
+        if (r != 0) {
+          if (level == 0) {
+            return r;
+          }
+          active_levels = level;
+          break;
+        }
+      }
 
-      bool next_left = left.next(e_left);
-      bool next_right = right.next(e_right);
-      if (!next_left && !next_right) {
+      if (code_points) {
+        code_points->update();
+      }
+
+      if (!more_left && !more_right) {
         break;
       }
 
-      if ((r = level_1.push(e_left.level_1, e_right.level_1))) {
-        return r;
+      left_chunk.len = 0;
+      right_chunk.len = 0;
+      if (more_left) {
+        more_left = fill_chunk(left, left_chunk, chunk_size);
       }
-      level_2.push(e_left.level_2, e_right.level_2);
-      level_3.push(e_left.level_3, e_right.level_3);
-      level_4.push(e_left.level_4, e_right.level_4);
+      if (more_right) {
+        more_right = fill_chunk(right, right_chunk, chunk_size);
+      }
+      chunk_size = std::min(chunk_size * 2, MAX_CHUNK_SIZE);
     }
 
-    if ((r = level_1.final_result())) {
-      return r;
-    }
-    if ((r = level_2.final_result())) {
-      return r;
+    for (uint32_t level = 0; level < LEVEL_COUNT; level++) {
+      int r = levels[level].final_result();
+      if (r != 0) {
+        return r;
+      }
     }
-    if ((r = level_3.final_result())) {
-      return r;
+    return code_points ? code_points->final_result() : 0;
+  }
+
+  // Compares the collation elements of two strings, as compare_elements, and
+  // adds the comparison to the current thread's statistics. The comparison is
+  // timed if the thread has a measurement running (see stats.h). Profiling
+  // builds also time its stages: see profile.h. Only those use the strings
+  // themselves.
+  template<typename Iter>
+  inline int compare_counted(
+    int a_len,
+    [[maybe_unused]] const char* a,
+    int b_len,
+    [[maybe_unused]] const char* b,
+    Iter &left,
+    Iter &right,
+    CodePointComparer* code_points = nullptr
+  ) {
+    stats::ThreadCounters &counters = stats::local();
+    bool timed = counters.measuring();
+    uint64_t start = timed ? stats::now() : 0;
+
+    CONDICT_UCA_PROFILE_COMPARE_BEGIN(a_len, a, b_len, b);
+    int result = compare_elements(left, right, code_points);
+    CONDICT_UCA_PROFILE_COMPARE_END(result);
+    counters.add_comparison(
+      (uint64_t) a_len + (uint64_t) b_len,
+      left.stats(),
+      right.stats()
+    );
+    if (timed) {
+      counters.add(stats::Counter::MEASURED_NANOSECONDS, stats::now() - start);
     }
-    return level_4.final_result();
+    return result;
   }
 
-  int compare_tb(int a_len, const char* a, int b_len, const char *b) {
-    int r = compare(a_len, a, b_len, b);
-    if (r != 0) {
-      return r;
-    }
-
-    nfd::NfdIter left(a_len, a);
-    nfd::NfdIter right(b_len, b);
-    while (r == 0) {
-      uint32_t cp_left;
-      uint32_t cp_right;
-
-      bool next_left = left.next(cp_left);
-      bool next_right = right.next(cp_right);
-      if (!next_left || !next_right) {
-        // We've reached the end of at least one string without any
-        // differences. The shorter string is sorted before the longer.
-        // If they are the same length, then they are equivalent.
-        r = (int)next_left - (int)next_right;
-        break;
-      }
+  int compare(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding
+  ) {
+    cea::ElementIter left(a_len, a, nullptr, nullptr, false, encoding);
+    cea::ElementIter right(b_len, b, nullptr, nullptr, false, encoding);
+    return compare_counted(a_len, a, b_len, b, left, right);
+  }
 
-      if (cp_left < cp_right) {
-        r = -1;
-      } else if (cp_left > cp_right) {
-        r = 1;
-      }
+  int compare_nfd(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding
+  ) {
+    cea::ElementIter left(a_len, a, nullptr, nullptr, true, encoding);
+    cea::ElementIter right(b_len, b, nullptr, nullptr, true, encoding);
+    return compare_counted(a_len, a, b_len, b, left, right);
+  }
+
+  int compare_numeric(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding
+  ) {
+    cea::ElementIter left(a_len, a, nullptr, nullptr, false, encoding, true);
+    cea::ElementIter right(b_len, b, nullptr, nullptr, false, encoding, true);
+    return compare_counted(a_len, a, b_len, b, left, right);
+  }
+
+  int compare_reverse(int a_len, const char* a, int b_len, const char* b) {
+    cea::ReverseElementIter left(a_len, a);
+    cea::ReverseElementIter right(b_len, b);
+    return compare_counted(a_len, a, b_len, b, left, right);
+  }
+
+  int compare_tailored(
+    const tailoring::Tailoring* tailoring,
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding
+  ) {
+    cea::ElementIter left(a_len, a, tailoring, nullptr, false, encoding);
+    cea::ElementIter right(b_len, b, tailoring, nullptr, false, encoding);
+    return compare_counted(a_len, a, b_len, b, left, right);
+  }
+
+  int compare_tb(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char *b,
+    Encoding encoding
+  ) {
+    CodePointComparer code_points;
+    cea::ElementIter left(
+      a_len,
+      a,
+      nullptr,
+      &code_points.left,
+      false,
+      encoding
+    );
+    cea::ElementIter right(
+      b_len,
+      b,
+      nullptr,
+      &code_points.right,
+      false,
+      encoding
+    );
+    return compare_counted(a_len, a, b_len, b, left, right, &code_points);
+  }
+
+  std::string collation_version(const tailoring::Tailoring* tailoring) {
+    char version[128];
+    int len = snprintf(
+      version,
+      sizeof(version),
+      "%s; tables %08x; algorithm %u",
+      data::get().version,
+      data::tables_checksum(),
+      ALGORITHM_VERSION
+    );
+    std::string result(version, len);
+
+    if (tailoring) {
+      uint32_t crc = data::crc32(
+        reinterpret_cast<const uint8_t*>(tailoring->contractions()),
+        tailoring->contraction_count() * sizeof(HashTableBucket<uint32_t>)
+      );
+      crc = data::crc32(
+        reinterpret_cast<const uint8_t*>(tailoring->cea_data()),
+        tailoring->cea_data_size() * sizeof(uint16_t),
+        crc
+      );
+      len = snprintf(version, sizeof(version), "; tailoring %08x", crc);
+      result.append(version, len);
     }
-    return r;
+    return result;
   }
 }
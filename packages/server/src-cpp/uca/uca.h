@@ -1,9 +1,81 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
+
+#include "tailoring.h"
+#include "text.h"
 
 namespace condict_uca {
-  int compare(int a_len, const char* a, int b_len, const char* b);
+  // The version of the comparison code. Increment it whenever a change to the
+  // code changes how any two strings compare, so that indexes built with the
+  // old code are rebuilt. See collation_version.
+  constexpr uint32_t ALGORITHM_VERSION = 1;
+
+  // Gets a string that identifies the order of a collation: the Unicode and
+  // CLDR versions of the tables in use, a checksum of their contents, the
+  // ALGORITHM_VERSION, and a checksum of the tailoring, if any. Whenever the
+  // order may have changed, so has the version. Indexes only need to be
+  // rebuilt when the version of their collation changes.
+  std::string collation_version(const tailoring::Tailoring* tailoring);
+
+  // Compares two strings using the root collation. The lengths are in bytes.
+  // Both strings must be in `encoding`. Strings in different encodings compare
+  // the same as long as they are valid.
+  int compare(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding = Encoding::UTF8
+  );
+
+  // Compares two strings like `compare`, but breaks ties by comparing their
+  // code points in NFD. Only canonically equivalent strings are equal. Both
+  // comparisons are made in a single pass over each string.
+  int compare_tb(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char *b,
+    Encoding encoding = Encoding::UTF8
+  );
+
+  // Compares two strings like `compare`, but assumes that both are already in
+  // NFD, which saves normalizing them. The result is undefined if either
+  // string is not in NFD; use nfc::Normalizer::to_nfd to store strings in NFD.
+  int compare_nfd(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding = Encoding::UTF8
+  );
+
+  // Compares two strings like `compare`, but runs of decimal digits are
+  // compared by their numeric value, so that "a2" sorts before "a10". Digits
+  // of every script count. Leading zeros are ignored unless the strings are
+  // otherwise equal, and then the one with fewer sorts first.
+  int compare_numeric(
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding = Encoding::UTF8
+  );
+
+  // Compares two strings by their collation elements in reverse order, last
+  // element first. Strings that end the same way sort next to each other,
+  // which is useful for finding rhymes and suffixes. Only UTF-8 is supported.
+  int compare_reverse(int a_len, const char* a, int b_len, const char* b);
 
-  int compare_tb(int a_len, const char* a, int b_len, const char *b);
+  // Compares two strings using a tailoring on top of the root collation.
+  int compare_tailored(
+    const tailoring::Tailoring* tailoring,
+    int a_len,
+    const char* a,
+    int b_len,
+    const char* b,
+    Encoding encoding = Encoding::UTF8
+  );
 }
@@ -0,0 +1,104 @@
+#include "utf16.h"
+
+#include "profile.h"
+
+namespace condict_uca {
+  namespace utf16 {
+    // Quick UTF-16 summary:
+    //
+    // U+0000  to U+FFFF:   xxxxxxxx xxxxxxxx (except U+D800 to U+DFFF)
+    // U+10000 to U+10FFFF: 110110yy yyyyyyyy 110111xx xxxxxxxx
+    //
+    // where the y bits are the top 10 bits of (code point - 0x10000), and the
+    // x bits are the bottom 10 bits. The first code unit is called the high
+    // surrogate, the second the low surrogate. A surrogate that isn't part of
+    // such a pair is invalid, and we emit U+FFFD Replacement Character for it.
+
+    constexpr uint32_t REPLACEMENT_CHAR = 0xFFFD;
+
+    template<bool BigEndian>
+    inline uint32_t read_unit(const uint8_t* str) {
+      return BigEndian
+        ? ((uint32_t) str[0] << 8) | str[1]
+        : ((uint32_t) str[1] << 8) | str[0];
+    }
+
+    // Decodes the code point at `str`, which must be before `end`, and returns
+    // the number of bytes it occupies.
+    template<bool BigEndian>
+    uint8_t scan_next(const uint8_t* str, const uint8_t* end, uint32_t &cp) {
+      if (end - str < 2) {
+        // A stray byte at the end of the string.
+        cp = REPLACEMENT_CHAR;
+        return 1;
+      }
+      uint32_t unit = read_unit<BigEndian>(str);
+      if ((unit & 0xF800) != 0xD800) {
+        cp = unit;
+        return 2;
+      }
+      if (unit < 0xDC00 && end - str >= 4) {
+        uint32_t low = read_unit<BigEndian>(str + 2);
+        if ((low & 0xFC00) == 0xDC00) {
+          cp = 0x10000 + ((unit & 0x3FF) << 10) + (low & 0x3FF);
+          return 4;
+        }
+      }
+      // An unpaired surrogate.
+      cp = REPLACEMENT_CHAR;
+      return 2;
+    }
+
+    template<bool BigEndian>
+    const uint8_t* scan_batch(
+      const uint8_t* str,
+      const uint8_t* end,
+      uint32_t* out,
+      uint32_t n,
+      uint32_t &count
+    ) {
+      while (count < n && str != end) {
+        str += scan_next<BigEndian>(str, end, out[count]);
+        count++;
+      }
+      return str;
+    }
+
+    bool CodePointIter::next(uint32_t &result) {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
+      if (this->str == this->end) {
+        result = 0;
+        return false;
+      }
+      this->str += this->big_endian
+        ? scan_next<true>(this->str, this->end, result)
+        : scan_next<false>(this->str, this->end, result);
+      return true;
+    }
+
+    uint32_t CodePointIter::next_batch(uint32_t* out, uint32_t n) {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
+      uint32_t count = 0;
+      // The byte order is the same for the whole string, so we only branch on
+      // it once per batch.
+      this->str = this->big_endian
+        ? scan_batch<true>(this->str, this->end, out, n, count)
+        : scan_batch<false>(this->str, this->end, out, n, count);
+      return count;
+    }
+
+    uint32_t CodePointIter::peek() {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
+      if (this->str == this->end) {
+        return 0;
+      }
+      uint32_t result;
+      if (this->big_endian) {
+        scan_next<true>(this->str, this->end, result);
+      } else {
+        scan_next<false>(this->str, this->end, result);
+      }
+      return result;
+    }
+  }
+}
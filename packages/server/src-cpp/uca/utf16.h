@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+namespace condict_uca {
+  namespace utf16 {
+    // An iterator that produces the code points of a UTF-16 string in either
+    // byte order. SQLite hands UTF-16 text to collations as raw bytes, so the
+    // string is addressed by bytes too, and its length need not be even.
+    //
+    // Invalid UTF-16 is decoded the same way that utf8::CodePointIter decodes
+    // invalid UTF-8: each unpaired surrogate becomes one U+FFFD replacement
+    // character, as does a stray odd byte at the end of the string. Valid
+    // strings therefore produce exactly the code points of their UTF-8 form,
+    // and compare the same in either encoding.
+    class CodePointIter {
+    public:
+      inline CodePointIter(int str_len, const char* str, bool big_endian) :
+        str(reinterpret_cast<const uint8_t*>(str)),
+        end(reinterpret_cast<const uint8_t*>(str) + str_len),
+        big_endian(big_endian)
+      { }
+
+      bool next(uint32_t &result);
+
+      // Reads up to `n` code points into `out`, and returns the number of code
+      // points read. Returns less than `n` only at the end of the string.
+      uint32_t next_batch(uint32_t* out, uint32_t n);
+
+      uint32_t peek();
+
+      inline void skip() {
+        uint32_t _cp;
+        this->next(_cp);
+      }
+
+      // Returns a pointer to the current position in the string, that is, the
+      // first byte of the code point that will be returned next.
+      inline const char* position() const {
+        return reinterpret_cast<const char*>(this->str);
+      }
+
+    private:
+      const uint8_t* str;
+      const uint8_t* end;
+      bool big_endian;
+    };
+  }
+}
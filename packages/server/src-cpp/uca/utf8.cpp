@@ -1,5 +1,7 @@
 #include "utf8.h"
 
+#include "profile.h"
+
 namespace condict_uca {
   namespace utf8 {
     // Quick UTF-8 summary:
@@ -72,6 +74,7 @@ namespace condict_uca {
     }
 
     bool CodePointIter::next(uint32_t &result) {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
       if (this->str == this->end) {
         result = 0;
         return false;
@@ -80,7 +83,62 @@ namespace condict_uca {
       return true;
     }
 
+    uint32_t CodePointIter::next_batch(uint32_t* out, uint32_t n) {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
+      const uint8_t* str = this->str;
+      const uint8_t* end = this->end;
+      uint32_t count = 0;
+      while (count < n && str != end) {
+        if (*str < 0x80) {
+          // ASCII doesn't need the table lookup or any validation.
+          out[count] = *str;
+          str++;
+        } else {
+          str += scan_next(str, end, out[count]);
+        }
+        count++;
+      }
+      this->str = str;
+      return count;
+    }
+
+    bool ReverseCodePointIter::next(uint32_t &result) {
+      if (this->str == this->start) {
+        result = 0;
+        return false;
+      }
+
+      // The forward decoder never consumes anything but continuation bytes
+      // after the first byte of a sequence, so every other byte is guaranteed
+      // to start a sequence of its own. Such a byte can be followed by at most
+      // three continuation bytes. If we find one, we decode forward from it;
+      // if it doesn't take us all the way to the current position, then the
+      // last byte is a stray continuation byte.
+      const uint8_t* lead = this->str - 1;
+      const uint8_t* limit = this->str - this->start > 4
+        ? this->str - 4
+        : this->start;
+      while (lead > limit && (*lead & 0xc0) == 0x80) {
+        lead--;
+      }
+
+      if ((*lead & 0xc0) != 0x80) {
+        uint32_t cp;
+        if (lead + scan_next(lead, this->str, cp) == this->str) {
+          this->str = lead;
+          result = cp;
+          return true;
+        }
+      }
+
+      // A stray continuation byte, which is always decoded on its own.
+      this->str--;
+      result = REPLACEMENT_CHAR;
+      return true;
+    }
+
     uint32_t CodePointIter::peek() {
+      CONDICT_UCA_PROFILE_STAGE(DECODE);
       if (this->str == this->end) {
         return 0;
       }
@@ -18,6 +18,10 @@ namespace condict_uca {
 
       bool next(uint32_t &result);
 
+      // Reads up to `n` code points into `out`, and returns the number of code
+      // points read. Returns less than `n` only at the end of the string.
+      uint32_t next_batch(uint32_t* out, uint32_t n);
+
       uint32_t peek();
 
       inline void skip() {
@@ -25,9 +29,69 @@ namespace condict_uca {
         this->next(_cp);
       }
 
+      // Returns a pointer to the current position in the string, that is, the
+      // first byte of the code point that will be returned next.
+      inline const char* position() const {
+        return reinterpret_cast<const char*>(this->str);
+      }
+
     private:
       const uint8_t* str;
       const uint8_t* end;
     };
+
+    // Writes the UTF-8 encoding of a code point to `dest`, which must have room
+    // for 4 bytes, and returns the number of bytes written. The code point must
+    // be valid.
+    inline uint32_t encode(uint32_t cp, char* dest) {
+      uint8_t* d = reinterpret_cast<uint8_t*>(dest);
+      if (cp < 0x80) {
+        d[0] = (uint8_t) cp;
+        return 1;
+      }
+      if (cp < 0x800) {
+        d[0] = (uint8_t) (0xC0 | (cp >> 6));
+        d[1] = (uint8_t) (0x80 | (cp & 0x3F));
+        return 2;
+      }
+      if (cp < 0x10000) {
+        d[0] = (uint8_t) (0xE0 | (cp >> 12));
+        d[1] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+        d[2] = (uint8_t) (0x80 | (cp & 0x3F));
+        return 3;
+      }
+      d[0] = (uint8_t) (0xF0 | (cp >> 18));
+      d[1] = (uint8_t) (0x80 | ((cp >> 12) & 0x3F));
+      d[2] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+      d[3] = (uint8_t) (0x80 | (cp & 0x3F));
+      return 4;
+    }
+
+    // An iterator that produces the code points of a string in reverse order,
+    // from the end of the string to the start.
+    //
+    // Invalid UTF-8 is decoded exactly as CodePointIter decodes it: the same
+    // byte sequences turn into the same U+FFFD replacement characters. The
+    // position of the iterator is therefore always a position CodePointIter
+    // would also stop at, and the two can be freely mixed.
+    class ReverseCodePointIter {
+    public:
+      inline ReverseCodePointIter(int str_len, const char* str) :
+        start(reinterpret_cast<const uint8_t*>(str)),
+        str(reinterpret_cast<const uint8_t*>(str) + str_len)
+      { }
+
+      bool next(uint32_t &result);
+
+      // Returns a pointer to the current position in the string, that is, the
+      // first byte of the code point that was most recently returned.
+      inline const char* position() const {
+        return reinterpret_cast<const char*>(this->str);
+      }
+
+    private:
+      const uint8_t* start;
+      const uint8_t* str;
+    };
   }
 }
@@ -0,0 +1,258 @@
+#include "weights.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || \
+  defined(_M_X64) || defined(_M_IX86)
+# define CONDICT_UCA_X86 1
+# include <immintrin.h>
+# ifdef _MSC_VER
+#   include <intrin.h>
+# endif
+#else
+# define CONDICT_UCA_X86 0
+#endif
+
+// MSVC lets us use any intrinsic in any function, whereas GCC and Clang need
+// to be told which instruction set extensions a function may use.
+#if CONDICT_UCA_X86 && !defined(_MSC_VER)
+# define TARGET(isa) __attribute__((target(isa)))
+#else
+# define TARGET(isa)
+#endif
+
+namespace condict_uca {
+  namespace weights {
+    constexpr Kernels SCALAR = {
+      "scalar",
+      compress_scalar,
+      mismatch_scalar,
+    };
+
+#if CONDICT_UCA_X86
+    inline uint32_t count_trailing_zeros(uint32_t x) {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, x);
+      return index;
+#else
+      return __builtin_ctz(x);
+#endif
+    }
+
+    // For each 8-bit mask of non-zero lanes in a vector of eight weights,
+    // a byte shuffle that moves the non-zero weights to the front, and the
+    // number of non-zero weights.
+    struct CompressTable {
+      uint8_t shuffle[256][16];
+      uint8_t count[256];
+    };
+
+    constexpr CompressTable make_compress_table() {
+      CompressTable table{};
+      for (uint32_t mask = 0; mask < 256; mask++) {
+        uint32_t n = 0;
+        for (uint32_t lane = 0; lane < 8; lane++) {
+          if (mask & (1 << lane)) {
+            table.shuffle[mask][2 * n] = (uint8_t) (2 * lane);
+            table.shuffle[mask][2 * n + 1] = (uint8_t) (2 * lane + 1);
+            n++;
+          }
+        }
+        // The remaining bytes are never read, as the output position only
+        // advances by `n` weights.
+        for (uint32_t i = 2 * n; i < 16; i++) {
+          table.shuffle[mask][i] = 0x80;
+        }
+        table.count[mask] = (uint8_t) n;
+      }
+      return table;
+    }
+
+    constexpr CompressTable COMPRESS_TABLE = make_compress_table();
+
+    // Compresses eight weights and returns the number of non-zero weights.
+    // Always writes 16 bytes to `dest`.
+    TARGET("sse4.1")
+    inline uint32_t compress_8(__m128i v, uint16_t* dest) {
+      __m128i zero = _mm_setzero_si128();
+      __m128i is_zero = _mm_cmpeq_epi16(v, zero);
+      // Narrow each 16-bit lane to 8 bits, so that movemask yields exactly one
+      // bit per lane.
+      uint32_t keep =
+        ~_mm_movemask_epi8(_mm_packs_epi16(is_zero, zero)) & 0xFF;
+      __m128i shuffle = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(COMPRESS_TABLE.shuffle[keep])
+      );
+      _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dest),
+        _mm_shuffle_epi8(v, shuffle)
+      );
+      return COMPRESS_TABLE.count[keep];
+    }
+
+    TARGET("sse4.1")
+    uint32_t compress_sse41(
+      const uint16_t* src,
+      uint32_t count,
+      uint16_t* dest
+    ) {
+      uint32_t n = 0;
+      uint32_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        n += compress_8(v, dest + n);
+      }
+      return n + compress_scalar(src + i, count - i, dest + n);
+    }
+
+    TARGET("sse4.1")
+    uint32_t mismatch_sse41(
+      const uint16_t* a,
+      const uint16_t* b,
+      uint32_t count
+    ) {
+      uint32_t i = 0;
+      for (; i + 8 <= count; i += 8) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        uint32_t equal = _mm_movemask_epi8(_mm_cmpeq_epi16(va, vb));
+        if (equal != 0xFFFF) {
+          // Two mask bits per lane.
+          return i + count_trailing_zeros(~equal) / 2;
+        }
+      }
+      return i + mismatch_scalar(a + i, b + i, count - i);
+    }
+
+    constexpr Kernels SSE41 = {
+      "sse4.1",
+      compress_sse41,
+      mismatch_sse41,
+    };
+
+    TARGET("avx2")
+    uint32_t compress_avx2(
+      const uint16_t* src,
+      uint32_t count,
+      uint16_t* dest
+    ) {
+      __m256i zero = _mm256_setzero_si256();
+      uint32_t n = 0;
+      uint32_t i = 0;
+      for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(src + i)
+        );
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero)) == 0) {
+          // Most weights at the secondary and tertiary levels are non-zero,
+          // so it pays to check for that first.
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + n), v);
+          n += 16;
+        } else {
+          n += compress_8(_mm256_castsi256_si128(v), dest + n);
+          n += compress_8(_mm256_extracti128_si256(v, 1), dest + n);
+        }
+      }
+      return n + compress_sse41(src + i, count - i, dest + n);
+    }
+
+    TARGET("avx2")
+    uint32_t mismatch_avx2(
+      const uint16_t* a,
+      const uint16_t* b,
+      uint32_t count
+    ) {
+      uint32_t i = 0;
+      for (; i + 16 <= count; i += 16) {
+        __m256i va = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(a + i)
+        );
+        __m256i vb = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(b + i)
+        );
+        uint32_t equal = _mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb));
+        if (equal != 0xFFFFFFFF) {
+          return i + count_trailing_zeros(~equal) / 2;
+        }
+      }
+      return i + mismatch_sse41(a + i, b + i, count - i);
+    }
+
+    constexpr Kernels AVX2 = {
+      "avx2",
+      compress_avx2,
+      mismatch_avx2,
+    };
+
+    bool cpu_has_sse41() {
+#ifdef _MSC_VER
+      int info[4];
+      __cpuid(info, 1);
+      // ECX bit 19: SSE4.1. SSE4.1 implies SSSE3, which we also need.
+      return (info[2] & (1 << 19)) != 0;
+#else
+      return __builtin_cpu_supports("sse4.1");
+#endif
+    }
+
+    bool cpu_has_avx2() {
+#ifdef _MSC_VER
+      int info[4];
+      __cpuid(info, 1);
+      // ECX bit 27: OSXSAVE, bit 28: AVX. The OS must also save the YMM
+      // registers on context switches.
+      bool os_saves_ymm =
+        (info[2] & (1 << 27)) != 0 &&
+        (info[2] & (1 << 28)) != 0 &&
+        (_xgetbv(0) & 6) == 6;
+      if (!os_saves_ymm) {
+        return false;
+      }
+      __cpuidex(info, 7, 0);
+      // EBX bit 5: AVX2.
+      return (info[1] & (1 << 5)) != 0;
+#else
+      return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif // CONDICT_UCA_X86
+
+    Kernels active = SCALAR;
+
+    const Kernels* find_kernels(const char* name) {
+      if (strcmp(name, SCALAR.name) == 0) {
+        return &SCALAR;
+      }
+#if CONDICT_UCA_X86
+      if (strcmp(name, SSE41.name) == 0) {
+        return cpu_has_sse41() ? &SSE41 : nullptr;
+      }
+      if (strcmp(name, AVX2.name) == 0) {
+        return cpu_has_avx2() ? &AVX2 : nullptr;
+      }
+#endif
+      return nullptr;
+    }
+
+    void use_kernels(const Kernels &kernels) {
+      active = kernels;
+    }
+
+    const Kernels &best_kernels() {
+#if CONDICT_UCA_X86
+      if (cpu_has_avx2()) {
+        return AVX2;
+      }
+      if (cpu_has_sse41()) {
+        return SSE41;
+      }
+#endif
+      return SCALAR;
+    }
+
+    // As with the collation tables (see data.h), pick the kernels before
+    // anything can compare strings from another thread.
+    const bool kernels_chosen = (use_kernels(best_kernels()), true);
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+// Weight kernels
+//
+// Collation elements are compared one level at a time, by comparing the
+// sequences of non-zero weights at each level. The comparison code collects
+// the weights of a chunk of elements into one contiguous array per level, and
+// then uses the kernels in this file to (1) drop the zero weights from those
+// arrays, and (2) find the first position where two weight sequences differ.
+//
+// There are several implementations of the kernels, and the best one that the
+// CPU supports is chosen during static initialization. Until then, and on CPUs
+// without SIMD support, the portable scalar implementation is used.
+
+namespace condict_uca {
+  namespace weights {
+    struct Kernels {
+      // A short name for the implementation, for tests and benchmarks.
+      const char* name;
+
+      // Copies the non-zero weights in `src` to `dest`, in order, and returns
+      // the number of weights copied. `dest` must have room for `count`
+      // weights, as all of them may be written to.
+      uint32_t (*compress)(
+        const uint16_t* src,
+        uint32_t count,
+        uint16_t* dest
+      );
+
+      // Returns the index of the first weight that differs between `a` and
+      // `b`, or `count` if the first `count` weights are equal.
+      uint32_t (*mismatch)(
+        const uint16_t* a,
+        const uint16_t* b,
+        uint32_t count
+      );
+    };
+
+    // The kernels in use.
+    extern Kernels active;
+
+    // Finds an implementation of the kernels by name ("scalar", "sse4.1" or
+    // "avx2"). Returns nullptr if there is no such implementation, or if the
+    // CPU doesn't support it.
+    const Kernels* find_kernels(const char* name);
+
+    // Replaces the kernels in use. This is not thread-safe, and is only meant
+    // for tests and benchmarks.
+    void use_kernels(const Kernels &kernels);
+
+    inline uint32_t compress_scalar(
+      const uint16_t* src,
+      uint32_t count,
+      uint16_t* dest
+    ) {
+      uint32_t n = 0;
+      for (uint32_t i = 0; i < count; i++) {
+        // Always write the weight, but only advance past it if it's non-zero.
+        // This avoids a hard-to-predict branch.
+        uint16_t w = src[i];
+        dest[n] = w;
+        n += w != 0;
+      }
+      return n;
+    }
+
+    inline uint32_t mismatch_scalar(
+      const uint16_t* a,
+      const uint16_t* b,
+      uint32_t count
+    ) {
+      uint32_t i = 0;
+      while (i < count && a[i] == b[i]) {
+        i++;
+      }
+      return i;
+    }
+
+    // Below this many weights, calling the active kernels costs more than it
+    // saves, and the scalar code is inlined instead.
+    constexpr uint32_t MIN_KERNEL_COUNT = 8;
+
+    // Calls the `compress` kernel of the active implementation.
+    inline uint32_t compress(
+      const uint16_t* src,
+      uint32_t count,
+      uint16_t* dest
+    ) {
+      if (count < MIN_KERNEL_COUNT) {
+        return compress_scalar(src, count, dest);
+      }
+      return active.compress(src, count, dest);
+    }
+
+    // Calls the `mismatch` kernel of the active implementation.
+    inline uint32_t mismatch(
+      const uint16_t* a,
+      const uint16_t* b,
+      uint32_t count
+    ) {
+      if (count < MIN_KERNEL_COUNT) {
+        return mismatch_scalar(a, b, count);
+      }
+      return active.mismatch(a, b, count);
+    }
+  }
+}
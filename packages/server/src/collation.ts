@@ -0,0 +1,49 @@
+import {createRequire} from 'module';
+import path from 'path';
+
+import {getNativeDir} from './paths';
+
+/**
+ * The number of collation levels that take part in a comparison:
+ *
+ * 1. Base letters only: "a" = "á" = "A".
+ * 2. Accents: "a" = "A" < "á".
+ * 3. Case and variant forms: "a" < "A" < "á".
+ * 4. Punctuation and other variable characters, as in the database.
+ */
+export type CollationStrength = 1 | 2 | 3 | 4;
+
+interface CollationAddon {
+  sortStrings(
+    strings: readonly string[],
+    strength?: CollationStrength
+  ): string[];
+}
+
+const AddonName = 'condict_collation.node';
+
+let addon: CollationAddon | null = null;
+
+const getAddon = (): CollationAddon => {
+  if (!addon) {
+    // The addon is next to the SQLite extension, not in node_modules.
+    const require = createRequire(import.meta.url);
+    addon = require(path.join(getNativeDir(), AddonName)) as CollationAddon;
+  }
+  return addon;
+};
+
+/**
+ * Sorts strings the way the `unicode` collation does in the database. The
+ * whole array is sorted in a single native call, which is much faster than
+ * calling into native code from `Array.prototype.sort` for every comparison.
+ * Strings that compare equal keep their relative order.
+ * @param strings The strings to sort. The array is not modified.
+ * @param strength The number of levels to compare. Defaults to 4, all levels.
+ * @return A new array with the strings in sorted order.
+ */
+export const sortStrings = (
+  strings: readonly string[],
+  strength?: CollationStrength
+): string[] =>
+  getAddon().sortStrings(strings, strength);
@@ -10,6 +10,8 @@ export {
   Scalar,
   Options,
   RwLock,
+  ReadPool,
+  getExtensionPath,
   validateOptions,
 } from './sqlite';
 export {default as reindentQuery} from './reindent-query';
@@ -1,6 +1,12 @@
 export interface TableSchema {
   readonly name: string;
   readonly commands: readonly string[];
+  /**
+   * Commands that fill the table from other tables. They run after the table
+   * is created, and again when the default Unicode collation changes, for
+   * tables that store sort keys from `unicode_sort_key()`.
+   */
+  readonly rebuild?: readonly string[];
 }
 
 export const SchemaVersion = 1;
@@ -82,6 +88,26 @@ const tables: readonly TableSchema[] = [
     ],
   },
 
+  // Custom alphabetical orders of languages. A language without a row here uses
+  // the default (root) collation. Each row is registered as a collation named
+  // `unicode_language_<language_id>` when the database is opened.
+  {
+    name: 'language_collations',
+    commands: [`
+      create table language_collations (
+        -- The language that the collation belongs to.
+        language_id integer not null primary key,
+        -- The tailoring rules, such as '&n < ng'. See the documentation of the
+        -- SQLite extension for the supported syntax.
+        rules text not null collate binary,
+
+        foreign key (language_id)
+          references languages
+          on delete cascade
+      )`,
+    ],
+  },
+
   // Parts of speech defined for a language. A part of speech is associated with
   // every definition, and can define any number of inflection tables.
   {
@@ -359,6 +385,42 @@ const tables: readonly TableSchema[] = [
     ],
   },
 
+  // The position of each lemma in the default alphabetical order of its
+  // language, for finding the lemmas on a page without stepping over all the
+  // lemmas before it. See src-cpp/sqlite3_rank.cpp. Languages with custom
+  // collation rules are not ordered by this table. Kept up to date by triggers
+  // on `lemmas`, so that no write to that table can forget it.
+  {
+    name: 'lemma_ranks',
+    commands: [`
+      create virtual table lemma_ranks using unicode_rank`, `
+      create trigger lemma_ranks_insert after insert on lemmas
+      begin
+        insert into lemma_ranks (rowid, group_id, key)
+        values (new.id, new.language_id, unicode_sort_key(new.term));
+      end`, `
+      create trigger lemma_ranks_update
+      after update of language_id, term on lemmas
+      begin
+        update lemma_ranks
+        set group_id = new.language_id,
+          key = unicode_sort_key(new.term)
+        where rowid = old.id;
+      end`, `
+      create trigger lemma_ranks_delete after delete on lemmas
+      begin
+        delete from lemma_ranks
+        where rowid = old.id;
+      end`,
+    ],
+    rebuild: [
+      `delete from lemma_ranks`,
+      `insert into lemma_ranks (rowid, group_id, key)
+        select id, language_id, unicode_sort_key(term)
+        from lemmas`,
+    ],
+  },
+
   // Definitions of dictionary words. The primary component of a definition is
   // its free text description (stored in `descriptions`). In addition to the
   // properties in this table, each definition can also have multiple inflection
@@ -3,6 +3,7 @@ import {Database, Statement} from 'better-sqlite3';
 import {FieldSet} from '../../model';
 
 import {RwGuard} from './rwlock';
+import ReadPool from './read-pool';
 import RequestCache from './request-cache';
 import {
   DataAccessor,
@@ -15,6 +16,8 @@ import {
   Param,
   RawSql,
   SqlLogger,
+  QueryPlanNode,
+  CollationCost,
 } from './types';
 
 /**
@@ -29,6 +32,26 @@ type Sql = TemplateStringsArray | string;
 // queries anywhere.
 const escapeId = (id: string) => '`' + id + '`';
 
+interface RawCollationCost {
+  comparisons: number;
+  code_points: number;
+  nanoseconds: number;
+}
+
+/**
+ * Parses the result of `unicode_collation_measure_stop()`.
+ * @param json The JSON object returned by the function.
+ * @return The collation cost.
+ */
+const parseCollationCost = (json: string): CollationCost => {
+  const raw = JSON.parse(json) as RawCollationCost;
+  return {
+    comparisons: raw.comparisons,
+    codePoints: raw.code_points,
+    nanoseconds: raw.nanoseconds,
+  };
+};
+
 /**
  * Implements a DataAccessor and DataWriter, which supports queries, commands
  * and batching of queries.
@@ -44,6 +67,7 @@ const escapeId = (id: string) => '`' + id + '`';
 export default class Accessor implements DataAccessor, DataWriter {
   private readonly database: RwGuard<Database>;
   private readonly logger: SqlLogger;
+  private readonly readPool: ReadPool | null;
 
   // TODO: See if it's meaningful to break out batching into a separate type.
   private readonly cache: RequestCache;
@@ -51,10 +75,12 @@ export default class Accessor implements DataAccessor, DataWriter {
   public constructor(
     database: RwGuard<Database>,
     logger: SqlLogger,
+    readPool: ReadPool | null,
     sharedCache?: RequestCache
   ) {
     this.database = database;
     this.logger = logger;
+    this.readPool = readPool;
     this.cache = sharedCache ?? new RequestCache(this);
   }
 
@@ -76,11 +102,7 @@ export default class Accessor implements DataAccessor, DataWriter {
       throw new Error('The specified SQL does not return data');
     }
 
-    if (this.logger.logQueryPlan) {
-      this.explainQueryPlan(sql, params);
-    }
-
-    return stmt.get(params) as Row ?? null;
+    return this.run(sql, params, () => stmt.get(params) as Row ?? null);
   }
 
   public getRequired<Row>(parts: Sql, ...values: Value[]): Row {
@@ -97,11 +119,11 @@ export default class Accessor implements DataAccessor, DataWriter {
       throw new Error('The specified SQL does not return data');
     }
 
-    if (this.logger.logQueryPlan) {
-      this.explainQueryPlan(sql, params);
-    }
-
-    const row = stmt.get(params) as Row | undefined;
+    const row = this.run(
+      sql,
+      params,
+      () => stmt.get(params) as Row | undefined
+    );
 
     if (row === undefined) {
       throw new Error('No rows found');
@@ -123,11 +145,44 @@ export default class Accessor implements DataAccessor, DataWriter {
       throw new Error('The specified SQL does not return data');
     }
 
+    return this.run(sql, params, () => stmt.all(params) as Row[]);
+  }
+
+  public async allAsync<Row>(
+    parts: Sql,
+    ...values: Value[]
+  ): Promise<Row[]> {
+    this.ensureValid();
+
+    // Writers must see their own uncommitted changes, which the workers'
+    // connections can't.
+    const readPool = this.readPool;
+    if (!readPool?.isAvailable || this.database.isWriter) {
+      return this.all<Row>(parts, ...values);
+    }
+
+    const params: Param[] = [];
+    const sql = formatSql(parts, values, params);
+
+    // The statement is prepared here too, to validate it before it's sent
+    // off. Preparing is cheap compared to the queries this method is for.
+    const stmt = this.prepare(sql);
+    if (!stmt.readonly) {
+      throw new Error('Cannot execute a mutating statement as a reader');
+    }
+    if (!stmt.reader) {
+      throw new Error('The specified SQL does not return data');
+    }
+
+    // The query runs on another connection, whose collation cost we can't
+    // measure from here.
     if (this.logger.logQueryPlan) {
-      this.explainQueryPlan(sql, params);
+      this.logger.logQueryPlan(this.explainQueryPlan(sql, params), null);
     }
 
-    return stmt.all(params) as Row[];
+    // This accessor's reader guard is held until the query is done, so no
+    // write transaction can run in the meantime.
+    return readPool.all<Row>(sql, params);
   }
 
   public exec<I extends number = number>(
@@ -237,20 +292,46 @@ export default class Accessor implements DataAccessor, DataWriter {
     return this.database.get().prepare(sql);
   }
 
-  private explainQueryPlan(sql: string, params: Param[]): void {
+  /**
+   * Runs a query on the main connection. If query plans are logged, the
+   * query's collation cost is measured and logged with its plan.
+   * @param sql The SQL query, for the query plan.
+   * @param params The query parameters, for the query plan.
+   * @param execute A callback that runs the query.
+   * @return The result of the callback.
+   */
+  private run<R>(sql: string, params: Param[], execute: () => R): R {
+    const logQueryPlan = this.logger.logQueryPlan;
+    if (!logQueryPlan) {
+      return execute();
+    }
+
+    const nodes = this.explainQueryPlan(sql, params);
+
+    const db = this.database.get();
+    db.prepare('select unicode_collation_measure_start()').get();
+    try {
+      return execute();
+    } finally {
+      const cost = db.prepare('select unicode_collation_measure_stop()')
+        .pluck()
+        .get() as string | null;
+      logQueryPlan(nodes, cost !== null ? parseCollationCost(cost) : null);
+    }
+  }
+
+  private explainQueryPlan(sql: string, params: Param[]): QueryPlanNode[] {
     type Row = [number, number, number, string];
 
     const stmt = this.database.get().prepare(`explain query plan ${sql}`);
     stmt.raw(true);
 
     const rows = stmt.all(params) as Row[];
-    // This function is only ever entered when logQueryPlan != null.
-    // eslint-disable-next-line @typescript-eslint/no-non-null-assertion
-    this.logger.logQueryPlan!(rows.map(row => ({
+    return rows.map(row => ({
       id: row[0],
       parentId: row[1],
       description: row[3],
-    })));
+    }));
   }
 
   private ensureValid(): void {
@@ -1,3 +1,5 @@
+import os from 'os';
+
 import Sqlite, {Database} from 'better-sqlite3';
 
 import {Logger} from '../../types';
@@ -6,15 +8,30 @@ import reindentQuery from '../reindent-query';
 
 import Accessor from './accessor';
 import RwLock from './rwlock';
+import ReadPool from './read-pool';
 import registerExtension from './extension';
-import formatQueryPlan from './query-plan';
-import {Options, DataAccessor, QueryPlanNode} from './types';
+import formatQueryPlan, {formatCollationCost} from './query-plan';
+import {
+  Options,
+  DataAccessor,
+  QueryPlanNode,
+  CollationCost,
+} from './types';
 
 // NB: "db" refers to instances of better-sqlite3's Database, and "connection"
 // to our own wrapper.
 
+// The most read workers we start if the config doesn't say. Each worker is
+// a thread with its own connection and page cache, and a dictionary rarely
+// has more than a few expensive queries running at once, so one per core is
+// wasteful on large machines.
+const MaxDefaultReadWorkers = 4;
+
 type QueryLogger = (logger: Logger) => (sql: string) => void;
-type QueryPlanLogger = (logger: Logger) => (nodes: QueryPlanNode[]) => void;
+type QueryPlanLogger = (logger: Logger) => (
+  nodes: QueryPlanNode[],
+  collationCost: CollationCost | null
+) => void;
 
 /**
  * Manages access to a shared SQLite connection. The server uses a single handle
@@ -22,13 +39,20 @@ type QueryPlanLogger = (logger: Logger) => (nodes: QueryPlanNode[]) => void;
  * used to serialize modifications of the database: it permits any number of
  * concurrent readers, but only one writer, and only when there are no readers.
  * See the documentation of Accessor and RwLock for details.
+ *
+ * Expensive read-only queries can also be sent to a pool of worker threads,
+ * each with its own read-only connection, through `DataReader.allAsync`. The
+ * workers are governed by the same lock: they only run queries on behalf of
+ * readers. See ReadPool.
  */
 export default class Connection {
   private readonly defaultLogger: Logger;
   private readonly lock: RwLock<Database>;
+  private readonly readPool: ReadPool | null = null;
   // eslint-disable-next-line @typescript-eslint/no-empty-function
   private readonly logQuery: QueryLogger = () => () => { };
   private readonly logQueryPlan: QueryPlanLogger | undefined = undefined;
+  private readonly statsTimer: NodeJS.Timeout | undefined = undefined;
 
   public constructor(defaultLogger: Logger, options: Options) {
     this.defaultLogger = defaultLogger;
@@ -39,6 +63,14 @@ export default class Connection {
 
     this.lock = new RwLock(db);
 
+    const readWorkers =
+      options.readWorkers ??
+      Math.min(os.cpus().length, MaxDefaultReadWorkers);
+    // Other connections can't open the main connection's in-memory database.
+    if (readWorkers > 0 && !isMemoryDatabase(options.file)) {
+      this.readPool = new ReadPool(options.file, readWorkers);
+    }
+
     const queryLogging = getQueryLogSetting(process.env.DEBUG_QUERIES);
 
     if (queryLogging !== false) {
@@ -53,11 +85,21 @@ export default class Connection {
     }
 
     if (queryLogging === 'queryAndPlan') {
-      this.logQueryPlan = logger => nodes => {
+      this.logQueryPlan = logger => (nodes, collationCost) => {
         const queryPlan = formatQueryPlan(nodes);
-        logger.debug(`Query plan:\n${queryPlan}`);
+        const cost = collationCost && formatCollationCost(collationCost);
+        logger.debug(`Query plan:\n${queryPlan}${cost ? `\n${cost}` : ''}`);
       };
     }
+
+    const statsInterval = getStatsInterval(process.env.DEBUG_COLLATION_STATS);
+    if (statsInterval !== null) {
+      this.statsTimer = setInterval(() => {
+        logCollationStats(defaultLogger, db);
+      }, statsInterval);
+      // The timer must not keep the process alive.
+      this.statsTimer.unref();
+    }
   }
 
   /**
@@ -78,15 +120,40 @@ export default class Connection {
     return new Accessor(guard, {
       logQuery: this.logQuery(logger),
       logQueryPlan: logQueryPlan && logQueryPlan(logger),
-    });
+    }, this.readPool);
+  }
+
+  /**
+   * Sets a query that registers per-connection state, such as collations, on
+   * the connections of the read workers. The workers run it before their
+   * first query, and again after every write to the database. The query must
+   * only read from the database.
+   * @param sql The setup query.
+   */
+  public setReaderSetupQuery(sql: string): void {
+    this.readPool?.setSetupQuery(sql);
   }
 
   public async close(): Promise<void> {
+    if (this.statsTimer) {
+      clearInterval(this.statsTimer);
+    }
     const db = await this.lock.close();
+    // The lock has no readers left, so the workers are idle.
+    await this.readPool?.close();
     db.close();
   }
 }
 
+/**
+ * Determines whether a database file name refers to an in-memory database.
+ * See https://www.sqlite.org/inmemorydb.html.
+ */
+const isMemoryDatabase = (file: string): boolean =>
+  file === ':memory:' ||
+  file.startsWith('file::memory:') ||
+  /^file:.*[?&]mode=memory(&|$)/.test(file);
+
 const getQueryLogSetting = (envValue: string | undefined) => {
   switch (envValue?.toLowerCase()) {
     case '1':
@@ -99,3 +166,32 @@ const getQueryLogSetting = (envValue: string | undefined) => {
       return false;
   }
 };
+
+/**
+ * Parses the interval, in seconds, at which collation statistics are logged.
+ * @param envValue The value of the environment variable.
+ * @return The interval in milliseconds, or null if statistics are not logged.
+ */
+const getStatsInterval = (envValue: string | undefined): number | null => {
+  const seconds = envValue ? Number(envValue) : NaN;
+  return seconds > 0 ? seconds * 1000 : null;
+};
+
+/**
+ * Logs the collation statistics of the process, which are collected by our
+ * SQLite extension, and resets them. Only the non-zero counters are logged.
+ */
+const logCollationStats = (logger: Logger, db: Database): void => {
+  // Statements that only read the stats don't touch the database file, so
+  // there's no need to go through the lock. The reset function returns the
+  // stats it cleared, so nothing is lost between reading and resetting.
+  const {stats: json} = db.prepare(
+    'select unicode_collation_stats_reset() as stats'
+  ).get() as {stats: string};
+  const stats = Object.entries(JSON.parse(json) as Record<string, number>);
+
+  if (stats.length > 0) {
+    const lines = stats.map(([name, value]) => `  ${name}: ${value}`);
+    logger.debug(`Collation stats:\n${lines.join('\n')}`);
+  }
+};
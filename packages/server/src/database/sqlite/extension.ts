@@ -2,32 +2,19 @@ import path from 'path';
 
 import {Database} from 'better-sqlite3';
 
-import {getServerRootDir} from '../../paths';
+import {getNativeDir} from '../../paths';
 
 // Our SQLite extension is not a Node module that is loaded with `require()`,
-// but a standalone dynamic library. We can't use the `bindings` package to
-// locate it. Instead, the build process places it in a well-known directory.
-//
-// When we're running inside the Electron app, the file is *outside* app.asar,
-// as SQLite cannot load extensions that reside within ASAR archives.
+// but a standalone dynamic library. See getNativeDir() for where it lives.
 
 const ExtensionName = 'condict.sqlite3-ext';
 
-const registerExtension = (db: Database): void => {
-  const serverRoot = getServerRootDir();
-
-  let extensionDir: string;
-  if (serverRoot.includes('app.asar')) {
-    // FIXME: This is a bit hacky.
-    // If the path to this file contains `app.asar`, we are (probably) running
-    // inside the main Condict app. This regex strips the `/asar.app/` part
-    // (`\` on Windows) and everything after it, and is likely quite fragile.
-    extensionDir = serverRoot.replace(/[/\\]app.asar[/\\].*$/, '/');
-  } else {
-    extensionDir = path.resolve(serverRoot, 'bin');
-  }
+/** Gets the path of the SQLite extension, for loading it on other threads. */
+export const getExtensionPath = (): string =>
+  path.join(getNativeDir(), ExtensionName);
 
-  db.loadExtension(path.join(extensionDir, ExtensionName));
+const registerExtension = (db: Database): void => {
+  db.loadExtension(getExtensionPath());
 };
 
 export default registerExtension;
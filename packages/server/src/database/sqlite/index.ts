@@ -12,3 +12,5 @@ export {
 } from './types';
 export {default as Connection} from './connection';
 export {default as RwLock} from './rwlock';
+export {default as ReadPool} from './read-pool';
+export {getExtensionPath} from './extension';
@@ -1,4 +1,4 @@
-import {QueryPlanNode} from './types';
+import {CollationCost, QueryPlanNode} from './types';
 
 /**
  * Formats a list of SQLite query plan nodes into a textual representation.
@@ -13,6 +13,24 @@ const formatQueryPlan = (nodes: readonly QueryPlanNode[]): string => {
 
 export default formatQueryPlan;
 
+/**
+ * Formats the collation cost of a query, as a single line that can be appended
+ * to the query plan.
+ * @param cost The measured collation cost.
+ * @return The formatted collation cost, or null if the query made no
+ *         comparisons.
+ */
+export const formatCollationCost = (cost: CollationCost): string | null => {
+  if (cost.comparisons === 0) {
+    return null;
+  }
+  const ms = (cost.nanoseconds / 1e6).toFixed(2);
+  return (
+    `Collation: ${cost.comparisons} comparisons, ` +
+    `${cost.codePoints} code points, ${ms} ms`
+  );
+};
+
 // The query plan formatter is a somewhat inefficient quadratic implementation
 // that basically assumes the node count is fairly low.
 // Two assumptions are made:
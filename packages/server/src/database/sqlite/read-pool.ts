@@ -0,0 +1,225 @@
+import {createRequire} from 'module';
+import {Worker} from 'worker_threads';
+
+import {getExtensionPath} from './extension';
+import {Param} from './types';
+
+// The worker's source code. The server is bundled into a single file, so the
+// worker can't be a module of its own: it's evaluated from this string, and
+// receives the paths of better-sqlite3 and our extension from the pool.
+//
+// Some connection state is not stored in the database, chiefly the language
+// collations, which are registered by `unicode_tailor()`. The pool gives each
+// worker a setup query that registers them. The worker runs it before its
+// first query, and again whenever another connection has written to the
+// database (when `pragma data_version` changes), as the writer may have
+// changed collation rules.
+const WorkerSource = `
+const {parentPort, workerData} = require('worker_threads');
+const Sqlite = require(workerData.sqlitePath);
+
+const db = new Sqlite(workerData.file, {readonly: true, fileMustExist: true});
+db.loadExtension(workerData.extensionPath);
+
+const dataVersion = db.prepare('pragma data_version').pluck();
+let setupSql = null;
+let setupVersion = null;
+
+const runQuery = (sql, params) => {
+  if (setupSql !== null) {
+    const version = dataVersion.get();
+    if (version !== setupVersion) {
+      db.prepare(setupSql).all();
+      setupVersion = version;
+    }
+  }
+  return db.prepare(sql).all(params);
+};
+
+parentPort.on('message', msg => {
+  switch (msg.type) {
+    case 'setup':
+      setupSql = msg.sql;
+      setupVersion = null;
+      break;
+    case 'query':
+      try {
+        const rows = runQuery(msg.sql, msg.params);
+        parentPort.postMessage({id: msg.id, rows});
+      } catch (e) {
+        parentPort.postMessage({id: msg.id, error: String(e?.message ?? e)});
+      }
+      break;
+    case 'close':
+      db.close();
+      parentPort.close();
+      break;
+  }
+});
+`;
+
+type WorkerRequest =
+  | {type: 'setup'; sql: string}
+  | {type: 'query'; id: number; sql: string; params: readonly Param[]}
+  | {type: 'close'};
+
+type WorkerResponse =
+  | {id: number; rows: unknown[]}
+  | {id: number; error: string};
+
+interface PendingQuery {
+  readonly resolve: (rows: unknown[]) => void;
+  readonly reject: (error: Error) => void;
+}
+
+interface ReadWorker {
+  readonly worker: Worker;
+  /** Queries that have been sent to the worker, by ID. */
+  readonly pending: Map<number, PendingQuery>;
+  /** False once the worker has exited or failed. */
+  alive: boolean;
+}
+
+/**
+ * Runs read-only queries on a pool of worker threads, each with its own
+ * read-only connection to the database. Expensive queries, such as those that
+ * sort many rows by a collation, can then run in parallel with each other and
+ * with the main thread, rather than blocking every other request.
+ *
+ * The pool does no locking of its own. Queries must be sent while holding a
+ * reader guard of the main connection's lock (see Accessor), so that no write
+ * transaction runs at the same time. Since the database is in WAL mode, each
+ * query sees everything committed before it started.
+ */
+export default class ReadPool {
+  private readonly workers: ReadWorker[];
+  private nextId = 1;
+
+  /**
+   * Starts the workers of a pool.
+   * @param file The database file. Must not be an in-memory database, which
+   *        other connections can't open.
+   * @param size The number of workers.
+   */
+  public constructor(file: string, size: number) {
+    // better-sqlite3 is external to our bundle, so the workers can load it
+    // from the same place as we do.
+    const require = createRequire(import.meta.url);
+    const workerData = {
+      file,
+      sqlitePath: require.resolve('better-sqlite3'),
+      extensionPath: getExtensionPath(),
+    };
+
+    this.workers = [];
+    for (let i = 0; i < size; i++) {
+      this.workers.push(this.startWorker(workerData));
+    }
+  }
+
+  /** True if the pool has any workers left to run queries on. */
+  public get isAvailable(): boolean {
+    return this.workers.some(w => w.alive);
+  }
+
+  /**
+   * Sets a query that every worker runs before its first query, and again
+   * whenever the database has been written to. It is used to register
+   * per-connection state, such as collations, on the workers' connections.
+   * @param sql The setup query.
+   */
+  public setSetupQuery(sql: string): void {
+    for (const w of this.workers) {
+      if (w.alive) {
+        this.send(w, {type: 'setup', sql});
+      }
+    }
+  }
+
+  /**
+   * Runs a read-only query on the least busy worker.
+   * @param sql The SQL query.
+   * @param params The query parameters.
+   * @return A promise that resolves with the rows that match the query. The
+   *         promise is rejected if the query fails, or if there are no workers
+   *         left.
+   */
+  public all<Row>(sql: string, params: readonly Param[]): Promise<Row[]> {
+    let target: ReadWorker | null = null;
+    for (const w of this.workers) {
+      if (w.alive && (!target || w.pending.size < target.pending.size)) {
+        target = w;
+      }
+    }
+    if (!target) {
+      return Promise.reject(new Error('There are no read workers left'));
+    }
+
+    const w = target;
+    const id = this.nextId++;
+    return new Promise<unknown[]>((resolve, reject) => {
+      if (w.pending.size === 0) {
+        // Keep the process alive while we're waiting for the result.
+        w.worker.ref();
+      }
+      w.pending.set(id, {resolve, reject});
+      this.send(w, {type: 'query', id, sql, params});
+    }) as Promise<Row[]>;
+  }
+
+  /**
+   * Stops all workers. Queries that have not finished are rejected.
+   * @return A promise that resolves when the workers have exited.
+   */
+  public async close(): Promise<void> {
+    const exits = this.workers
+      .filter(w => w.alive)
+      .map(w => new Promise<void>(resolve => {
+        w.worker.once('exit', () => resolve());
+        this.send(w, {type: 'close'});
+      }));
+    await Promise.all(exits);
+  }
+
+  private startWorker(workerData: object): ReadWorker {
+    const worker = new Worker(WorkerSource, {eval: true, workerData});
+    // Idle workers must not keep the process alive.
+    worker.unref();
+
+    const w: ReadWorker = {worker, pending: new Map(), alive: true};
+
+    worker.on('message', (msg: WorkerResponse) => {
+      const query = w.pending.get(msg.id);
+      if (!query) {
+        return;
+      }
+      w.pending.delete(msg.id);
+      if (w.pending.size === 0) {
+        worker.unref();
+      }
+      if ('error' in msg) {
+        query.reject(new Error(msg.error));
+      } else {
+        query.resolve(msg.rows);
+      }
+    });
+
+    const fail = (error: Error) => {
+      w.alive = false;
+      for (const query of w.pending.values()) {
+        query.reject(error);
+      }
+      w.pending.clear();
+    };
+    worker.on('error', fail);
+    worker.on('exit', () => {
+      fail(new Error('The read worker has exited'));
+    });
+
+    return w;
+  }
+
+  private send(w: ReadWorker, request: WorkerRequest): void {
+    w.worker.postMessage(request);
+  }
+}
@@ -6,6 +6,13 @@ export interface Options {
    * The path to the database file. The file is created if it does not exist.
    */
   readonly file: string;
+  /**
+   * The number of worker threads that run expensive read-only queries, each
+   * with its own connection to the database. If omitted, there is one worker
+   * per CPU core, up to 4. If 0, or if the database is in memory, all queries
+   * run on the main thread.
+   */
+  readonly readWorkers?: number;
 }
 
 export const validateOptions = (options: any): Options => {
@@ -21,7 +28,16 @@ export const validateOptions = (options: any): Options => {
   if (file === '') {
     throw new Error('Database file name cannot be empty.');
   }
-  return {file};
+
+  // eslint-disable-next-line @typescript-eslint/no-unsafe-member-access, @typescript-eslint/no-unsafe-assignment
+  const readWorkers = options.readWorkers;
+  if (
+    readWorkers !== undefined &&
+    !(Number.isInteger(readWorkers) && readWorkers >= 0)
+  ) {
+    throw new Error('Database read worker count must be a non-negative integer.');
+  }
+  return {file, readWorkers};
 };
 
 /**
@@ -80,6 +96,28 @@ export interface DataReader {
    */
   all<Row>(parts: TemplateStringsArray, ...values: Value[]): Row[];
 
+  /**
+   * Fetches all rows that match a query, on a read worker thread if there is
+   * one. Use this for expensive queries, such as those that sort many rows by
+   * a collation, so that other requests can run in the meantime. Inside a
+   * transaction, the query runs on the main thread, as only the main
+   * connection can see the transaction's changes.
+   * @param query An SQL query string.
+   * @return A promise that resolves with the rows that match the query.
+   */
+  allAsync<Row>(query: string): Promise<Row[]>;
+  /**
+   * Fetches all rows that match a query, on a read worker thread if there is
+   * one. This overload should be used as a template string tag.
+   * @param parts Template string parts.
+   * @param values Values to be embedded in the query.
+   * @return A promise that resolves with the rows that match the query.
+   */
+  allAsync<Row>(
+    parts: TemplateStringsArray,
+    ...values: Value[]
+  ): Promise<Row[]>;
+
   /**
    * Treats the specified string as raw SQL, enabling it to be inserted into
    * queries and commands without being escaped.
@@ -336,7 +374,10 @@ export type Param = string | number | null;
 /** A function that logs an executed SQL string. */
 export interface SqlLogger {
   readonly logQuery: (sql: string) => void;
-  readonly logQueryPlan?: (nodes: QueryPlanNode[]) => void;
+  readonly logQueryPlan?: (
+    nodes: QueryPlanNode[],
+    collationCost: CollationCost | null
+  ) => void;
 }
 
 /** A query plan node, as returned by SQLite's `explain query plan`. */
@@ -345,3 +386,16 @@ export interface QueryPlanNode {
   readonly parentId: number;
   readonly description: string;
 }
+
+/**
+ * The time a query spent comparing strings by collation, as measured by our
+ * SQLite extension's `unicode_collation_measure_stop()`.
+ */
+export interface CollationCost {
+  /** The number of comparisons. */
+  readonly comparisons: number;
+  /** The number of code points that the comparisons read. */
+  readonly codePoints: number;
+  /** The total time of the comparisons, in nanoseconds. */
+  readonly nanoseconds: number;
+}
@@ -23,13 +23,18 @@ const getSchemaVersion = (db: DataReader) => {
   return +result.value;
 };
 
+/**
+ * Creates the tables that do not exist yet, and fills the ones that store sort
+ * keys. Returns the names of the tables that were created.
+ */
 const createSchema = (
   logger: Logger,
   db: DataWriter,
   config: ServerConfig,
   isNewSchema: boolean
-) => {
-  for (const {name, commands} of schema) {
+): Set<string> => {
+  const createdTables = new Set<string>();
+  for (const {name, commands, rebuild} of schema) {
     const tableExists = db.tableExists(name);
     if (tableExists) {
       if (isNewSchema) {
@@ -45,6 +50,10 @@ const createSchema = (
     for (const command of commands) {
       db.exec(command);
     }
+    for (const command of rebuild ?? []) {
+      db.exec(command);
+    }
+    createdTables.add(name);
   }
 
   if (isNewSchema) {
@@ -53,6 +62,125 @@ const createSchema = (
       values ('schema_version', ${String(ServerSchemaVersion)})
     `;
   }
+  return createdTables;
+};
+
+type CollationVersions = Record<string, string>;
+
+const getCollationVersions = (db: DataReader): CollationVersions => {
+  type Row = { value: string };
+
+  const result = db.get<Row>`
+    select value
+    from schema_info
+    where name = 'collation_versions'
+  `;
+  return result !== null ? JSON.parse(result.value) : {};
+};
+
+/**
+ * Finds the indexes that use a collation from the SQLite extension, and groups
+ * them by collation. Collation names are lowercased, since SQLite ignores the
+ * case of ASCII letters in them.
+ */
+const getIndexesByCollation = (db: DataReader): Map<string, string[]> => {
+  type Row = {
+    index_name: string;
+    collation: string;
+  };
+
+  const rows = db.all<Row>`
+    select distinct
+      il.name as index_name,
+      lower(ix.coll) as collation
+    from sqlite_master t
+    join pragma_index_list(t.name) il
+    join pragma_index_xinfo(il.name) ix
+    where t.type = 'table'
+      and ix.key = 1
+      and lower(ix.coll) like 'unicode%'
+  `;
+
+  const result = new Map<string, string[]>();
+  for (const row of rows) {
+    const indexes = result.get(row.collation);
+    if (indexes) {
+      indexes.push(row.index_name);
+    } else {
+      result.set(row.collation, [row.index_name]);
+    }
+  }
+  return result;
+};
+
+/**
+ * Compares the version of each collation that is used by an index with the
+ * version that the index was built with, and rebuilds the indexes whose
+ * collation has changed, such as after an upgrade to a newer version of
+ * Unicode. Tables that store sort keys are refilled when the default
+ * collation changes. Then stores the current versions. If the database has no
+ * stored versions, it was created before they were tracked, and every index
+ * that uses a Unicode collation is rebuilt once. Tables in `createdTables` were
+ * filled by createSchema() and are not refilled.
+ */
+const updateCollations = (
+  logger: Logger,
+  db: DataWriter,
+  isNewSchema: boolean,
+  createdTables: ReadonlySet<string>
+) => {
+  const stored = getCollationVersions(db);
+  const current: CollationVersions = {};
+  const staleIndexes: string[] = [];
+
+  for (const [collation, indexes] of getIndexesByCollation(db)) {
+    const {version} = db.getRequired<{version: string | null}>`
+      select unicode_collation_version(${collation}) as version
+    `;
+    if (version === null) {
+      // Not a collation that the extension knows about, so there is nothing
+      // we can check.
+      continue;
+    }
+    current[collation] = version;
+
+    if (!isNewSchema && stored[collation] !== version) {
+      logger.info(
+        `Collation ${collation} has changed: ${
+          stored[collation] ?? '(unknown)'
+        } -> ${version}`
+      );
+      staleIndexes.push(...indexes);
+    }
+  }
+
+  for (const index of staleIndexes) {
+    logger.info(`Rebuilding index: ${index}`);
+    db.exec(`reindex "${index.replace(/"/g, '""')}"`);
+  }
+
+  // Sort keys are built with the default collation, whether or not an index
+  // uses it.
+  const {version: unicodeVersion} = db.getRequired<{version: string}>`
+    select unicode_collation_version('unicode') as version
+  `;
+  current.unicode = unicodeVersion;
+  if (!isNewSchema && stored.unicode !== unicodeVersion) {
+    for (const {name, rebuild} of schema) {
+      if (rebuild && !createdTables.has(name)) {
+        logger.info(`Rebuilding sort keys: ${name}`);
+        for (const command of rebuild) {
+          db.exec(command);
+        }
+      }
+    }
+  }
+
+  db.exec`
+    insert into schema_info (name, value)
+    values ('collation_versions', ${JSON.stringify(current)})
+    on conflict (name) do update set value = excluded.value
+  `;
 };
 
 const createNewSchema = (
@@ -63,12 +191,14 @@ const createNewSchema = (
   logger.info(
     'No schema_info or schema version found: initializing new database.'
   );
-  return createSchema(logger, db, config, true);
+  const createdTables = createSchema(logger, db, config, true);
+  updateCollations(logger, db, true, createdTables);
 };
 
 const verifySchema = (logger: Logger, db: DataWriter, config: ServerConfig) => {
   logger.info('Database schema is up to date. Verifying existing tables.');
-  return createSchema(logger, db, config, false);
+  const createdTables = createSchema(logger, db, config, false);
+  updateCollations(logger, db, false, createdTables);
 };
 
 const migrateSchema = (
@@ -1,6 +1,7 @@
 import {
   Language as LanguageModel,
   LanguageStats as LanguageStatsModel,
+  LanguageCollation,
   LanguageMut,
   Description,
   Definition,
@@ -28,6 +29,8 @@ import {ResolversFor, Mutators} from './types';
 const Language: ResolversFor<LanguageType, LanguageRow> = {
   description: (p, _args, {db}) => Description.parsedById(db, p.description_id),
 
+  collationRules: (p, _args, {db}) => LanguageCollation.rulesById(db, p.id),
+
   partsOfSpeech: (p, _args, {db}) => PartOfSpeech.allByLanguage(db, p.id),
 
   partOfSpeechByName: (p, {name}, {db}) => PartOfSpeech.byName(db, p.id, name),
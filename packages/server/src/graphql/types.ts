@@ -643,6 +643,11 @@ export type EditLanguageInput = {
    * If set, updates the language's description.
    */
   description?: BlockElementInput[] | null;
+  /**
+   * If set, updates the language's collation rules. The empty string removes the
+   * rules, so that the language uses the default order.
+   */
+  collationRules?: string | null;
 };
 
 /**
@@ -1445,6 +1450,22 @@ export type Language = {
    * Formatted text that provides a description of the language.
    */
   description: BlockElement[];
+  /**
+   * The rules that define the alphabetical order of the language, relative to the
+   * default order. If null, the language uses the default order. The rules use a
+   * subset of the CLDR syntax, for example:
+   * 
+   * ```
+   * &n < ng <<< Ng <<< NG
+   * &t < þ <<< Þ
+   * ```
+   * 
+   * `&x` resets the insertion point to after `x`. The operators `<`, `<<`, `<<<`
+   * and `=` insert the next string after the previous one, with a primary (base
+   * letter), secondary (accent), tertiary (case) or no difference respectively.
+   * Each case form must be listed separately.
+   */
+  collationRules: string | null;
   /**
    * The parts of speech that belong to this language.
    */
@@ -2330,6 +2351,12 @@ export type NewLanguageInput = {
    * null, the language has no description.
    */
   description?: BlockElementInput[] | null;
+  /**
+   * The rules that define the alphabetical order of the language. See the
+   * documentation of `Language.collationRules` for details. If omitted, null or
+   * empty, the language uses the default order.
+   */
+  collationRules?: string | null;
 };
 
 /**
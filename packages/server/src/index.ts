@@ -23,6 +23,7 @@ export {
   TagEvent,
 } from './event';
 export {validateLoggerOptions, validateServerConfig} from './config';
+export {CollationStrength, sortStrings} from './collation';
 export {
   Logger,
   LoggerOptions,
@@ -41,4 +42,6 @@ export {
   RawSql,
   Options as DatabaseConfig,
   RwLock as _INTERNAL_RwLock,
+  ReadPool as _INTERNAL_ReadPool,
+  getExtensionPath as _INTERNAL_getExtensionPath,
 } from './database';
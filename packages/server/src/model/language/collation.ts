@@ -0,0 +1,134 @@
+import {DataReader, RawSql} from '../../database';
+import {LanguageId} from '../../graphql';
+import {Logger} from '../../types';
+
+import {LanguageCollationRow} from './types';
+
+/**
+ * Custom alphabetical orders. Each language with collation rules gets its own
+ * SQLite collation, named by `LanguageCollation.name`, which must be registered
+ * on the connection before it can be used in a query. This happens when the
+ * server starts, and whenever the rules change.
+ */
+const LanguageCollation = {
+  rulesByIdKey: 'LanguageCollation.rulesById',
+
+  name(languageId: LanguageId): string {
+    return `unicode_language_${languageId}`;
+  },
+
+  async rulesById(
+    db: DataReader,
+    languageId: LanguageId
+  ): Promise<string | null> {
+    const row = await db.batchOneToOne(
+      this.rulesByIdKey,
+      languageId,
+      (db, ids) => db.all<LanguageCollationRow>`
+        select *
+        from language_collations
+        where language_id in (${ids})
+      `,
+      row => row.language_id
+    );
+    return row ? row.rules : null;
+  },
+
+  /**
+   * Determines whether a language has custom collation rules. Languages
+   * without rules use the default order.
+   * @param db The data reader.
+   * @param languageId The language to check.
+   * @return True if the language has rules.
+   */
+  hasRules(db: DataReader, languageId: LanguageId): boolean {
+    const row = db.get<{language_id: LanguageId}>`
+      select language_id
+      from language_collations
+      where language_id = ${languageId}
+    `;
+    return row !== null;
+  },
+
+  /**
+   * Returns an `order by` term that sorts the specified text column in the
+   * alphabetical order of the language.
+   * @param db The data reader.
+   * @param languageId The language whose order to use.
+   * @param column The column to sort by, as raw SQL.
+   * @return The column with an explicit collation if the language has custom
+   *         rules; otherwise, the column as-is.
+   */
+  orderBy(db: DataReader, languageId: LanguageId, column: string): RawSql {
+    return this.hasRules(db, languageId)
+      ? db.raw(`${column} collate ${this.name(languageId)}`)
+      : db.raw(column);
+  },
+
+  /**
+   * Validates collation rules.
+   * @param db The data reader.
+   * @param rules The rules to validate.
+   * @return A description of the first error in the rules, or null if the rules
+   *         are valid.
+   */
+  validateRules(db: DataReader, rules: string): string | null {
+    const {error} = db.getRequired<{error: string | null}>`
+      select unicode_tailoring_error(${rules}) as error
+    `;
+    return error;
+  },
+
+  /**
+   * Registers (or re-registers) the collation of a language on the connection.
+   * Languages without rules get the default order.
+   * @param db The data reader.
+   * @param languageId The language to register the collation for.
+   * @param rules The collation rules, or null to use the default order.
+   */
+  register(
+    db: DataReader,
+    languageId: LanguageId,
+    rules: string | null
+  ): void {
+    db.get`select unicode_tailor(${this.name(languageId)}, ${rules})`;
+  },
+
+  /**
+   * Registers the collations of all languages that have custom rules. If the
+   * rules of a language are invalid, the language gets the default order, so
+   * that queries that use the collation can still run.
+   * @param db The data reader.
+   * @param logger A logger that receives warnings about invalid rules.
+   */
+  registerAll(db: DataReader, logger: Logger): void {
+    const rows = db.all<LanguageCollationRow>`
+      select *
+      from language_collations
+    `;
+    for (const row of rows) {
+      const error = this.validateRules(db, row.rules);
+      if (error !== null) {
+        logger.warn(
+          `Invalid collation rules for language ${row.language_id}: ${error}`
+        );
+      }
+      this.register(db, row.language_id, error === null ? row.rules : null);
+    }
+  },
+
+  /**
+   * An SQL query that does the same as `registerAll`, without the warnings.
+   * It's used to register the collations on the connections of read workers,
+   * which rerun it whenever the database changes. See Connection.
+   */
+  registerAllQuery: `
+    select unicode_tailor(
+      'unicode_language_' || language_id,
+      case when unicode_tailoring_error(rules) is null then rules end
+    )
+    from language_collations
+  `,
+} as const;
+
+export {LanguageCollation};
@@ -1,3 +1,4 @@
 export {Language, LanguageStats} from './model';
+export {LanguageCollation} from './collation';
 export {LanguageMut} from './mut';
 export * from './types';
@@ -10,15 +10,19 @@ import {InflectionTableMut} from '../inflection-table';
 import {TagMut} from '../tag';
 
 import {Language} from './model';
+import {LanguageCollation} from './collation';
 import {LanguageRow} from './types';
-import {validateName} from './validators';
-import {MutContext} from '../types';
+import {validateName, validateCollationRules} from './validators';
+import {MutContext, WriteContext} from '../types';
 
 const LanguageMut = {
   insert(context: MutContext, data: NewLanguageInput): Promise<LanguageRow> {
-    const {name, description} = data;
+    const {name, description, collationRules} = data;
 
     const validName = validateName(context.db, null, name);
+    const validRules = collationRules != null
+      ? validateCollationRules(context.db, collationRules)
+      : null;
 
     return MutContext.transact(context, context => {
       const {db, events, logger} = context;
@@ -32,6 +36,10 @@ const LanguageMut = {
 
       SearchIndexMut.insertLanguage(db, languageId, validName);
 
+      if (validRules !== null) {
+        setCollationRules(context, languageId, validRules);
+      }
+
       events.emit({type: 'language', action: 'create', id: languageId});
       logger.verbose(`Created language: ${languageId}`);
 
@@ -45,7 +53,7 @@ const LanguageMut = {
     data: EditLanguageInput
   ): Promise<LanguageRow> {
     const {db} = context;
-    const {name, description} = data;
+    const {name, description, collationRules} = data;
 
     const language = await Language.byIdRequired(db, id);
 
@@ -54,7 +62,12 @@ const LanguageMut = {
       newFields.set('name', validateName(db, language.id, name));
     }
 
-    if (newFields.hasValues || description) {
+    // Undefined means unchanged; null means the rules are removed.
+    const newRules = collationRules != null
+      ? validateCollationRules(db, collationRules)
+      : undefined;
+
+    if (newFields.hasValues || description || newRules !== undefined) {
       await MutContext.transact(context, context => {
         const {db, events, logger} = context;
         newFields.set('time_updated', Date.now());
@@ -74,6 +87,10 @@ const LanguageMut = {
           DescriptionMut.update(db, language.description_id, description);
         }
 
+        if (newRules !== undefined) {
+          setCollationRules(context, language.id, newRules);
+        }
+
         events.emit({type: 'language', action: 'update', id: language.id});
         logger.verbose(`Updated language: ${language.id}`);
 
@@ -119,6 +136,9 @@ const LanguageMut = {
       DescriptionMut.delete(db, language.description_id);
       logger.debug('Deleted description');
 
+      setCollationRules(context, language.id, null);
+      logger.debug('Deleted collation rules');
+
       SearchIndexMut.deleteLanguage(db, language.id);
 
       events.emit({type: 'language', action: 'delete', id: language.id});
@@ -132,4 +152,28 @@ const LanguageMut = {
   },
 } as const;
 
+const setCollationRules = (
+  context: WriteContext,
+  languageId: LanguageId,
+  rules: string | null
+): void => {
+  const {db} = context;
+  if (rules !== null) {
+    db.exec`
+      insert into language_collations (language_id, rules)
+      values (${languageId}, ${rules})
+      on conflict (language_id) do update set rules = excluded.rules
+    `;
+  } else {
+    db.exec`
+      delete from language_collations
+      where language_id = ${languageId}
+    `;
+  }
+  context.afterCommit(db => {
+    LanguageCollation.register(db, languageId, rules);
+    db.clearCache(LanguageCollation.rulesByIdKey, languageId);
+  });
+};
+
 export {LanguageMut};
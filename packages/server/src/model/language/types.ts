@@ -18,3 +18,8 @@ export type LanguageStatsRow = {
   part_of_speech_count: number;
   tag_count: number;
 };
+
+export type LanguageCollationRow = {
+  language_id: LanguageId;
+  rules: string;
+};
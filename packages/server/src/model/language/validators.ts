@@ -1,8 +1,11 @@
 import {DataReader} from '../../database';
 import {LanguageId} from '../../graphql';
+import {UserInputError} from '../../errors';
 
 import validator, {minLength, unique} from '../validator';
 
+import {LanguageCollation} from './collation';
+
 export const validateName = (
   db: DataReader,
   currentId: LanguageId | null,
@@ -24,3 +27,23 @@ export const validateName = (
       name => `There is already a language with the name '${name}'`
     ))
     .validate(value);
+
+export const validateCollationRules = (
+  db: DataReader,
+  value: string
+): string | null =>
+  validator<string>('collationRules')
+    .do(rules => rules.trim())
+    .do((rules, paramName) => {
+      if (rules === '') {
+        return null;
+      }
+      const error = LanguageCollation.validateRules(db, rules);
+      if (error !== null) {
+        throw new UserInputError(`Invalid collation rules: ${error}`, {
+          invalidArgs: [paramName],
+        });
+      }
+      return rules;
+    })
+    .validate(value);
@@ -9,7 +9,8 @@ import {
   validatePageParams,
 } from '../../graphql';
 
-import paginate from '../paginate';
+import {LanguageCollation} from '../language/collation';
+import {paginateAsync} from '../paginate';
 import {ItemConnection} from '../types';
 
 import {
@@ -72,7 +73,7 @@ const Lemma = {
     page: PageParams | undefined | null,
     filter: LemmaFilter | undefined | null,
     info?: GraphQLResolveInfo
-  ): ItemConnection<LemmaRow> {
+  ): Promise<ItemConnection<LemmaRow>> {
     page = validatePageParams(page ?? this.defaultPagination, this.maxPerPage);
     if (filter && isFilteringNeeded(filter)) {
       return this.allByLanguageFiltered(db, languageId, page, filter, info);
@@ -86,23 +87,47 @@ const Lemma = {
     languageId: LanguageId,
     page: PageParams,
     info?: GraphQLResolveInfo
-  ): ItemConnection<LemmaRow> {
-    return paginate(
+  ): Promise<ItemConnection<LemmaRow>> {
+    const getTotal = () => {
+      const {total} = db.getRequired<{total: number}>`
+        select lng.lemma_count as total
+        from languages lng
+        where lng.id = ${languageId}
+      `;
+      return total;
+    };
+
+    if (LanguageCollation.hasRules(db, languageId)) {
+      // There are no ranks in custom orders, so we have to step over all the
+      // lemmas before the page.
+      const collation = LanguageCollation.name(languageId);
+      return paginateAsync(
+        page,
+        getTotal,
+        (limit, offset) => db.allAsync<LemmaRow>`
+          select l.*
+          from lemmas l
+          where l.language_id = ${languageId}
+          order by l.term collate ${db.raw(collation)}
+          limit ${limit} offset ${offset}
+        `,
+        info
+      );
+    }
+
+    // In the default order, lemma_ranks finds the first lemma of the page
+    // directly.
+    return paginateAsync(
       page,
-      () => {
-        const {total} = db.getRequired<{total: number}>`
-          select lng.lemma_count as total
-          from languages lng
-          where lng.id = ${languageId}
-        `;
-        return total;
-      },
-      (limit, offset) => db.all<LemmaRow>`
+      getTotal,
+      (limit, offset) => db.allAsync<LemmaRow>`
         select l.*
-        from lemmas l
-        where l.language_id = ${languageId}
-        order by l.term
-        limit ${limit} offset ${offset}
+        from lemma_ranks r
+        join lemmas l on l.id = r.rowid
+        where r.group_id = ${languageId}
+          and r.rank >= ${offset}
+        order by r.rank
+        limit ${limit}
       `,
       info
     );
@@ -114,15 +139,15 @@ const Lemma = {
     page: PageParams,
     filter: LemmaFilter,
     info?: GraphQLResolveInfo
-  ): ItemConnection<LemmaRow> {
+  ): Promise<ItemConnection<LemmaRow>> {
     if (isFilterImpossible(filter)) {
-      return {
+      return Promise.resolve({
         page: {
           ...page,
           totalCount: 0,
         },
         nodes: [],
-      };
+      });
     }
 
     // If tags are specified, force DEFINED_LEMMAS_ONLY, as we currently do not
@@ -141,7 +166,8 @@ const Lemma = {
     const whereAnyMatch = filter.kind === 'ALL_LEMMAS'
       ? db.raw`and (d.lemma_id is not null or dd.lemma_id is not null)`
       : db.raw``;
-    return paginate(
+    const order = LanguageCollation.orderBy(db, languageId, 'l.term');
+    return paginateAsync(
       validatePageParams(page ?? this.defaultPagination, this.maxPerPage),
       () => {
         const {total} = db.getRequired<{total: number}>`
@@ -153,13 +179,13 @@ const Lemma = {
         `;
         return total;
       },
-      (limit, offset) => db.all<LemmaRow>`
+      (limit, offset) => db.allAsync<LemmaRow>`
         select l.*
         from lemmas l
         ${source}
         where l.language_id = ${languageId}
           ${whereAnyMatch}
-        order by l.term
+        order by ${order}
         limit ${limit} offset ${offset}
       `,
       info
@@ -167,21 +193,23 @@ const Lemma = {
   },
 
   firstInLanguage(db: DataReader, languageId: LanguageId): LemmaRow | null {
+    const order = LanguageCollation.orderBy(db, languageId, 'term');
     return db.get<LemmaRow>`
       select *
       from lemmas
       where language_id = ${languageId}
-      order by term asc
+      order by ${order} asc
       limit 1
     `;
   },
 
   lastInLanguage(db: DataReader, languageId: LanguageId): LemmaRow | null {
+    const order = LanguageCollation.orderBy(db, languageId, 'term');
     return db.get<LemmaRow>`
       select *
       from lemmas
       where language_id = ${languageId}
-      order by term desc
+      order by ${order} desc
       limit 1
     `;
   },
@@ -1,5 +1,5 @@
 import {LemmaId, LanguageId, DefinitionId} from '../../graphql';
-import {DataWriter} from '../../database';
+import {DataReader, DataWriter} from '../../database';
 
 import {SearchIndexMut} from '../search-index';
 import {WriteContext} from '../types';
@@ -8,6 +8,45 @@ import {Lemma} from './model';
 import {ValidTerm} from './validators';
 
 const LemmaMut = {
+  /**
+   * Converts a term to NFC, which is how terms are stored. The conversion is
+   * done by the SQLite extension, so that it uses the same Unicode data as the
+   * collation. Canonically equivalent terms always compare equal, so terms
+   * that were stored before normalization still match.
+   */
+  normalizeTerm(db: DataReader, term: ValidTerm): ValidTerm {
+    const result = db.getRequired<{term: ValidTerm}>`
+      select unicode_nfc(${term}) as term
+    `;
+    return result.term;
+  },
+
+  /**
+   * Converts several terms to NFC, as `normalizeTerm` does, in a single query.
+   * @param db The data reader.
+   * @param terms The terms to convert.
+   * @return A map from each term to its NFC form.
+   */
+  normalizeTerms(
+    db: DataReader,
+    terms: readonly ValidTerm[]
+  ): Map<string, ValidTerm> {
+    type Row = {
+      term: string;
+      nfc_term: ValidTerm;
+    };
+
+    const rows = db.all<Row>`
+      select
+        value as term,
+        unicode_nfc(value) as nfc_term
+      from json_each(${JSON.stringify(terms)})
+    `;
+    return new Map<string, ValidTerm>(
+      rows.map<[string, ValidTerm]>(row => [row.term, row.nfc_term])
+    );
+  },
+
   insert(
     context: WriteContext,
     languageId: LanguageId,
@@ -15,6 +54,7 @@ const LemmaMut = {
   ): LemmaId {
     const {db, events, logger} = context;
 
+    term = LemmaMut.normalizeTerm(db, term);
     const {insertId} = db.exec<LemmaId>`
       insert into lemmas (language_id, term)
       values (${languageId}, ${term})
@@ -34,6 +74,7 @@ const LemmaMut = {
     term: ValidTerm
   ): LemmaId {
     const {db, logger} = context;
+    term = LemmaMut.normalizeTerm(db, term);
     const result = db.get<{id: LemmaId}>`
       select id
       from lemmas
@@ -64,19 +105,26 @@ const LemmaMut = {
       return new Map<string, LemmaId>();
     }
 
+    // Several terms may normalize to the same thing, in which case they share
+    // a lemma.
+    const normalized = LemmaMut.normalizeTerms(db, terms);
+    const uniqueTerms = Array.from(new Set(normalized.values()));
+
+    // Existing terms may not be in NFC, but they compare equal to their NFC
+    // form, so we key the map on that.
     const result = db.all<Row>`
       select
         id,
-        term
+        unicode_nfc(term) as term
       from lemmas
       where language_id = ${languageId}
-        and term in (${terms})
+        and term in (${uniqueTerms})
     `;
-    const termToId = new Map<string, LemmaId>(
+    const nfcToId = new Map<string, LemmaId>(
       result.map<[string, LemmaId]>(row => [row.term, row.id])
     );
 
-    const newTerms = terms.filter(t => !termToId.has(t));
+    const newTerms = uniqueTerms.filter(t => !nfcToId.has(t));
     if (newTerms.length > 0) {
       const newLemmas = db.all<Row>`
         insert into lemmas (language_id, term)
@@ -90,7 +138,7 @@ const LemmaMut = {
       this.updateLemmaCount(db, languageId);
 
       for (const lemma of newLemmas) {
-        termToId.set(lemma.term, lemma.id);
+        nfcToId.set(lemma.term, lemma.id);
         events.emit({
           type: 'lemma',
           action: 'create',
@@ -101,11 +149,19 @@ const LemmaMut = {
     }
 
     const created = newTerms.length;
-    const existing = terms.length - created;
+    const existing = uniqueTerms.length - created;
     logger.debug(
       `Bulk creation of lemmas: ${created} created, ${existing} existing`
     );
 
+    // The caller looks up lemmas by the terms it passed in.
+    const termToId = new Map<string, LemmaId>();
+    for (const [term, nfcTerm] of normalized) {
+      const id = nfcToId.get(nfcTerm);
+      if (id !== undefined) {
+        termToId.set(term, id);
+      }
+    }
     return termToId;
   },
 
@@ -140,6 +196,7 @@ const LemmaMut = {
     };
 
     const {db, events, logger} = context;
+    newTerm = LemmaMut.normalizeTerm(db, newTerm);
     const result = db.getRequired<Row>`
       select
         (
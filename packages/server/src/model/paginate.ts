@@ -94,4 +94,39 @@ const paginate = <T>(
   };
 };
 
+/**
+ * Like `paginate`, but the nodes are fetched asynchronously, typically with
+ * `DataReader.allAsync`. The total is still fetched synchronously, as it is
+ * usually cheap.
+ * @param page Determines which page to fetch and how many items to fetch
+ *        from that page.
+ * @param getTotal A callback that returns the total number of matching items.
+ * @param getNodes A callback that returns a promise of the nodes in the
+ *        current page. It receives the limit and the start offset.
+ * @param info The GraphQL resolver info. See `paginate`.
+ * @return A promise of a connection value with the nodes of the current page
+ *         and pagination details.
+ */
+export const paginateAsync = async <T>(
+  page: PageParams,
+  getTotal: () => number,
+  getNodes: (limit: number, offset: number) => Promise<T[]>,
+  info?: GraphQLResolveInfo
+): Promise<ItemConnection<T>> => {
+  const selected = findSelectedFields(info);
+
+  const offset = page.page * page.perPage;
+  const totalCount = selected.page ? getTotal() : 0;
+  const nodes = selected.nodes ? await getNodes(page.perPage, offset) : [];
+
+  return {
+    page: {
+      page: page.page,
+      perPage: page.perPage,
+      totalCount,
+    },
+    nodes,
+  };
+};
+
 export default paginate;
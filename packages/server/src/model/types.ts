@@ -1,4 +1,4 @@
-import {DataAccessor, DataWriter} from '../database';
+import {DataAccessor, DataReader, DataWriter} from '../database';
 import {DictionaryEventEmitter} from '../event';
 import DictionaryEventQueue from '../event-queue';
 import {Context, PageInfo} from '../graphql';
@@ -31,23 +31,39 @@ export const MutContext = {
    *         promise is rejected if an error occurs inside the callback, or if
    *         the database's underlying readers-writer lock is closed.
    */
-  transact<R>(
+  async transact<R>(
     context: MutContext,
     callback: (ctx: WriteContext) => Awaitable<R>
   ): Promise<R> {
     const {db, events: parentEvents, logger} = context;
-    return db.transact(async db => {
+    const commitCallbacks: ((db: DataReader) => void)[] = [];
+    const result = await db.transact(async db => {
       // We must buffer events that occur during the transaction. If it fails,
       // we can't emit any of those events.
       const events = new DictionaryEventQueue();
-      const result = await callback({db, events, logger});
+      const afterCommit = (callback: (db: DataReader) => void) => {
+        commitCallbacks.push(callback);
+      };
+      const result = await callback({db, events, logger, afterCommit});
       events.drainInto(parentEvents);
       return result;
     });
+    for (const commitCallback of commitCallbacks) {
+      commitCallback(db);
+    }
+    return result;
   },
 } as const;
 
-export type WriteContext = BaseContext<DataWriter>;
+export interface WriteContext extends BaseContext<DataWriter> {
+  /**
+   * Schedules a callback to run after the transaction has been committed. If
+   * the transaction is rolled back, the callback is never called.
+   * @param callback The callback to schedule. It receives a DataReader that
+   *        sees the committed changes.
+   */
+  readonly afterCommit: (callback: (db: DataReader) => void) => void;
+}
 
 /** A value that can be awaited. */
 export type Awaitable<T> = T | Promise<T>;
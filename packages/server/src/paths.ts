@@ -10,3 +10,22 @@ export const getServerRootDir = (): string =>
 
 export const getGraphqlSchemaDir = (): string =>
   path.join(getServerRootDir(), 'graphql-schema');
+
+// Our native binaries (the SQLite extension and the collation addon) are not
+// located with the `bindings` package. Instead, the build process places them
+// in a well-known directory.
+//
+// When we're running inside the Electron app, the files are *outside*
+// app.asar, as SQLite cannot load extensions that reside within ASAR archives,
+// and Node cannot load addons from them either.
+export const getNativeDir = (): string => {
+  const serverRoot = getServerRootDir();
+  if (serverRoot.includes('app.asar')) {
+    // FIXME: This is a bit hacky.
+    // If the path to this file contains `app.asar`, we are (probably) running
+    // inside the main Condict app. This regex strips the `/asar.app/` part
+    // (`\` on Windows) and everything after it, and is likely quite fragile.
+    return serverRoot.replace(/[/\\]app.asar[/\\].*$/, '/');
+  }
+  return path.resolve(serverRoot, 'bin');
+};
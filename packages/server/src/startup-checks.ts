@@ -1,12 +1,55 @@
 import {Connection, ensureSchemaIsValid} from './database';
+import {LanguageCollation} from './model';
 import {ServerConfig, Logger} from './types';
 
+const checkCollationData = async (
+  logger: Logger,
+  connection: Connection
+): Promise<void> => {
+  const db = await connection.getAccessor();
+  try {
+    const {source, error} = db.getRequired<{
+      source: string | null;
+      error: string | null;
+    }>`
+      select
+        unicode_data_source() as source,
+        unicode_data_error() as error
+    `;
+    if (error !== null) {
+      logger.warn(
+        `Could not load collation data file, using embedded tables: ${error}`
+      );
+    } else if (source !== null) {
+      logger.info(`Using collation data file: ${source}`);
+    }
+  } finally {
+    db.finish();
+  }
+};
+
+const registerCollations = async (
+  logger: Logger,
+  connection: Connection
+): Promise<void> => {
+  const db = await connection.getAccessor();
+  try {
+    LanguageCollation.registerAll(db, logger);
+  } finally {
+    db.finish();
+  }
+  connection.setReaderSetupQuery(LanguageCollation.registerAllQuery);
+};
+
 const performStartupChecks = async (
   logger: Logger,
   config: ServerConfig,
   connection: Connection
 ): Promise<void> => {
   await ensureSchemaIsValid(logger, config, connection);
+  await checkCollationData(logger, connection);
+  // Collations must be registered before any query that uses them is run.
+  await registerCollations(logger, connection);
 };
 
 export default performStartupChecks;
@@ -0,0 +1,91 @@
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const Sqlite = require('better-sqlite3');
+
+const {_INTERNAL_ReadPool: ReadPool} = require('../../dist');
+
+describe('ReadPool', function() {
+  // Workers load better-sqlite3 and the extension when they start.
+  this.slow(500);
+
+  let dir;
+  let file;
+  let db;
+  let pool;
+
+  beforeEach(() => {
+    dir = fs.mkdtempSync(path.join(os.tmpdir(), 'condict-read-pool-'));
+    file = path.join(dir, 'test.sqlite');
+    db = new Sqlite(file);
+    db.pragma('journal_mode = WAL');
+    db.exec(`
+      create table words (id integer primary key, word text not null);
+      insert into words (word) values ('b'), ('A'), ('a'), ('ä');
+    `);
+    pool = new ReadPool(file, 2);
+  });
+
+  afterEach(async () => {
+    await pool.close();
+    db.close();
+    fs.rmSync(dir, {recursive: true, force: true});
+  });
+
+  it('runs queries with parameters', async () => {
+    const rows = await pool.all(
+      'select word from words where id > ? order by id',
+      [1]
+    );
+    assert.deepStrictEqual(rows.map(r => r.word), ['A', 'a', 'ä']);
+  });
+
+  it('loads the extension on the workers', async () => {
+    const rows = await pool.all(
+      'select word from words order by word collate unicode',
+      []
+    );
+    assert.deepStrictEqual(rows.map(r => r.word), ['a', 'A', 'ä', 'b']);
+  });
+
+  it('runs queries in parallel', async () => {
+    const results = await Promise.all(
+      [1, 2, 3, 4].map(id =>
+        pool.all('select word from words where id = ?', [id])
+      )
+    );
+    assert.deepStrictEqual(
+      results.map(rows => rows[0].word),
+      ['b', 'A', 'a', 'ä']
+    );
+  });
+
+  it('rejects failed queries', async () => {
+    await assert.rejects(
+      pool.all('select * from no_such_table', []),
+      /no such table/
+    );
+    // The worker is still usable.
+    const rows = await pool.all('select count(*) as n from words', []);
+    assert.strictEqual(rows[0].n, 4);
+  });
+
+  it('reruns the setup query after writes', async () => {
+    db.exec(`create table rules (name text, rules text)`);
+    pool.setSetupQuery('select unicode_tailor(name, rules) from rules');
+
+    const query = 'select word from words order by word collate test';
+    await assert.rejects(pool.all(query, []), /no such collation/);
+
+    db.prepare('insert into rules values (?, ?)').run('test', '&b < a');
+    const results = await Promise.all([
+      pool.all(query, []),
+      pool.all(query, []),
+    ]);
+    for (const rows of results) {
+      assert.deepStrictEqual(rows.map(r => r.word), ['A', 'b', 'a', 'ä']);
+    }
+  });
+});
@@ -0,0 +1,169 @@
+const assert = require('assert');
+
+const Sqlite = require('better-sqlite3');
+
+const {_INTERNAL_getExtensionPath: getExtensionPath} = require('../../dist');
+
+describe('unicode_rank', () => {
+  let db;
+
+  // The rows of the rank table, in the order that the table must keep them.
+  const expectedRows = group => db.prepare(`
+    select
+      id as rowid,
+      row_number() over (order by unicode_sort_key(word), id) - 1 as rank
+    from words
+    where grp = ?
+    order by rank
+  `).all(group);
+
+  const actualRows = group => db.prepare(`
+    select rowid, rank
+    from ranks
+    where group_id = ?
+    order by rank
+  `).all(group);
+
+  beforeEach(() => {
+    db = new Sqlite(':memory:');
+    db.loadExtension(getExtensionPath());
+    db.exec(`
+      create table words (id integer primary key, grp integer, word text);
+      create virtual table ranks using unicode_rank;
+    `);
+  });
+
+  afterEach(() => {
+    db.close();
+  });
+
+  const insertWords = words => {
+    const insertWord = db.prepare(
+      'insert into words (id, grp, word) values (?, ?, ?)'
+    );
+    const insertRank = db.prepare(`
+      insert into ranks (rowid, group_id, key)
+      values (?, ?, unicode_sort_key(?))
+    `);
+    db.transaction(() => {
+      for (const [id, group, word] of words) {
+        insertWord.run(id, group, word);
+        insertRank.run(id, group, word);
+      }
+    })();
+  };
+
+  // Enough words to fill several levels of nodes.
+  const manyWords = () => {
+    const words = [];
+    for (let i = 1; i <= 5000; i++) {
+      words.push([i, i % 3, `w${(i * 7919) % 5000}`]);
+    }
+    return words;
+  };
+
+  it('ranks rows within their group', () => {
+    insertWords([
+      [1, 1, 'b'],
+      [2, 1, 'ä'],
+      [3, 2, 'b'],
+      [4, 1, 'a'],
+    ]);
+    assert.deepStrictEqual(actualRows(1), [
+      {rowid: 4, rank: 0},
+      {rowid: 2, rank: 1},
+      {rowid: 1, rank: 2},
+    ]);
+    assert.deepStrictEqual(actualRows(2), [{rowid: 3, rank: 0}]);
+
+    const {rank} = db.prepare('select rank from ranks where rowid = 1').get();
+    assert.strictEqual(rank, 2);
+  });
+
+  it('finds pages by rank', () => {
+    insertWords(manyWords());
+    const expected = expectedRows(1);
+
+    const page = db.prepare(`
+      select rowid, rank
+      from ranks
+      where group_id = 1 and rank >= ?
+      order by rank
+      limit 50
+    `);
+    for (const offset of [0, 50, 1200, 1650]) {
+      assert.deepStrictEqual(
+        page.all(offset),
+        expected.slice(offset, offset + 50)
+      );
+    }
+  });
+
+  it('stays in order after updates and deletes', () => {
+    insertWords(manyWords());
+    db.exec(`
+      delete from words where id % 4 = 0;
+      delete from ranks where rowid % 4 = 0;
+
+      update words set word = 'x' || word where id % 5 = 0;
+      update ranks
+      set key = (
+        select unicode_sort_key(word) from words where id = ranks.rowid
+      )
+      where rowid % 5 = 0;
+
+      update words set grp = 2 where id % 7 = 0;
+      update ranks set group_id = 2 where rowid % 7 = 0;
+    `);
+    for (const group of [0, 1, 2]) {
+      assert.deepStrictEqual(actualRows(group), expectedRows(group));
+    }
+  });
+
+  it('counts keys in a range', () => {
+    insertWords(manyWords());
+    const count = db.prepare(`
+      select unicode_rank_count(
+        'ranks',
+        2,
+        unicode_sort_key(?),
+        unicode_sort_key(?)
+      ) as n
+    `);
+    const expected = db.prepare(`
+      select count(*) as n
+      from words
+      where grp = 2
+        and word collate unicode >= ?
+        and word collate unicode < ?
+    `);
+    for (const [lower, upper] of [['w1', 'w2'], ['w', 'x'], ['w3', 'w30']]) {
+      assert.strictEqual(
+        count.get(lower, upper).n,
+        expected.get(lower, upper).n
+      );
+    }
+
+    const {n} = db.prepare("select unicode_rank_count('ranks', 2) as n").get();
+    assert.strictEqual(n, expectedRows(2).length);
+  });
+
+  it('rolls back with the transaction', () => {
+    insertWords(manyWords());
+    const before = actualRows(0);
+    assert.throws(() => {
+      db.transaction(() => {
+        db.exec('delete from ranks where rowid % 2 = 0');
+        throw new Error('rollback');
+      })();
+    }, /rollback/);
+    assert.deepStrictEqual(actualRows(0), before);
+  });
+
+  it('rejects rows without a rowid', () => {
+    assert.throws(
+      () => db.exec(`insert into ranks (group_id, key) values (1, x'00')`),
+      /rowid must be an integer/
+    );
+  });
+});
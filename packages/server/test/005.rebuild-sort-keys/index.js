@@ -0,0 +1,126 @@
+const assert = require('assert');
+
+const Sqlite = require('better-sqlite3');
+
+const {_INTERNAL_getExtensionPath: getExtensionPath} = require('../../dist');
+
+describe('unicode_rebuild_sort_keys', () => {
+  let db;
+
+  // More than two batches of rows, so that the workers and the writer overlap.
+  const rowCount = 20000;
+
+  const keysOf = () => db.prepare('select id, k from t order by id').all();
+
+  beforeEach(() => {
+    db = new Sqlite(':memory:');
+    db.loadExtension(getExtensionPath());
+    db.exec(`
+      create table t (id integer primary key, w text, k blob);
+
+      with recursive n(i) as (
+        select 1
+        union all
+        select i + 1 from n where i < ${rowCount}
+      )
+      insert into t (id, w, k)
+      select i, 'w' || ((i * 7919) % ${rowCount}), x'00'
+      from n;
+
+      update t set w = null where id % 1000 = 0;
+    `);
+  });
+
+  afterEach(() => {
+    db.close();
+  });
+
+  it('writes the sort key of every row', () => {
+    const {n} = db.prepare(
+      "select unicode_rebuild_sort_keys('t', 'w', 'k') as n"
+    ).get();
+    assert.strictEqual(n, rowCount);
+
+    const {wrong} = db.prepare(`
+      select count(*) as wrong
+      from t
+      where k is not unicode_sort_key(w)
+    `).get();
+    assert.strictEqual(wrong, 0);
+  });
+
+  it('writes reverse sort keys', () => {
+    db.exec("select unicode_rebuild_sort_keys('t', 'w', 'k', 1)");
+
+    const {wrong} = db.prepare(`
+      select count(*) as wrong
+      from t
+      where k is not unicode_reverse_sort_key(w)
+    `).get();
+    assert.strictEqual(wrong, 0);
+  });
+
+  it('changes no keys if a write fails', () => {
+    // Fails in the second batch, after the first has been written.
+    db.exec(`
+      create trigger fail_update before update on t when new.id = 15000
+      begin
+        select raise(abort, 'update failed');
+      end;
+    `);
+    const before = keysOf();
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('t', 'w', 'k')"),
+      /update failed/
+    );
+    assert.deepStrictEqual(keysOf(), before);
+  });
+
+  it('keeps the enclosing transaction', () => {
+    db.exec(`
+      create trigger fail_update before update on t when new.id = 15000
+      begin
+        select raise(abort, 'update failed');
+      end;
+    `);
+    db.exec('begin');
+    db.exec("update t set k = x'01' where id = 1");
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('t', 'w', 'k')"),
+      /update failed/
+    );
+    assert.strictEqual(db.inTransaction, true);
+    const {k} = db.prepare('select k from t where id = 1').get();
+    assert.deepStrictEqual(k, Buffer.from([1]));
+    db.exec('commit');
+  });
+
+  it('rejects unknown tables and columns', () => {
+    const before = keysOf();
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('nope', 'w', 'k')"),
+      /no such table: nope/
+    );
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('t', 'nope', 'k')"),
+      /no such column: t\.nope/
+    );
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('t', 'w', 'nope')"),
+      /no such column: t\.nope/
+    );
+    assert.deepStrictEqual(keysOf(), before);
+  });
+
+  it('rejects the same column for text and key', () => {
+    const before = db.prepare('select id, w from t order by id').all();
+    assert.throws(
+      () => db.exec("select unicode_rebuild_sort_keys('t', 'w', 'W')"),
+      /text and key columns must differ/
+    );
+    assert.deepStrictEqual(
+      db.prepare('select id, w from t order by id').all(),
+      before
+    );
+  });
+});